@@ -0,0 +1,96 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+// The replacements live in a translation unit of their own: where the compiler could
+// inline them into the code that allocates, it would see malloc's memory handed to
+// operator delete and warn of a mismatch. Every form allocates and frees with the same
+// pair, so none of them can be mixed up either.
+namespace
+{
+	std::atomic<size_t> g_allocations(0);
+	std::atomic<size_t> g_bytes(0);
+
+	void* Allocate(size_t size) noexcept
+	{
+		g_allocations++;
+		g_bytes += size;
+		return malloc(size ? size : 1);
+	}
+
+	void* AllocateOrThrow(size_t size)
+	{
+		if (void* p = Allocate(size))
+			return p;
+		throw std::bad_alloc();
+	}
+
+#if defined(__cpp_aligned_new)
+	void* AllocateAligned(size_t size, std::align_val_t alignment) noexcept
+	{
+		g_allocations++;
+		g_bytes += size;
+		const size_t align = size_t(alignment);
+#if defined(_MSC_VER)
+		return _aligned_malloc(size ? size : 1, align);
+#else
+		void* p = nullptr;
+		return posix_memalign(&p, align < sizeof(void*) ? sizeof(void*) : align, size ? size : 1) == 0 ? p : nullptr;
+#endif
+	}
+
+	void* AllocateAlignedOrThrow(size_t size, std::align_val_t alignment)
+	{
+		if (void* p = AllocateAligned(size, alignment))
+			return p;
+		throw std::bad_alloc();
+	}
+
+	void FreeAligned(void* p) noexcept
+	{
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+#endif
+}
+
+size_t AllocationCounter::Allocations()
+{
+	return g_allocations;
+}
+
+size_t AllocationCounter::Bytes()
+{
+	return g_bytes;
+}
+
+void* operator new(size_t size) { return AllocateOrThrow(size); }
+void* operator new[](size_t size) { return AllocateOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+#if defined(__cpp_aligned_new)
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateAlignedOrThrow(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AllocateAlignedOrThrow(size, alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateAligned(size, alignment); }
+void operator delete(void* p, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { FreeAligned(p); }
+#endif
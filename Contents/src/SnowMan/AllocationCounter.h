@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+
+// Heap allocations made through operator new since the program started. Linking
+// AllocationCounter.cpp replaces every form of the global operator new and delete
+// with counting ones, so only the benchmark links it; the app keeps the CRT's.
+namespace AllocationCounter
+{
+	size_t Allocations();
+	size_t Bytes();
+}
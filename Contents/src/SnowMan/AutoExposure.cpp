@@ -0,0 +1,112 @@
+#include "AutoExposure.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+const uint32_t AutoExposure::HistogramBins;
+
+namespace
+{
+	const size_t HistogramGrain = 16384;		// pixels per partial histogram
+
+	float BinsPerStop(const ExposureSettings& settings)
+	{
+		return float(AutoExposure::HistogramBins) / (settings.maxLogLuminance - settings.minLogLuminance);
+	}
+}
+
+AutoExposure::AutoExposure(const ExposureSettings& settings) :
+	m_settings(settings)
+{
+}
+
+LuminanceHistogramConstants AutoExposure::Constants(uint32_t width, uint32_t height) const
+{
+	LuminanceHistogramConstants c;
+	c.minLogLuminance = m_settings.minLogLuminance;
+	c.logLuminanceScale = BinsPerStop(m_settings);
+	c.width = width;
+	c.height = height;
+	return c;
+}
+
+uint32_t AutoExposure::Bin(const float rgb[3], const ExposureSettings& settings)
+{
+	// Rec.709 luminance, as in luminanceHistogram.hlsl
+	float luminance = rgb[0] * 0.2126f + rgb[1] * 0.7152f + rgb[2] * 0.0722f;
+	float t = (std::log2(luminance) - settings.minLogLuminance) * BinsPerStop(settings);
+	if (!(t > 0.0f))
+		return 0;
+	if (t >= float(HistogramBins - 1))
+		return HistogramBins - 1;
+	return uint32_t(t);
+}
+
+void AutoExposure::BuildHistogram(const float* rgb, size_t count, const ExposureSettings& settings,
+	uint32_t histogram[HistogramBins], JobSystem* jobs)
+{
+	memset(histogram, 0, sizeof(uint32_t) * HistogramBins);
+	if (!jobs || count <= HistogramGrain) {
+		for (size_t i = 0; i < count; i++)
+			histogram[Bin(rgb + i * 3, settings)]++;
+		return;
+	}
+	// One partial histogram per block of pixels, added up in block order
+	const size_t blocks = (count + HistogramGrain - 1) / HistogramGrain;
+	std::vector<uint32_t> partial(blocks * HistogramBins, 0);
+	jobs->ParallelFor(0, blocks, 1, [&](size_t first, size_t last) {
+		for (size_t b = first; b < last; b++) {
+			uint32_t* bins = &partial[b * HistogramBins];
+			const size_t end = std::min(count, (b + 1) * HistogramGrain);
+			for (size_t i = b * HistogramGrain; i < end; i++)
+				bins[Bin(rgb + i * 3, settings)]++;
+		}
+	});
+	for (size_t b = 0; b < blocks; b++) {
+		for (uint32_t i = 0; i < HistogramBins; i++)
+			histogram[i] += partial[b * HistogramBins + i];
+	}
+}
+
+float AutoExposure::AverageLogLuminance(const uint32_t histogram[HistogramBins], const ExposureSettings& settings)
+{
+	double total = 0.0;
+	for (uint32_t i = 0; i < HistogramBins; i++)
+		total += histogram[i];
+	const double low = total * settings.lowPercentile;
+	const double high = total * settings.highPercentile;
+	const double stopsPerBin = 1.0 / BinsPerStop(settings);
+
+	// Weigh each bin centre by how many of its pixels fall between the percentiles
+	double below = 0.0, sum = 0.0, weight = 0.0;
+	for (uint32_t i = 0; i < HistogramBins; i++) {
+		const double from = std::max(below, low);
+		const double to = std::min(below + histogram[i], high);
+		if (to > from) {
+			sum += (to - from) * (settings.minLogLuminance + (i + 0.5) * stopsPerBin);
+			weight += to - from;
+		}
+		below += histogram[i];
+	}
+	return weight > 0.0 ? float(sum / weight) : settings.minLogLuminance;
+}
+
+void AutoExposure::SetHistogram(const uint32_t histogram[HistogramBins])
+{
+	float target = std::log2(m_settings.keyValue) - AverageLogLuminance(histogram, m_settings);
+	m_target = std::min(std::max(target, m_settings.minExposure), m_settings.maxExposure);
+}
+
+float AutoExposure::Adapt(float deltaTime)
+{
+	const float rate = m_target < m_exposure ? m_settings.brightAdaptation : m_settings.darkAdaptation;
+	m_exposure += (m_target - m_exposure) * (1.0f - std::exp(-deltaTime * rate));
+	return m_exposure;
+}
+
+void AutoExposure::Reset(float exposure)
+{
+	m_exposure = m_target = exposure;
+}
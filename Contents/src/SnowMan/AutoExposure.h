@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class JobSystem;
+
+struct ExposureSettings
+{
+	float minLogLuminance = -8.0f;	// log2 of the darkest luminance the histogram tells apart
+	float maxLogLuminance = 4.0f;	// and of the brightest
+	float lowPercentile = 0.5f;		// the darkest half of the pixels is left out of the average
+	float highPercentile = 0.95f;	// and so are the brightest 5%
+	float keyValue = 0.18f;			// middle grey the average luminance is exposed to
+	float minExposure = -6.0f;		// exposure limits, in stops
+	float maxExposure = 6.0f;
+	float brightAdaptation = 3.0f;	// per second, when the exposure goes down (the scene got brighter)
+	float darkAdaptation = 1.0f;	// per second, when it goes up
+};
+
+// The HistogramBuffer cbuffer of luminanceHistogram.hlsl.
+struct LuminanceHistogramConstants
+{
+	float minLogLuminance;
+	float logLuminanceScale;		// bins per stop
+	uint32_t width;
+	uint32_t height;
+};
+
+// Auto-exposure from a histogram of log2 luminance. luminanceHistogram.hlsl builds the
+// histogram of the HDR scene on the GPU; BuildHistogram is its CPU reference and bins
+// each pixel the same way. The exposure is in stops (the scene is scaled by 2^exposure)
+// and moves towards the histogram's target at the adaptation rates, exponentially.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+class AutoExposure
+{
+public:
+	static const uint32_t HistogramBins = 64;
+
+	explicit AutoExposure(const ExposureSettings& settings = ExposureSettings());
+
+	const ExposureSettings& Settings() const { return m_settings; }
+	void SetSettings(const ExposureSettings& settings) { m_settings = settings; }
+	LuminanceHistogramConstants Constants(uint32_t width, uint32_t height) const;
+
+	// Histogram bin of a linear RGB colour; black and NaN land in bin 0.
+	static uint32_t Bin(const float rgb[3], const ExposureSettings& settings);
+	// Histogram of count pixels of three floats each, spread over jobs when given; the
+	// counts do not depend on how the pixels were split.
+	static void BuildHistogram(const float* rgb, size_t count, const ExposureSettings& settings,
+		uint32_t histogram[HistogramBins], JobSystem* jobs = nullptr);
+	// Mean log2 luminance of the pixels between the low and high percentiles, at bin
+	// centres; minLogLuminance for an empty histogram.
+	static float AverageLogLuminance(const uint32_t histogram[HistogramBins], const ExposureSettings& settings);
+
+	// Sets the exposure the adaptation heads for from a new histogram.
+	void SetHistogram(const uint32_t histogram[HistogramBins]);
+	// Moves the exposure towards the target; returns it.
+	float Adapt(float deltaTime);
+	// Jumps straight to exposure, as the target too.
+	void Reset(float exposure = 0.0f);
+
+	float Exposure() const { return m_exposure; }
+	float TargetExposure() const { return m_target; }
+
+private:
+	ExposureSettings m_settings;
+	float m_exposure = 0.0f;
+	float m_target = 0.0f;
+};
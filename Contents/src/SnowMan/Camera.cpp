@@ -1,15 +1,29 @@
 #include "pch.h"
 #include "Camera.h"
+#include <limits>
 
 using namespace DirectX;
 
+namespace
+{
+	const float NoTurn = std::numeric_limits<float>::quiet_NaN();
+
+	inline XMMATRIX Load(const float* m)
+	{
+		return XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(m));
+	}
+}
+
 Camera::Camera()
-	: position(0.0f, 0.0f, 0.0f),
+	: turnPitch(NoTurn),
+	turnYaw(NoTurn),
+	position(0.0f, 0.0f, 0.0f),
 	right(1.0f, 0.0f, 0.0f),
 	up(0.0f, 1.0f, 0.0f),
 	look(0.0f, 0.0f, 1.0f)
 {
 	SetLens(XMConvertToRadians(45.0f), 1280.0f/960.f, 0.1f, 1000.0f);
+	UpdateViewMatrix();
 }
 
 Camera::~Camera()
@@ -28,12 +42,15 @@ XMFLOAT3 Camera::GetPosition()
 
 void Camera::SetPosition(float x, float y, float z)
 {
-	position = XMFLOAT3(x, y, z);
+	SetPosition(XMFLOAT3(x, y, z));
 }
 
 void Camera::SetPosition(const XMFLOAT3& v)
 {
+	if (v.x == position.x && v.y == position.y && v.z == position.z)
+		return;
 	position = v;
+	poseDirty = true;
 }
 
 XMVECTOR Camera::GetRightXM()const
@@ -116,16 +133,16 @@ void Camera::SetLens(float fovY, float aspect, float zn, float zf)
 {
 	// cache properties
 	fovy = fovY;
-	aspect = aspect;
+	this->aspect = aspect;
 	near_clip = zn;
 	far_clip = zf;
 
 	nearWindowHeight = 2.0f * near_clip * tanf(0.5f*fovy);
 	farWindowHeight = 2.0f * far_clip * tanf(0.5f*fovy);
 
-	XMMATRIX P = XMMatrixPerspectiveFovLH(fovy, aspect, near_clip, far_clip);
-	//P = XMMatrixOrthographicLH(40.0, 40.0, near_clip, far_clip);
-	XMStoreFloat4x4(&projection, P);
+	// XMMatrixPerspectiveFovLH(fovy, aspect, near_clip, far_clip), rebuilt only if the lens changed
+	matrices.SetPerspective(fovy, aspect, near_clip, far_clip);
+	matrices.Update();
 }
 
 void Camera::LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR worldUp)
@@ -138,6 +155,8 @@ void Camera::LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR worldUp)
 	XMStoreFloat3(&look, L);
 	XMStoreFloat3(&right, R);
 	XMStoreFloat3(&up, U);
+	turnPitch = turnYaw = NoTurn;
+	poseDirty = true;
 }
 
 void Camera::LookAt(const XMFLOAT3& pos, const XMFLOAT3& target, const XMFLOAT3& up)
@@ -151,44 +170,85 @@ void Camera::LookAt(const XMFLOAT3& pos, const XMFLOAT3& target, const XMFLOAT3&
 
 XMMATRIX Camera::View()const
 {
-	return XMLoadFloat4x4(&view);
+	return Load(matrices.View());
 }
 
 XMMATRIX Camera::Proj()const
 {
-	return XMLoadFloat4x4(&projection);
+	return Load(matrices.Projection());
 }
 
 XMMATRIX Camera::ViewProj()const
 {
-	return XMMatrixMultiply(View(), Proj());
+	return Load(matrices.ViewProjection());
+}
+
+XMMATRIX Camera::InvView()const
+{
+	return Load(matrices.InverseView());
+}
+
+XMMATRIX Camera::InvProj()const
+{
+	return Load(matrices.InverseProjection());
+}
+
+XMMATRIX Camera::InvViewProj()const
+{
+	return Load(matrices.InverseViewProjection());
+}
+
+const FrustumPlanes& Camera::Frustum()const
+{
+	return matrices.Frustum();
+}
+
+uint32_t Camera::ViewRevision()const
+{
+	return matrices.ViewRevision();
+}
+
+uint32_t Camera::ProjRevision()const
+{
+	return matrices.ProjectionRevision();
 }
 
 void Camera::Strafe(float d)
 {
+	if (d == 0.0f)
+		return;
 	// position += d*right
 	XMVECTOR s = XMVectorReplicate(d);
 	XMVECTOR r = XMLoadFloat3(&right);
 	XMVECTOR p = XMLoadFloat3(&position);
 	XMStoreFloat3(&position, XMVectorMultiplyAdd(s, r, p));
+	poseDirty = true;
 }
 
 void Camera::Walk(float d)
 {
+	if (d == 0.0f)
+		return;
 	// position += d*look
 	XMVECTOR s = XMVectorReplicate(d);
 	XMVECTOR l = XMLoadFloat3(&look);
 	XMVECTOR p = XMLoadFloat3(&position);
 	XMStoreFloat3(&position, XMVectorMultiplyAdd(s, l, p));
+	poseDirty = true;
 }
 
 void Camera::Turn(float pitch, float yaw) {
+	// Called every frame with the mouse look angles; the basis only depends on them
+	if (pitch == turnPitch && yaw == turnYaw)
+		return;
 	float y = sinf(pitch);
 	float r = cosf(pitch);
 	float z = r * cosf(yaw);
 	float x = r * sinf(yaw);
 	XMFLOAT3 target = DirectX::XMFLOAT3(position.x + x, position.y + y, position.z + z);
 	LookAt(position, target, DirectX::XMFLOAT3(0.0, 1.0, 0.0));
+	turnPitch = pitch;
+	turnYaw = yaw;
 }
 
 void Camera::Pitch(float angle)
@@ -199,6 +259,8 @@ void Camera::Pitch(float angle)
 
 	XMStoreFloat3(&up, XMVector3TransformNormal(XMLoadFloat3(&up), R));
 	XMStoreFloat3(&look, XMVector3TransformNormal(XMLoadFloat3(&look), R));
+	turnPitch = turnYaw = NoTurn;
+	poseDirty = true;
 }
 
 void Camera::RotateY(float angle)
@@ -210,14 +272,19 @@ void Camera::RotateY(float angle)
 	XMStoreFloat3(&right, XMVector3TransformNormal(XMLoadFloat3(&right), R));
 	XMStoreFloat3(&up, XMVector3TransformNormal(XMLoadFloat3(&up), R));
 	XMStoreFloat3(&look, XMVector3TransformNormal(XMLoadFloat3(&look), R));
+	turnPitch = turnYaw = NoTurn;
+	poseDirty = true;
 }
 
 void Camera::UpdateViewMatrix()
 {
+	if (!poseDirty) {
+		matrices.Update();
+		return;
+	}
 	XMVECTOR R = XMLoadFloat3(&right);
 	XMVECTOR U = XMLoadFloat3(&up);
 	XMVECTOR L = XMLoadFloat3(&look);
-	XMVECTOR P = XMLoadFloat3(&position);
 
 	// Keep camera's axes orthogonal to each other and of unit length.
 	L = XMVector3Normalize(L);
@@ -226,33 +293,13 @@ void Camera::UpdateViewMatrix()
 	// U, L already ortho-normal, so no need to normalize cross product.
 	R = XMVector3Cross(U, L);
 
-	// Fill in the view matrix entries.
-	float x = -XMVectorGetX(XMVector3Dot(P, R));
-	float y = -XMVectorGetX(XMVector3Dot(P, U));
-	float z = -XMVectorGetX(XMVector3Dot(P, L));
-
 	XMStoreFloat3(&right, R);
 	XMStoreFloat3(&up, U);
 	XMStoreFloat3(&look, L);
 
-	view(0, 0) = right.x;
-	view(1, 0) = right.y;
-	view(2, 0) = right.z;
-	view(3, 0) = x;
-
-	view(0, 1) = up.x;
-	view(1, 1) = up.y;
-	view(2, 1) = up.z;
-	view(3, 1) = y;
-
-	view(0, 2) = look.x;
-	view(1, 2) = look.y;
-	view(2, 2) = look.z;
-	view(3, 2) = z;
-
-	view(0, 3) = 0.0f;
-	view(1, 3) = 0.0f;
-	view(2, 3) = 0.0f;
-	view(3, 3) = 1.0f;
+	// The view matrix has the basis in its columns and -P.R, -P.U, -P.L in its last row
+	matrices.SetPose(&position.x, &right.x, &up.x, &look.x);
+	matrices.Update();
+	poseDirty = false;
 }
 
@@ -1,12 +1,20 @@
 #pragma once
 #include "pch.h"
+#include "CameraMatrices.h"
 
 // Thanks for the examples of Introduction-to-3D-Game-Programming-With-DirectX11 
+// The matrices are cached in CameraMatrices: moving or turning the camera only marks
+// them stale, UpdateViewMatrix rebuilds them once, and the getters return the copies
+// from that call.
 class Camera
 {
 private:
-	DirectX::XMFLOAT4X4 projection;
-	DirectX::XMFLOAT4X4 view;
+	CameraMatrices matrices;
+	// Set by whatever moves or turns the camera, cleared by UpdateViewMatrix
+	bool poseDirty = true;
+	// The angles the basis was last turned to by Turn; NaN once anything else turns it
+	float turnPitch;
+	float turnYaw;
 	float fovy = 45;
 	float aspect = 1.0;
 	float near_clip = 0.1;
@@ -61,10 +69,18 @@ public:
 	void LookAt(DirectX::FXMVECTOR pos, DirectX::FXMVECTOR target, DirectX::FXMVECTOR worldUp);
 	void LookAt(const DirectX::XMFLOAT3& pos, const DirectX::XMFLOAT3& target, const DirectX::XMFLOAT3& up);
 
-	// Get View/Proj matrices.
+	// Get View/Proj matrices, as of the last UpdateViewMatrix.
 	DirectX::XMMATRIX View()const;
 	DirectX::XMMATRIX Proj()const;
 	DirectX::XMMATRIX ViewProj()const;
+	DirectX::XMMATRIX InvView()const;
+	DirectX::XMMATRIX InvProj()const;
+	DirectX::XMMATRIX InvViewProj()const;
+	// World space frustum planes of ViewProj.
+	const FrustumPlanes& Frustum()const;
+	// Change whenever UpdateViewMatrix rebuilds the view or the projection.
+	uint32_t ViewRevision()const;
+	uint32_t ProjRevision()const;
 
 	// Strafe/Walk the camera a distance d.
 	void Strafe(float d);
@@ -76,6 +92,7 @@ public:
 	void RotateY(float angle);
 
 	// After modifying camera position/orientation, call to rebuild the view matrix.
+	// Rebuilds nothing if neither the pose nor the lens changed since the last call.
 	void UpdateViewMatrix();
 };
 
@@ -0,0 +1,126 @@
+#include "CameraMatrices.h"
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+CameraMatrices::CameraMatrices()
+{
+	const float pose[12] = { 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+	memcpy(m_pose, pose, sizeof(pose));
+	SetPerspective(0.785398f, 1.0f, 0.1f, 1000.0f);
+	Update();
+}
+
+void CameraMatrices::SetPose(const float position[3], const float right[3], const float up[3], const float look[3])
+{
+	float pose[12];
+	memcpy(pose, position, 3 * sizeof(float));
+	memcpy(pose + 3, right, 3 * sizeof(float));
+	memcpy(pose + 6, up, 3 * sizeof(float));
+	memcpy(pose + 9, look, 3 * sizeof(float));
+	if (memcmp(pose, m_pose, sizeof(pose)) == 0)
+		return;
+	memcpy(m_pose, pose, sizeof(pose));
+	m_viewDirty = true;
+}
+
+void CameraMatrices::SetPerspective(float fovY, float aspect, float nearZ, float farZ)
+{
+	const float lens[4] = { fovY, aspect, nearZ, farZ };
+	if (m_lensKind == Lens_Perspective && memcmp(lens, m_lens, sizeof(lens)) == 0)
+		return;
+	memcpy(m_lens, lens, sizeof(lens));
+	m_lensKind = Lens_Perspective;
+	m_projectionDirty = true;
+}
+
+void CameraMatrices::SetOrthographic(float width, float height, float nearZ, float farZ)
+{
+	const float lens[4] = { width, height, nearZ, farZ };
+	if (m_lensKind == Lens_Orthographic && memcmp(lens, m_lens, sizeof(lens)) == 0)
+		return;
+	memcpy(m_lens, lens, sizeof(lens));
+	m_lensKind = Lens_Orthographic;
+	m_projectionDirty = true;
+}
+
+bool CameraMatrices::Update()
+{
+	if (!m_viewDirty && !m_projectionDirty)
+		return false;
+
+	if (m_viewDirty) {
+		const float* p = m_pose;
+		const float* axes[3] = { m_pose + 3, m_pose + 6, m_pose + 9 };
+		// The basis in the columns, the position moved to the origin in the last row; the
+		// inverse has the basis in the rows and the position as it is
+		memset(m_view, 0, sizeof(m_view));
+		memset(m_inverseView, 0, sizeof(m_inverseView));
+		for (int a = 0; a < 3; a++) {
+			const float* axis = axes[a];
+			for (int i = 0; i < 3; i++) {
+				m_view[i * 4 + a] = axis[i];
+				m_inverseView[a * 4 + i] = axis[i];
+			}
+			m_view[12 + a] = -(p[0] * axis[0] + p[1] * axis[1] + p[2] * axis[2]);
+			m_inverseView[12 + a] = p[a];
+		}
+		m_view[15] = m_inverseView[15] = 1.0f;
+		m_viewRevision++;
+	}
+
+	if (m_projectionDirty) {
+		memset(m_projection, 0, sizeof(m_projection));
+		memset(m_inverseProjection, 0, sizeof(m_inverseProjection));
+		const float nearZ = m_lens[2], farZ = m_lens[3];
+		const float range = farZ / (farZ - nearZ);
+		if (m_lensKind == Lens_Perspective) {
+			const float height = 1.0f / std::tan(0.5f * m_lens[0]);
+			const float width = height / m_lens[1];
+			m_projection[0] = width;
+			m_projection[5] = height;
+			m_projection[10] = range;
+			m_projection[11] = 1.0f;
+			m_projection[14] = -range * nearZ;
+			// z' = range (z - near) / z solved for z; w' = z
+			m_inverseProjection[0] = 1.0f / width;
+			m_inverseProjection[5] = 1.0f / height;
+			m_inverseProjection[11] = 1.0f / m_projection[14];
+			m_inverseProjection[14] = 1.0f;
+			m_inverseProjection[15] = -range / m_projection[14];
+		}
+		else {
+			const float depth = 1.0f / (farZ - nearZ);
+			m_projection[0] = 2.0f / m_lens[0];
+			m_projection[5] = 2.0f / m_lens[1];
+			m_projection[10] = depth;
+			m_projection[14] = -depth * nearZ;
+			m_projection[15] = 1.0f;
+			m_inverseProjection[0] = 0.5f * m_lens[0];
+			m_inverseProjection[5] = 0.5f * m_lens[1];
+			m_inverseProjection[10] = farZ - nearZ;
+			m_inverseProjection[14] = nearZ;
+			m_inverseProjection[15] = 1.0f;
+		}
+		m_projectionRevision++;
+	}
+
+	Multiply(m_view, m_projection, m_viewProjection);
+	Multiply(m_inverseProjection, m_inverseView, m_inverseViewProjection);
+	ViewFrustum::ExtractSimd(m_viewProjection, m_frustum);
+	m_viewDirty = m_projectionDirty = false;
+	return true;
+}
+
+void CameraMatrices::Multiply(const float a[16], const float b[16], float result[16])
+{
+	const __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12);
+	for (int i = 0; i < 4; i++) {
+		// Row i of a weighs the rows of b
+		__m128 row = _mm_mul_ps(_mm_set1_ps(a[i * 4 + 0]), b0);
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i * 4 + 1]), b1));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i * 4 + 2]), b2));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i * 4 + 3]), b3));
+		_mm_storeu_ps(result + i * 4, row);
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include "ViewFrustum.h"
+
+// The matrices of a camera, kept between frames and rebuilt only when the pose or lens
+// they come from changed: view, projection, their product, the three inverses and the
+// world space frustum. Setting the same pose or lens again changes nothing. The
+// inverses are built from the pose and lens rather than by general inversion.
+// Matrices are row-major, row-vector (DirectXMath), left-handed, looking down +z.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+class CameraMatrices
+{
+public:
+	CameraMatrices();
+
+	// Position and orthonormal basis of the camera in the world.
+	void SetPose(const float position[3], const float right[3], const float up[3], const float look[3]);
+	// XMMatrixPerspectiveFovLH and XMMatrixOrthographicLH lenses.
+	void SetPerspective(float fovY, float aspect, float nearZ, float farZ);
+	void SetOrthographic(float width, float height, float nearZ, float farZ);
+
+	// Rebuilds what the changes since the last call affect; false if there were none.
+	bool Update();
+
+	const float* View() const { return m_view; }
+	const float* Projection() const { return m_projection; }
+	const float* ViewProjection() const { return m_viewProjection; }
+	const float* InverseView() const { return m_inverseView; }
+	const float* InverseProjection() const { return m_inverseProjection; }
+	const float* InverseViewProjection() const { return m_inverseViewProjection; }
+	const FrustumPlanes& Frustum() const { return m_frustum; }
+	// Bumped each time Update rebuilds the view or the projection.
+	uint32_t ViewRevision() const { return m_viewRevision; }
+	uint32_t ProjectionRevision() const { return m_projectionRevision; }
+
+	// 4x4 product a * b, four rows at a time.
+	static void Multiply(const float a[16], const float b[16], float result[16]);
+
+private:
+	enum Lens { Lens_Perspective, Lens_Orthographic };
+
+	float m_pose[12];			// position, right, up, look
+	float m_lens[4];
+	Lens m_lensKind = Lens_Perspective;
+	bool m_viewDirty = true;
+	bool m_projectionDirty = true;
+	uint32_t m_viewRevision = 0;
+	uint32_t m_projectionRevision = 0;
+
+	float m_view[16];
+	float m_projection[16];
+	float m_viewProjection[16];
+	float m_inverseView[16];
+	float m_inverseProjection[16];
+	float m_inverseViewProjection[16];
+	FrustumPlanes m_frustum;
+};
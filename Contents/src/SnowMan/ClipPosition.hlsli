@@ -0,0 +1,15 @@
+//--------------------------------------------------------------------------------------
+// ClipPosition.hlsli
+//
+// The one object-to-clip transform of the depth pre-pass and the main pass. The main
+// pass tests depth EQUAL against the pre-pass, so both must compute bit-identical
+// positions: precise keeps the compiler from fusing or reordering the math differently
+// in each shader. Callers that decode the position first declare it precise as well.
+//--------------------------------------------------------------------------------------
+float4 ClipPosition(float3 position, matrix world, matrix view, matrix projection)
+{
+	precise float4 clip = mul(float4(position, 1.0f), world);
+	clip = mul(clip, view);
+	clip = mul(clip, projection);
+	return clip;
+}
\ No newline at end of file
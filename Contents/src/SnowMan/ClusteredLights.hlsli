@@ -0,0 +1,47 @@
+//--------------------------------------------------------------------------------------
+// ClusteredLights.hlsli
+//
+// Point lights binned per froxel by LightClusters: a pixel finds its cluster from its
+// screen position and view depth and loops over that cluster's lights only.
+//--------------------------------------------------------------------------------------
+cbuffer ClusterBuffer : register(b1)
+{
+	float4 clusterScale;	// tiles per pixel x, y; depth slice = log(view depth) * z + w
+	float4 viewDepth;		// view depth = dot(world position, xyz) + w
+	uint4 clusterDim;		// tiles x, y, depth slices, lights
+};
+
+struct PointLight
+{
+	float3 position;
+	float radius;
+	float3 color;
+	float intensity;
+};
+
+StructuredBuffer<PointLight> pointLights : register(t3);
+StructuredBuffer<uint2> lightClusters : register(t4);		// offset, count into lightIndices
+StructuredBuffer<uint> lightIndices : register(t5);
+
+float3 ClusteredLighting(float2 pixel, float3 worldPosition, float3 normal)
+{
+	if (clusterDim.w == 0)
+		return 0;
+	float depth = dot(worldPosition, viewDepth.xyz) + viewDepth.w;
+	uint3 cluster;
+	cluster.xy = min(uint2(pixel * clusterScale.xy), clusterDim.xy - 1);
+	cluster.z = uint(clamp(log(max(depth, 1e-4f)) * clusterScale.z + clusterScale.w, 0.0f, float(clusterDim.z - 1)));
+	uint2 range = lightClusters[(cluster.z * clusterDim.y + cluster.y) * clusterDim.x + cluster.x];
+
+	float3 sum = 0;
+	for (uint i = 0; i < range.y; i++) {
+		PointLight light = pointLights[lightIndices[range.x + i]];
+		float3 toLight = light.position - worldPosition;
+		float distanceSq = dot(toLight, toLight);
+		// Smooth falloff to zero at the radius the lights were binned with
+		float falloff = saturate(1.0f - distanceSq / (light.radius * light.radius));
+		float diffuse = saturate(dot(normal, toLight) * rsqrt(max(distanceSq, 1e-8f)));
+		sum += light.color * (light.intensity * falloff * falloff * diffuse);
+	}
+	return sum;
+}
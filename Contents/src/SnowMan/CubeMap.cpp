@@ -0,0 +1,51 @@
+#include "CubeMap.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+uint32_t CubeMap::FromHorizontalCross(const uint32_t* texels, uint32_t width, uint32_t height, std::vector<uint32_t>& faces)
+{
+	if (width == 0 || width % 4 != 0 || width * 3 != height * 4)
+		throw std::invalid_argument("CubeMap::FromHorizontalCross: the atlas must be 4 x 3 square faces");
+	const uint32_t size = width / 4;
+	// Column and row of each face in the cross, CubeFace order
+	static const uint32_t cell[CubeFace_Count][2] = { { 2, 1 }, { 0, 1 }, { 1, 0 }, { 1, 2 }, { 1, 1 }, { 3, 1 } };
+
+	faces.resize(size_t(size) * size * CubeFace_Count);
+	for (int face = 0; face < CubeFace_Count; face++) {
+		const uint32_t* src = texels + size_t(cell[face][1]) * size * width + size_t(cell[face][0]) * size;
+		uint32_t* dst = faces.data() + size_t(face) * size * size;
+		for (uint32_t y = 0; y < size; y++)
+			memcpy(dst + size_t(y) * size, src + size_t(y) * width, size * sizeof(uint32_t));
+	}
+	return size;
+}
+
+CubeFace CubeMap::Lookup(const float direction[3], float& u, float& v)
+{
+	float x = direction[0], y = direction[1], z = direction[2];
+	float ax = fabsf(x), ay = fabsf(y), az = fabsf(z);
+	CubeFace face;
+	float s, t, major;
+	if (ax >= ay && ax >= az) {
+		face = x >= 0 ? CubeFace_PositiveX : CubeFace_NegativeX;
+		s = x >= 0 ? -z : z;
+		t = -y;
+		major = ax;
+	}
+	else if (ay >= az) {
+		face = y >= 0 ? CubeFace_PositiveY : CubeFace_NegativeY;
+		s = x;
+		t = y >= 0 ? z : -z;
+		major = ay;
+	}
+	else {
+		face = z >= 0 ? CubeFace_PositiveZ : CubeFace_NegativeZ;
+		s = z >= 0 ? x : -x;
+		t = -y;
+		major = az;
+	}
+	u = (s / major + 1.0f) * 0.5f;
+	v = (t / major + 1.0f) * 0.5f;
+	return face;
+}
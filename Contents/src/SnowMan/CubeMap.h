@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Faces in D3D11 texture array order.
+enum CubeFace
+{
+	CubeFace_PositiveX,
+	CubeFace_NegativeX,
+	CubeFace_PositiveY,
+	CubeFace_NegativeY,
+	CubeFace_PositiveZ,
+	CubeFace_NegativeZ,
+	CubeFace_Count
+};
+
+// CPU side of cube textures, with no D3D dependency.
+namespace CubeMap
+{
+	// Splits a horizontal cross atlas into six square faces, in CubeFace order, each
+	// row-major with its top row first. The atlas is 4 x 3 faces: -X, +Z, +X, -Z
+	// across the middle row, +Y above +Z and -Y below it. Returns the face size.
+	// Throws std::invalid_argument if the atlas is not 4:3.
+	uint32_t FromHorizontalCross(const uint32_t* texels, uint32_t width, uint32_t height, std::vector<uint32_t>& faces);
+
+	// The face a direction samples and the texture coordinates on it (0..1, v down),
+	// as the D3D11 sampler picks them.
+	CubeFace Lookup(const float direction[3], float& u, float& v);
+}
@@ -17,10 +17,16 @@ namespace DX
     class DeviceResources
     {
     public:
+        // Options: flip model presentation (Windows 10), and HDR10 output on displays that
+        // support it (implies flip; use an R10G10B10A2_UNORM back buffer).
+        static const unsigned int c_FlipPresent = 0x1;
+        static const unsigned int c_EnableHDR   = 0x2;
+
         DeviceResources(DXGI_FORMAT backBufferFormat = DXGI_FORMAT_B8G8R8A8_UNORM,
                         DXGI_FORMAT depthBufferFormat = DXGI_FORMAT_D32_FLOAT,
                         UINT backBufferCount = 2,
-                        D3D_FEATURE_LEVEL minFeatureLevel = D3D_FEATURE_LEVEL_10_0);
+                        D3D_FEATURE_LEVEL minFeatureLevel = D3D_FEATURE_LEVEL_10_0,
+                        unsigned int flags = 0);
 
         void CreateDeviceResources();
         void CreateWindowSizeDependentResources();
@@ -46,6 +52,8 @@ namespace DX
         DXGI_FORMAT             GetDepthBufferFormat() const            { return m_depthBufferFormat; }
         D3D11_VIEWPORT          GetScreenViewport() const               { return m_screenViewport; }
         UINT                    GetBackBufferCount() const              { return m_backBufferCount; }
+        DXGI_COLOR_SPACE_TYPE   GetColorSpace() const                   { return m_colorSpace; }
+        unsigned int            GetDeviceOptions() const                { return m_options; }
 
         // Performance events
         void PIXBeginEvent(_In_z_ const wchar_t* name)
@@ -65,6 +73,7 @@ namespace DX
 
     private:
         void GetHardwareAdapter(IDXGIAdapter1** ppAdapter);
+        void UpdateColorSpace();
 
         // Direct3D objects.
         Microsoft::WRL::ComPtr<ID3D11Device1>               m_d3dDevice;
@@ -90,6 +99,10 @@ namespace DX
         D3D_FEATURE_LEVEL                               m_d3dFeatureLevel;
         RECT                                            m_outputSize;
 
+        // HDR support
+        DXGI_COLOR_SPACE_TYPE                           m_colorSpace;
+        unsigned int                                    m_options;
+
         // The IDeviceNotify can be held directly as it owns the DeviceResources.
         IDeviceNotify*                                  m_deviceNotify;
     };
@@ -0,0 +1,27 @@
+#include "DrawOrder.h"
+#include <algorithm>
+#include <cstring>
+
+uint32_t DrawOrder::DepthKey(float depth)
+{
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	// Negative floats order backwards as integers: flip all their bits, and only the
+	// sign bit of positive ones.
+	return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+void DrawOrder::FrontToBack(const float view[16], const float* spheres, size_t stride,
+	uint32_t* indices, size_t count, uint64_t* keys)
+{
+	// Depth key above, index below: one sort of plain integers
+	const uint8_t* base = reinterpret_cast<const uint8_t*>(spheres);
+	for (size_t i = 0; i < count; i++) {
+		const float* s = reinterpret_cast<const float*>(base + indices[i] * stride);
+		float depth = s[0] * view[2] + s[1] * view[6] + s[2] * view[10] + view[14] - s[3];
+		keys[i] = (uint64_t(DepthKey(depth)) << 32) | indices[i];
+	}
+	std::sort(keys, keys + count);
+	for (size_t i = 0; i < count; i++)
+		indices[i] = uint32_t(keys[i]);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Draw ordering for the opaque passes, with no D3D dependency.
+namespace DrawOrder
+{
+	// Sortable key of a depth: nearer depths give smaller keys, for either sign.
+	uint32_t DepthKey(float depth);
+
+	// Sorts indices nearest first by the view depth of each bounding sphere's closest
+	// point, so early-Z rejects what later draws hide. Spheres are a center and radius
+	// (four floats, stride bytes apart) in world space, looked up by index; view is
+	// row-major, row-vector, looking down +z. Equal depths go in index order. keys is
+	// scratch space for count entries.
+	void FrontToBack(const float view[16], const float* spheres, size_t stride,
+		uint32_t* indices, size_t count, uint64_t* keys);
+}
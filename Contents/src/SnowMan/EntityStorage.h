@@ -0,0 +1,159 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Entity id: index into the sparse arrays plus a generation to catch stale ids.
+struct Entity
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+};
+
+// Hands out entity ids and recycles destroyed ones.
+class EntityAllocator
+{
+public:
+	Entity Create()
+	{
+		Entity e;
+		if (!m_free.empty()) {
+			e.index = m_free.back();
+			m_free.pop_back();
+		}
+		else {
+			e.index = uint32_t(m_generations.size());
+			m_generations.push_back(0);
+		}
+		e.generation = m_generations[e.index];
+		return e;
+	}
+
+	void Destroy(Entity e)
+	{
+		if (!IsAlive(e))
+			return;
+		m_generations[e.index]++;
+		m_free.push_back(e.index);
+	}
+
+	bool IsAlive(Entity e) const { return e.index < m_generations.size() && m_generations[e.index] == e.generation; }
+
+private:
+	std::vector<uint32_t> m_generations;
+	std::vector<uint32_t> m_free;
+};
+
+// Sparse set: components live packed in a dense array, the sparse array maps an
+// entity index to its slot. Iteration walks the dense array front to back.
+// Removal swaps the last element in, so order is not stable unless re-sorted.
+template <typename T>
+class ComponentPool
+{
+public:
+	T& Add(Entity e, const T& value)
+	{
+		if (e.index >= m_sparse.size())
+			m_sparse.resize(e.index + 1, None);
+		if (m_sparse[e.index] != None) {
+			m_data[m_sparse[e.index]] = value;
+			return m_data[m_sparse[e.index]];
+		}
+		m_sparse[e.index] = uint32_t(m_data.size());
+		m_entities.push_back(e);
+		m_data.push_back(value);
+		return m_data.back();
+	}
+
+	void Remove(Entity e)
+	{
+		if (!Has(e))
+			return;
+		uint32_t slot = m_sparse[e.index];
+		uint32_t last = uint32_t(m_data.size() - 1);
+		if (slot != last) {
+			m_data[slot] = std::move(m_data[last]);
+			m_entities[slot] = m_entities[last];
+			m_sparse[m_entities[slot].index] = slot;
+		}
+		m_data.pop_back();
+		m_entities.pop_back();
+		m_sparse[e.index] = None;
+	}
+
+	bool Has(Entity e) const
+	{
+		return e.index < m_sparse.size() && m_sparse[e.index] != None &&
+			m_entities[m_sparse[e.index]].generation == e.generation;
+	}
+
+	T& Get(Entity e) { return m_data[m_sparse[e.index]]; }
+	const T& Get(Entity e) const { return m_data[m_sparse[e.index]]; }
+	T* Find(Entity e) { return Has(e) ? &Get(e) : nullptr; }
+
+	size_t Size() const { return m_data.size(); }
+	T* Data() { return m_data.data(); }
+	const T* Data() const { return m_data.data(); }
+	Entity EntityAt(size_t slot) const { return m_entities[slot]; }
+
+	// Reorders this pool so entities shared with other come first, in other's
+	// order. Joined iteration over both then walks both arrays in lockstep.
+	template <typename U>
+	void SortAs(const ComponentPool<U>& other)
+	{
+		uint32_t next = 0;
+		for (size_t i = 0; i < other.Size(); i++) {
+			Entity e = other.EntityAt(i);
+			if (!Has(e))
+				continue;
+			uint32_t slot = m_sparse[e.index];
+			if (slot != next) {
+				Entity moved = m_entities[next];
+				std::swap(m_data[slot], m_data[next]);
+				std::swap(m_entities[slot], m_entities[next]);
+				m_sparse[moved.index] = slot;
+				m_sparse[e.index] = next;
+			}
+			next++;
+		}
+	}
+
+	template <typename Fn>
+	void ForEach(Fn&& fn)
+	{
+		for (size_t i = 0; i < m_data.size(); i++)
+			fn(m_entities[i], m_data[i]);
+	}
+
+private:
+	static const uint32_t None = UINT32_MAX;
+
+	std::vector<uint32_t> m_sparse;
+	std::vector<Entity> m_entities;
+	std::vector<T> m_data;
+};
+
+template <typename T>
+const uint32_t ComponentPool<T>::None;
+
+// Calls fn(entity, a, b) for every entity with both components, driven by pool a.
+template <typename A, typename B, typename Fn>
+void ForEach(ComponentPool<A>& a, ComponentPool<B>& b, Fn&& fn)
+{
+	for (size_t i = 0; i < a.Size(); i++) {
+		Entity e = a.EntityAt(i);
+		if (b.Has(e))
+			fn(e, a.Data()[i], b.Get(e));
+	}
+}
+
+template <typename A, typename B, typename C, typename Fn>
+void ForEach(ComponentPool<A>& a, ComponentPool<B>& b, ComponentPool<C>& c, Fn&& fn)
+{
+	for (size_t i = 0; i < a.Size(); i++) {
+		Entity e = a.EntityAt(i);
+		if (b.Has(e) && c.Has(e))
+			fn(e, a.Data()[i], b.Get(e), c.Get(e));
+	}
+}
@@ -0,0 +1,177 @@
+#include "FileWatcher.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <unordered_map>
+#endif
+
+namespace
+{
+#if defined(_WIN32)
+	std::wstring Widen(const std::string& s)
+	{
+		int n = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), int(s.size()), nullptr, 0);
+		std::wstring w(n, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, s.c_str(), int(s.size()), &w[0], n);
+		return w;
+	}
+
+	std::string Narrow(const wchar_t* w, int length)
+	{
+		int n = WideCharToMultiByte(CP_UTF8, 0, w, length, nullptr, 0, nullptr, nullptr);
+		std::string s(n, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, w, length, &s[0], n, nullptr, nullptr);
+		return s;
+	}
+
+	// One overlapped ReadDirectoryChangesW per directory, always kept pending.
+	class DirectoryChangesWatcher : public FileWatcher
+	{
+	public:
+		~DirectoryChangesWatcher()
+		{
+			for (auto& d : m_dirs) {
+				DWORD bytes;
+				CancelIoEx(d->handle, &d->overlapped);
+				GetOverlappedResult(d->handle, &d->overlapped, &bytes, TRUE);
+				CloseHandle(d->handle);
+				CloseHandle(d->overlapped.hEvent);
+			}
+		}
+
+		bool Watch(const std::string& directory) override
+		{
+			std::unique_ptr<Directory> d(new Directory());
+			d->path = directory;
+			d->handle = CreateFileW(Widen(directory).c_str(), FILE_LIST_DIRECTORY,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+				FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+			if (d->handle == INVALID_HANDLE_VALUE)
+				return false;
+			d->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+			if (!Issue(*d)) {
+				CloseHandle(d->handle);
+				CloseHandle(d->overlapped.hEvent);
+				return false;
+			}
+			m_dirs.push_back(std::move(d));
+			return true;
+		}
+
+		void Poll(std::vector<FileChange>& changes) override
+		{
+			for (auto& d : m_dirs) {
+				DWORD bytes = 0;
+				if (!GetOverlappedResult(d->handle, &d->overlapped, &bytes, FALSE))
+					continue;
+				auto now = std::chrono::steady_clock::now();
+				// bytes == 0 means the buffer overflowed and the changes were lost.
+				const BYTE* p = reinterpret_cast<const BYTE*>(d->buffer);
+				while (bytes > 0) {
+					auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+					if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED ||
+						info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+						changes.push_back(FileChange{ d->path + '/' +
+							Narrow(info->FileName, int(info->FileNameLength / sizeof(WCHAR))), now });
+					}
+					if (info->NextEntryOffset == 0)
+						break;
+					p += info->NextEntryOffset;
+				}
+				ResetEvent(d->overlapped.hEvent);
+				Issue(*d);
+			}
+		}
+
+	private:
+		struct Directory
+		{
+			std::string path;
+			HANDLE handle = INVALID_HANDLE_VALUE;
+			OVERLAPPED overlapped = {};
+			DWORD buffer[4096];		// FILE_NOTIFY_INFORMATION records must be DWORD aligned
+		};
+
+		static bool Issue(Directory& d)
+		{
+			return ReadDirectoryChangesW(d.handle, d.buffer, sizeof(d.buffer), FALSE,
+				FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE,
+				nullptr, &d.overlapped, nullptr) != 0;
+		}
+
+		std::vector<std::unique_ptr<Directory>> m_dirs;
+	};
+#elif defined(__linux__)
+	class InotifyWatcher : public FileWatcher
+	{
+	public:
+		InotifyWatcher() : m_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+		~InotifyWatcher()
+		{
+			if (m_fd >= 0)
+				close(m_fd);
+		}
+
+		bool Watch(const std::string& directory) override
+		{
+			if (m_fd < 0)
+				return false;
+			// Editors either rewrite in place or write a temporary and rename it over.
+			int wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd < 0)
+				return false;
+			m_dirs[wd] = directory;
+			return true;
+		}
+
+		void Poll(std::vector<FileChange>& changes) override
+		{
+			if (m_fd < 0)
+				return;
+			alignas(inotify_event) char buffer[4096];
+			for (;;) {
+				ssize_t bytes = read(m_fd, buffer, sizeof(buffer));
+				if (bytes <= 0)
+					break;
+				auto now = std::chrono::steady_clock::now();
+				for (ssize_t offset = 0; offset < bytes;) {
+					auto e = reinterpret_cast<const inotify_event*>(buffer + offset);
+					auto dir = m_dirs.find(e->wd);
+					if (e->len > 0 && dir != m_dirs.end())
+						changes.push_back(FileChange{ dir->second + '/' + e->name, now });
+					offset += sizeof(inotify_event) + e->len;
+				}
+			}
+		}
+
+	private:
+		int m_fd;
+		std::unordered_map<int, std::string> m_dirs;
+	};
+#endif
+
+	class NullWatcher : public FileWatcher
+	{
+	public:
+		bool Watch(const std::string&) override { return false; }
+		void Poll(std::vector<FileChange>&) override {}
+	};
+}
+
+std::unique_ptr<FileWatcher> FileWatcher::Create()
+{
+#if defined(_WIN32)
+	return std::unique_ptr<FileWatcher>(new DirectoryChangesWatcher());
+#elif defined(__linux__)
+	return std::unique_ptr<FileWatcher>(new InotifyWatcher());
+#else
+	return std::unique_ptr<FileWatcher>(new NullWatcher());
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct FileChange
+{
+	std::string path;		// watched directory + '/' + file name, UTF-8
+	std::chrono::steady_clock::time_point time;
+};
+
+// Reports files written in a set of directories (not recursive). Backed by
+// ReadDirectoryChangesW on Windows and inotify on Linux; elsewhere Watch fails
+// and nothing is reported.
+class FileWatcher
+{
+public:
+	virtual ~FileWatcher() {}
+
+	// directory is UTF-8. Returns false if it cannot be watched.
+	virtual bool Watch(const std::string& directory) = 0;
+	// Non-blocking. Appends the files changed since the last call.
+	virtual void Poll(std::vector<FileChange>& changes) = 0;
+
+	static std::unique_ptr<FileWatcher> Create();
+};
@@ -0,0 +1,119 @@
+#include "FlyCamera.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float Pi = 3.141592654f;
+	// Distance per tick a held key walks or strafes, and per wheel unit
+	const float WalkSpeed = 0.05f;
+	const float ScrollSpeed = 0.001f;
+	// Radians per tick a held key turns, and per relative mouse unit
+	const float TurnSpeed = 0.02f;
+	const float MouseSpeed = 0.01f;
+}
+
+void FlyCamera::Step(const InputSnapshot& input)
+{
+	// Moves along the basis of the last tick's angles, as Walk and Strafe do before Turn
+	float right[3], up[3], look[3];
+	Basis(right, up, look);
+	auto move = [this](const float axis[3], float d) {
+		for (int i = 0; i < 3; i++)
+			position[i] += d * axis[i];
+	};
+	if (input.keys & InputKey_W)
+		move(look, WalkSpeed);
+	if (input.keys & InputKey_A)
+		move(right, -WalkSpeed);
+	if (input.keys & InputKey_S)
+		move(look, -WalkSpeed);
+	if (input.keys & InputKey_D)
+		move(right, WalkSpeed);
+	if (input.scroll != 0)
+		move(look, float(input.scroll) * ScrollSpeed);
+
+	if (input.keys & InputKey_Q)
+		yaw -= TurnSpeed;
+	if (input.keys & InputKey_E)
+		yaw += TurnSpeed;
+	if (input.keys & InputKey_Z)
+		pitch += TurnSpeed;
+	if (input.keys & InputKey_C)
+		pitch -= TurnSpeed;
+	if (input.relative) {
+		pitch -= float(input.mouseY) * MouseSpeed;
+		yaw += float(input.mouseX) * MouseSpeed;
+	}
+	// A little short of straight up or down, where the basis would flip
+	const float limit = Pi / 2.0f - 0.01f;
+	pitch = std::min(std::max(pitch, -limit), limit);
+	if (yaw > Pi)
+		yaw -= Pi * 2.0f;
+	else if (yaw < -Pi)
+		yaw += Pi * 2.0f;
+}
+
+bool FlyCamera::Ride(const float center[3], const float size[3], const float halfWidth[3], float angle, float deltaAngle, bool getOff)
+{
+	// The camera box's corners turned back by angle, against the box
+	const float c = cosf(angle), s = sinf(angle);
+	bool touches = false;
+	for (int corner = 0; corner < 8 && !touches; corner++) {
+		float p[3];
+		for (int i = 0; i < 3; i++)
+			p[i] = position[i] + ((corner >> i) & 1 ? halfWidth[i] : -halfWidth[i]);
+		const float local[3] = { p[0] * c - p[2] * s, p[1], p[0] * s + p[2] * c };
+		touches = true;
+		for (int i = 0; i < 3; i++)
+			touches = touches && local[i] >= center[i] - size[i] * 0.5f && local[i] <= center[i] + size[i] * 0.5f;
+	}
+	if (!touches)
+		return false;
+
+	// Turned by deltaAngle, or set down past the box's corner, turned by angle
+	float from[3] = { position[0], position[1], position[2] };
+	float turn = deltaAngle;
+	if (getOff) {
+		from[0] = center[0] + sqrtf(size[0] * size[0] + size[2] * size[2]);
+		from[1] = center[1];
+		from[2] = center[2];
+		turn = angle;
+	}
+	const float tc = cosf(turn), ts = sinf(turn);
+	position[0] = from[0] * tc + from[2] * ts;
+	position[1] = from[1];
+	position[2] = from[2] * tc - from[0] * ts;
+	return true;
+}
+
+void FlyCamera::Basis(float right[3], float up[3], float look[3]) const
+{
+	look[0] = cosf(pitch) * sinf(yaw);
+	look[1] = sinf(pitch);
+	look[2] = cosf(pitch) * cosf(yaw);
+	// right = normalize((0, 1, 0) x look), up = look x right
+	const float length = sqrtf(look[2] * look[2] + look[0] * look[0]);
+	right[0] = look[2] / length;
+	right[1] = 0.0f;
+	right[2] = -look[0] / length;
+	up[0] = look[1] * right[2] - look[2] * right[1];
+	up[1] = look[2] * right[0] - look[0] * right[2];
+	up[2] = look[0] * right[1] - look[1] * right[0];
+}
+
+void FlyCamera::Save(float state[5]) const
+{
+	for (int i = 0; i < 3; i++)
+		state[i] = position[i];
+	state[3] = pitch;
+	state[4] = yaw;
+}
+
+void FlyCamera::Restore(const float state[5])
+{
+	for (int i = 0; i < 3; i++)
+		position[i] = state[i];
+	pitch = state[3];
+	yaw = state[4];
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "InputLog.h"
+
+// The viewer's camera as Scene::Update steers it, one InputSnapshot per fixed-step
+// tick: W/S and the scroll wheel walk along the view direction, A/D strafe, Q/E turn,
+// Z/C look up and down, and the mouse turns in relative mode. Pitch stops short of
+// straight up or down and yaw wraps to [-pi, pi]. The same ticks from the same start
+// give the same path to the bit, so a recorded InputLog replays it exactly.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+struct FlyCamera
+{
+	float position[3];
+	float pitch;
+	float yaw;
+
+	// Moves and turns the camera by one tick of input.
+	void Step(const InputSnapshot& input);
+
+	// One tick on the box a turntable carries: size and center before turning, turned
+	// angle radians about the world y axis, deltaAngle of them since the tick before.
+	// While the camera's box of half extents halfWidth touches it, the camera is carried
+	// round with it, or set down beside it when getOff. Returns whether they touched.
+	bool Ride(const float center[3], const float size[3], const float halfWidth[3], float angle, float deltaAngle, bool getOff);
+
+	// Camera::Turn's view direction, and the right and up vectors Camera::LookAt builds around it.
+	void Basis(float right[3], float up[3], float look[3]) const;
+
+	// Position, pitch and yaw, as InputLog stores the origin.
+	void Save(float state[5]) const;
+	void Restore(const float state[5]);
+};
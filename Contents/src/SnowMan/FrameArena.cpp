@@ -0,0 +1,89 @@
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+	uintptr_t AlignUp(uintptr_t p, size_t alignment)
+	{
+		return (p + alignment - 1) & ~uintptr_t(alignment - 1);
+	}
+}
+
+LinearArena::LinearArena(size_t capacity) :
+	m_block(capacity ? new uint8_t[capacity] : nullptr),
+	m_capacity(capacity)
+{
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment)
+{
+	m_allocations++;
+	uintptr_t base = reinterpret_cast<uintptr_t>(m_block.get());
+	uintptr_t p = AlignUp(base + m_offset, alignment);
+	if (m_block && p + size <= base + m_capacity) {
+		m_offset = p + size - base;
+		return reinterpret_cast<void*>(p);
+	}
+
+	// Block full: serve from the heap until the next Reset.
+	size_t bytes = size + alignment;
+	m_overflow.emplace_back(new uint8_t[bytes]);
+	m_overflowBytes += bytes;
+	return reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(m_overflow.back().get()), alignment));
+}
+
+void LinearArena::Reset()
+{
+	if (m_overflowBytes) {
+		size_t needed = m_offset + m_overflowBytes;
+		m_capacity = std::max(m_capacity * 2, needed);
+		m_block.reset(new uint8_t[m_capacity]);
+		m_overflow.clear();
+		m_overflowBytes = 0;
+	}
+	m_offset = 0;
+	m_allocations = 0;
+}
+
+FrameArenaStats LinearArena::Stats() const
+{
+	FrameArenaStats s;
+	s.allocations = m_allocations;
+	s.bytesUsed = m_offset + m_overflowBytes;
+	s.overflowBytes = m_overflowBytes;
+	s.capacity = m_capacity;
+	return s;
+}
+
+FrameAllocator::FrameAllocator(size_t bytesPerThread, unsigned bufferedFrames, unsigned threadCount)
+{
+	m_frames.resize(std::max(bufferedFrames, 1u));
+	for (auto& frame : m_frames) {
+		for (unsigned t = 0; t < std::max(threadCount, 1u); t++)
+			frame.push_back(std::make_unique<LinearArena>(bytesPerThread));
+	}
+}
+
+void FrameAllocator::BeginFrame()
+{
+	FrameArenaStats total;
+	for (auto& arena : m_frames[m_current]) {
+		FrameArenaStats s = arena->Stats();
+		total.allocations += s.allocations;
+		total.bytesUsed += s.bytesUsed;
+		total.overflowBytes += s.overflowBytes;
+		total.capacity += s.capacity;
+	}
+	m_lastFrame = total;
+	m_peakBytes = std::max(m_peakBytes, total.bytesUsed);
+
+	m_current = (m_current + 1) % unsigned(m_frames.size());
+	for (auto& arena : m_frames[m_current])
+		arena->Reset();
+}
+
+LinearArena& FrameAllocator::ThreadArena(const JobSystem& jobs)
+{
+	return Arena(jobs.ThreadIndex());
+}
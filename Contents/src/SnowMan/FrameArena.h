@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class JobSystem;
+
+struct FrameArenaStats
+{
+	size_t allocations = 0;		// Allocate calls
+	size_t bytesUsed = 0;		// including alignment padding and overflow
+	size_t overflowBytes = 0;	// served from the heap because the block was full
+	size_t capacity = 0;		// block sizes
+};
+
+// Bump allocator over one block. Nothing is freed individually; Reset() drops
+// everything at once. Requests that don't fit go to the heap for the rest of the
+// cycle, and the next Reset() grows the block so the steady state never overflows.
+class LinearArena
+{
+public:
+	explicit LinearArena(size_t capacity = 0);
+
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template <typename T>
+	T* Allocate(size_t count) { return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T))); }
+
+	void Reset();
+
+	FrameArenaStats Stats() const;
+
+private:
+	std::unique_ptr<uint8_t[]> m_block;
+	size_t m_capacity = 0;
+	size_t m_offset = 0;
+	size_t m_allocations = 0;
+	size_t m_overflowBytes = 0;
+	std::vector<std::unique_ptr<uint8_t[]>> m_overflow;
+};
+
+// Per-frame transient memory: bufferedFrames sets of arenas used round-robin, so
+// data allocated in a frame stays valid until BeginFrame() has been called
+// bufferedFrames more times (2 = double, 3 = triple buffered). Each set has one
+// arena per job system thread so workers allocate without locking.
+class FrameAllocator
+{
+public:
+	FrameAllocator(size_t bytesPerThread, unsigned bufferedFrames = 2, unsigned threadCount = 1);
+
+	// Frame boundary: latches the stats of the frame that ended, then moves to the
+	// oldest arena set and resets it.
+	void BeginFrame();
+
+	// thread is the JobSystem::ThreadIndex() of the caller; 0 for the main thread.
+	LinearArena& Arena(unsigned thread = 0) { return *m_frames[m_current][thread]; }
+	LinearArena& ThreadArena(const JobSystem& jobs);
+
+	// Totals over all thread arenas of the last completed frame.
+	const FrameArenaStats& LastFrameStats() const { return m_lastFrame; }
+	// Largest bytesUsed seen in any frame.
+	size_t PeakBytes() const { return m_peakBytes; }
+	unsigned BufferedFrames() const { return unsigned(m_frames.size()); }
+
+private:
+	std::vector<std::vector<std::unique_ptr<LinearArena>>> m_frames;
+	unsigned m_current = 0;
+	FrameArenaStats m_lastFrame;
+	size_t m_peakBytes = 0;
+};
+
+// STL allocator over a LinearArena; deallocate is a no-op. Containers using it
+// must not outlive the arena's next Reset().
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(LinearArena& arena) : m_arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.m_arena) {}
+
+	T* allocate(size_t count) { return m_arena->Allocate<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.m_arena; }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.m_arena; }
+
+private:
+	template <typename U> friend class ArenaAllocator;
+	LinearArena* m_arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
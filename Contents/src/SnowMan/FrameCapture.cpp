@@ -0,0 +1,594 @@
+#include "FrameCapture.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	// Deflate window and the hash of three bytes that finds earlier occurrences in it
+	const unsigned WindowSize = 1 << 15;
+	const unsigned HashBits = 15;
+	// Candidates tried per position; more finds longer matches, slower
+	const unsigned MaxProbes = 8;
+	const unsigned MinMatch = 3;
+	const unsigned MaxMatch = 258;
+
+	// DXGI_FORMAT values of the capture formats, for the DDS header
+	const uint32_t DxgiFormats[] = { 28, 87, 24 };
+
+	struct DdsPixelFormat
+	{
+		uint32_t size, flags, fourCC, rgbBitCount, rBitMask, gBitMask, bBitMask, aBitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount, reserved1[11];
+		DdsPixelFormat ddspf;
+		uint32_t caps, caps2, caps3, caps4, reserved2;
+	};
+
+	struct DdsHeaderDx10
+	{
+		uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+	};
+
+	// The fixed Huffman codes of literals and lengths (RFC 1951 3.2.6), bit-reversed to go
+	// out least significant bit first as the rest of the stream does
+	struct FixedCodes
+	{
+		uint16_t code[288];
+		uint8_t length[288];
+
+		FixedCodes()
+		{
+			for (unsigned s = 0; s < 288; s++) {
+				unsigned c, n;
+				if (s < 144) { c = 0x30 + s; n = 8; }
+				else if (s < 256) { c = 0x190 + s - 144; n = 9; }
+				else if (s < 280) { c = s - 256; n = 7; }
+				else { c = 0xC0 + s - 280; n = 8; }
+				code[s] = uint16_t(Reverse(c, n));
+				length[s] = uint8_t(n);
+			}
+		}
+
+		static unsigned Reverse(unsigned c, unsigned n)
+		{
+			unsigned r = 0;
+			for (unsigned i = 0; i < n; i++)
+				r |= ((c >> i) & 1) << (n - 1 - i);
+			return r;
+		}
+	};
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+		void Put(uint32_t value, unsigned count)
+		{
+			m_bits |= uint64_t(value) << m_count;
+			m_count += count;
+			if (m_count >= 32) {
+				const uint8_t bytes[4] = { uint8_t(m_bits), uint8_t(m_bits >> 8), uint8_t(m_bits >> 16), uint8_t(m_bits >> 24) };
+				m_out.insert(m_out.end(), bytes, bytes + 4);
+				m_bits >>= 32;
+				m_count -= 32;
+			}
+		}
+
+		void Finish()
+		{
+			for (; m_count > 0; m_count = m_count > 8 ? m_count - 8 : 0) {
+				m_out.push_back(uint8_t(m_bits));
+				m_bits >>= 8;
+			}
+		}
+
+	private:
+		std::vector<uint8_t>& m_out;
+		uint64_t m_bits = 0;
+		unsigned m_count = 0;
+	};
+
+	unsigned Log2(unsigned v)
+	{
+		unsigned n = 0;
+		while (v >>= 1)
+			n++;
+		return n;
+	}
+
+	void PutMatch(BitWriter& bits, const FixedCodes& codes, unsigned length, unsigned distance)
+	{
+		// Length codes 257..284 cover 3..257 in groups of four per extra bit; 258 has its own
+		unsigned x = length - 3, symbol, extra = 0;
+		if (length == MaxMatch)
+			symbol = 285;
+		else if (x < 8)
+			symbol = 257 + x;
+		else {
+			unsigned n = Log2(x);
+			extra = n - 2;
+			symbol = 257 + 4 * (n - 1) + ((x >> extra) & 3);
+		}
+		bits.Put(codes.code[symbol], codes.length[symbol]);
+		if (extra)
+			bits.Put(x & ((1u << extra) - 1), extra);
+
+		// Distance codes 0..29 in pairs per extra bit, all five bits long
+		unsigned d = distance - 1, code;
+		extra = 0;
+		if (d < 4)
+			code = d;
+		else {
+			unsigned n = Log2(d);
+			extra = n - 1;
+			code = 2 * n + ((d >> extra) & 1);
+		}
+		bits.Put(FixedCodes::Reverse(code, 5), 5);
+		if (extra)
+			bits.Put(d & ((1u << extra) - 1), extra);
+	}
+
+	// Bytes a and b have in common, up to limit, compared a word at a time
+	unsigned MatchLength(const uint8_t* a, const uint8_t* b, unsigned limit)
+	{
+		unsigned n = 0;
+		for (; n + 8 <= limit; n += 8) {
+			uint64_t x, y;
+			memcpy(&x, a + n, 8);
+			memcpy(&y, b + n, 8);
+			if (x != y)
+				break;
+		}
+		while (n < limit && a[n] == b[n])
+			n++;
+		return n;
+	}
+
+	uint32_t Hash(const uint8_t* p)
+	{
+		uint32_t v = uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16;
+		return (v * 2654435761u) >> (32 - HashBits);
+	}
+
+	// A zlib stream of data in one fixed-Huffman block, greedy LZ77 over a short hash chain
+	void Deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+	{
+		static const FixedCodes codes;
+		out.push_back(0x78);
+		out.push_back(0x01);
+
+		BitWriter bits(out);
+		bits.Put(1, 1);		// final block
+		bits.Put(1, 2);		// fixed Huffman codes
+		std::vector<int32_t> head(size_t(1) << HashBits, -1);
+		std::vector<int32_t> chain(WindowSize, -1);
+		const uint8_t* p = data.data();
+		const size_t size = data.size();
+		auto insert = [&](size_t at) {
+			uint32_t h = Hash(p + at);
+			chain[at & (WindowSize - 1)] = head[h];
+			head[h] = int32_t(at);
+		};
+
+		size_t at = 0;
+		while (at < size) {
+			unsigned best = 0, bestDistance = 0;
+			if (at + MinMatch <= size) {
+				const unsigned limit = unsigned(std::min<size_t>(MaxMatch, size - at));
+				int32_t candidate = head[Hash(p + at)];
+				for (unsigned probe = 0; probe < MaxProbes && candidate >= 0; probe++) {
+					const size_t distance = at - size_t(candidate);
+					if (distance > WindowSize)
+						break;
+					if (p[candidate + best] == p[at + best]) {
+						const unsigned length = MatchLength(p + candidate, p + at, limit);
+						if (length > best) {
+							best = length;
+							bestDistance = unsigned(distance);
+							if (length == limit)
+								break;
+						}
+					}
+					// The ring may hold a newer position in the slot; chains only go back
+					int32_t next = chain[size_t(candidate) & (WindowSize - 1)];
+					if (next >= candidate)
+						break;
+					candidate = next;
+				}
+				insert(at);
+			}
+			if (best >= MinMatch) {
+				PutMatch(bits, codes, best, bestDistance);
+				for (size_t end = at + best, i = at + 1; i < end; i++)
+					if (i + MinMatch <= size)
+						insert(i);
+				at += best;
+			}
+			else {
+				bits.Put(codes.code[p[at]], codes.length[p[at]]);
+				at++;
+			}
+		}
+		bits.Put(codes.code[256], codes.length[256]);
+		bits.Finish();
+
+		// Adler-32 of the uncompressed data, summed in runs short enough not to overflow
+		uint32_t a = 1, b = 0;
+		for (size_t i = 0; i < size;) {
+			const size_t end = std::min<size_t>(size, i + 5552);
+			for (; i < end; i++) {
+				a += p[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		const uint32_t adler = b << 16 | a;
+		const uint8_t trailer[4] = { uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler) };
+		out.insert(out.end(), trailer, trailer + 4);
+	}
+
+	uint32_t Crc32(const uint8_t* data, size_t size)
+	{
+		struct Table
+		{
+			uint32_t entries[256];
+			Table()
+			{
+				for (uint32_t n = 0; n < 256; n++) {
+					uint32_t c = n;
+					for (int k = 0; k < 8; k++)
+						c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+					entries[n] = c;
+				}
+			}
+		};
+		static const Table table;
+		uint32_t c = 0xFFFFFFFFu;
+		for (size_t i = 0; i < size; i++)
+			c = table.entries[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+		return c ^ 0xFFFFFFFFu;
+	}
+
+	void PutBigEndian(std::vector<uint8_t>& out, uint32_t v)
+	{
+		const uint8_t bytes[4] = { uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v) };
+		out.insert(out.end(), bytes, bytes + 4);
+	}
+
+	// Closes the chunk whose length field starts at start
+	void EndChunk(std::vector<uint8_t>& out, size_t start)
+	{
+		const uint32_t length = uint32_t(out.size() - start - 8);
+		for (int i = 0; i < 4; i++)
+			out[start + i] = uint8_t(length >> (24 - 8 * i));
+		PutBigEndian(out, Crc32(out.data() + start + 4, length + 4));
+	}
+
+	void BeginChunk(std::vector<uint8_t>& out, const char type[4])
+	{
+		PutBigEndian(out, 0);
+		out.insert(out.end(), type, type + 4);
+	}
+
+	// Row y of frame as 8-bit RGB
+	void ToRgb(const CaptureFrame& frame, uint32_t y, uint8_t* rgb)
+	{
+		const uint8_t* p = frame.pixels.data() + size_t(y) * frame.width * 4;
+		const uint8_t* end = p + size_t(frame.width) * 4;
+		switch (frame.format) {
+		case CaptureFormat_R8G8B8A8:
+			for (; p != end; p += 4, rgb += 3) {
+				rgb[0] = p[0]; rgb[1] = p[1]; rgb[2] = p[2];
+			}
+			break;
+		case CaptureFormat_B8G8R8A8:
+			for (; p != end; p += 4, rgb += 3) {
+				rgb[0] = p[2]; rgb[1] = p[1]; rgb[2] = p[0];
+			}
+			break;
+		case CaptureFormat_R10G10B10A2:
+			// The top eight of each channel's ten bits
+			for (; p != end; p += 4, rgb += 3) {
+				uint32_t v;
+				memcpy(&v, p, 4);
+				rgb[0] = uint8_t(v >> 2);
+				rgb[1] = uint8_t(v >> 12);
+				rgb[2] = uint8_t(v >> 22);
+			}
+			break;
+		}
+	}
+
+	// The neighbour nearest a + b - c, ties going to a then b, without branches
+	int Paeth(int a, int b, int c)
+	{
+		const int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+		const int nearer = pb <= pc ? b : c;
+		return pa <= std::min(pb, pc) ? a : nearer;
+	}
+}
+
+size_t CaptureEncoder::BytesPerPixel(CaptureFormat)
+{
+	return 4;
+}
+
+void CaptureEncoder::Encode(const CaptureFrame& frame, std::vector<uint8_t>& out)
+{
+	switch (frame.encoding) {
+	case CaptureEncoding_Png:
+		EncodePng(frame, out);
+		break;
+	case CaptureEncoding_Dds:
+		EncodeDds(frame, out);
+		break;
+	case CaptureEncoding_Raw:
+		out = frame.pixels;
+		break;
+	}
+}
+
+void CaptureEncoder::EncodePng(const CaptureFrame& frame, std::vector<uint8_t>& out)
+{
+	// Each row filtered the way that leaves the smallest residuals (the usual
+	// minimum-sum-of-absolute-differences guess), of None, Sub, Up and Paeth. Rows
+	// start after three zero bytes and the first row under a zero row, which is what
+	// the filters take the missing neighbours to be.
+	const size_t stride = size_t(frame.width) * 3;
+	std::vector<uint8_t> rows[2] = { std::vector<uint8_t>(stride + 3), std::vector<uint8_t>(stride + 3) };
+	std::vector<uint8_t> filtered((stride + 1) * frame.height);
+	for (uint32_t y = 0; y < frame.height; y++) {
+		const uint8_t* row = rows[y & 1].data() + 3;
+		const uint8_t* up = rows[(y + 1) & 1].data() + 3;
+		ToRgb(frame, y, rows[y & 1].data() + 3);
+		unsigned sums[4] = {};
+		for (size_t i = 0; i < stride; i++) {
+			const int x = row[i], a = row[i - 3], b = up[i], c = up[i - 3];
+			sums[0] += std::abs(int(int8_t(x)));
+			sums[1] += std::abs(int(int8_t(x - a)));
+			sums[2] += std::abs(int(int8_t(x - b)));
+			sums[3] += std::abs(int(int8_t(x - Paeth(a, b, c))));
+		}
+		int best = 0;
+		for (int f = 1; f < 4; f++)
+			if (sums[f] < sums[best])
+				best = f;
+
+		uint8_t* line = &filtered[y * (stride + 1)];
+		*line++ = uint8_t(best == 3 ? 4 : best);
+		switch (best) {
+		case 0:
+			memcpy(line, row, stride);
+			break;
+		case 1:
+			for (size_t i = 0; i < stride; i++)
+				line[i] = uint8_t(row[i] - row[i - 3]);
+			break;
+		case 2:
+			for (size_t i = 0; i < stride; i++)
+				line[i] = uint8_t(row[i] - up[i]);
+			break;
+		case 3:
+			for (size_t i = 0; i < stride; i++)
+				line[i] = uint8_t(row[i] - Paeth(row[i - 3], up[i], up[i - 3]));
+			break;
+		}
+	}
+
+	out.clear();
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.insert(out.end(), signature, signature + 8);
+
+	size_t start = out.size();
+	BeginChunk(out, "IHDR");
+	PutBigEndian(out, frame.width);
+	PutBigEndian(out, frame.height);
+	// 8 bits per channel, truecolour without alpha (the back buffer's is not coverage),
+	// deflate, adaptive filtering, not interlaced
+	const uint8_t header[5] = { 8, 2, 0, 0, 0 };
+	out.insert(out.end(), header, header + 5);
+	EndChunk(out, start);
+
+	start = out.size();
+	BeginChunk(out, "IDAT");
+	Deflate(filtered, out);
+	EndChunk(out, start);
+
+	start = out.size();
+	BeginChunk(out, "IEND");
+	EndChunk(out, start);
+}
+
+void CaptureEncoder::EncodeDds(const CaptureFrame& frame, std::vector<uint8_t>& out)
+{
+	DdsHeader header = {};
+	header.size = sizeof(DdsHeader);
+	header.flags = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000;		// caps, height, width, pitch, pixel format
+	header.height = frame.height;
+	header.width = frame.width;
+	header.pitchOrLinearSize = uint32_t(frame.width * BytesPerPixel(frame.format));
+	header.mipMapCount = 1;
+	header.ddspf.size = sizeof(DdsPixelFormat);
+	header.ddspf.flags = 0x4;			// four CC
+	header.ddspf.fourCC = uint32_t('D') | uint32_t('X') << 8 | uint32_t('1') << 16 | uint32_t('0') << 24;
+	header.caps = 0x1000;				// texture
+	DdsHeaderDx10 dx10 = {};
+	dx10.dxgiFormat = DxgiFormats[frame.format];
+	dx10.resourceDimension = 3;			// D3D10_RESOURCE_DIMENSION_TEXTURE2D
+	dx10.arraySize = 1;
+	dx10.miscFlags2 = 0x3;				// alpha is opaque
+	const char magic[4] = { 'D', 'D', 'S', ' ' };
+
+	out.resize(sizeof(magic) + sizeof(header) + sizeof(dx10) + frame.pixels.size());
+	uint8_t* p = out.data();
+	memcpy(p, magic, sizeof(magic));
+	memcpy(p + sizeof(magic), &header, sizeof(header));
+	memcpy(p + sizeof(magic) + sizeof(header), &dx10, sizeof(dx10));
+	if (!frame.pixels.empty())
+		memcpy(p + sizeof(magic) + sizeof(header) + sizeof(dx10), frame.pixels.data(), frame.pixels.size());
+}
+
+const char* CaptureEncoder::RawPixelFormat(CaptureFormat format)
+{
+	const char* names[] = { "rgba", "bgra", "x2bgr10le" };
+	return names[format];
+}
+
+CaptureEncoder::CaptureEncoder(std::string prefix, size_t maxQueued, Sink sink) :
+	m_prefix(std::move(prefix)),
+	m_maxQueued(maxQueued),
+	m_sink(std::move(sink))
+{
+	m_worker = std::thread(&CaptureEncoder::WorkerLoop, this);
+}
+
+CaptureEncoder::~CaptureEncoder()
+{
+	{
+		std::lock_guard<std::mutex> l(m_lock);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	// The worker writes what is queued before it returns
+	m_worker.join();
+	if (m_raw)
+		fclose(m_raw);
+}
+
+CaptureFrame CaptureEncoder::Acquire(uint32_t width, uint32_t height, CaptureFormat format)
+{
+	CaptureFrame frame;
+	{
+		std::lock_guard<std::mutex> l(m_lock);
+		if (!m_free.empty()) {
+			frame.pixels = std::move(m_free.back());
+			m_free.pop_back();
+		}
+	}
+	frame.width = width;
+	frame.height = height;
+	frame.format = format;
+	frame.pixels.resize(size_t(width) * height * BytesPerPixel(format));
+	return frame;
+}
+
+bool CaptureEncoder::Submit(CaptureFrame frame)
+{
+	{
+		std::lock_guard<std::mutex> l(m_lock);
+		if (m_queue.size() >= m_maxQueued) {
+			m_stats.dropped++;
+			m_free.push_back(std::move(frame.pixels));
+			return false;
+		}
+		m_stats.submitted++;
+		m_queue.push_back(std::move(frame));
+	}
+	m_wake.notify_one();
+	return true;
+}
+
+void CaptureEncoder::EndSequence()
+{
+	// An empty raw frame stands for the end of the sequence in the queue
+	CaptureFrame end;
+	end.encoding = CaptureEncoding_Raw;
+	{
+		std::lock_guard<std::mutex> l(m_lock);
+		m_queue.push_back(std::move(end));
+	}
+	m_wake.notify_one();
+}
+
+void CaptureEncoder::Flush()
+{
+	std::unique_lock<std::mutex> l(m_lock);
+	m_idle.wait(l, [this] { return m_queue.empty() && !m_busy; });
+}
+
+CaptureStats CaptureEncoder::Stats() const
+{
+	std::lock_guard<std::mutex> l(m_lock);
+	return m_stats;
+}
+
+void CaptureEncoder::WorkerLoop()
+{
+	typedef std::chrono::steady_clock Clock;
+	std::unique_lock<std::mutex> l(m_lock);
+	for (;;) {
+		m_wake.wait(l, [this] { return m_stop || !m_queue.empty(); });
+		if (m_queue.empty())
+			return;
+		CaptureFrame frame = std::move(m_queue.front());
+		m_queue.pop_front();
+		m_busy = true;
+		l.unlock();
+
+		const bool end = frame.encoding == CaptureEncoding_Raw && frame.pixels.empty();
+		bool written = true;
+		size_t bytesOut = 0;
+		double seconds = 0.0;
+		if (end) {
+			if (m_raw)
+				fclose(m_raw);
+			m_raw = nullptr;
+		}
+		else {
+			// Raw frames are written as they are, without a copy
+			const std::vector<uint8_t>* encoded = &frame.pixels;
+			if (frame.encoding != CaptureEncoding_Raw) {
+				const Clock::time_point start = Clock::now();
+				Encode(frame, m_encoded);
+				seconds = std::chrono::duration<double>(Clock::now() - start).count();
+				encoded = &m_encoded;
+			}
+			written = Write(frame, *encoded);
+			bytesOut = written ? encoded->size() : 0;
+		}
+
+		l.lock();
+		m_busy = false;
+		if (!end) {
+			m_stats.encoded += written ? 1 : 0;
+			m_stats.failed += written ? 0 : 1;
+			m_stats.bytesIn += frame.pixels.size();
+			m_stats.bytesOut += bytesOut;
+			m_stats.encodeSeconds += seconds;
+			m_free.push_back(std::move(frame.pixels));
+		}
+		if (m_queue.empty())
+			m_idle.notify_all();
+	}
+}
+
+bool CaptureEncoder::Write(const CaptureFrame& frame, const std::vector<uint8_t>& encoded)
+{
+	if (m_sink) {
+		m_sink(frame, encoded);
+		return true;
+	}
+	char suffix[40];
+	if (frame.encoding == CaptureEncoding_Raw) {
+		// A sequence's frames go to the file named after its first
+		if (!m_raw) {
+			snprintf(suffix, sizeof(suffix), "_%06llu.raw", (unsigned long long)frame.frame);
+			m_raw = fopen((m_prefix + suffix).c_str(), "wb");
+		}
+		return m_raw && fwrite(encoded.data(), 1, encoded.size(), m_raw) == encoded.size();
+	}
+	snprintf(suffix, sizeof(suffix), "_%06llu.%s", (unsigned long long)frame.frame,
+		frame.encoding == CaptureEncoding_Png ? "png" : "dds");
+	FILE* fp = fopen((m_prefix + suffix).c_str(), "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(encoded.data(), 1, encoded.size(), fp) == encoded.size();
+	return fclose(fp) == 0 && ok;
+}
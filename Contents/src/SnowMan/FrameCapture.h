@@ -0,0 +1,113 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pixel layouts a captured frame can be in, as the back buffer formats they come from.
+enum CaptureFormat : uint32_t
+{
+	CaptureFormat_R8G8B8A8,			// DXGI_FORMAT_R8G8B8A8_UNORM(_SRGB)
+	CaptureFormat_B8G8R8A8,			// DXGI_FORMAT_B8G8R8A8_UNORM(_SRGB)
+	CaptureFormat_R10G10B10A2,		// DXGI_FORMAT_R10G10B10A2_UNORM, the HDR10 back buffer
+};
+
+enum CaptureEncoding : uint32_t
+{
+	CaptureEncoding_Png,			// 8-bit RGB, one file per frame
+	CaptureEncoding_Dds,			// the pixels as they are, one file per frame
+	CaptureEncoding_Raw,			// the pixels as they are, appended to one file for a video encoder
+};
+
+// A frame read back from the GPU: packed rows top to bottom, no row padding.
+struct CaptureFrame
+{
+	uint64_t frame = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	CaptureFormat format = CaptureFormat_R8G8B8A8;
+	CaptureEncoding encoding = CaptureEncoding_Png;
+	std::vector<uint8_t> pixels;
+};
+
+struct CaptureStats
+{
+	uint64_t submitted = 0;			// frames queued
+	uint64_t dropped = 0;			// frames refused because the queue was full
+	uint64_t encoded = 0;			// frames encoded and written
+	uint64_t failed = 0;			// frames that could not be written
+	uint64_t bytesIn = 0;			// pixel bytes encoded
+	uint64_t bytesOut = 0;			// encoded bytes written
+	double encodeSeconds = 0.0;		// time the encoding thread spent encoding
+};
+
+// Encodes and writes captured frames on a thread of its own, so neither the frame
+// loop nor the job system waits on compression or the disk. Frames go through a
+// bounded queue: when the encoder falls behind Submit refuses the frame rather than
+// letting memory grow. Pixel buffers of written frames are handed out again by
+// Acquire, so a steady capture stops allocating after the first few frames.
+// PNG frames go to <prefix>_<frame>.png, DDS to <prefix>_<frame>.dds and raw frames
+// are appended to <prefix>_<first frame>.raw until EndSequence; a sink, if given,
+// gets the encoded bytes instead.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+class CaptureEncoder
+{
+public:
+	typedef std::function<void(const CaptureFrame& frame, const std::vector<uint8_t>& encoded)> Sink;
+
+	explicit CaptureEncoder(std::string prefix, size_t maxQueued = 8, Sink sink = nullptr);
+	~CaptureEncoder();
+
+	CaptureEncoder(const CaptureEncoder&) = delete;
+	CaptureEncoder& operator=(const CaptureEncoder&) = delete;
+
+	// A frame with room for width x height pixels of format, to fill and Submit.
+	CaptureFrame Acquire(uint32_t width, uint32_t height, CaptureFormat format);
+	// Queues frame for encoding; false, and the frame dropped, when maxQueued frames are waiting.
+	bool Submit(CaptureFrame frame);
+	// Closes the raw file once the frames queued so far are in it; the next raw frame starts another.
+	void EndSequence();
+	// Waits until every queued frame is written.
+	void Flush();
+	CaptureStats Stats() const;
+
+	static size_t BytesPerPixel(CaptureFormat format);
+	// FFmpeg's name for the pixel layout of raw frames of format, to read them back with.
+	static const char* RawPixelFormat(CaptureFormat format);
+	// Frame as a file of its encoding (the raw encoding is the pixels alone), replacing out.
+	static void Encode(const CaptureFrame& frame, std::vector<uint8_t>& out);
+	// Filtered rows deflated with the fixed Huffman codes: a fraction of the time of an
+	// optimal encoder for a somewhat larger file.
+	static void EncodePng(const CaptureFrame& frame, std::vector<uint8_t>& out);
+	// A DX10 header naming the DXGI format, then the pixels.
+	static void EncodeDds(const CaptureFrame& frame, std::vector<uint8_t>& out);
+
+private:
+	void WorkerLoop();
+	bool Write(const CaptureFrame& frame, const std::vector<uint8_t>& encoded);
+
+	const std::string m_prefix;
+	const size_t m_maxQueued;
+	const Sink m_sink;
+
+	mutable std::mutex m_lock;
+	std::condition_variable m_wake;			// a frame was queued, or stopping
+	std::condition_variable m_idle;			// the queue emptied
+	std::deque<CaptureFrame> m_queue;
+	std::vector<std::vector<uint8_t>> m_free;	// pixel buffers of written frames
+	bool m_busy = false;					// the worker holds a frame
+	bool m_stop = false;
+	CaptureStats m_stats;
+
+	// Worker only
+	FILE* m_raw = nullptr;
+	std::vector<uint8_t> m_encoded;
+
+	std::thread m_worker;
+};
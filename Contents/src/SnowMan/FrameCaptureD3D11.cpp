@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "FrameCaptureD3D11.h"
+
+const unsigned D3D11FrameCapture::FramesInFlight;
+const unsigned D3D11FrameCapture::Latency;
+
+D3D11FrameCapture::D3D11FrameCapture(ID3D11Device* device, ID3D11DeviceContext* context, CaptureEncoder& encoder) :
+	m_device(device),
+	m_context(context),
+	m_encoder(encoder)
+{
+}
+
+bool D3D11FrameCapture::ToCaptureFormat(DXGI_FORMAT format, CaptureFormat& captureFormat)
+{
+	switch (format) {
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		captureFormat = CaptureFormat_R8G8B8A8;
+		return true;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		captureFormat = CaptureFormat_B8G8R8A8;
+		return true;
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+		captureFormat = CaptureFormat_R10G10B10A2;
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool D3D11FrameCapture::Capture(ID3D11Texture2D* source, uint64_t frame, CaptureEncoding encoding)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	source->GetDesc(&desc);
+	CaptureFormat format;
+	if (desc.SampleDesc.Count != 1 || !ToCaptureFormat(desc.Format, format))
+		return false;
+	if (m_next - m_oldest == FramesInFlight) {
+		m_skipped++;
+		return false;
+	}
+
+	// Made on first use and again when the back buffer is resized
+	Slot& slot = m_slots[m_next % FramesInFlight];
+	D3D11_TEXTURE2D_DESC stagingDesc = {};
+	if (slot.staging)
+		slot.staging->GetDesc(&stagingDesc);
+	if (stagingDesc.Width != desc.Width || stagingDesc.Height != desc.Height || stagingDesc.Format != desc.Format) {
+		CD3D11_TEXTURE2D_DESC newDesc(desc.Format, desc.Width, desc.Height, 1, 1, 0,
+			D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_READ);
+		DX::ThrowIfFailed(m_device->CreateTexture2D(&newDesc, nullptr, slot.staging.ReleaseAndGetAddressOf()));
+	}
+	m_context->CopySubresourceRegion(slot.staging.Get(), 0, 0, 0, 0, source, 0, nullptr);
+	slot.frame = frame;
+	slot.encoding = encoding;
+	slot.format = format;
+	m_next++;
+	return true;
+}
+
+void D3D11FrameCapture::Collect(uint64_t frame)
+{
+	while (m_oldest != m_next) {
+		Slot& slot = m_slots[m_oldest % FramesInFlight];
+		if (frame < slot.frame + Latency)
+			break;
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = m_context->Map(slot.staging.Get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+			break;
+		DX::ThrowIfFailed(hr);
+
+		// Rows are padded to the driver's pitch; the encoder takes them packed
+		D3D11_TEXTURE2D_DESC desc;
+		slot.staging->GetDesc(&desc);
+		CaptureFrame captured = m_encoder.Acquire(desc.Width, desc.Height, slot.format);
+		captured.frame = slot.frame;
+		captured.encoding = slot.encoding;
+		const size_t row = desc.Width * CaptureEncoder::BytesPerPixel(slot.format);
+		const uint8_t* source = static_cast<const uint8_t*>(mapped.pData);
+		for (UINT y = 0; y < desc.Height; y++)
+			memcpy(captured.pixels.data() + y * row, source + size_t(y) * mapped.RowPitch, row);
+		m_context->Unmap(slot.staging.Get(), 0);
+		// A full queue drops the frame; the encoder counts it
+		m_encoder.Submit(std::move(captured));
+		m_oldest++;
+	}
+}
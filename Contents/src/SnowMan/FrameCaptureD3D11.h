@@ -0,0 +1,48 @@
+#pragma once
+#include "pch.h"
+#include "FrameCapture.h"
+
+// Reads frames back from the GPU for a CaptureEncoder without stalling it. Capture
+// copies the frame into the next of a ring of staging textures; Collect maps each
+// copy no sooner than Latency frames later and without waiting, so by then the GPU
+// has finished it and the frame loop never blocks on the readback. (ScreenGrab's
+// SaveDDSTextureToFile and SaveWICTextureToFile map straight after the copy, which
+// waits for the GPU to drain, and encode on the calling thread.)
+class D3D11FrameCapture
+{
+public:
+	static const unsigned FramesInFlight = 4;
+	// Frames between a copy and the first attempt to map it
+	static const unsigned Latency = 2;
+
+	D3D11FrameCapture(ID3D11Device* device, ID3D11DeviceContext* context, CaptureEncoder& encoder);
+
+	// Copies source, single sampled and in a CaptureFormat, to be encoded as encoding.
+	// False, and nothing copied, when it can not be captured or every staging texture is in flight.
+	bool Capture(ID3D11Texture2D* source, uint64_t frame, CaptureEncoding encoding);
+	// Hands the encoder the copies the GPU has finished, oldest first. frame is the current frame.
+	void Collect(uint64_t frame);
+	// Copies not yet handed to the encoder.
+	bool Pending() const { return m_oldest != m_next; }
+	// Frames Capture turned away because the ring was full.
+	uint64_t SkippedFrames() const { return m_skipped; }
+
+	static bool ToCaptureFormat(DXGI_FORMAT format, CaptureFormat& captureFormat);
+
+private:
+	struct Slot
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> staging;
+		uint64_t frame = 0;
+		CaptureEncoding encoding = CaptureEncoding_Png;
+		CaptureFormat format = CaptureFormat_R8G8B8A8;
+	};
+
+	ID3D11Device* m_device;
+	ID3D11DeviceContext* m_context;
+	CaptureEncoder& m_encoder;
+	Slot m_slots[FramesInFlight];
+	uint64_t m_next = 0;		// ring position of the next copy
+	uint64_t m_oldest = 0;		// ring position of the oldest copy not yet read back
+	uint64_t m_skipped = 0;
+};
@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "GpuTimerD3D11.h"
+
+const unsigned D3D11GpuTimer::FramesInFlight;
+
+D3D11GpuTimer::D3D11GpuTimer(ID3D11Device* device, ID3D11DeviceContext* context, unsigned maxScopes) :
+	m_context(context), m_maxScopes(maxScopes)
+{
+	D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+	D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+	for (Frame& f : m_frames) {
+		DX::ThrowIfFailed(device->CreateQuery(&disjointDesc, f.disjoint.GetAddressOf()));
+		DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, f.start.GetAddressOf()));
+		f.timestamps.resize(maxScopes * 2);
+		for (auto& query : f.timestamps)
+			DX::ThrowIfFailed(device->CreateQuery(&timestampDesc, query.GetAddressOf()));
+		f.names.resize(maxScopes);
+		f.depths.resize(maxScopes);
+	}
+}
+
+void D3D11GpuTimer::BeginFrame(uint64_t frame)
+{
+	// The ring is full when the GPU is more than FramesInFlight frames behind.
+	if (m_next - m_oldest == FramesInFlight) {
+		m_oldest++;
+		m_dropped++;
+	}
+	Frame& f = m_frames[m_next % FramesInFlight];
+	f.frame = frame;
+	f.scopeCount = 0;
+	m_depth = 0;
+	m_context->Begin(f.disjoint.Get());
+	m_context->End(f.start.Get());
+}
+
+int D3D11GpuTimer::Begin(const char* name)
+{
+	Frame& f = m_frames[m_next % FramesInFlight];
+	if (f.scopeCount == m_maxScopes)
+		return -1;
+	unsigned scope = f.scopeCount++;
+	f.names[scope] = name;
+	f.depths[scope] = m_depth++;
+	m_context->End(f.timestamps[scope * 2].Get());
+	return int(scope);
+}
+
+void D3D11GpuTimer::End(int scope)
+{
+	Frame& f = m_frames[m_next % FramesInFlight];
+	m_context->End(f.timestamps[scope * 2 + 1].Get());
+	m_depth--;
+}
+
+void D3D11GpuTimer::EndFrame()
+{
+	Frame& f = m_frames[m_next % FramesInFlight];
+	m_context->End(f.disjoint.Get());
+	m_next++;
+}
+
+bool D3D11GpuTimer::Collect(GpuFrame& out)
+{
+	while (m_oldest < m_next) {
+		Frame& f = m_frames[m_oldest % FramesInFlight];
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		if (m_context->GetData(f.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			return false;
+
+		// Once the disjoint query is done, every timestamp inside it is too.
+		uint64_t start = 0;
+		bool ok = !disjoint.Disjoint &&
+			m_context->GetData(f.start.Get(), &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK;
+		out.frame = f.frame;
+		out.samples.clear();
+		for (unsigned i = 0; ok && i < f.scopeCount; i++) {
+			uint64_t begin, end;
+			ok = m_context->GetData(f.timestamps[i * 2].Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+				m_context->GetData(f.timestamps[i * 2 + 1].Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK;
+			double toMs = 1000.0 / double(disjoint.Frequency);
+			out.samples.push_back(GpuSample{ f.names[i], double(begin - start) * toMs, double(end - start) * toMs, f.depths[i] });
+		}
+		m_oldest++;
+		if (ok)
+			return true;
+		m_dropped++;
+	}
+	return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "pch.h"
+#include "Profiler.h"
+
+// GPU scopes timed with D3D11 timestamp queries. Each frame in flight owns a
+// disjoint query and a begin/end timestamp pair per scope; results are read
+// without flushing once the frame has finished on the GPU. Frames whose
+// disjoint query reports an unreliable clock are dropped.
+class D3D11GpuTimer : public GpuTimer
+{
+public:
+	static const unsigned FramesInFlight = 4;
+
+	D3D11GpuTimer(ID3D11Device* device, ID3D11DeviceContext* context, unsigned maxScopes = 32);
+
+	void BeginFrame(uint64_t frame) override;
+	int Begin(const char* name) override;
+	void End(int scope) override;
+	void EndFrame() override;
+	bool Collect(GpuFrame& out) override;
+
+	// Frames lost to disjoint intervals or to the ring wrapping before results arrived.
+	uint64_t DroppedFrames() const { return m_dropped; }
+
+private:
+	struct Frame
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+		Microsoft::WRL::ComPtr<ID3D11Query> start;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> timestamps;	// begin, end per scope
+		std::vector<const char*> names;
+		std::vector<uint32_t> depths;
+		uint64_t frame = 0;
+		unsigned scopeCount = 0;
+	};
+
+	ID3D11DeviceContext* m_context;
+	unsigned m_maxScopes;
+	Frame m_frames[FramesInFlight];
+	uint64_t m_next = 0;		// ring position of the frame being recorded
+	uint64_t m_oldest = 0;		// ring position of the oldest pending frame
+	uint32_t m_depth = 0;
+	uint64_t m_dropped = 0;
+};
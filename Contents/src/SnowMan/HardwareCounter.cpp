@@ -0,0 +1,76 @@
+#include "HardwareCounter.h"
+#if defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+HardwareCounter::HardwareCounter(HardwareEvent event)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	if (event == HardwareEvent_L1DataMisses) {
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	}
+	else {
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	}
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// This thread, on any CPU
+	m_fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+	if (m_fd < 0)
+		m_error = std::string("perf_event_open: ") + strerror(errno);
+}
+
+HardwareCounter::~HardwareCounter()
+{
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+void HardwareCounter::Start()
+{
+	if (m_fd < 0)
+		return;
+	ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t HardwareCounter::Stop()
+{
+	if (m_fd < 0)
+		return 0;
+	ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+	uint64_t count = 0;
+	if (read(m_fd, &count, sizeof(count)) != ssize_t(sizeof(count)))
+		return 0;
+	return count;
+}
+#else
+HardwareCounter::HardwareCounter(HardwareEvent) :
+	m_error("no perf_event_open on this platform")
+{
+}
+
+HardwareCounter::~HardwareCounter()
+{
+}
+
+void HardwareCounter::Start()
+{
+}
+
+uint64_t HardwareCounter::Stop()
+{
+	return 0;
+}
+#endif
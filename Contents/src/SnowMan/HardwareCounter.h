@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+enum HardwareEvent
+{
+	HardwareEvent_CacheMisses,		// last level cache misses
+	HardwareEvent_L1DataMisses,		// level 1 data cache read misses
+};
+
+// Counts a hardware event on the calling thread through perf_event_open, for the
+// benchmark. Where the kernel refuses the counter (perf_event_paranoid, containers,
+// virtual machines without a PMU) or the platform has no perf_event_open, Available()
+// is false, Error() says why and Stop() returns 0.
+class HardwareCounter
+{
+public:
+	explicit HardwareCounter(HardwareEvent event);
+	~HardwareCounter();
+
+	HardwareCounter(const HardwareCounter&) = delete;
+	HardwareCounter& operator=(const HardwareCounter&) = delete;
+
+	bool Available() const { return m_fd >= 0; }
+	const std::string& Error() const { return m_error; }
+
+	void Start();
+	// Events since Start().
+	uint64_t Stop();
+
+private:
+	int m_fd = -1;
+	std::string m_error;
+};
@@ -0,0 +1,183 @@
+#include "HotReload.h"
+#include <algorithm>
+#include <cctype>
+#include <exception>
+
+void ReloadDependencies::Add(uint32_t resource, const std::string& file)
+{
+	std::string key = Normalize(file);
+	std::vector<uint32_t>& users = m_byFile[key];
+	if (std::find(users.begin(), users.end(), resource) != users.end())
+		return;
+	users.push_back(resource);
+	m_byResource[resource].push_back(key);
+}
+
+void ReloadDependencies::Remove(uint32_t resource)
+{
+	auto it = m_byResource.find(resource);
+	if (it == m_byResource.end())
+		return;
+	for (const std::string& file : it->second) {
+		std::vector<uint32_t>& users = m_byFile[file];
+		users.erase(std::remove(users.begin(), users.end(), resource), users.end());
+		if (users.empty())
+			m_byFile.erase(file);
+	}
+	m_byResource.erase(it);
+}
+
+void ReloadDependencies::Clear()
+{
+	m_byFile.clear();
+	m_byResource.clear();
+}
+
+void ReloadDependencies::Affected(const std::vector<std::string>& files, std::vector<uint32_t>& out) const
+{
+	size_t first = out.size();
+	for (const std::string& file : files) {
+		auto it = m_byFile.find(Normalize(file));
+		if (it != m_byFile.end())
+			out.insert(out.end(), it->second.begin(), it->second.end());
+	}
+	std::sort(out.begin() + first, out.end());
+	out.erase(std::unique(out.begin() + first, out.end()), out.end());
+}
+
+// Forward slashes, no "./" segments or doubled separators; lower case on Windows,
+// where file names are case-insensitive.
+std::string ReloadDependencies::Normalize(const std::string& path)
+{
+	std::string out;
+	out.reserve(path.size());
+	for (size_t i = 0; i < path.size(); i++) {
+		char c = path[i] == '\\' ? '/' : path[i];
+#if defined(_WIN32)
+		c = char(tolower((unsigned char)c));
+#endif
+		if (c == '/' && !out.empty() && out.back() == '/')
+			continue;
+		if (c == '.' && (out.empty() || out.back() == '/') &&
+			(i + 1 == path.size() || path[i + 1] == '/' || path[i + 1] == '\\')) {
+			i++;
+			continue;
+		}
+		out.push_back(c);
+	}
+	return out;
+}
+
+HotReload::HotReload(std::unique_ptr<FileWatcher> watcher) :
+	m_watcher(std::move(watcher))
+{
+}
+
+bool HotReload::Watch(const std::string& directory)
+{
+	std::string key = ReloadDependencies::Normalize(directory);
+	if (std::find(m_directories.begin(), m_directories.end(), key) != m_directories.end())
+		return true;
+	if (!m_watcher || !m_watcher->Watch(directory))
+		return false;
+	m_directories.push_back(key);
+	return true;
+}
+
+uint32_t HotReload::Add(const std::string& name, Reloader reload)
+{
+	m_resources.push_back(Resource{ name, std::move(reload) });
+	return uint32_t(m_resources.size() - 1);
+}
+
+void HotReload::Depend(uint32_t resource, const std::string& file)
+{
+	m_dependencies.Add(resource, file);
+	size_t slash = file.find_last_of("\\/");
+	if (slash != std::string::npos)
+		Watch(file.substr(0, slash));
+}
+
+void HotReload::SetDependencies(uint32_t resource, const std::vector<std::string>& files)
+{
+	m_dependencies.Remove(resource);
+	for (const std::string& file : files)
+		Depend(resource, file);
+}
+
+void HotReload::Clear()
+{
+	m_resources.clear();
+	m_dependencies.Clear();
+	m_pending.clear();
+	m_awaitingPresent.clear();
+}
+
+void HotReload::FileChanged(const std::string& path, Clock::time_point when)
+{
+	auto inserted = m_pending.insert(std::make_pair(ReloadDependencies::Normalize(path), Pending{ when, when }));
+	if (!inserted.second)
+		inserted.first->second.last = when;
+}
+
+size_t HotReload::Update(Clock::time_point now)
+{
+	if (m_watcher) {
+		m_changes.clear();
+		m_watcher->Poll(m_changes);
+		for (const FileChange& change : m_changes)
+			FileChanged(change.path, change.time);
+	}
+	if (m_pending.empty())
+		return 0;
+
+	// Settled files; latency is measured from the earliest change among them.
+	std::vector<std::string> files;
+	Clock::time_point firstChange = now;
+	for (auto it = m_pending.begin(); it != m_pending.end();) {
+		if (now - it->second.last < m_settle) {
+			++it;
+			continue;
+		}
+		files.push_back(it->first);
+		firstChange = std::min(firstChange, it->second.first);
+		it = m_pending.erase(it);
+	}
+	std::vector<uint32_t> affected;
+	m_dependencies.Affected(files, affected);
+
+	// Build every replacement before swapping any of them in.
+	std::vector<std::function<void()>> commits;
+	std::vector<uint32_t> built;
+	for (uint32_t resource : affected) {
+		try {
+			commits.push_back(m_resources[resource].reload(resource));
+			built.push_back(resource);
+		}
+		catch (const std::exception& e) {
+			m_reports.push_back(Report{ m_resources[resource].name, true, e.what(), 0.0 });
+		}
+	}
+	for (size_t i = 0; i < commits.size(); i++) {
+		if (commits[i])
+			commits[i]();
+		m_awaitingPresent.push_back(Swapped{ built[i], firstChange });
+	}
+	return commits.size();
+}
+
+void HotReload::FramePresented(Clock::time_point now)
+{
+	for (const Swapped& s : m_awaitingPresent) {
+		double ms = std::chrono::duration<double, std::milli>(now - s.changed).count();
+		m_reports.push_back(Report{ m_resources[s.resource].name, false, std::string(), ms });
+	}
+	m_awaitingPresent.clear();
+}
+
+std::vector<HotReload::Report> HotReload::TakeReports()
+{
+	std::vector<Report> reports;
+	reports.swap(m_reports);
+	return reports;
+}
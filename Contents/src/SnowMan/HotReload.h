@@ -0,0 +1,106 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FileWatcher.h"
+
+// Which resources are built from which files. Paths are compared after
+// Normalize, so callers can mix separators (and case, on Windows).
+class ReloadDependencies
+{
+public:
+	void Add(uint32_t resource, const std::string& file);
+	// Forgets every file of resource.
+	void Remove(uint32_t resource);
+	void Clear();
+	// Appends the resources depending on any of files, each once, in ascending order.
+	void Affected(const std::vector<std::string>& files, std::vector<uint32_t>& out) const;
+	size_t FileCount() const { return m_byFile.size(); }
+
+	static std::string Normalize(const std::string& path);
+
+private:
+	std::unordered_map<std::string, std::vector<uint32_t>> m_byFile;
+	std::unordered_map<uint32_t, std::vector<std::string>> m_byResource;
+};
+
+// Watches the files resources are built from and rebuilds the resources when
+// they change. Rebuilding happens in Update, which the frame loop calls between
+// frames: every affected resource builds its replacement first, then all the
+// replacements are swapped in together, so a frame never sees half a reload.
+class HotReload
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	// Builds a replacement for the given resource without touching the live one
+	// and returns the function that swaps it in. Throwing keeps the live resource.
+	typedef std::function<std::function<void()>(uint32_t resource)> Reloader;
+
+	struct Report
+	{
+		std::string name;
+		bool failed;
+		std::string error;
+		double latencyMs;		// first file change to the end of the frame that shows it
+	};
+
+	explicit HotReload(std::unique_ptr<FileWatcher> watcher = FileWatcher::Create());
+
+	// UTF-8 directory; watching the same directory twice is harmless.
+	bool Watch(const std::string& directory);
+
+	uint32_t Add(const std::string& name, Reloader reload);
+	// Also watches the file's directory.
+	void Depend(uint32_t resource, const std::string& file);
+	// Replaces the files of resource, e.g. with the includes found by a recompile.
+	void SetDependencies(uint32_t resource, const std::vector<std::string>& files);
+	// Drops every resource, keeps the watched directories.
+	void Clear();
+
+	// Records a change as the watcher would.
+	void FileChanged(const std::string& path, Clock::time_point when);
+
+	// Call at a frame boundary. Reloads resources whose files changed and have then
+	// been quiet for the settle time (editors often write a file several times).
+	// Returns the number of resources swapped in.
+	size_t Update(Clock::time_point now = Clock::now());
+	// Call after presenting the frame; completes the latency of this frame's swaps.
+	void FramePresented(Clock::time_point now = Clock::now());
+	std::vector<Report> TakeReports();
+
+	void SetSettleTime(Clock::duration settle) { m_settle = settle; }
+	const ReloadDependencies& Dependencies() const { return m_dependencies; }
+
+private:
+	struct Resource
+	{
+		std::string name;
+		Reloader reload;
+	};
+
+	struct Pending
+	{
+		Clock::time_point first;
+		Clock::time_point last;
+	};
+
+	struct Swapped
+	{
+		uint32_t resource;
+		Clock::time_point changed;
+	};
+
+	std::unique_ptr<FileWatcher> m_watcher;
+	std::vector<std::string> m_directories;
+	std::vector<Resource> m_resources;
+	ReloadDependencies m_dependencies;
+	std::unordered_map<std::string, Pending> m_pending;
+	std::vector<Swapped> m_awaitingPresent;
+	std::vector<Report> m_reports;
+	std::vector<FileChange> m_changes;
+	Clock::duration m_settle = std::chrono::milliseconds(50);
+};
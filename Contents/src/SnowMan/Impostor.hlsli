@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// Impostor.hlsli
+//
+// Octahedral impostor billboards: the frame selection of ImpostorAtlas.cpp, and what
+// impostorVert.hlsl hands impostorPixel.hlsl.
+//--------------------------------------------------------------------------------------
+cbuffer ImpostorBuffer : register(b4)
+{
+	matrix viewProjection;
+	float4 camPos;
+	uint framesPerSide;
+	uint objectsPerRow;
+	float2 frameSize;		// in atlas texture coordinates
+};
+
+struct ImpostorInterpolants
+{
+	float4 position                     : SV_Position;
+	float2 tex                          : TEXCOORD0;
+	float3 worldPosition                : TEXCOORD1;
+	nointerpolation float3 forward      : TEXCOORD2;	// away from the viewer, radius long
+	nointerpolation float2 axis         : TEXCOORD3;
+};
+
+// ImpostorAtlas::Encode and Decode
+float2 EncodeHemiOctahedral(float3 dir)
+{
+	dir.y = max(dir.y, 0.0f);
+	dir /= abs(dir.x) + dir.y + abs(dir.z);
+	return float2(dir.x + dir.z, dir.x - dir.z) * 0.5f + 0.5f;
+}
+
+float3 DecodeHemiOctahedral(float2 uv)
+{
+	uv = uv * 2.0f - 1.0f;
+	float x = (uv.x + uv.y) * 0.5f, z = (uv.x - uv.y) * 0.5f;
+	return normalize(float3(x, 1.0f - abs(x) - abs(z), z));
+}
+
+// ImpostorAtlas::ToObject and ToWorld
+float3 ImpostorToObject(float2 axis, float3 v)
+{
+	return float3(v.x * axis.x + v.z * axis.y, v.y, v.z * axis.x - v.x * axis.y);
+}
+
+float3 ImpostorToWorld(float2 axis, float3 v)
+{
+	return float3(v.x * axis.x - v.z * axis.y, v.y, v.x * axis.y + v.z * axis.x);
+}
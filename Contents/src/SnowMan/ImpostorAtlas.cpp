@@ -0,0 +1,97 @@
+#include "ImpostorAtlas.h"
+#include <algorithm>
+#include <cmath>
+
+ImpostorAtlasLayout ImpostorAtlas::MakeLayout(uint32_t objectCount, uint32_t framesPerSide, uint32_t frameSize, uint32_t maxWidth)
+{
+	ImpostorAtlasLayout layout;
+	layout.framesPerSide = std::max(framesPerSide, 1u);
+	layout.frameSize = std::max(frameSize, 1u);
+	layout.objectCount = objectCount;
+	const uint32_t block = layout.framesPerSide * layout.frameSize;
+	layout.objectsPerRow = std::max(1u, std::min(std::max(objectCount, 1u), maxWidth / block));
+	const uint32_t rows = (std::max(objectCount, 1u) + layout.objectsPerRow - 1) / layout.objectsPerRow;
+	layout.width = layout.objectsPerRow * block;
+	layout.height = rows * block;
+	return layout;
+}
+
+void ImpostorAtlas::Encode(const float dir[3], float uv[2])
+{
+	// Onto the octahedron |x| + |y| + |z| = 1, then its upper half turned 45 degrees
+	// to fill the square
+	const float y = std::max(dir[1], 0.0f);
+	const float l1 = std::fabs(dir[0]) + y + std::fabs(dir[2]);
+	const float x = l1 > 0.0f ? dir[0] / l1 : 0.0f;
+	const float z = l1 > 0.0f ? dir[2] / l1 : 0.0f;
+	uv[0] = (x + z) * 0.5f + 0.5f;
+	uv[1] = (x - z) * 0.5f + 0.5f;
+}
+
+void ImpostorAtlas::Decode(const float uv[2], float dir[3])
+{
+	const float u = uv[0] * 2.0f - 1.0f, v = uv[1] * 2.0f - 1.0f;
+	const float x = (u + v) * 0.5f, z = (u - v) * 0.5f;
+	const float y = 1.0f - std::fabs(x) - std::fabs(z);
+	const float length = std::sqrt(x * x + y * y + z * z);
+	dir[0] = x / length;
+	dir[1] = y / length;
+	dir[2] = z / length;
+}
+
+void ImpostorAtlas::FrameDirection(const ImpostorAtlasLayout& layout, uint32_t frame, float dir[3])
+{
+	const float n = float(layout.framesPerSide);
+	const float uv[2] = { (float(frame % layout.framesPerSide) + 0.5f) / n, (float(frame / layout.framesPerSide) + 0.5f) / n };
+	Decode(uv, dir);
+}
+
+uint32_t ImpostorAtlas::SelectFrame(const ImpostorAtlasLayout& layout, const float dir[3])
+{
+	float uv[2];
+	Encode(dir, uv);
+	const uint32_t last = layout.framesPerSide - 1;
+	const uint32_t x = std::min(uint32_t(std::max(uv[0] * float(layout.framesPerSide), 0.0f)), last);
+	const uint32_t y = std::min(uint32_t(std::max(uv[1] * float(layout.framesPerSide), 0.0f)), last);
+	return y * layout.framesPerSide + x;
+}
+
+void ImpostorAtlas::FrameBasis(const float dir[3], float right[3], float up[3])
+{
+	// Looking along forward = -dir; right = up hint x forward, up = forward x right
+	const float forward[3] = { -dir[0], -dir[1], -dir[2] };
+	const bool vertical = std::fabs(dir[1]) > 0.999f;
+	const float hint[3] = { 0.0f, vertical ? 0.0f : 1.0f, vertical ? 1.0f : 0.0f };
+	right[0] = hint[1] * forward[2] - hint[2] * forward[1];
+	right[1] = hint[2] * forward[0] - hint[0] * forward[2];
+	right[2] = hint[0] * forward[1] - hint[1] * forward[0];
+	const float length = std::sqrt(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+	for (int i = 0; i < 3; i++)
+		right[i] /= length;
+	up[0] = forward[1] * right[2] - forward[2] * right[1];
+	up[1] = forward[2] * right[0] - forward[0] * right[2];
+	up[2] = forward[0] * right[1] - forward[1] * right[0];
+}
+
+void ImpostorAtlas::FrameRect(const ImpostorAtlasLayout& layout, uint32_t object, uint32_t frame, uint32_t rect[4])
+{
+	const uint32_t block = layout.framesPerSide * layout.frameSize;
+	rect[0] = (object % layout.objectsPerRow) * block + (frame % layout.framesPerSide) * layout.frameSize;
+	rect[1] = (object / layout.objectsPerRow) * block + (frame / layout.framesPerSide) * layout.frameSize;
+	rect[2] = rect[3] = layout.frameSize;
+}
+
+void ImpostorAtlas::ToObject(const float axis[2], const float world[3], float object[3])
+{
+	// Object x is (a, 0, b) in the world and z is (-b, 0, a)
+	object[0] = world[0] * axis[0] + world[2] * axis[1];
+	object[1] = world[1];
+	object[2] = world[2] * axis[0] - world[0] * axis[1];
+}
+
+void ImpostorAtlas::ToWorld(const float axis[2], const float object[3], float world[3])
+{
+	world[0] = object[0] * axis[0] - object[2] * axis[1];
+	world[1] = object[1];
+	world[2] = object[0] * axis[1] + object[2] * axis[0];
+}
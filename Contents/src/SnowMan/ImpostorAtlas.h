@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+
+// Where the views of each impostor object are in the atlas. An object takes a square
+// block of framesPerSide x framesPerSide frames of frameSize pixels; blocks fill rows
+// objectsPerRow wide.
+struct ImpostorAtlasLayout
+{
+	uint32_t framesPerSide = 0;
+	uint32_t frameSize = 0;
+	uint32_t objectCount = 0;
+	uint32_t objectsPerRow = 0;
+	uint32_t width = 0;			// pixels
+	uint32_t height = 0;
+};
+
+// One billboard, 32 bytes as impostorVert.hlsl reads them. Objects stay upright: of
+// their transform only the position, the largest scale (in radius) and the yaw are kept.
+struct ImpostorInstance
+{
+	float center[3];			// world space bounding sphere
+	float radius;
+	float axis[2];				// the object's x axis in the world's xz plane, unit length
+	uint32_t object;
+	uint32_t pad;
+};
+
+// Octahedral impostors: an object seen from framesPerSide^2 directions over the upper
+// hemisphere, laid out by the hemi-octahedral mapping of direction to the unit square so
+// neighbouring frames are neighbouring views. Directions point from the object to the
+// viewer in the object's space, y up; views from below use the frames on the horizon.
+// impostorVert.hlsl repeats SelectFrame, FrameBasis and the axis rotations.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+namespace ImpostorAtlas
+{
+	// Packs objectCount blocks into rows at most maxWidth pixels wide.
+	ImpostorAtlasLayout MakeLayout(uint32_t objectCount, uint32_t framesPerSide, uint32_t frameSize, uint32_t maxWidth);
+
+	// Hemi-octahedral mapping between unit directions with y >= 0 and [0, 1]^2.
+	void Encode(const float dir[3], float uv[2]);
+	void Decode(const float uv[2], float dir[3]);
+
+	inline uint32_t FrameCount(const ImpostorAtlasLayout& layout) { return layout.framesPerSide * layout.framesPerSide; }
+	// The direction frame was baked from: its cell's center.
+	void FrameDirection(const ImpostorAtlasLayout& layout, uint32_t frame, float dir[3]);
+	// The frame whose cell dir falls in; dir need not be unit length.
+	uint32_t SelectFrame(const ImpostorAtlasLayout& layout, const float dir[3]);
+	// The view's right and up for a viewer in direction dir, as XMMatrixLookAtLH builds
+	// them looking back at the object: world up, or +z when looking straight down.
+	void FrameBasis(const float dir[3], float right[3], float up[3]);
+	// Pixel rectangle of an object's frame: x, y, width, height.
+	void FrameRect(const ImpostorAtlasLayout& layout, uint32_t object, uint32_t frame, uint32_t rect[4]);
+
+	// Between world directions and an instance's object space, by its axis.
+	void ToObject(const float axis[2], const float world[3], float object[3]);
+	void ToWorld(const float axis[2], const float object[3], float world[3]);
+}
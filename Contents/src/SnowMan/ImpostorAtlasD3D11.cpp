@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "ImpostorAtlasD3D11.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	void CreateTarget(ID3D11Device* device, UINT width, UINT height, DXGI_FORMAT format, ComPtr<ID3D11Texture2D>& texture,
+		ComPtr<ID3D11RenderTargetView>& target, ComPtr<ID3D11ShaderResourceView>& view)
+	{
+		CD3D11_TEXTURE2D_DESC desc(format, width, height, 1, 1, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+		DX::ThrowIfFailed(device->CreateTexture2D(&desc, nullptr, texture.GetAddressOf()));
+		DX::ThrowIfFailed(device->CreateRenderTargetView(texture.Get(), nullptr, target.GetAddressOf()));
+		DX::ThrowIfFailed(device->CreateShaderResourceView(texture.Get(), nullptr, view.GetAddressOf()));
+	}
+}
+
+D3D11ImpostorAtlas::D3D11ImpostorAtlas(ID3D11Device* device, const ImpostorAtlasLayout& layout) :
+	m_layout(layout)
+{
+	// Sampled as linear, like the textures the albedo comes from
+	CreateTarget(device, layout.width, layout.height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, m_albedo, m_albedoTarget, m_albedoView);
+	CreateTarget(device, layout.width, layout.height, DXGI_FORMAT_R16G16B16A16_FLOAT, m_normalDepth, m_normalDepthTarget, m_normalDepthView);
+	CD3D11_TEXTURE2D_DESC depthDesc(DXGI_FORMAT_D32_FLOAT, layout.width, layout.height, 1, 1, D3D11_BIND_DEPTH_STENCIL);
+	DX::ThrowIfFailed(device->CreateTexture2D(&depthDesc, nullptr, m_depth.GetAddressOf()));
+	DX::ThrowIfFailed(device->CreateDepthStencilView(m_depth.Get(), nullptr, m_depthTarget.GetAddressOf()));
+
+	// Clamped so the frames on the atlas's edges do not wrap around
+	CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+	DX::ThrowIfFailed(device->CreateSamplerState(&samplerDesc, m_sampler.GetAddressOf()));
+
+	CD3D11_BUFFER_DESC constantsDesc(sizeof(ImpostorBufferType), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	DX::ThrowIfFailed(device->CreateBuffer(&constantsDesc, nullptr, m_constants.GetAddressOf()));
+
+	static const uint16_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+	CD3D11_BUFFER_DESC quadDesc(sizeof(quad), D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+	D3D11_SUBRESOURCE_DATA quadData = { quad, 0, 0 };
+	DX::ThrowIfFailed(device->CreateBuffer(&quadDesc, &quadData, m_quadIndices.GetAddressOf()));
+}
+
+void D3D11ImpostorAtlas::BeginBake(ID3D11DeviceContext* context)
+{
+	const float clear[4] = {};
+	context->ClearRenderTargetView(m_albedoTarget.Get(), clear);
+	context->ClearRenderTargetView(m_normalDepthTarget.Get(), clear);
+	context->ClearDepthStencilView(m_depthTarget.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	ID3D11RenderTargetView* targets[2] = { m_albedoTarget.Get(), m_normalDepthTarget.Get() };
+	context->OMSetRenderTargets(2, targets, m_depthTarget.Get());
+}
+
+void D3D11ImpostorAtlas::BakeFrame(ID3D11DeviceContext* context, uint32_t object, uint32_t frame, const BoundingSphere& bounds,
+	XMMATRIX& view, XMMATRIX& projection) const
+{
+	uint32_t rect[4];
+	ImpostorAtlas::FrameRect(m_layout, object, frame, rect);
+	CD3D11_VIEWPORT viewport(float(rect[0]), float(rect[1]), float(rect[2]), float(rect[3]));
+	context->RSSetViewports(1, &viewport);
+
+	// From two radii out along the frame's direction, so the sphere spans depth 0 to 1
+	XMFLOAT3 dir, right, up;
+	ImpostorAtlas::FrameDirection(m_layout, frame, &dir.x);
+	ImpostorAtlas::FrameBasis(&dir.x, &right.x, &up.x);
+	XMVECTOR center = XMLoadFloat3(&bounds.Center);
+	XMVECTOR eye = center + XMLoadFloat3(&dir) * (2.0f * bounds.Radius);
+	view = XMMatrixLookAtLH(eye, center, XMLoadFloat3(&up));
+	projection = XMMatrixOrthographicLH(2.0f * bounds.Radius, 2.0f * bounds.Radius, bounds.Radius, 3.0f * bounds.Radius);
+}
+
+void D3D11ImpostorAtlas::EndBake(ID3D11DeviceContext* context)
+{
+	context->OMSetRenderTargets(0, nullptr, nullptr);
+}
+
+void D3D11ImpostorAtlas::Reserve(ID3D11Device* device, size_t count)
+{
+	if (count <= m_capacity)
+		return;
+	// Doubling, so a growing crowd does not recreate it every frame
+	m_capacity = std::max(count, m_capacity * 2);
+	CD3D11_BUFFER_DESC desc(UINT(m_capacity * sizeof(ImpostorInstance)), D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC,
+		D3D11_CPU_ACCESS_WRITE, D3D11_RESOURCE_MISC_BUFFER_STRUCTURED, sizeof(ImpostorInstance));
+	DX::ThrowIfFailed(device->CreateBuffer(&desc, nullptr, m_instances.ReleaseAndGetAddressOf()));
+	CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(m_instances.Get(), DXGI_FORMAT_UNKNOWN, 0, UINT(m_capacity));
+	DX::ThrowIfFailed(device->CreateShaderResourceView(m_instances.Get(), &viewDesc, m_instanceView.ReleaseAndGetAddressOf()));
+}
+
+ImpostorBufferType D3D11ImpostorAtlas::Constants(FXMMATRIX viewProjection, const XMFLOAT3& camPos) const
+{
+	ImpostorBufferType constants;
+	constants.viewProjection = XMMatrixTranspose(viewProjection);
+	constants.camPos = XMFLOAT4(camPos.x, camPos.y, camPos.z, 1.0f);
+	constants.framesPerSide = m_layout.framesPerSide;
+	constants.objectsPerRow = m_layout.objectsPerRow;
+	constants.frameWidth = float(m_layout.frameSize) / float(m_layout.width);
+	constants.frameHeight = float(m_layout.frameSize) / float(m_layout.height);
+	return constants;
+}
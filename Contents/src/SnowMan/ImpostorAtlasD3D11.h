@@ -0,0 +1,68 @@
+#pragma once
+#include "pch.h"
+#include "ImpostorAtlas.h"
+#include <DirectXCollision.h>
+
+// Constants of impostorVert.hlsl and impostorPixel.hlsl
+struct ImpostorBufferType
+{
+	DirectX::XMMATRIX viewProjection;
+	DirectX::XMFLOAT4 camPos;
+	uint32_t framesPerSide;
+	uint32_t objectsPerRow;
+	float frameWidth;			// of a frame, in atlas texture coordinates
+	float frameHeight;
+};
+
+// The GPU side of an ImpostorAtlasLayout: albedo with coverage in alpha, and object
+// space normal with depth through the bounding sphere in alpha. Frames are baked one
+// viewport at a time by drawing the object's meshes with the scene's vertex shaders and
+// impostorBakePixel.hlsl. Also keeps the buffer the frame's instances are written to and
+// the quad they are drawn as.
+class D3D11ImpostorAtlas
+{
+public:
+	D3D11ImpostorAtlas(ID3D11Device* device, const ImpostorAtlasLayout& layout);
+
+	// Clears the atlas and binds it as the targets for the frames to be drawn into.
+	void BeginBake(ID3D11DeviceContext* context);
+	// Sets the viewport of an object's frame and returns the view and projection it is
+	// seen with: orthographic and just around bounds, in the object's space.
+	void BakeFrame(ID3D11DeviceContext* context, uint32_t object, uint32_t frame, const DirectX::BoundingSphere& bounds,
+		DirectX::XMMATRIX& view, DirectX::XMMATRIX& projection) const;
+	// Unbinds the atlas so it can be sampled.
+	void EndBake(ID3D11DeviceContext* context);
+
+	// Grows the instance buffer to hold at least count instances.
+	void Reserve(ID3D11Device* device, size_t count);
+	ImpostorBufferType Constants(DirectX::FXMMATRIX viewProjection, const DirectX::XMFLOAT3& camPos) const;
+
+	const ImpostorAtlasLayout& Layout() const { return m_layout; }
+	ID3D11ShaderResourceView* Albedo() const { return m_albedoView.Get(); }
+	ID3D11ShaderResourceView* NormalDepth() const { return m_normalDepthView.Get(); }
+	ID3D11SamplerState* Sampler() const { return m_sampler.Get(); }
+	// Dynamic; ImpostorInstance per element
+	ID3D11Buffer* Instances() const { return m_instances.Get(); }
+	ID3D11ShaderResourceView* InstanceView() const { return m_instanceView.Get(); }
+	size_t Capacity() const { return m_capacity; }
+	ID3D11Buffer* ConstantBuffer() const { return m_constants.Get(); }
+	// Corners 0..3 of impostorVert.hlsl: top left, top right, bottom left, bottom right
+	ID3D11Buffer* QuadIndices() const { return m_quadIndices.Get(); }
+
+private:
+	ImpostorAtlasLayout m_layout;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_albedo;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_albedoTarget;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_albedoView;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_normalDepth;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_normalDepthTarget;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_normalDepthView;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_depth;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> m_depthTarget;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_sampler;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_instances;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_instanceView;
+	size_t m_capacity = 0;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_constants;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_quadIndices;
+};
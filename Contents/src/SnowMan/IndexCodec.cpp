@@ -0,0 +1,184 @@
+#include "IndexCodec.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define INDEXCODEC_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	const uint32_t PackMagic = 0x58444953; // 'SIDX'
+
+	struct PackHeader
+	{
+		uint32_t magic;
+		uint32_t indexCount;
+		uint32_t byteCount;
+	};
+
+	inline uint32_t ZigZag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+	inline int32_t UnZigZag(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+	// Decodes one varint delta at src[pos]. Returns false on truncated or overlong input.
+	inline bool DecodeOne(const uint8_t* src, size_t srcSize, size_t& pos, uint32_t& prev)
+	{
+		uint32_t v = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (pos >= srcSize)
+				return false;
+			uint8_t b = src[pos++];
+			v |= uint32_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) {
+				prev += uint32_t(UnZigZag(v));
+				return true;
+			}
+		}
+		return false;
+	}
+
+#ifdef INDEXCODEC_SSE2
+	inline __m128i UnZigZag4(__m128i v)
+	{
+		const __m128i one = _mm_set1_epi32(1);
+		return _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one)));
+	}
+
+	inline int CountTrailingZeros(uint32_t mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return int(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	inline __m128i PrefixSum4(__m128i v)
+	{
+		v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+		return _mm_add_epi32(v, _mm_slli_si128(v, 8));
+	}
+#endif
+}
+
+std::vector<uint8_t> IndexCodec::Encode(const uint32_t* indices, size_t count)
+{
+	std::vector<uint8_t> out;
+	out.reserve(count + count / 4);
+	uint32_t prev = 0;
+	for (size_t i = 0; i < count; i++) {
+		uint32_t v = ZigZag(int32_t(indices[i] - prev));
+		prev = indices[i];
+		while (v >= 0x80) {
+			out.push_back(uint8_t(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back(uint8_t(v));
+	}
+	return out;
+}
+
+size_t IndexCodec::DecodeScalar(const uint8_t* src, size_t srcSize, uint32_t* dst, size_t count)
+{
+	size_t pos = 0;
+	uint32_t prev = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (!DecodeOne(src, srcSize, pos, prev))
+			return 0;
+		dst[i] = prev;
+	}
+	return pos;
+}
+
+size_t IndexCodec::Decode(const uint8_t* src, size_t srcSize, uint32_t* dst, size_t count)
+{
+#ifdef INDEXCODEC_SSE2
+	size_t pos = 0;
+	size_t i = 0;
+	uint32_t prev = 0;
+	size_t backoff = 1;			// scalar indices after a failed check, doubling while they keep failing
+	const __m128i zero = _mm_setzero_si128();
+	while (i < count) {
+		// Fast path: 16 single-byte deltas in a row, decoded and prefix-summed in registers.
+		size_t scalarRun = 1;
+		if (count - i >= 16 && srcSize - pos >= 16) {
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+			int mask = _mm_movemask_epi8(bytes);
+			if (mask == 0) {
+				__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+				__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+				__m128i d0 = PrefixSum4(UnZigZag4(_mm_unpacklo_epi16(lo, zero)));
+				__m128i d1 = PrefixSum4(UnZigZag4(_mm_unpackhi_epi16(lo, zero)));
+				__m128i d2 = PrefixSum4(UnZigZag4(_mm_unpacklo_epi16(hi, zero)));
+				__m128i d3 = PrefixSum4(UnZigZag4(_mm_unpackhi_epi16(hi, zero)));
+
+				__m128i base = _mm_set1_epi32(int32_t(prev));
+				d0 = _mm_add_epi32(d0, base);
+				base = _mm_shuffle_epi32(d0, _MM_SHUFFLE(3, 3, 3, 3));
+				d1 = _mm_add_epi32(d1, base);
+				base = _mm_shuffle_epi32(d1, _MM_SHUFFLE(3, 3, 3, 3));
+				d2 = _mm_add_epi32(d2, base);
+				base = _mm_shuffle_epi32(d2, _MM_SHUFFLE(3, 3, 3, 3));
+				d3 = _mm_add_epi32(d3, base);
+
+				__m128i* out = reinterpret_cast<__m128i*>(dst + i);
+				_mm_storeu_si128(out + 0, d0);
+				_mm_storeu_si128(out + 1, d1);
+				_mm_storeu_si128(out + 2, d2);
+				_mm_storeu_si128(out + 3, d3);
+				prev = uint32_t(_mm_cvtsi128_si32(_mm_shuffle_epi32(d3, _MM_SHUFFLE(3, 3, 3, 3))));
+				pos += 16;
+				i += 16;
+				backoff = 1;
+				continue;
+			}
+			// Everything up to and including the first multi-byte varint goes through the scalar
+			// path, and then more the more checks fail in a row: where long deltas are common, as
+			// in grids wider than 64, a check before every one costs more than the fast path saves.
+			scalarRun = std::min(std::max(size_t(CountTrailingZeros(uint32_t(mask))) + 1, backoff), count - i);
+			backoff = std::min(backoff * 2, size_t(1024));
+		}
+		for (size_t end = i + scalarRun; i < end; i++) {
+			if (!DecodeOne(src, srcSize, pos, prev))
+				return 0;
+			dst[i] = prev;
+		}
+	}
+	return pos;
+#else
+	return DecodeScalar(src, srcSize, dst, count);
+#endif
+}
+
+void IndexCodec::WritePack(const uint32_t* indices, size_t count, std::vector<uint8_t>& out)
+{
+	const std::vector<uint8_t> bytes = Encode(indices, count);
+	const PackHeader header = { PackMagic, uint32_t(count), uint32_t(bytes.size()) };
+	out.resize(sizeof(header));
+	memcpy(out.data(), &header, sizeof(header));
+	out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+bool IndexCodec::ReadPack(const uint8_t* data, size_t size, std::vector<uint32_t>& indices)
+{
+	indices.clear();
+	PackHeader header;
+	if (size < sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	// Every index takes at least a byte, so a pack cannot claim more indices than bytes
+	if (header.magic != PackMagic || header.byteCount != size - sizeof(header) || header.indexCount > header.byteCount)
+		return false;
+	indices.resize(header.indexCount);
+	if (Decode(data + sizeof(header), header.byteCount, indices.data(), indices.size()) != header.byteCount) {
+		indices.clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Compressed index streams: each index is stored as the zigzag-encoded delta
+// from the previous one, written as a LEB128 varint. Triangle lists built from
+// grids and GeometricPrimitive have small deltas, so most indices take 1 byte.
+namespace IndexCodec
+{
+	std::vector<uint8_t> Encode(const uint32_t* indices, size_t count);
+	inline std::vector<uint8_t> Encode(const std::vector<uint32_t>& indices) { return Encode(indices.data(), indices.size()); }
+
+	// Decodes exactly count indices from src. Returns the number of bytes consumed,
+	// or 0 if the stream is truncated or malformed.
+	size_t Decode(const uint8_t* src, size_t srcSize, uint32_t* dst, size_t count);
+
+	// Reference decoder without the SSE2 fast path.
+	size_t DecodeScalar(const uint8_t* src, size_t srcSize, uint32_t* dst, size_t count);
+
+	// An index pack as the asset pack stores it: a header with the index and byte counts,
+	// then the encoded stream.
+	void WritePack(const uint32_t* indices, size_t count, std::vector<uint8_t>& out);
+	// False, with indices empty, unless the header's counts match size and the stream
+	// decodes to exactly them. Nothing is allocated before the counts are checked.
+	bool ReadPack(const uint8_t* data, size_t size, std::vector<uint32_t>& indices);
+}
@@ -0,0 +1,275 @@
+#include "InputLog.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char InputMagic[4] = { 'I', 'N', 'P', '1' };
+
+	// Field bits of a tick's first byte; Run stands alone and is followed by the run length
+	enum : uint8_t
+	{
+		Field_Keys = 1 << 0,
+		Field_MouseX = 1 << 1,
+		Field_MouseY = 1 << 2,
+		Field_Scroll = 1 << 3,
+		Field_Buttons = 1 << 4,
+		Field_Run = 1 << 7,
+	};
+
+	void PutVarint(std::vector<uint8_t>& out, uint32_t v)
+	{
+		while (v >= 0x80) {
+			out.push_back(uint8_t(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back(uint8_t(v));
+	}
+
+	bool GetVarint(const uint8_t* data, size_t size, size_t& at, uint32_t& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (at >= size)
+				return false;
+			uint8_t b = data[at++];
+			v |= uint32_t(b & 0x7F) << shift;
+			if (!(b & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	// Differences wrap, so any two int32 values round trip
+	uint32_t ZigZag(int32_t value, int32_t previous)
+	{
+		uint32_t d = uint32_t(value) - uint32_t(previous);
+		return (d << 1) ^ (0u - (d >> 31));
+	}
+
+	int32_t UnZigZag(uint32_t v, int32_t previous)
+	{
+		uint32_t d = (v >> 1) ^ (0u - (v & 1));
+		return int32_t(uint32_t(previous) + d);
+	}
+
+	// Decodes one token into input from previous; a run sets repeats to the ticks it covers.
+	bool DecodeTick(const uint8_t* data, size_t size, size_t& at, InputSnapshot& input, uint32_t& repeats)
+	{
+		if (at >= size)
+			return false;
+		uint8_t fields = data[at++];
+		repeats = 1;
+		if (fields == Field_Run)
+			return GetVarint(data, size, at, repeats) && repeats > 0;
+		if (fields & ~uint8_t(Field_Keys | Field_MouseX | Field_MouseY | Field_Scroll | Field_Buttons))
+			return false;
+		uint32_t v;
+		if (fields & Field_Keys) {
+			if (!GetVarint(data, size, at, v))
+				return false;
+			input.keys = v;
+		}
+		if (fields & Field_MouseX) {
+			if (!GetVarint(data, size, at, v))
+				return false;
+			input.mouseX = UnZigZag(v, input.mouseX);
+		}
+		if (fields & Field_MouseY) {
+			if (!GetVarint(data, size, at, v))
+				return false;
+			input.mouseY = UnZigZag(v, input.mouseY);
+		}
+		if (fields & Field_Scroll) {
+			if (!GetVarint(data, size, at, v))
+				return false;
+			input.scroll = UnZigZag(v, input.scroll);
+		}
+		if (fields & Field_Buttons) {
+			if (at >= size)
+				return false;
+			uint8_t b = data[at++];
+			input.buttons = uint8_t(b & 0x7F);
+			input.relative = uint8_t(b >> 7);
+		}
+		return true;
+	}
+}
+
+uint32_t FlipToggles(uint32_t toggles, uint32_t pressed)
+{
+	// In InputToggle order
+	static const uint32_t keys[] = { InputKey_O, InputKey_K, InputKey_P, InputKey_N, InputKey_L, InputKey_X, InputKey_B, InputKey_G };
+	for (uint32_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		toggles ^= (pressed & keys[i]) ? 1u << i : 0u;
+	return toggles;
+}
+
+void InputLog::Reset(uint32_t ticksPerSecond, const InputOrigin& origin)
+{
+	m_ticksPerSecond = ticksPerSecond;
+	m_tickCount = 0;
+	m_origin = origin;
+	m_stream.clear();
+	m_last = InputSnapshot();
+	m_run = 0;
+	Rewind();
+}
+
+void InputLog::Record(const InputSnapshot& input)
+{
+	m_tickCount++;
+	if (input == m_last) {
+		m_run++;
+		return;
+	}
+	FlushRun(m_stream);
+	m_run = 0;
+
+	const uint8_t fields = uint8_t((input.keys != m_last.keys ? Field_Keys : 0) |
+		(input.mouseX != m_last.mouseX ? Field_MouseX : 0) |
+		(input.mouseY != m_last.mouseY ? Field_MouseY : 0) |
+		(input.scroll != m_last.scroll ? Field_Scroll : 0) |
+		(input.buttons != m_last.buttons || input.relative != m_last.relative ? Field_Buttons : 0));
+	m_stream.push_back(fields);
+	if (fields & Field_Keys)
+		PutVarint(m_stream, input.keys);
+	if (fields & Field_MouseX)
+		PutVarint(m_stream, ZigZag(input.mouseX, m_last.mouseX));
+	if (fields & Field_MouseY)
+		PutVarint(m_stream, ZigZag(input.mouseY, m_last.mouseY));
+	if (fields & Field_Scroll)
+		PutVarint(m_stream, ZigZag(input.scroll, m_last.scroll));
+	if (fields & Field_Buttons)
+		m_stream.push_back(uint8_t((input.buttons & 0x7F) | (input.relative ? 0x80 : 0)));
+	m_last = input;
+}
+
+void InputLog::FlushRun(std::vector<uint8_t>& stream) const
+{
+	if (m_run == 0)
+		return;
+	stream.push_back(Field_Run);
+	PutVarint(stream, m_run);
+}
+
+void InputLog::Rewind()
+{
+	// A run still being recorded goes into the stream, so it reads back like a saved log
+	FlushRun(m_stream);
+	m_run = 0;
+	m_read = 0;
+	m_previous = InputSnapshot();
+	m_repeats = 0;
+	m_ticksRead = 0;
+}
+
+bool InputLog::Next(InputSnapshot& input)
+{
+	if (m_ticksRead >= m_tickCount)
+		return false;
+	if (m_repeats == 0) {
+		InputSnapshot decoded = m_previous;
+		// The stream was checked by Parse or written by Record
+		if (!DecodeTick(m_stream.data(), m_stream.size(), m_read, decoded, m_repeats))
+			return false;
+		m_previous = decoded;
+	}
+	m_repeats--;
+	m_ticksRead++;
+	input = m_previous;
+	return true;
+}
+
+size_t InputLog::StreamBytes() const
+{
+	std::vector<uint8_t> run;
+	FlushRun(run);
+	return m_stream.size() + run.size();
+}
+
+bool InputLog::Parse(const uint8_t* data, size_t size, std::string* error)
+{
+	auto fail = [&](const char* why) {
+		if (error)
+			*error = why;
+		Reset(60, InputOrigin());
+		return false;
+	};
+	InputLogHeader header;
+	if (size < sizeof(header))
+		return fail("input log is shorter than its header");
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, InputMagic, sizeof(InputMagic)) != 0)
+		return fail("not an input log");
+	if (header.version != InputLogVersion)
+		return fail("unsupported input log version");
+	if (header.streamBytes != size - sizeof(header))
+		return fail("input log stream size does not match its header");
+
+	const uint8_t* stream = data + sizeof(header);
+	size_t at = 0;
+	uint64_t ticks = 0;
+	InputSnapshot input = {};
+	uint32_t repeats;
+	while (at < header.streamBytes) {
+		if (!DecodeTick(stream, header.streamBytes, at, input, repeats))
+			return fail("input log stream is corrupt");
+		ticks += repeats;
+	}
+	if (ticks != header.tickCount)
+		return fail("input log tick count does not match its header");
+
+	Reset(header.ticksPerSecond, header.origin);
+	m_stream.assign(stream, stream + header.streamBytes);
+	m_tickCount = header.tickCount;
+	return true;
+}
+
+bool InputLog::Load(const char* path, std::string* error)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp) {
+		if (error)
+			*error = std::string("cannot open ") + path;
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	std::vector<uint8_t> data(size_t(size > 0 ? size : 0));
+	size_t read = fread(data.data(), 1, data.size(), fp);
+	fclose(fp);
+	if (read != data.size()) {
+		if (error)
+			*error = std::string("cannot read ") + path;
+		return false;
+	}
+	return Parse(data.data(), data.size(), error);
+}
+
+void InputLog::Serialize(std::vector<uint8_t>& data) const
+{
+	InputLogHeader header;
+	memcpy(header.magic, InputMagic, sizeof(header.magic));
+	header.version = InputLogVersion;
+	header.ticksPerSecond = m_ticksPerSecond;
+	header.tickCount = m_tickCount;
+	header.streamBytes = uint32_t(StreamBytes());
+	header.origin = m_origin;
+	data.resize(sizeof(header));
+	memcpy(data.data(), &header, sizeof(header));
+	data.insert(data.end(), m_stream.begin(), m_stream.end());
+	FlushRun(data);
+}
+
+bool InputLog::Save(const char* path) const
+{
+	std::vector<uint8_t> data;
+	Serialize(data);
+	FILE* fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Keys Scene::Update acts on, as bits of InputSnapshot::keys.
+enum InputKey : uint32_t
+{
+	InputKey_W = 1 << 0,
+	InputKey_A = 1 << 1,
+	InputKey_S = 1 << 2,
+	InputKey_D = 1 << 3,
+	InputKey_Q = 1 << 4,
+	InputKey_E = 1 << 5,
+	InputKey_Z = 1 << 6,
+	InputKey_C = 1 << 7,
+	InputKey_F = 1 << 8,
+	InputKey_O = 1 << 9,
+	InputKey_K = 1 << 10,
+	InputKey_P = 1 << 11,
+	InputKey_N = 1 << 12,
+	InputKey_L = 1 << 13,
+	InputKey_X = 1 << 14,
+	InputKey_B = 1 << 15,
+	InputKey_G = 1 << 16,
+	InputKey_F9 = 1 << 17,
+};
+
+enum InputButton : uint8_t
+{
+	InputButton_Left = 1 << 0,
+	InputButton_Right = 1 << 1,
+	InputButton_Middle = 1 << 2,
+};
+
+// What the keyboard and mouse did over one fixed-step tick.
+struct InputSnapshot
+{
+	uint32_t keys;			// InputKey bits held
+	int32_t mouseX;			// relative mode motion over the tick, 0 in absolute mode
+	int32_t mouseY;
+	int32_t scroll;			// wheel motion over the tick
+	uint8_t buttons;		// InputButton bits held
+	uint8_t relative;		// 1 if the mouse was in relative mode
+};
+
+// Settings the toggle keys flip, as bits of InputOrigin::toggles.
+enum InputToggle : uint32_t
+{
+	InputToggle_OcclusionCulling = 1 << 0,	// O
+	InputToggle_Lod = 1 << 1,				// K
+	InputToggle_DepthPrePass = 1 << 2,		// P
+	InputToggle_Snowfall = 1 << 3,			// N
+	InputToggle_ClusteredLights = 1 << 4,	// L
+	InputToggle_AutoExposure = 1 << 5,		// X
+	InputToggle_Bloom = 1 << 6,				// B
+	InputToggle_Fxaa = 1 << 7,				// G
+};
+
+// toggles with the ones whose keys are in pressed flipped.
+uint32_t FlipToggles(uint32_t toggles, uint32_t pressed);
+
+// What a replay has to start from besides the ticks: the camera they steer, the
+// settings the toggle keys flip, and the turntable the camera can ride.
+struct InputOrigin
+{
+	float camera[5];		// position, pitch, yaw
+	uint32_t toggles;		// InputToggle bits set
+	float turntable;		// radians
+};
+
+inline bool operator==(const InputSnapshot& a, const InputSnapshot& b)
+{
+	return a.keys == b.keys && a.mouseX == b.mouseX && a.mouseY == b.mouseY && a.scroll == b.scroll &&
+		a.buttons == b.buttons && a.relative == b.relative;
+}
+
+inline bool operator!=(const InputSnapshot& a, const InputSnapshot& b)
+{
+	return !(a == b);
+}
+
+const uint32_t InputLogVersion = 2;
+
+struct InputLogHeader
+{
+	char magic[4];			// "INP1"
+	uint32_t version;
+	uint32_t ticksPerSecond;
+	uint32_t tickCount;
+	uint32_t streamBytes;
+	InputOrigin origin;
+};
+
+// One InputSnapshot per fixed-step tick, recorded as a compact stream and read back
+// bit for bit. Each tick is a byte saying which fields changed since the tick before,
+// then those fields: keys as they are, mouse and wheel motion as zigzag varint
+// differences, buttons as a byte. A run of unchanged ticks is one byte and its length,
+// so idle stretches cost next to nothing. Saved as the header and the stream.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+class InputLog
+{
+public:
+	// Empties the log for recording ticks at ticksPerSecond, starting from origin.
+	void Reset(uint32_t ticksPerSecond, const InputOrigin& origin);
+	void Record(const InputSnapshot& input);
+
+	// Reads the ticks back from the first; Next is false after the last.
+	void Rewind();
+	bool Next(InputSnapshot& input);
+
+	uint32_t TickCount() const { return m_tickCount; }
+	uint32_t TicksPerSecond() const { return m_ticksPerSecond; }
+	const InputOrigin& Origin() const { return m_origin; }
+	// Bytes of the saved stream, header excluded.
+	size_t StreamBytes() const;
+
+	// Checks the whole stream decodes to the header's tick count. On failure error (if
+	// given) says why and the log is left empty.
+	bool Parse(const uint8_t* data, size_t size, std::string* error = nullptr);
+	bool Load(const char* path, std::string* error = nullptr);
+	// The header and the stream, as Parse reads them.
+	void Serialize(std::vector<uint8_t>& data) const;
+	bool Save(const char* path) const;
+
+private:
+	void FlushRun(std::vector<uint8_t>& stream) const;
+
+	uint32_t m_ticksPerSecond = 60;
+	uint32_t m_tickCount = 0;
+	InputOrigin m_origin = {};
+	std::vector<uint8_t> m_stream;
+	// Recording: the last tick, and how many ticks after it repeated it, not yet in the stream
+	InputSnapshot m_last = {};
+	uint32_t m_run = 0;
+	// Reading: where the next tick starts, the tick before and the repeats of it still to give
+	size_t m_read = 0;
+	InputSnapshot m_previous = {};
+	uint32_t m_repeats = 0;
+	uint32_t m_ticksRead = 0;
+};
@@ -0,0 +1,227 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace
+{
+	// Queue of the pool the current thread works for; external threads use queue 0.
+	thread_local const JobSystem* t_system = nullptr;
+	thread_local size_t t_queue = 0;
+
+	// Spins before a worker goes to sleep, so short gaps between jobs don't pay for a wake-up.
+	const int IdleSpins = 64;
+
+	template <typename Q>
+	std::unique_lock<std::mutex> LockQueue(Q& q)
+	{
+		std::unique_lock<std::mutex> l(q.lock, std::try_to_lock);
+		if (!l.owns_lock()) {
+			q.contended.fetch_add(1, std::memory_order_relaxed);
+			l.lock();
+		}
+		return l;
+	}
+}
+
+JobSystem::JobSystem(unsigned workerCount)
+{
+	if (workerCount == 0) {
+		unsigned hw = std::thread::hardware_concurrency();
+		workerCount = hw > 1 ? hw - 1 : 1;
+	}
+	for (unsigned i = 0; i <= workerCount; i++)
+		m_queues.push_back(std::make_unique<Queue>());
+	for (unsigned i = 1; i <= workerCount; i++)
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, size_t(i));
+}
+
+JobSystem::~JobSystem()
+{
+	m_stop = true;
+	{
+		std::lock_guard<std::mutex> l(m_sleepLock);
+	}
+	m_wake.notify_all();
+	for (auto& w : m_workers)
+		w.join();
+}
+
+size_t JobSystem::CurrentQueue() const
+{
+	return t_system == this ? t_queue : 0;
+}
+
+void JobSystem::Run(std::function<void()> job, JobCounter* counter)
+{
+	if (counter)
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+	Push(Job{ std::move(job), counter });
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter)
+{
+	if (counter)
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> l(dependency.m_lock);
+		if (dependency.m_pending.load(std::memory_order_acquire) != 0) {
+			dependency.m_continuations.emplace_back(std::move(job), counter);
+			return;
+		}
+	}
+	Push(Job{ std::move(job), counter });
+}
+
+void JobSystem::Push(Job job)
+{
+	Queue& q = *m_queues[CurrentQueue()];
+	{
+		auto l = LockQueue(q);
+		q.jobs.push_back(std::move(job));
+	}
+	m_queued.fetch_add(1);
+	if (m_sleeping.load() > 0) {
+		// Taking the lock orders this with a worker that is about to wait.
+		{
+			std::lock_guard<std::mutex> l(m_sleepLock);
+		}
+		m_wake.notify_one();
+	}
+}
+
+bool JobSystem::Pop(size_t index, Job& job)
+{
+	Queue& q = *m_queues[index];
+	auto l = LockQueue(q);
+	if (q.jobs.empty())
+		return false;
+	job = std::move(q.jobs.back());
+	q.jobs.pop_back();
+	m_queued.fetch_sub(1);
+	return true;
+}
+
+bool JobSystem::Steal(size_t thief, Job& job)
+{
+	size_t count = m_queues.size();
+	for (size_t i = 1; i < count; i++) {
+		Queue& victim = *m_queues[(thief + i) % count];
+		auto l = LockQueue(victim);
+		if (victim.jobs.empty())
+			continue;
+		job = std::move(victim.jobs.front());
+		victim.jobs.pop_front();
+		m_queued.fetch_sub(1);
+		m_queues[thief]->stolen.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	m_queues[thief]->failedSteals.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+bool JobSystem::RunOne()
+{
+	size_t index = CurrentQueue();
+	Job job;
+	if (!Pop(index, job) && !Steal(index, job))
+		return false;
+	Execute(index, job);
+	return true;
+}
+
+void JobSystem::Execute(size_t index, Job& job)
+{
+	job.fn();
+	m_queues[index]->executed.fetch_add(1, std::memory_order_relaxed);
+	Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (!counter)
+		return;
+	// The decrement happens under the counter lock so Wait() can't return (and the
+	// counter go out of scope) while this thread still holds it.
+	std::vector<std::pair<std::function<void()>, JobCounter*>> ready;
+	{
+		std::lock_guard<std::mutex> l(counter->m_lock);
+		if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			ready.swap(counter->m_continuations);
+	}
+	for (auto& c : ready)
+		Push(Job{ std::move(c.first), c.second });
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	while (!counter.Done()) {
+		if (!RunOne())
+			std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> l(counter.m_lock);
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	if (end <= begin)
+		return;
+	grain = std::max<size_t>(grain, 1);
+	if (end - begin <= grain) {
+		body(begin, end);
+		return;
+	}
+	JobCounter counter;
+	for (size_t first = begin + grain; first < end; first += grain) {
+		size_t last = std::min(first + grain, end);
+		Run([&body, first, last]() { body(first, last); }, &counter);
+	}
+	// The first range runs here instead of sitting idle.
+	body(begin, begin + grain);
+	Wait(counter);
+}
+
+void JobSystem::WorkerLoop(size_t index)
+{
+	t_system = this;
+	t_queue = index;
+	int idle = 0;
+	while (!m_stop.load(std::memory_order_relaxed)) {
+		if (RunOne()) {
+			idle = 0;
+			continue;
+		}
+		if (++idle < IdleSpins) {
+			std::this_thread::yield();
+			continue;
+		}
+		idle = 0;
+		std::unique_lock<std::mutex> l(m_sleepLock);
+		m_sleeping.fetch_add(1);
+		m_queues[index]->sleeps.fetch_add(1, std::memory_order_relaxed);
+		m_wake.wait(l, [this]() { return m_queued.load() > 0 || m_stop.load(); });
+		m_sleeping.fetch_sub(1);
+	}
+}
+
+JobStats JobSystem::Stats() const
+{
+	JobStats s;
+	for (auto& q : m_queues) {
+		s.executed += q->executed.load(std::memory_order_relaxed);
+		s.stolen += q->stolen.load(std::memory_order_relaxed);
+		s.failedSteals += q->failedSteals.load(std::memory_order_relaxed);
+		s.contended += q->contended.load(std::memory_order_relaxed);
+		s.sleeps += q->sleeps.load(std::memory_order_relaxed);
+	}
+	return s;
+}
+
+void JobSystem::ResetStats()
+{
+	for (auto& q : m_queues) {
+		q->executed = 0;
+		q->stolen = 0;
+		q->failedSteals = 0;
+		q->contended = 0;
+		q->sleeps = 0;
+	}
+}
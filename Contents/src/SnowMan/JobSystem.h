@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Counts outstanding jobs. Jobs submitted with a counter increment it and decrement
+// it when they finish; Wait() returns once it reaches zero. Jobs can also be queued
+// to start only when a counter drains (RunAfter), which is how dependencies are expressed.
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool Done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int> m_pending{ 0 };
+	std::mutex m_lock;
+	std::vector<std::pair<std::function<void()>, JobCounter*>> m_continuations;
+};
+
+struct JobStats
+{
+	uint64_t executed = 0;		// jobs run
+	uint64_t stolen = 0;		// jobs taken from another thread's deque
+	uint64_t failedSteals = 0;	// steal attempts that found the victim empty
+	uint64_t contended = 0;		// deque locks that were already held
+	uint64_t sleeps = 0;		// times a worker blocked waiting for work
+};
+
+// Work-stealing job system on std::thread. Each worker owns a deque: it pushes and
+// pops at the back (LIFO, cache friendly) and idle threads steal from the front.
+// Threads outside the pool submit to a shared queue and help run jobs while they wait.
+class JobSystem
+{
+public:
+	// workerCount 0 uses one worker per hardware thread, minus the calling thread.
+	explicit JobSystem(unsigned workerCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void Run(std::function<void()> job, JobCounter* counter = nullptr);
+
+	// Starts job once dependency has drained.
+	void RunAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr);
+
+	// Runs other jobs until counter reaches zero. Safe to call from inside a job (fork/join).
+	void Wait(JobCounter& counter);
+
+	// Calls body(first, last) over [begin, end) in ranges of at most grain items and waits.
+	void ParallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+	// Workers plus the calling thread.
+	unsigned ThreadCount() const { return unsigned(m_workers.size()) + 1; }
+	// 1..workers on pool threads, 0 on any other thread. Indexes per-thread data such as FrameAllocator arenas.
+	unsigned ThreadIndex() const { return unsigned(CurrentQueue()); }
+
+	JobStats Stats() const;
+	void ResetStats();
+
+private:
+	struct Job
+	{
+		std::function<void()> fn;
+		JobCounter* counter;
+	};
+
+	// One per worker plus the shared external queue at index 0. Allocated separately
+	// and padded so neighbouring queues' locks and stats don't share cache lines.
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<Job> jobs;
+		std::atomic<uint64_t> executed{ 0 };
+		std::atomic<uint64_t> stolen{ 0 };
+		std::atomic<uint64_t> failedSteals{ 0 };
+		std::atomic<uint64_t> contended{ 0 };
+		std::atomic<uint64_t> sleeps{ 0 };
+		char padding[64];
+	};
+
+	void Push(Job job);
+	bool Pop(size_t index, Job& job);
+	bool Steal(size_t thief, Job& job);
+	bool RunOne();
+	void Execute(size_t index, Job& job);
+	void Finish(JobCounter* counter);
+	void WorkerLoop(size_t index);
+	size_t CurrentQueue() const;
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_workers;
+
+	std::atomic<int> m_queued{ 0 };
+	std::atomic<int> m_sleeping{ 0 };
+	std::mutex m_sleepLock;
+	std::condition_variable m_wake;
+	std::atomic<bool> m_stop{ false };
+};
@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "LightCamera.h"
+
+using namespace DirectX;
+
+namespace
+{
+	inline XMMATRIX Load(const float* m)
+	{
+		return XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(m));
+	}
+}
+
+LightCamera::LightCamera() :
+	m_position(0.0f, 0.0f, 0.0f)
+{
+	SetVolume(40.0f, 40.0f, 0.1f, 1000.0f);
+}
+
+void LightCamera::Place(const XMFLOAT3& position, float pitch, float yaw)
+{
+	m_position = position;
+	// Camera::Turn's direction, and the basis XMMatrixLookToLH builds around it
+	XMVECTOR look = XMVectorSet(cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw), 0.0f);
+	XMVECTOR right = XMVector3Normalize(XMVector3Cross(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), look));
+	XMVECTOR up = XMVector3Cross(look, right);
+	XMFLOAT3 axes[3];
+	XMStoreFloat3(&axes[0], right);
+	XMStoreFloat3(&axes[1], up);
+	XMStoreFloat3(&axes[2], look);
+	m_matrices.SetPose(&m_position.x, &axes[0].x, &axes[1].x, &axes[2].x);
+	m_matrices.Update();
+}
+
+void LightCamera::SetVolume(float width, float height, float nearZ, float farZ)
+{
+	m_matrices.SetOrthographic(width, height, nearZ, farZ);
+	m_matrices.Update();
+}
+
+XMMATRIX LightCamera::View() const
+{
+	return Load(m_matrices.View());
+}
+
+XMMATRIX LightCamera::Proj() const
+{
+	return Load(m_matrices.Projection());
+}
+
+XMMATRIX LightCamera::ViewProj() const
+{
+	return Load(m_matrices.ViewProjection());
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "pch.h"
+#include "CameraMatrices.h"
+
+// The orthographic view of a directional light, kept apart from the viewer's Camera:
+// placed where the light is, turned by its pitch and yaw as Camera::Turn turns, and
+// covering a width x height box from nearZ to farZ. The matrices are rebuilt only when
+// the placement or the box changes.
+class LightCamera
+{
+public:
+	LightCamera();
+
+	void Place(const DirectX::XMFLOAT3& position, float pitch, float yaw);
+	void SetVolume(float width, float height, float nearZ, float farZ);
+
+	DirectX::XMMATRIX View() const;
+	DirectX::XMMATRIX Proj() const;
+	DirectX::XMMATRIX ViewProj() const;
+	// World space frustum planes of ViewProj.
+	const FrustumPlanes& Frustum() const { return m_matrices.Frustum(); }
+	DirectX::XMFLOAT3 GetPosition() const { return m_position; }
+
+private:
+	CameraMatrices m_matrices;
+	DirectX::XMFLOAT3 m_position;
+};
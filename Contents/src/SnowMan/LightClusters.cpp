@@ -0,0 +1,242 @@
+#include "LightClusters.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <limits>
+
+namespace
+{
+	// Distance from c to [lo, hi] along one axis, 0 inside
+	inline float Outside(float lo, float hi, float c)
+	{
+		return std::max(lo - c, 0.0f) + std::max(c - hi, 0.0f);
+	}
+
+	// Sphere against the box at b[0], b[stride], ... b[5 * stride]: min x, y, z, max x, y, z
+	inline bool Touches(const float* b, size_t stride, const float center[3], float radiusSq)
+	{
+		float dx = Outside(b[0], b[3 * stride], center[0]);
+		float dy = Outside(b[stride], b[4 * stride], center[1]);
+		float dz = Outside(b[2 * stride], b[5 * stride], center[2]);
+		return dx * dx + dy * dy + dz * dz <= radiusSq;
+	}
+
+	// Same as Touches for four boxes side by side; one mask bit each
+	inline int Touches4(const float* b, size_t stride, __m128 cx, __m128 cy, __m128 cz, __m128 radiusSq)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(b), cx), zero), _mm_max_ps(_mm_sub_ps(cx, _mm_loadu_ps(b + 3 * stride)), zero));
+		__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(b + stride), cy), zero), _mm_max_ps(_mm_sub_ps(cy, _mm_loadu_ps(b + 4 * stride)), zero));
+		__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(b + 2 * stride), cz), zero), _mm_max_ps(_mm_sub_ps(cz, _mm_loadu_ps(b + 5 * stride)), zero));
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		return _mm_movemask_ps(_mm_cmple_ps(d, radiusSq));
+	}
+}
+
+LightClusters::LightClusters(int dimX, int dimY, int dimZ) :
+	m_dimX(std::max(dimX, 1)),
+	m_dimY(std::max(dimY, 1)),
+	m_dimZ(std::max(dimZ, 1))
+{
+	m_paddedX = (m_dimX + 3) & ~3;
+	size_t clusters = size_t(m_dimX) * m_dimY * m_dimZ;
+	m_bounds.assign(size_t(m_dimZ) * m_dimY * 6 * m_paddedX, 0.0f);
+	m_rowBounds.assign(size_t(m_dimZ) * m_dimY * 6, 0.0f);
+	m_lists.resize(clusters);
+	m_clusters.assign(clusters, Cluster{ 0, 0 });
+	m_sliceStart.assign(m_dimZ + 1, 0);
+}
+
+void LightClusters::SetProjection(const float proj[16], float nearZ, float farZ)
+{
+	m_nearZ = nearZ;
+	m_farZ = farZ;
+	m_sliceScale = float(m_dimZ / log(double(farZ) / nearZ));
+	m_sliceBias = float(-log(double(nearZ)) * m_sliceScale);
+
+	const float empty = std::numeric_limits<float>::infinity();
+	for (int z = 0; z < m_dimZ; z++) {
+		float depth[2] = {
+			float(nearZ * pow(double(farZ) / nearZ, double(z) / m_dimZ)),
+			z + 1 == m_dimZ ? farZ : float(nearZ * pow(double(farZ) / nearZ, double(z + 1) / m_dimZ))
+		};
+		for (int y = 0; y < m_dimY; y++) {
+			float* b = Bounds(z, y);
+			float* row = &m_rowBounds[(size_t(z) * m_dimY + y) * 6];
+			row[0] = row[1] = empty;
+			row[3] = row[4] = -empty;
+			row[2] = depth[0];
+			row[5] = depth[1];
+			// Tile rows run down the screen, clip space y up
+			float ndcY[2] = { 1.0f - 2.0f * float(y + 1) / m_dimY, 1.0f - 2.0f * float(y) / m_dimY };
+			for (int x = 0; x < m_paddedX; x++) {
+				if (x >= m_dimX) {
+					b[x] = b[m_paddedX + x] = b[2 * m_paddedX + x] = empty;
+					b[3 * m_paddedX + x] = b[4 * m_paddedX + x] = b[5 * m_paddedX + x] = -empty;
+					continue;
+				}
+				float ndcX[2] = { -1.0f + 2.0f * float(x) / m_dimX, -1.0f + 2.0f * float(x + 1) / m_dimX };
+				float lo[2] = { empty, empty }, hi[2] = { -empty, -empty };
+				// View space corners: clip x = x * proj[0] + z * proj[8], w = z
+				for (float d : depth) {
+					for (int k = 0; k < 2; k++) {
+						float vx = (ndcX[k] - proj[8]) * d / proj[0];
+						float vy = (ndcY[k] - proj[9]) * d / proj[5];
+						lo[0] = std::min(lo[0], vx);
+						hi[0] = std::max(hi[0], vx);
+						lo[1] = std::min(lo[1], vy);
+						hi[1] = std::max(hi[1], vy);
+					}
+				}
+				b[x] = lo[0];
+				b[m_paddedX + x] = lo[1];
+				b[2 * m_paddedX + x] = depth[0];
+				b[3 * m_paddedX + x] = hi[0];
+				b[4 * m_paddedX + x] = hi[1];
+				b[5 * m_paddedX + x] = depth[1];
+				row[0] = std::min(row[0], lo[0]);
+				row[1] = std::min(row[1], lo[1]);
+				row[3] = std::max(row[3], hi[0]);
+				row[4] = std::max(row[4], hi[1]);
+			}
+		}
+	}
+}
+
+LightClusterConstants LightClusters::Constants(const float view[16], float width, float height, uint32_t lightCount) const
+{
+	LightClusterConstants c = {
+		{ m_dimX / width, m_dimY / height, m_sliceScale, m_sliceBias },
+		{ view[2], view[6], view[10], view[14] },
+		{ uint32_t(m_dimX), uint32_t(m_dimY), uint32_t(m_dimZ), lightCount }
+	};
+	return c;
+}
+
+int LightClusters::Slice(float z) const
+{
+	if (z <= m_nearZ)
+		return 0;
+	return std::min(int(floorf(logf(z) * m_sliceScale + m_sliceBias)), m_dimZ - 1);
+}
+
+void LightClusters::TransformLights(const PointLight* lights, const float view[16], size_t first, size_t last)
+{
+	for (size_t i = first; i < last; i++) {
+		const float* p = lights[i].position;
+		ViewLight& l = m_viewLights[i];
+		for (int k = 0; k < 3; k++)
+			l.center[k] = p[0] * view[k] + p[1] * view[4 + k] + p[2] * view[8 + k] + view[12 + k];
+		l.radius = lights[i].radius;
+		float zNear = l.center[2] - l.radius, zFar = l.center[2] + l.radius;
+		if (zFar <= m_nearZ || zNear >= m_farZ || l.radius <= 0.0f) {
+			l.firstSlice = 1;
+			l.lastSlice = 0;
+			continue;
+		}
+		// One slice of slack each way for the rounding of log; the box tests are exact
+		l.firstSlice = std::max(Slice(zNear) - 1, 0);
+		l.lastSlice = std::min(Slice(zFar) + 1, m_dimZ - 1);
+	}
+}
+
+void LightClusters::BinSlice(int slice)
+{
+	const size_t sliceFirst = size_t(slice) * m_dimY * m_dimX;
+	for (size_t c = sliceFirst; c < sliceFirst + size_t(m_dimY) * m_dimX; c++)
+		m_lists[c].clear();
+	for (uint32_t s = m_sliceStart[slice]; s < m_sliceStart[slice + 1]; s++) {
+		const uint32_t i = m_sliceLights[s];
+		const ViewLight& l = m_viewLights[i];
+		const float radiusSq = l.radius * l.radius;
+		const __m128 cx = _mm_set1_ps(l.center[0]), cy = _mm_set1_ps(l.center[1]), cz = _mm_set1_ps(l.center[2]);
+		const __m128 r2 = _mm_set1_ps(radiusSq);
+		for (int y = 0; y < m_dimY; y++) {
+			if (!Touches(&m_rowBounds[(size_t(slice) * m_dimY + y) * 6], 1, l.center, radiusSq))
+				continue;
+			const float* b = Bounds(slice, y);
+			std::vector<uint32_t>* lists = &m_lists[sliceFirst + size_t(y) * m_dimX];
+			if (m_useSimd) {
+				for (int x = 0; x < m_paddedX; x += 4) {
+					int mask = Touches4(b + x, m_paddedX, cx, cy, cz, r2);
+					// Padding boxes are empty and never set a bit
+					for (int k = 0; mask; k++, mask >>= 1) {
+						if (mask & 1)
+							lists[x + k].push_back(i);
+					}
+				}
+			}
+			else {
+				for (int x = 0; x < m_dimX; x++) {
+					if (Touches(b + x, m_paddedX, l.center, radiusSq))
+						lists[x].push_back(i);
+				}
+			}
+		}
+	}
+}
+
+void LightClusters::Bin(const PointLight* lights, size_t count, const float view[16], JobSystem* jobs)
+{
+	m_viewLights.resize(count);
+	auto transform = [&](size_t first, size_t last) { TransformLights(lights, view, first, last); };
+	auto bin = [this](size_t first, size_t last) {
+		for (size_t z = first; z < last; z++)
+			BinSlice(int(z));
+	};
+	if (jobs)
+		jobs->ParallelFor(0, count, 1024, transform);
+	else
+		transform(0, count);
+
+	// Bucket the lights by depth slice, so each slice only visits its own
+	std::fill(m_sliceStart.begin(), m_sliceStart.end(), 0);
+	for (const ViewLight& l : m_viewLights) {
+		for (int z = l.firstSlice; z <= l.lastSlice; z++)
+			m_sliceStart[z + 1]++;
+	}
+	for (int z = 0; z < m_dimZ; z++)
+		m_sliceStart[z + 1] += m_sliceStart[z];
+	m_sliceLights.resize(m_sliceStart[m_dimZ]);
+	for (uint32_t i = 0; i < uint32_t(count); i++) {
+		const ViewLight& l = m_viewLights[i];
+		for (int z = l.firstSlice; z <= l.lastSlice; z++)
+			m_sliceLights[m_sliceStart[z]++] = i;
+	}
+	// The fill advanced every start to the next slice's
+	for (int z = m_dimZ; z > 0; z--)
+		m_sliceStart[z] = m_sliceStart[z - 1];
+	m_sliceStart[0] = 0;
+
+	if (jobs)
+		jobs->ParallelFor(0, size_t(m_dimZ), 1, bin);
+	else
+		bin(0, size_t(m_dimZ));
+
+	// Pack the lists back to back
+	m_stats = LightClusterStats();
+	m_stats.lights = count;
+	uint32_t offset = 0;
+	for (size_t c = 0; c < m_clusters.size(); c++) {
+		uint32_t n = uint32_t(m_lists[c].size());
+		m_clusters[c].offset = offset;
+		m_clusters[c].count = n;
+		offset += n;
+		m_stats.maxPerCluster = std::max(m_stats.maxPerCluster, n);
+	}
+	m_stats.lightSlices = m_sliceLights.size();
+	m_stats.indices = offset;
+	m_indices.resize(offset);
+	auto pack = [this](size_t first, size_t last) {
+		for (size_t c = first * m_dimY * m_dimX; c < last * m_dimY * m_dimX; c++) {
+			if (!m_lists[c].empty())
+				memcpy(&m_indices[m_clusters[c].offset], m_lists[c].data(), m_lists[c].size() * sizeof(uint32_t));
+		}
+	};
+	if (jobs)
+		jobs->ParallelFor(0, size_t(m_dimZ), 1, pack);
+	else
+		pack(0, size_t(m_dimZ));
+}
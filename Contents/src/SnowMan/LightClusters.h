@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// A point light as laid out in the structured buffer ClusteredLights.hlsli reads.
+struct PointLight
+{
+	float position[3];		// world space
+	float radius;			// no light at or beyond this distance
+	float color[3];
+	float intensity;
+};
+
+// The ClusterBuffer cbuffer of ClusteredLights.hlsli.
+struct LightClusterConstants
+{
+	float clusterScale[4];		// tiles per pixel x, y, then SliceScale, SliceBias
+	float viewDepth[4];			// third column of the view matrix
+	uint32_t clusterDim[4];		// dimX, dimY, dimZ, light count (0 turns the lights off)
+};
+
+struct LightClusterStats
+{
+	size_t lights = 0;				// passed to Bin
+	size_t lightSlices = 0;			// light / depth slice pairs tested
+	size_t indices = 0;				// light / cluster pairs kept
+	uint32_t maxPerCluster = 0;
+};
+
+// Clustered forward lighting. The view frustum is cut into dimX x dimY screen tiles
+// and dimZ depth slices spaced exponentially from the near to the far plane
+// (froxels). Bin finds the lights whose sphere touches each froxel's view space box
+// and packs their indices, cluster after cluster, into one list the pixel shaders
+// walk. Clusters are numbered x fastest, then y from the top of the screen, then z
+// from the near plane. Depth slices are binned in parallel on the job system, four
+// tiles of a row at a time with SSE2 where enabled; the lists come out the same
+// either way, lights in ascending order within each cluster.
+// Matrices are row-major, row-vector (DirectXMath), D3D clip depth 0..w.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+class LightClusters
+{
+public:
+	struct Cluster
+	{
+		uint32_t offset;	// into LightIndices
+		uint32_t count;
+	};
+
+	LightClusters(int dimX = 16, int dimY = 9, int dimZ = 24);
+
+	// Froxel boxes of a perspective projection; call again when it changes.
+	void SetProjection(const float proj[16], float nearZ, float farZ);
+
+	// Bins world space lights seen through view.
+	void Bin(const PointLight* lights, size_t count, const float view[16], JobSystem* jobs = nullptr);
+
+	// Falls back to scalar box tests when off.
+	void SetUseSimd(bool enable) { m_useSimd = enable; }
+	bool UsesSimd() const { return m_useSimd; }
+
+	int DimX() const { return m_dimX; }
+	int DimY() const { return m_dimY; }
+	int DimZ() const { return m_dimZ; }
+	size_t ClusterCount() const { return m_clusters.size(); }
+	const std::vector<Cluster>& Clusters() const { return m_clusters; }
+	const std::vector<uint32_t>& LightIndices() const { return m_indices; }
+	// Depth slice of view depth z: floor(log(z) * SliceScale() + SliceBias())
+	float SliceScale() const { return m_sliceScale; }
+	float SliceBias() const { return m_sliceBias; }
+	const LightClusterStats& Stats() const { return m_stats; }
+	// What the shaders need to find the cluster of a pixel of a width x height target.
+	LightClusterConstants Constants(const float view[16], float width, float height, uint32_t lightCount) const;
+
+private:
+	// A light in view space, with the depth slices its sphere may reach
+	struct ViewLight
+	{
+		float center[3];
+		float radius;
+		int firstSlice, lastSlice;
+	};
+
+	int Slice(float z) const;
+	float* Bounds(int slice, int row) { return &m_bounds[(size_t(slice) * m_dimY + row) * 6 * m_paddedX]; }
+	void TransformLights(const PointLight* lights, const float view[16], size_t first, size_t last);
+	void BinSlice(int slice);
+
+	int m_dimX, m_dimY, m_dimZ;
+	int m_paddedX;				// dimX rounded up to whole SSE registers
+	float m_nearZ = 0.0f, m_farZ = 0.0f;
+	float m_sliceScale = 0.0f, m_sliceBias = 0.0f;
+	bool m_useSimd = true;
+
+	// Per slice and row: min x, y, z then max x, y, z of each tile, m_paddedX apart;
+	// padding tiles are empty boxes
+	std::vector<float> m_bounds;
+	std::vector<float> m_rowBounds;			// the union of each row, six floats
+	std::vector<ViewLight> m_viewLights;
+	// Lights reaching each depth slice, in ascending order: slice z owns
+	// m_sliceLights[m_sliceStart[z], m_sliceStart[z + 1])
+	std::vector<uint32_t> m_sliceLights;
+	std::vector<uint32_t> m_sliceStart;
+	std::vector<std::vector<uint32_t>> m_lists;	// per cluster, kept between frames
+	std::vector<Cluster> m_clusters;
+	std::vector<uint32_t> m_indices;
+	LightClusterStats m_stats;
+};
@@ -0,0 +1,111 @@
+#include "LodSelection.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <emmintrin.h>
+
+const uint32_t LodSettings::MaxLevels;
+
+namespace
+{
+	// Nearer than this, or behind the eye, everything counts as filling the screen
+	const float MinDepth = 1e-4f;
+
+	// Each band boundary narrowed (lower) and widened (upper) by the hysteresis. A band
+	// only grows past boundaries the size is below the lower side of, and only shrinks
+	// past those it is above the upper side of.
+	struct BandBounds
+	{
+		float lower[LodSettings::MaxLevels];
+		float upper[LodSettings::MaxLevels];
+	};
+
+	BandBounds MakeBounds(const LodSettings& settings)
+	{
+		BandBounds b;
+		for (uint32_t k = 0; k < LodSettings::MaxLevels; k++) {
+			float size = k + 1 < LodSettings::MaxLevels ? settings.screenSizes[k] : settings.impostorSize;
+			b.lower[k] = size * (1.0f - settings.hysteresis);
+			b.upper[k] = size * (1.0f + settings.hysteresis);
+		}
+		return b;
+	}
+
+	inline const float* Sphere(const float* spheres, size_t stride, size_t i)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(spheres) + i * stride);
+	}
+}
+
+float LodSelection::ScreenSize(float radius, float z, float projScale)
+{
+	return radius * projScale / std::max(z, MinDepth);
+}
+
+void LodSelection::Select(const LodSettings& settings, const float view[16], float projScale, const float* spheres, size_t sphereStride,
+	uint8_t* bands, size_t bandStride, size_t first, size_t last)
+{
+	const BandBounds b = MakeBounds(settings);
+	for (size_t i = first; i < last; i++) {
+		const float* s = Sphere(spheres, sphereStride, i);
+		const float z = s[0] * view[2] + s[1] * view[6] + s[2] * view[10] + view[14];
+		const float size = ScreenSize(s[3], z, projScale);
+		uint32_t lowest = 0, highest = 0;
+		for (uint32_t k = 0; k < LodSettings::MaxLevels; k++) {
+			lowest += size < b.lower[k];
+			highest += size < b.upper[k];
+		}
+		uint8_t& band = bands[i * bandStride];
+		band = uint8_t(std::min(std::max(uint32_t(band), lowest), highest));
+	}
+}
+
+void LodSelection::SelectSimd(const LodSettings& settings, const float view[16], float projScale, const float* spheres, size_t sphereStride,
+	uint8_t* bands, size_t bandStride, size_t first, size_t last)
+{
+	const BandBounds b = MakeBounds(settings);
+	const __m128 viewX = _mm_set1_ps(view[2]), viewY = _mm_set1_ps(view[6]), viewZ = _mm_set1_ps(view[10]), viewW = _mm_set1_ps(view[14]);
+	const __m128 scale = _mm_set1_ps(projScale), minDepth = _mm_set1_ps(MinDepth);
+
+	size_t i = first;
+	for (; i + 4 <= last; i += 4) {
+		__m128 x = _mm_loadu_ps(Sphere(spheres, sphereStride, i));
+		__m128 y = _mm_loadu_ps(Sphere(spheres, sphereStride, i + 1));
+		__m128 z = _mm_loadu_ps(Sphere(spheres, sphereStride, i + 2));
+		__m128 r = _mm_loadu_ps(Sphere(spheres, sphereStride, i + 3));
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+
+		// Same operation order as Select, so the sizes are the same to the bit
+		__m128 depth = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, viewX), _mm_mul_ps(y, viewY)), _mm_mul_ps(z, viewZ)), viewW);
+		__m128 size = _mm_div_ps(_mm_mul_ps(r, scale), _mm_max_ps(depth, minDepth));
+		__m128i lowest = _mm_setzero_si128(), highest = _mm_setzero_si128();
+		for (uint32_t k = 0; k < LodSettings::MaxLevels; k++) {
+			// A true compare is -1
+			lowest = _mm_sub_epi32(lowest, _mm_castps_si128(_mm_cmplt_ps(size, _mm_set1_ps(b.lower[k]))));
+			highest = _mm_sub_epi32(highest, _mm_castps_si128(_mm_cmplt_ps(size, _mm_set1_ps(b.upper[k]))));
+		}
+		uint8_t* band[4] = { &bands[i * bandStride], &bands[(i + 1) * bandStride], &bands[(i + 2) * bandStride], &bands[(i + 3) * bandStride] };
+		__m128i current = _mm_setr_epi32(*band[0], *band[1], *band[2], *band[3]);
+		// Bands are small, so 16-bit min and max work on the 32-bit lanes
+		current = _mm_min_epi16(_mm_max_epi16(current, lowest), highest);
+		alignas(16) int32_t result[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(result), current);
+		for (int k = 0; k < 4; k++)
+			*band[k] = uint8_t(result[k]);
+	}
+	Select(settings, view, projScale, spheres, sphereStride, bands, bandStride, i, last);
+}
+
+void LodSelection::SelectAll(const LodSettings& settings, const float view[16], float projScale, const float* spheres, size_t sphereStride,
+	uint8_t* bands, size_t bandStride, size_t count, JobSystem* jobs, bool simd)
+{
+	auto select = [&](size_t first, size_t last) {
+		if (simd)
+			SelectSimd(settings, view, projScale, spheres, sphereStride, bands, bandStride, first, last);
+		else
+			Select(settings, view, projScale, spheres, sphereStride, bands, bandStride, first, last);
+	};
+	if (jobs)
+		jobs->ParallelFor(0, count, 4096, select);
+	else
+		select(0, count);
+}
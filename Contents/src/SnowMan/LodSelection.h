@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class JobSystem;
+
+// Where drawing drops a level of detail. Screen sizes are the projected diameter of an
+// object's bounding sphere over the height of the screen.
+struct LodSettings
+{
+	static const uint32_t MaxLevels = 4;			// mesh levels of a chain, finest first
+
+	// Level i + 1 is drawn below screenSizes[i]; descending
+	float screenSizes[MaxLevels - 1] = { 0.25f, 0.1f, 0.04f };
+	// Below it objects with an impostor draw that instead; 0 never
+	float impostorSize = 0.0f;
+	// A level holds until the size leaves its range by this fraction, so objects near a
+	// boundary do not flip between levels as the camera moves
+	float hysteresis = 0.1f;
+};
+
+// Level of detail selection by projected size. Each object keeps a band: how many of the
+// settings' sizes (impostorSize last) its size is below, 0 to MaxLevels. A band only
+// moves once the size is past the boundary by the hysteresis; the level drawn follows
+// from the band and what the object has. Scalar and 4-wide SSE2, with the same results.
+// Matrices are row-major, row-vector (DirectXMath), looking down +z.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+namespace LodSelection
+{
+	const uint8_t Impostor = 0xFF;
+
+	// The level an object with levelCount mesh levels draws in band.
+	inline uint8_t Level(uint8_t band, uint8_t levelCount, bool hasImpostor)
+	{
+		if (band == LodSettings::MaxLevels && hasImpostor)
+			return Impostor;
+		return band < levelCount ? band : uint8_t(levelCount - 1);
+	}
+
+	// Projected size of a sphere at view depth z; projScale is the projection's _22.
+	float ScreenSize(float radius, float z, float projScale);
+
+	// Updates bands[i] of objects [first, last). Spheres are a center and radius (four
+	// floats, sphereStride bytes apart) in world space; bands are bandStride bytes apart.
+	void Select(const LodSettings& settings, const float view[16], float projScale, const float* spheres, size_t sphereStride,
+		uint8_t* bands, size_t bandStride, size_t first, size_t last);
+	// Same results as Select, four objects at a time.
+	void SelectSimd(const LodSettings& settings, const float view[16], float projScale, const float* spheres, size_t sphereStride,
+		uint8_t* bands, size_t bandStride, size_t first, size_t last);
+
+	// Selects for every object, spread over jobs when given.
+	void SelectAll(const LodSettings& settings, const float view[16], float projScale, const float* spheres, size_t sphereStride,
+		uint8_t* bands, size_t bandStride, size_t count, JobSystem* jobs = nullptr, bool simd = true);
+}
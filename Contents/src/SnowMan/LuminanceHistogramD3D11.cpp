@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "LuminanceHistogramD3D11.h"
+
+const unsigned D3D11LuminanceHistogram::FramesInFlight;
+
+D3D11LuminanceHistogram::D3D11LuminanceHistogram(ID3D11Device* device, ID3D11DeviceContext* context) :
+	m_context(context)
+{
+	const UINT bytes = AutoExposure::HistogramBins * sizeof(uint32_t);
+
+	// Raw so the shader can add to it with InterlockedAdd
+	CD3D11_BUFFER_DESC histogramDesc(bytes, D3D11_BIND_UNORDERED_ACCESS, D3D11_USAGE_DEFAULT, 0,
+		D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS);
+	DX::ThrowIfFailed(device->CreateBuffer(&histogramDesc, nullptr, m_histogram.GetAddressOf()));
+	CD3D11_UNORDERED_ACCESS_VIEW_DESC accessDesc(m_histogram.Get(), DXGI_FORMAT_R32_TYPELESS,
+		0, AutoExposure::HistogramBins, D3D11_BUFFER_UAV_FLAG_RAW);
+	DX::ThrowIfFailed(device->CreateUnorderedAccessView(m_histogram.Get(), &accessDesc, m_histogramAccess.GetAddressOf()));
+
+	CD3D11_BUFFER_DESC constantsDesc(sizeof(LuminanceHistogramConstants), D3D11_BIND_CONSTANT_BUFFER,
+		D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	DX::ThrowIfFailed(device->CreateBuffer(&constantsDesc, nullptr, m_constants.GetAddressOf()));
+
+	CD3D11_BUFFER_DESC stagingDesc(bytes, 0, D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_READ);
+	for (auto& staging : m_staging)
+		DX::ThrowIfFailed(device->CreateBuffer(&stagingDesc, nullptr, staging.GetAddressOf()));
+}
+
+void D3D11LuminanceHistogram::Build(ID3D11ComputeShader* shader, ID3D11ShaderResourceView* scene,
+	const LuminanceHistogramConstants& constants)
+{
+	// The ring is full when the GPU is more than FramesInFlight histograms behind.
+	if (m_next - m_oldest == FramesInFlight)
+		m_oldest++;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(m_context->Map(m_constants.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	memcpy(mapped.pData, &constants, sizeof(constants));
+	m_context->Unmap(m_constants.Get(), 0);
+
+	const UINT zero[4] = {};
+	m_context->ClearUnorderedAccessViewUint(m_histogramAccess.Get(), zero);
+	m_context->CSSetShader(shader, nullptr, 0);
+	m_context->CSSetConstantBuffers(0, 1, m_constants.GetAddressOf());
+	m_context->CSSetShaderResources(0, 1, &scene);
+	m_context->CSSetUnorderedAccessViews(0, 1, m_histogramAccess.GetAddressOf(), nullptr);
+	m_context->Dispatch((constants.width + 15) / 16, (constants.height + 15) / 16, 1);
+	// Leave the scene free to be rendered to again
+	ID3D11ShaderResourceView* noScene = nullptr;
+	ID3D11UnorderedAccessView* noAccess = nullptr;
+	m_context->CSSetShaderResources(0, 1, &noScene);
+	m_context->CSSetUnorderedAccessViews(0, 1, &noAccess, nullptr);
+
+	m_context->CopyResource(m_staging[m_next % FramesInFlight].Get(), m_histogram.Get());
+	m_next++;
+}
+
+bool D3D11LuminanceHistogram::Collect(uint32_t histogram[AutoExposure::HistogramBins])
+{
+	bool collected = false;
+	while (m_oldest != m_next) {
+		ID3D11Buffer* staging = m_staging[m_oldest % FramesInFlight].Get();
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = m_context->Map(staging, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+			break;
+		DX::ThrowIfFailed(hr);
+		memcpy(histogram, mapped.pData, AutoExposure::HistogramBins * sizeof(uint32_t));
+		m_context->Unmap(staging, 0);
+		m_oldest++;
+		collected = true;
+	}
+	return collected;
+}
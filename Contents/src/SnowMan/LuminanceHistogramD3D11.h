@@ -0,0 +1,29 @@
+#pragma once
+#include "pch.h"
+#include "AutoExposure.h"
+
+// Luminance histogram of the HDR scene built by luminanceHistogram.hlsl and read
+// back for AutoExposure. Each frame in flight copies the histogram into its own
+// staging buffer; Collect maps them without flushing once the GPU has finished,
+// so the exposure follows the scene a few frames late but never stalls it.
+class D3D11LuminanceHistogram
+{
+public:
+	static const unsigned FramesInFlight = 4;
+
+	D3D11LuminanceHistogram(ID3D11Device* device, ID3D11DeviceContext* context);
+
+	// Histograms scene, which must not be bound as a render target, with shader.
+	void Build(ID3D11ComputeShader* shader, ID3D11ShaderResourceView* scene, const LuminanceHistogramConstants& constants);
+	// Copies out the newest histogram the GPU has finished; false when none finished since the last call.
+	bool Collect(uint32_t histogram[AutoExposure::HistogramBins]);
+
+private:
+	ID3D11DeviceContext* m_context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_histogram;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_histogramAccess;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_constants;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_staging[FramesInFlight];
+	uint64_t m_next = 0;		// ring position of the next histogram built
+	uint64_t m_oldest = 0;		// ring position of the oldest pending histogram
+};
@@ -0,0 +1,194 @@
+#include "pch.h"
+#include "MeshBuilder.h"
+#include "IndexCodec.h"
+
+using namespace DirectX;
+
+static_assert(sizeof(VertexFull) == sizeof(VertexPositionNormalTexture), "VertexFull must match VertexPositionNormalTexture");
+
+namespace
+{
+	const VertexFull* AsFull(const std::vector<VertexPositionNormalTexture>& vertices)
+	{
+		return reinterpret_cast<const VertexFull*>(vertices.data());
+	}
+
+	void CreateBuffers(ID3D11Device1* device, const void* vertexBytes, size_t vertexByteCount, MeshBuilder::SubMesh& sub)
+	{
+		D3D11_BUFFER_DESC vertexBufferDesc = { 0 };
+		D3D11_SUBRESOURCE_DATA vertexData = { 0 };
+		D3D11_BUFFER_DESC indexBufferDesc = { 0 };
+		D3D11_SUBRESOURCE_DATA indexData = { 0 };
+		vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+		vertexBufferDesc.ByteWidth = UINT(vertexByteCount);
+		vertexData.pSysMem = vertexBytes;
+		DX::ThrowIfFailed(
+			device->CreateBuffer(&vertexBufferDesc, &vertexData,
+				&sub.vertexBuffer));
+
+		sub.indexFormat = MeshBuilder::SelectIndexFormat(sub.vertices.size());
+		std::vector<uint16_t> indices16;
+		if (sub.indexFormat == DXGI_FORMAT_R16_UINT) {
+			indices16.assign(sub.indices.begin(), sub.indices.end());
+			indexBufferDesc.ByteWidth = UINT(sizeof(uint16_t) * indices16.size());
+			indexData.pSysMem = indices16.data();
+		}
+		else {
+			indexBufferDesc.ByteWidth = UINT(sizeof(uint32_t) * sub.indices.size());
+			indexData.pSysMem = sub.indices.data();
+		}
+		DX::ThrowIfFailed(
+			device->CreateBuffer(&indexBufferDesc, &indexData,
+				&sub.indexBuffer));
+	}
+}
+
+DXGI_FORMAT MeshBuilder::SelectIndexFormat(size_t vertexCount)
+{
+	return vertexCount <= MaxVertices16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
+std::vector<MeshBuilder::SubMesh> MeshBuilder::Split(const std::vector<VertexPositionNormalTexture>& vertices,
+	const std::vector<uint32_t>& indices, size_t maxVertices)
+{
+	std::vector<SubMesh> parts;
+	// remap[v] is the index of vertex v in the current part, or -1.
+	std::vector<int32_t> remap(vertices.size(), -1);
+	std::vector<uint32_t> used;
+	SubMesh current;
+
+	auto flush = [&]() {
+		for (uint32_t v : used)
+			remap[v] = -1;
+		used.clear();
+		parts.push_back(std::move(current));
+		current = SubMesh();
+	};
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+		size_t added = 0;
+		for (int k = 0; k < 3; k++) {
+			if (remap[indices[t + k]] < 0)
+				added++;
+		}
+		if (current.vertices.size() + added > maxVertices)
+			flush();
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = indices[t + k];
+			if (remap[v] < 0) {
+				remap[v] = int32_t(current.vertices.size());
+				current.vertices.push_back(vertices[v]);
+				used.push_back(v);
+			}
+			current.indices.push_back(uint32_t(remap[v]));
+		}
+	}
+	if (!current.indices.empty())
+		flush();
+	return parts;
+}
+
+MeshBuilder::Mesh MeshBuilder::Create(ID3D11Device1* device, const std::vector<VertexPositionNormalTexture>& vertices,
+	const std::vector<uint32_t>& indices, bool splitLargeMeshes, VertexFormat format)
+{
+	Mesh mesh;
+	if (splitLargeMeshes && vertices.size() > MaxVertices16) {
+		mesh.subMeshes = Split(vertices, indices);
+	}
+	else {
+		SubMesh whole;
+		whole.vertices = vertices;
+		whole.indices = indices;
+		mesh.subMeshes.push_back(std::move(whole));
+	}
+
+	for (auto& sub : mesh.subMeshes) {
+		sub.vertexFormat = format;
+		if (format == VertexFormat_Compact) {
+			sub.quantization = VertexCodec::ComputeQuantization(AsFull(sub.vertices), sub.vertices.size());
+			std::vector<VertexCompact> compact(sub.vertices.size());
+			VertexCodec::EncodeCompact(AsFull(sub.vertices), sub.vertices.size(), sub.quantization, compact.data());
+			CreateBuffers(device, compact.data(), sizeof(VertexCompact) * compact.size(), sub);
+		}
+		else {
+			CreateBuffers(device, sub.vertices.data(), sizeof(VertexPositionNormalTexture) * sub.vertices.size(), sub);
+		}
+	}
+	return mesh;
+}
+
+MeshBuilder::Mesh MeshBuilder::Create(ID3D11Device1* device, const std::vector<VertexPositionNormalTexture>& vertices,
+	const std::vector<uint16_t>& indices, VertexFormat format)
+{
+	return Create(device, vertices, std::vector<uint32_t>(indices.begin(), indices.end()), false, format);
+}
+
+MeshBuilder::Mesh MeshBuilder::CreateHeightField(ID3D11Device1* device, const std::vector<VertexPositionNormalTexture>& vertices,
+	const std::vector<uint32_t>& indices, const XMFLOAT4& grid)
+{
+	SubMesh sub;
+	sub.vertices = vertices;
+	sub.indices = indices;
+	sub.vertexFormat = VertexFormat_Height;
+	sub.quantization = VertexCodec::ComputeQuantization(AsFull(vertices), vertices.size());
+	memcpy(sub.quantization.grid, &grid, sizeof(sub.quantization.grid));
+
+	std::vector<float> heights(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		heights[i] = vertices[i].position.y;
+	std::vector<uint16_t> stream(vertices.size());
+	VertexCodec::EncodeHeights(heights.data(), heights.size(), sub.quantization, stream.data());
+	CreateBuffers(device, stream.data(), sizeof(uint16_t) * stream.size(), sub);
+
+	Mesh mesh;
+	mesh.subMeshes.push_back(std::move(sub));
+	return mesh;
+}
+
+void MeshBuilder::Assign(const SubMesh& subMesh, RModel* model)
+{
+	model->vertices = subMesh.vertices;
+	model->indices = subMesh.indices;
+	model->indexFormat = subMesh.indexFormat;
+	model->vertexFormat = subMesh.vertexFormat;
+	model->quantization = subMesh.quantization;
+	model->vertexBuffer = subMesh.vertexBuffer;
+	model->indexBuffer = subMesh.indexBuffer;
+}
+
+void MeshBuilder::AddLod(const SubMesh& subMesh, RModel* model)
+{
+	model->lods.push_back(RModelLod{ subMesh.vertexBuffer, subMesh.indexBuffer, UINT(subMesh.indices.size()),
+		subMesh.indexFormat, subMesh.quantization });
+}
+
+bool MeshBuilder::SaveIndices(const wchar_t* path, const std::vector<uint32_t>& indices)
+{
+	std::vector<uint8_t> pack;
+	IndexCodec::WritePack(indices.data(), indices.size(), pack);
+
+	std::ofstream outFile(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	outFile.write(reinterpret_cast<const char*>(pack.data()), pack.size());
+	return bool(outFile);
+}
+
+bool MeshBuilder::LoadIndices(const wchar_t* path, std::vector<uint32_t>& indices)
+{
+	indices.clear();
+	std::ifstream inFile(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!inFile)
+		return false;
+	// The pack is read whole, so only the file's own size is ever allocated before
+	// ReadPack checks the header against it
+	const std::streamoff size = inFile.tellg();
+	if (size < 0 || uint64_t(size) > 0xFFFFFFFFu)
+		return false;
+	std::vector<uint8_t> pack(size_t(size));
+	inFile.seekg(0);
+	inFile.read(reinterpret_cast<char*>(pack.data()), pack.size());
+	return inFile && IndexCodec::ReadPack(pack.data(), pack.size(), indices);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "pch.h"
+#include "RModel.h"
+#include <VertexTypes.h>
+
+// Shared path from CPU vertex/index data to GPU buffers for every drawable.
+// Picks R16_UINT or R32_UINT per mesh and, if asked, splits meshes with more
+// than 65536 vertices into sub-meshes that each fit 16-bit indices.
+namespace MeshBuilder
+{
+	struct SubMesh
+	{
+		std::vector<DirectX::VertexPositionNormalTexture> vertices;
+		std::vector<uint32_t> indices;
+		DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT;
+		VertexFormat vertexFormat = VertexFormat_Full;
+		VertexQuantization quantization;
+		ID3D11Buffer* vertexBuffer = nullptr;
+		ID3D11Buffer* indexBuffer = nullptr;
+	};
+
+	struct Mesh
+	{
+		std::vector<SubMesh> subMeshes;
+	};
+
+	const size_t MaxVertices16 = 65536;
+
+	DXGI_FORMAT SelectIndexFormat(size_t vertexCount);
+
+	// Partitions a triangle list so that no part references more than maxVertices vertices.
+	std::vector<SubMesh> Split(const std::vector<DirectX::VertexPositionNormalTexture>& vertices,
+		const std::vector<uint32_t>& indices, size_t maxVertices = MaxVertices16);
+
+	Mesh Create(ID3D11Device1* device, const std::vector<DirectX::VertexPositionNormalTexture>& vertices,
+		const std::vector<uint32_t>& indices, bool splitLargeMeshes = false, VertexFormat format = VertexFormat_Full);
+	Mesh Create(ID3D11Device1* device, const std::vector<DirectX::VertexPositionNormalTexture>& vertices,
+		const std::vector<uint16_t>& indices, VertexFormat format = VertexFormat_Full);
+
+	// Height-only stream for regular grids: x/z and UVs are rebuilt in the vertex shader
+	// from SV_VertexID and grid, so the mesh is never split. vertices is kept for CPU use.
+	Mesh CreateHeightField(ID3D11Device1* device, const std::vector<DirectX::VertexPositionNormalTexture>& vertices,
+		const std::vector<uint32_t>& indices, const DirectX::XMFLOAT4& grid);
+
+	// Points model at the sub-mesh buffers. Buffers are shared, not copied.
+	void Assign(const SubMesh& subMesh, RModel* model);
+	// Appends the sub-mesh buffers to model's levels of detail, as the next coarser level.
+	void AddLod(const SubMesh& subMesh, RModel* model);
+
+	// Compressed index packs for the asset pack (see IndexCodec.h); false if the file
+	// cannot be written, or is missing, malformed or does not match its header.
+	bool SaveIndices(const wchar_t* path, const std::vector<uint32_t>& indices);
+	bool LoadIndices(const wchar_t* path, std::vector<uint32_t>& indices);
+}
@@ -0,0 +1,486 @@
+#include "OcclusionBuffer.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OCCLUSION_AVX2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC emits AVX2 intrinsics without /arch; callers check HasAvx2 first.
+#define OCCLUSION_TARGET_AVX2
+#else
+#define OCCLUSION_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	// Boxes with a corner closer than this (clip w) are treated as crossing the near plane.
+	const float MinW = 1e-5f;
+
+	void Transform(const float v[3], const float m[16], float out[4])
+	{
+		for (int c = 0; c < 4; c++)
+			out[c] = v[0] * m[c] + v[1] * m[4 + c] + v[2] * m[8 + c] + m[12 + c];
+	}
+
+	void Multiply(const float a[16], const float b[16], float out[16])
+	{
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++)
+				out[i * 4 + j] = a[i * 4] * b[j] + a[i * 4 + 1] * b[4 + j] + a[i * 4 + 2] * b[8 + j] + a[i * 4 + 3] * b[12 + j];
+		}
+	}
+
+	// First and last pixel of [0, size) whose center is at or after / before coordinate.
+	// Clamping first keeps the float to int conversions in range and rounding exact.
+	inline int FirstPixel(float coordinate, int size)
+	{
+		float c = std::min(std::max(coordinate - 0.5f, -1.0f), float(size));
+		int i = int(c);
+		return std::max(i + (float(i) < c ? 1 : 0), 0);
+	}
+
+	inline int LastPixel(float coordinate, int size)
+	{
+		float c = std::min(std::max(coordinate - 0.5f, -1.0f), float(size));
+		int i = int(c);
+		return std::min(i - (float(i) > c ? 1 : 0), size - 1);
+	}
+
+	// Keeps the nearest depth of the triangle at every pixel center of [x0, x1] x [y0, y1].
+	void RasterizeScalar(const float edge[3][3], const float plane[3], int x0, int x1, int y0, int y1, float* depth, int pitch)
+	{
+		for (int y = y0; y <= y1; y++) {
+			float py = y + 0.5f;
+			float r0 = edge[0][1] * py + edge[0][2];
+			float r1 = edge[1][1] * py + edge[1][2];
+			float r2 = edge[2][1] * py + edge[2][2];
+			float rz = plane[1] * py + plane[2];
+			float* row = depth + size_t(y) * pitch;
+			for (int x = x0; x <= x1; x++) {
+				float px = x + 0.5f;
+				float e0 = edge[0][0] * px + r0;
+				float e1 = edge[1][0] * px + r1;
+				float e2 = edge[2][0] * px + r2;
+				if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+					row[x] = std::min(row[x], plane[0] * px + rz);
+			}
+		}
+	}
+
+#ifdef OCCLUSION_AVX2
+	// Same as RasterizeScalar, eight pixels at a time, and to the bit: the same edge test
+	// (-0.0 is inside, NaN outside) and the same min. x0 must leave room for eight pixels
+	// up to x1 inside the row; lanes past x1 fall outside the triangle's edges.
+	OCCLUSION_TARGET_AVX2
+	void RasterizeAvx2(const float edge[3][3], const float plane[3], int x0, int x1, int y0, int y1, float* depth, int pitch)
+	{
+		const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		const __m256 a0 = _mm256_set1_ps(edge[0][0]);
+		const __m256 a1 = _mm256_set1_ps(edge[1][0]);
+		const __m256 a2 = _mm256_set1_ps(edge[2][0]);
+		const __m256 az = _mm256_set1_ps(plane[0]);
+		const __m256 zero = _mm256_setzero_ps();
+		for (int y = y0; y <= y1; y++) {
+			float py = y + 0.5f;
+			// Per row constant part of each edge and of the depth plane
+			const __m256 r0 = _mm256_set1_ps(edge[0][1] * py + edge[0][2]);
+			const __m256 r1 = _mm256_set1_ps(edge[1][1] * py + edge[1][2]);
+			const __m256 r2 = _mm256_set1_ps(edge[2][1] * py + edge[2][2]);
+			const __m256 rz = _mm256_set1_ps(plane[1] * py + plane[2]);
+			float* row = depth + size_t(y) * pitch;
+			for (int x = x0; x <= x1; x += 8) {
+				__m256 px = _mm256_add_ps(_mm256_set1_ps(float(x)), lane);
+				__m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), r0);
+				__m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), r1);
+				__m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), r2);
+				// Set where any edge fails e >= 0, i.e. outside
+				__m256 outside = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(e0, zero, _CMP_NGE_UQ),
+					_mm256_cmp_ps(e1, zero, _CMP_NGE_UQ)), _mm256_cmp_ps(e2, zero, _CMP_NGE_UQ));
+				__m256 z = _mm256_add_ps(_mm256_mul_ps(az, px), rz);
+				__m256 d = _mm256_loadu_ps(row + x);
+				// min_ps(z, d) is z < d ? z : d, as std::min(d, z)
+				_mm256_storeu_ps(row + x, _mm256_blendv_ps(_mm256_min_ps(z, d), d, outside));
+			}
+		}
+	}
+#endif
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+{
+	m_tilesX = std::max(1, (width + TileWidth - 1) / TileWidth);
+	m_tilesY = std::max(1, (height + TileHeight - 1) / TileHeight);
+	m_width = m_tilesX * TileWidth;
+	m_height = m_tilesY * TileHeight;
+	m_bins.resize(size_t(m_tilesX) * m_tilesY);
+	m_useAvx2 = HasAvx2();
+
+	size_t offset = 0;
+	int w = m_width, h = m_height;
+	for (;;) {
+		m_levels.push_back(MipLevel{ w, h, offset });
+		offset += size_t(w) * h;
+		if (w == 1 && h == 1)
+			break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+	m_depth.assign(offset, 1.0f);
+	memset(m_viewProj, 0, sizeof(m_viewProj));
+}
+
+bool OcclusionBuffer::HasAvx2()
+{
+#ifdef OCCLUSION_AVX2
+#ifdef _MSC_VER
+	static const bool supported = []() {
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		// AVX with the OS saving the ymm registers, then the AVX2 feature bit
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}();
+	return supported;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+#else
+	return false;
+#endif
+}
+
+void OcclusionBuffer::BeginFrame(const float viewProj[16])
+{
+	memcpy(m_viewProj, viewProj, sizeof(m_viewProj));
+	m_occluders.clear();
+	m_stats = OcclusionStats();
+	m_rasterized = false;
+}
+
+void OcclusionBuffer::AddOccluder(const float* positions, size_t stride, size_t vertexCount,
+	const uint32_t* indices, size_t indexCount, const float world[16])
+{
+	Occluder o;
+	o.positions = reinterpret_cast<const uint8_t*>(positions);
+	o.stride = stride;
+	o.vertexCount = vertexCount;
+	o.indices = indices;
+	o.triangleCount = indexCount / 3;
+	if (world)
+		Multiply(world, m_viewProj, o.worldViewProj);
+	else
+		memcpy(o.worldViewProj, m_viewProj, sizeof(m_viewProj));
+	o.firstVertex = m_occluders.empty() ? 0 : m_occluders.back().firstVertex + m_occluders.back().vertexCount;
+	o.firstTriangle = m_occluders.empty() ? 0 : m_occluders.back().firstTriangle + m_occluders.back().triangleCount;
+	m_occluders.push_back(o);
+	m_stats.occluderTriangles += o.triangleCount;
+}
+
+void OcclusionBuffer::TransformVertices(const Occluder& o, size_t first, size_t last)
+{
+	for (size_t i = first; i < last; i++)
+		Transform(reinterpret_cast<const float*>(o.positions + i * o.stride), o.worldViewProj, &m_clip[(o.firstVertex + i) * 4]);
+}
+
+void OcclusionBuffer::SetupTriangles(const Occluder& o, size_t first, size_t last)
+{
+	const float* clip = &m_clip[o.firstVertex * 4];
+	for (size_t t = first; t < last; t++) {
+		TriangleSetup* out = &m_setup[(o.firstTriangle + t) * 2];
+		out[0].minX = out[1].minX = 1;
+		out[0].maxX = out[1].maxX = 0;
+		const uint32_t* tri = o.indices + t * 3;
+		const float* v[3] = { clip + tri[0] * 4, clip + tri[1] * 4, clip + tri[2] * 4 };
+		// Outside one frustum plane with all three vertices
+		bool rejected = false;
+		for (int axis = 0; axis < 2 && !rejected; axis++) {
+			rejected = (v[0][axis] > v[0][3] && v[1][axis] > v[1][3] && v[2][axis] > v[2][3]) ||
+				(v[0][axis] < -v[0][3] && v[1][axis] < -v[1][3] && v[2][axis] < -v[2][3]);
+		}
+		if (rejected || (v[0][2] < 0 && v[1][2] < 0 && v[2][2] < 0) || (v[0][2] > v[0][3] && v[1][2] > v[1][3] && v[2][2] > v[2][3]))
+			continue;
+		if (v[0][2] >= 0 && v[1][2] >= 0 && v[2][2] >= 0) {
+			Setup(v[0], v[1], v[2], out[0]);
+			continue;
+		}
+
+		// Clip against the near plane (z >= 0), which leaves three or four vertices.
+		float clipped[4][4];
+		int count = 0;
+		for (int i = 0; i < 3; i++) {
+			const float* a = v[i];
+			const float* b = v[(i + 1) % 3];
+			if (a[2] >= 0)
+				memcpy(clipped[count++], a, sizeof(float) * 4);
+			if ((a[2] >= 0) != (b[2] >= 0)) {
+				float s = a[2] / (a[2] - b[2]);
+				for (int c = 0; c < 4; c++)
+					clipped[count][c] = a[c] + (b[c] - a[c]) * s;
+				count++;
+			}
+		}
+		Setup(clipped[0], clipped[1], clipped[2], out[0]);
+		if (count == 4)
+			Setup(clipped[0], clipped[2], clipped[3], out[1]);
+	}
+}
+
+void OcclusionBuffer::Setup(const float* a, const float* b, const float* c, TriangleSetup& s) const
+{
+	// Pixels, y down, and depth
+	float x[3], y[3], z[3];
+	const float* v[3] = { a, b, c };
+	const float halfWidth = 0.5f * m_width, halfHeight = 0.5f * m_height;
+	for (int i = 0; i < 3; i++) {
+		float invW = 1.0f / std::max(v[i][3], MinW);
+		x[i] = v[i][0] * invW * halfWidth + halfWidth;
+		y[i] = halfHeight - v[i][1] * invW * halfHeight;
+		z[i] = v[i][2] * invW;
+	}
+
+	// Pixels whose centers fall inside the bounding box
+	int minX = FirstPixel(std::min(x[0], std::min(x[1], x[2])), m_width);
+	int minY = FirstPixel(std::min(y[0], std::min(y[1], y[2])), m_height);
+	int maxX = LastPixel(std::max(x[0], std::max(x[1], x[2])), m_width);
+	int maxY = LastPixel(std::max(y[0], std::max(y[1], y[2])), m_height);
+	if (minX > maxX || minY > maxY)
+		return;
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (!(fabsf(area) > 1e-8f))
+		return;
+
+	// Edge opposite each vertex, so each one is that vertex's barycentric weight times area
+	float sign = area > 0 ? 1.0f : -1.0f;
+	for (int k = 0; k < 3; k++) {
+		int i = (k + 1) % 3, j = (k + 2) % 3;
+		s.edge[k][0] = sign * (y[i] - y[j]);
+		s.edge[k][1] = sign * (x[j] - x[i]);
+		s.edge[k][2] = sign * (x[i] * y[j] - y[i] * x[j]);
+	}
+	float invArea = 1.0f / (area * sign);
+	for (int p = 0; p < 3; p++)
+		s.depth[p] = (s.edge[0][p] * z[0] + s.edge[1][p] * z[1] + s.edge[2][p] * z[2]) * invArea;
+	s.minX = minX;
+	s.minY = minY;
+	s.maxX = maxX;
+	s.maxY = maxY;
+}
+
+void OcclusionBuffer::Rasterize(JobSystem* jobs)
+{
+	if (m_occluders.empty()) {
+		m_clip.clear();
+		m_setup.clear();
+	}
+	else {
+		const Occluder& last = m_occluders.back();
+		m_clip.resize((last.firstVertex + last.vertexCount) * 4);
+		m_setup.resize((last.firstTriangle + last.triangleCount) * 2);
+	}
+	for (const Occluder& o : m_occluders) {
+		if (jobs) {
+			jobs->ParallelFor(0, o.vertexCount, 4096, [this, &o](size_t first, size_t last) { TransformVertices(o, first, last); });
+			jobs->ParallelFor(0, o.triangleCount, 2048, [this, &o](size_t first, size_t last) { SetupTriangles(o, first, last); });
+		}
+		else {
+			TransformVertices(o, 0, o.vertexCount);
+			SetupTriangles(o, 0, o.triangleCount);
+		}
+	}
+
+	const size_t count = m_setup.size();
+	for (auto& bin : m_bins)
+		bin.clear();
+	for (size_t i = 0; i < count; i++) {
+		const TriangleSetup& s = m_setup[i];
+		if (s.minX > s.maxX)
+			continue;
+		m_stats.rasterizedTriangles++;
+		for (int ty = s.minY / TileHeight; ty <= s.maxY / TileHeight; ty++) {
+			for (int tx = s.minX / TileWidth; tx <= s.maxX / TileWidth; tx++) {
+				m_bins[size_t(ty) * m_tilesX + tx].push_back(uint32_t(i));
+				m_stats.binnedTriangles++;
+			}
+		}
+	}
+
+	// Tiles own disjoint pixels, so they rasterize without synchronization.
+	const size_t tiles = m_bins.size();
+	if (jobs)
+		jobs->ParallelFor(0, tiles, 1, [this](size_t first, size_t last) {
+			for (size_t i = first; i < last; i++)
+				RasterizeTile(int(i));
+		});
+	else {
+		for (size_t i = 0; i < tiles; i++)
+			RasterizeTile(int(i));
+	}
+	BuildHiZ();
+	m_rasterized = true;
+}
+
+void OcclusionBuffer::RasterizeTile(int tile)
+{
+	const int tileX = (tile % m_tilesX) * TileWidth;
+	const int tileY = (tile / m_tilesX) * TileHeight;
+	float* depth = m_depth.data();
+	for (int y = tileY; y < tileY + TileHeight; y++)
+		std::fill(depth + size_t(y) * m_width + tileX, depth + size_t(y) * m_width + tileX + TileWidth, 1.0f);
+
+	for (uint32_t i : m_bins[tile]) {
+		const TriangleSetup& s = m_setup[i];
+		int x0 = std::max(s.minX, tileX), x1 = std::min(s.maxX, tileX + TileWidth - 1);
+		int y0 = std::max(s.minY, tileY), y1 = std::min(s.maxY, tileY + TileHeight - 1);
+#ifdef OCCLUSION_AVX2
+		if (m_useAvx2) {
+			// Tiles are whole multiples of eight pixels wide, so aligned groups stay inside.
+			RasterizeAvx2(s.edge, s.depth, x0 & ~7, x1, y0, y1, depth, m_width);
+			continue;
+		}
+#endif
+		RasterizeScalar(s.edge, s.depth, x0, x1, y0, y1, depth, m_width);
+	}
+}
+
+void OcclusionBuffer::BuildHiZ()
+{
+	for (size_t l = 1; l < m_levels.size(); l++) {
+		const MipLevel& src = m_levels[l - 1];
+		const MipLevel& dst = m_levels[l];
+		const float* in = &m_depth[src.offset];
+		float* out = &m_depth[dst.offset];
+		for (int y = 0; y < dst.height; y++) {
+			int y0 = y * 2, y1 = std::min(y * 2 + 1, src.height - 1);
+			for (int x = 0; x < dst.width; x++) {
+				int x0 = x * 2, x1 = std::min(x * 2 + 1, src.width - 1);
+				out[size_t(y) * dst.width + x] = std::max(
+					std::max(in[size_t(y0) * src.width + x0], in[size_t(y0) * src.width + x1]),
+					std::max(in[size_t(y1) * src.width + x0], in[size_t(y1) * src.width + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::IsOccluded(const float boundsMin[3], const float boundsMax[3]) const
+{
+	if (!m_rasterized)
+		return false;
+	float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f, minZ = 1.0f;
+	for (int i = 0; i < 8; i++) {
+		float corner[3] = { (i & 1) ? boundsMax[0] : boundsMin[0], (i & 2) ? boundsMax[1] : boundsMin[1], (i & 4) ? boundsMax[2] : boundsMin[2] };
+		float clip[4];
+		Transform(corner, m_viewProj, clip);
+		if (clip[3] < MinW || clip[2] < 0)
+			return false;
+		float x = clip[0] / clip[3], y = clip[1] / clip[3];
+		if (i == 0) {
+			minX = maxX = x;
+			minY = maxY = y;
+		}
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip[2] / clip[3]);
+	}
+
+	// Pixels the screen rectangle touches, y down
+	float left = (minX * 0.5f + 0.5f) * m_width, right = (maxX * 0.5f + 0.5f) * m_width;
+	float top = (0.5f - maxY * 0.5f) * m_height, bottom = (0.5f - minY * 0.5f) * m_height;
+	if (right < 0 || bottom < 0 || left >= m_width || top >= m_height)
+		return false;
+	int x0 = int(std::max(floorf(left), 0.0f)), x1 = int(std::min(floorf(right), float(m_width - 1)));
+	int y0 = int(std::max(floorf(top), 0.0f)), y1 = int(std::min(floorf(bottom), float(m_height - 1)));
+
+	// Coarsest level where the rectangle spans at most four texels each way
+	size_t level = 0;
+	while (level + 1 < m_levels.size() && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+		level++;
+	const MipLevel& l = m_levels[level];
+	const float* texels = &m_depth[l.offset];
+	for (int y = y0 >> level; y <= (y1 >> level); y++) {
+		for (int x = x0 >> level; x <= (x1 >> level); x++) {
+			if (texels[size_t(y) * l.width + x] >= minZ)
+				return false;
+		}
+	}
+	return true;
+}
+
+bool OcclusionBuffer::IsOccluded(const float center[3], float radius) const
+{
+	float boundsMin[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+	float boundsMax[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+	return IsOccluded(boundsMin, boundsMax);
+}
+
+const float* OcclusionBuffer::Level(int level, int* width, int* height) const
+{
+	const MipLevel& l = m_levels[level];
+	if (width)
+		*width = l.width;
+	if (height)
+		*height = l.height;
+	return &m_depth[l.offset];
+}
+
+void OcclusionBuffer::BuildHeightfieldOccluder(const float* heights, int dim, int firstCell, int lastCell, int step,
+	float cellSize, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+	std::vector<int> coords;
+	for (int c = firstCell; c < lastCell; c += step)
+		coords.push_back(c);
+	coords.push_back(lastCell);
+	const int n = int(coords.size());
+
+	// Lowest height inside each coarse cell, edges included
+	std::vector<float> cellMin(size_t(n - 1) * (n - 1));
+	for (int cz = 0; cz + 1 < n; cz++) {
+		for (int cx = 0; cx + 1 < n; cx++) {
+			float h = heights[coords[cx] + coords[cz] * dim];
+			for (int z = coords[cz]; z <= coords[cz + 1]; z++) {
+				for (int x = coords[cx]; x <= coords[cx + 1]; x++)
+					h = std::min(h, heights[x + z * dim]);
+			}
+			cellMin[size_t(cz) * (n - 1) + cx] = h;
+		}
+	}
+
+	positions.clear();
+	indices.clear();
+	positions.reserve(size_t(n) * n * 3);
+	for (int vz = 0; vz < n; vz++) {
+		for (int vx = 0; vx < n; vx++) {
+			float h = heights[coords[vx] + coords[vz] * dim];
+			for (int cz = std::max(vz - 1, 0); cz <= std::min(vz, n - 2); cz++) {
+				for (int cx = std::max(vx - 1, 0); cx <= std::min(vx, n - 2); cx++)
+					h = std::min(h, cellMin[size_t(cz) * (n - 1) + cx]);
+			}
+			positions.push_back(coords[vx] * cellSize);
+			positions.push_back(h);
+			positions.push_back(coords[vz] * cellSize);
+		}
+	}
+	indices.reserve(size_t(n - 1) * (n - 1) * 6);
+	for (int z = 1; z < n; z++) {
+		for (int x = 1; x < n; x++) {
+			indices.push_back((x - 1) + (z - 1) * n);
+			indices.push_back((x - 1) + z * n);
+			indices.push_back(x + (z - 1) * n);
+
+			indices.push_back((x - 1) + z * n);
+			indices.push_back(x + z * n);
+			indices.push_back(x + (z - 1) * n);
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+struct OcclusionStats
+{
+	size_t occluderTriangles = 0;	// triangles passed to AddOccluder
+	size_t rasterizedTriangles = 0;	// left after near clipping and rejection
+	size_t binnedTriangles = 0;		// triangle / tile pairs rasterized
+};
+
+// Low resolution software depth buffer for occlusion culling. Occluders are rasterized
+// on the CPU in screen tiles, spread over the job system, with 8-wide AVX2 edge
+// functions where the CPU has them. A Hi-Z chain (farthest depth of each 2x2 block per
+// level) then answers whether a box is hidden with a handful of texel reads.
+// Matrices are row-major, row-vector (DirectXMath), D3D clip depth 0..w.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+class OcclusionBuffer
+{
+public:
+	static const int TileWidth = 32;
+	static const int TileHeight = 16;
+
+	// Sizes are rounded up to whole tiles.
+	explicit OcclusionBuffer(int width = 256, int height = 128);
+
+	// Drops last frame's occluders and depth.
+	void BeginFrame(const float viewProj[16]);
+
+	// Triangles of vertexCount positions (three floats, stride bytes apart) in the space
+	// world maps to world space; null world is the identity. Either winding. Occluders
+	// must not extend past the surface they stand for, or visible objects get culled.
+	// positions and indices are read by Rasterize and must stay valid until then.
+	void AddOccluder(const float* positions, size_t stride, size_t vertexCount,
+		const uint32_t* indices, size_t indexCount, const float world[16] = nullptr);
+
+	// Rasterizes the occluders added since BeginFrame and builds the Hi-Z chain.
+	// With jobs, vertex transforms, triangle setup and tiles run in parallel.
+	void Rasterize(JobSystem* jobs = nullptr);
+
+	// True only when the world space box is entirely behind the rasterized occluders.
+	// Boxes crossing the near plane or outside the screen are never occluded.
+	bool IsOccluded(const float boundsMin[3], const float boundsMax[3]) const;
+	bool IsOccluded(const float center[3], float radius) const;
+
+	// Heightfield occluder over grid coordinates [firstCell, lastCell] of a dim x dim
+	// height map, one vertex every step cells at (x * cellSize, height, z * cellSize).
+	// Each vertex takes the lowest height of the cells around it, so the coarse surface
+	// stays under the full resolution one.
+	static void BuildHeightfieldOccluder(const float* heights, int dim, int firstCell, int lastCell, int step,
+		float cellSize, std::vector<float>& positions, std::vector<uint32_t>& indices);
+
+	static bool HasAvx2();
+	// Falls back to the scalar rasterizer when off or unsupported.
+	void SetUseAvx2(bool enable) { m_useAvx2 = enable && HasAvx2(); }
+	bool UsesAvx2() const { return m_useAvx2; }
+
+	int Width() const { return m_width; }
+	int Height() const { return m_height; }
+	int LevelCount() const { return int(m_levels.size()); }
+	// Level 0 is the rasterized depth; each further level is half the size.
+	const float* Level(int level, int* width = nullptr, int* height = nullptr) const;
+	const OcclusionStats& Stats() const { return m_stats; }
+
+private:
+	struct Occluder
+	{
+		const uint8_t* positions;
+		size_t stride;
+		size_t vertexCount;
+		const uint32_t* indices;
+		size_t triangleCount;
+		float worldViewProj[16];
+		size_t firstVertex;			// into m_clip
+		size_t firstTriangle;		// into m_setup, two slots per triangle
+	};
+
+	// Edge functions and depth plane in pixel space, inside where all edges are >= 0.
+	struct TriangleSetup
+	{
+		float edge[3][3];			// a * x + b * y + c
+		float depth[3];
+		int minX, minY, maxX, maxY;	// pixel bounds, empty when minX > maxX
+	};
+
+	struct MipLevel
+	{
+		int width, height;
+		size_t offset;
+	};
+
+	void TransformVertices(const Occluder& o, size_t first, size_t last);
+	void SetupTriangles(const Occluder& o, size_t first, size_t last);
+	void Setup(const float* a, const float* b, const float* c, TriangleSetup& s) const;
+	void RasterizeTile(int tile);
+	void BuildHiZ();
+
+	int m_width, m_height;
+	int m_tilesX, m_tilesY;
+	float m_viewProj[16];
+	bool m_useAvx2;
+	bool m_rasterized = false;
+
+	std::vector<Occluder> m_occluders;
+	std::vector<float> m_clip;				// clip space vertices of every occluder
+	std::vector<TriangleSetup> m_setup;		// near clipping splits a triangle in at most two
+	std::vector<std::vector<uint32_t>> m_bins;	// triangles overlapping each tile
+	std::vector<float> m_depth;				// every level, level 0 first
+	std::vector<MipLevel> m_levels;
+	OcclusionStats m_stats;
+};
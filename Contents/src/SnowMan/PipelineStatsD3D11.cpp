@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "PipelineStatsD3D11.h"
+
+const unsigned D3D11PipelineStats::FramesInFlight;
+
+D3D11PipelineStats::D3D11PipelineStats(ID3D11Device* device, ID3D11DeviceContext* context, unsigned maxScopes) :
+	m_context(context), m_maxScopes(maxScopes)
+{
+	D3D11_QUERY_DESC desc = { D3D11_QUERY_PIPELINE_STATISTICS, 0 };
+	for (Frame& f : m_frames) {
+		f.queries.resize(maxScopes);
+		for (auto& query : f.queries)
+			DX::ThrowIfFailed(device->CreateQuery(&desc, query.GetAddressOf()));
+		f.names.resize(maxScopes);
+	}
+}
+
+void D3D11PipelineStats::BeginFrame()
+{
+	// A frame still pending when the ring wraps is dropped.
+	if (m_next - m_oldest == FramesInFlight)
+		m_oldest++;
+	m_frames[m_next % FramesInFlight].scopeCount = 0;
+}
+
+int D3D11PipelineStats::Begin(const char* name)
+{
+	Frame& f = m_frames[m_next % FramesInFlight];
+	if (f.scopeCount == m_maxScopes)
+		return -1;
+	unsigned scope = f.scopeCount++;
+	f.names[scope] = name;
+	m_context->Begin(f.queries[scope].Get());
+	return int(scope);
+}
+
+void D3D11PipelineStats::End(int scope)
+{
+	if (scope < 0)
+		return;
+	m_context->End(m_frames[m_next % FramesInFlight].queries[scope].Get());
+}
+
+void D3D11PipelineStats::EndFrame()
+{
+	m_next++;
+}
+
+void D3D11PipelineStats::Collect()
+{
+	while (m_oldest < m_next) {
+		Frame& f = m_frames[m_oldest % FramesInFlight];
+		// Queries finish in order, so the last one being done means the frame is.
+		D3D11_QUERY_DATA_PIPELINE_STATISTICS data;
+		if (f.scopeCount > 0 &&
+			m_context->GetData(f.queries[f.scopeCount - 1].Get(), &data, sizeof(data), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			return;
+		for (unsigned i = 0; i < f.scopeCount; i++) {
+			if (m_context->GetData(f.queries[i].Get(), &data, sizeof(data), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+				continue;
+			Totals& t = m_totals[f.names[i]];
+			t.frames++;
+			t.sum.IAVertices += data.IAVertices;
+			t.sum.IAPrimitives += data.IAPrimitives;
+			t.sum.VSInvocations += data.VSInvocations;
+			t.sum.GSInvocations += data.GSInvocations;
+			t.sum.GSPrimitives += data.GSPrimitives;
+			t.sum.CInvocations += data.CInvocations;
+			t.sum.CPrimitives += data.CPrimitives;
+			t.sum.PSInvocations += data.PSInvocations;
+			t.sum.HSInvocations += data.HSInvocations;
+			t.sum.DSInvocations += data.DSInvocations;
+			t.sum.CSInvocations += data.CSInvocations;
+		}
+		m_oldest++;
+	}
+}
+
+const D3D11PipelineStats::Totals* D3D11PipelineStats::Find(const char* name) const
+{
+	auto it = m_totals.find(name);
+	return it == m_totals.end() ? nullptr : &it->second;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "pch.h"
+#include <map>
+#include <string>
+
+// D3D11 pipeline statistics queries around named ranges of draws. Each frame in
+// flight owns one query per range; results are read without flushing once the
+// frame has finished on the GPU and summed per range name until Reset.
+class D3D11PipelineStats
+{
+public:
+	static const unsigned FramesInFlight = 4;
+
+	struct Totals
+	{
+		uint64_t frames = 0;
+		D3D11_QUERY_DATA_PIPELINE_STATISTICS sum = {};
+	};
+
+	D3D11PipelineStats(ID3D11Device* device, ID3D11DeviceContext* context, unsigned maxScopes = 8);
+
+	void BeginFrame();
+	// Returns -1 once the frame has maxScopes ranges; End ignores it.
+	int Begin(const char* name);
+	void End(int scope);
+	void EndFrame();
+	// Adds up the frames the GPU has finished; call once per frame.
+	void Collect();
+
+	// Null until a frame with the range has been collected.
+	const Totals* Find(const char* name) const;
+	void Reset() { m_totals.clear(); }
+
+private:
+	struct Frame
+	{
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Query>> queries;
+		std::vector<const char*> names;
+		unsigned scopeCount = 0;
+	};
+
+	ID3D11DeviceContext* m_context;
+	unsigned m_maxScopes;
+	Frame m_frames[FramesInFlight];
+	uint64_t m_next = 0;		// ring position of the frame being recorded
+	uint64_t m_oldest = 0;		// ring position of the oldest pending frame
+	std::map<std::string, Totals> m_totals;
+};
+
+// RAII range on a D3D11PipelineStats, which may be null.
+class PipelineStatsScope
+{
+public:
+	PipelineStatsScope(D3D11PipelineStats* stats, const char* name) :
+		m_stats(stats), m_scope(stats ? stats->Begin(name) : -1) {}
+	~PipelineStatsScope() { if (m_stats) m_stats->End(m_scope); }
+	PipelineStatsScope(const PipelineStatsScope&) = delete;
+	PipelineStatsScope& operator=(const PipelineStatsScope&) = delete;
+
+private:
+	D3D11PipelineStats* m_stats;
+	int m_scope;
+};
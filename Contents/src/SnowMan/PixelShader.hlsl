@@ -6,6 +6,8 @@
 // Advanced Technology Group (ATG)
 // Copyright (C) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
+#include "ClusteredLights.hlsli"
+
 cbuffer CameraBuffer
 {
 	float4 c_color;
@@ -17,6 +19,7 @@ struct Interpolants
 	float3 normal       : fs_Nor;
 	float2 tex          : TEXCOORD0;
 	float4 lightPosition: TEXCOORD1;
+	float3 worldPosition: TEXCOORD2;
 };
 
 struct Pixel
@@ -86,7 +89,8 @@ Pixel main( Interpolants In )
 
 	float diffuseTerm = saturate(dot(In.normal, normalize(lightDir.xyz)));
 	float ambientTerm = 0.05;
+	float3 lamps = ClusteredLighting(In.position.xy, In.worldPosition, normalize(In.normal));
 	float4 col = txDiffuse.Sample(samLinear, In.tex);
-    Out.color = float4(sd*(ambientTerm + diffuseTerm) * col.xyz, 1.0);
+    Out.color = float4((sd*(ambientTerm + diffuseTerm) + lamps) * col.xyz, 1.0);
     return Out;
 }
\ No newline at end of file
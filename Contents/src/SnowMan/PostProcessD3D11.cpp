@@ -0,0 +1,158 @@
+#include "pch.h"
+#include "PostProcessD3D11.h"
+
+using namespace DirectX;
+
+D3D11PostProcess::D3D11PostProcess(ID3D11Device* device)
+{
+	m_basic = std::make_unique<BasicPostProcess>(device);
+	m_dual = std::make_unique<DualPostProcess>(device);
+	CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+	DX::ThrowIfFailed(device->CreateSamplerState(&samplerDesc, m_linearClamp.GetAddressOf()));
+}
+
+void D3D11PostProcess::AddPass(PassKind kind, uint32_t source, uint32_t source2, uint32_t target)
+{
+	m_passes.push_back({ kind, source, source2, target });
+	uint32_t reads[2];
+	size_t readCount = 0;
+	for (uint32_t s : { source, source2 }) {
+		if (s != RenderTargetPool::NoTarget)
+			reads[readCount++] = s;
+	}
+	m_pool.AddPass(reads, readCount, target);
+}
+
+void D3D11PostProcess::Configure(ID3D11Device* device, const PostProcessSettings& settings, uint32_t width, uint32_t height,
+	DXGI_FORMAT outputFormat)
+{
+	const uint32_t none = RenderTargetPool::NoTarget;
+	m_settings = settings;
+	m_width = width;
+	m_height = height;
+	m_passes.clear();
+	m_pool.Reset();
+
+	// Everything after the tone mapping is in the output's format; 4 bytes a pixel for
+	// the 8 and 10 bit ones swap chains use
+	const RenderTargetDesc full = { width, height, uint32_t(outputFormat), 4 };
+	const RenderTargetDesc half = { std::max(width / 2, 1u), std::max(height / 2, 1u), uint32_t(outputFormat), 4 };
+	const RenderTargetDesc quarter = { std::max(width / 4, 1u), std::max(height / 4, 1u), uint32_t(outputFormat), 4 };
+
+	uint32_t image = (settings.bloom || settings.fxaa) ? m_pool.AddTarget(full) : none;
+	AddPass(PassKind_ToneMap, none, none, image);
+	if (settings.bloom) {
+		uint32_t extracted = m_pool.AddTarget(half);
+		uint32_t halfBlurred = m_pool.AddTarget(half);
+		uint32_t halfBloom = m_pool.AddTarget(half);
+		uint32_t quarterSize = m_pool.AddTarget(quarter);
+		uint32_t quarterBlurred = m_pool.AddTarget(quarter);
+		uint32_t quarterBloom = m_pool.AddTarget(quarter);
+		uint32_t bloom = m_pool.AddTarget(half);
+		AddPass(PassKind_BloomExtract, image, none, extracted);
+		AddPass(PassKind_BlurHorizontal, extracted, none, halfBlurred);
+		AddPass(PassKind_BlurVertical, halfBlurred, none, halfBloom);
+		AddPass(PassKind_DownScale, halfBloom, none, quarterSize);
+		AddPass(PassKind_BlurHorizontal, quarterSize, none, quarterBlurred);
+		AddPass(PassKind_BlurVertical, quarterBlurred, none, quarterBloom);
+		AddPass(PassKind_Merge, halfBloom, quarterBloom, bloom);
+		uint32_t combined = settings.fxaa ? m_pool.AddTarget(full) : none;
+		AddPass(PassKind_BloomCombine, image, bloom, combined);
+		image = combined;
+	}
+	if (settings.fxaa)
+		AddPass(PassKind_Fxaa, image, none, none);
+	m_pool.Plan();
+
+	m_targets.clear();
+	m_targets.resize(m_pool.PhysicalCount());
+	for (size_t i = 0; i < m_targets.size(); i++) {
+		const RenderTargetDesc& desc = m_pool.PhysicalDesc(i);
+		CD3D11_TEXTURE2D_DESC textureDesc(DXGI_FORMAT(desc.format), desc.width, desc.height, 1, 1,
+			D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+		Target& t = m_targets[i];
+		DX::ThrowIfFailed(device->CreateTexture2D(&textureDesc, nullptr, t.texture.GetAddressOf()));
+		DX::ThrowIfFailed(device->CreateRenderTargetView(t.texture.Get(), nullptr, t.renderTarget.GetAddressOf()));
+		DX::ThrowIfFailed(device->CreateShaderResourceView(t.texture.Get(), nullptr, t.view.GetAddressOf()));
+	}
+}
+
+void D3D11PostProcess::Process(ID3D11DeviceContext* context, ToneMapPostProcess& toneMap, ID3D11ShaderResourceView* scene,
+	ID3D11RenderTargetView* output, ID3D11VertexShader* fullScreenShader, ID3D11PixelShader* fxaaShader)
+{
+	const uint32_t none = RenderTargetPool::NoTarget;
+	auto view = [&](uint32_t target) {
+		return target == none ? scene : m_targets[m_pool.PhysicalTarget(target)].view.Get();
+	};
+
+	for (const Pass& pass : m_passes) {
+		ID3D11RenderTargetView* target = output;
+		float width = float(m_width), height = float(m_height);
+		if (pass.target != none) {
+			uint32_t physical = m_pool.PhysicalTarget(pass.target);
+			target = m_targets[physical].renderTarget.Get();
+			width = float(m_pool.PhysicalDesc(physical).width);
+			height = float(m_pool.PhysicalDesc(physical).height);
+		}
+		context->OMSetRenderTargets(1, &target, nullptr);
+		CD3D11_VIEWPORT viewport(0.0f, 0.0f, width, height);
+		context->RSSetViewports(1, &viewport);
+
+		switch (pass.kind) {
+		case PassKind_ToneMap:
+			toneMap.SetHDRSourceTexture(scene);
+			toneMap.Process(context);
+			break;
+		case PassKind_BloomExtract:
+			m_basic->SetEffect(BasicPostProcess::BloomExtract);
+			m_basic->SetBloomExtractParameter(m_settings.bloomThreshold);
+			m_basic->SetSourceTexture(view(pass.source));
+			m_basic->Process(context);
+			break;
+		case PassKind_BlurHorizontal:
+		case PassKind_BlurVertical:
+			m_basic->SetEffect(BasicPostProcess::BloomBlur);
+			m_basic->SetBloomBlurParameters(pass.kind == PassKind_BlurHorizontal, m_settings.bloomBlurSize, m_settings.bloomBrightness);
+			m_basic->SetSourceTexture(view(pass.source));
+			m_basic->Process(context);
+			break;
+		case PassKind_DownScale:
+			m_basic->SetEffect(BasicPostProcess::DownScale_2x2);
+			m_basic->SetSourceTexture(view(pass.source));
+			m_basic->Process(context);
+			break;
+		case PassKind_Merge:
+			m_dual->SetEffect(DualPostProcess::Merge);
+			m_dual->SetMergeParameters(1.0f, 1.0f);
+			m_dual->SetSourceTexture(view(pass.source));
+			m_dual->SetSourceTexture2(view(pass.source2));
+			m_dual->Process(context);
+			break;
+		case PassKind_BloomCombine:
+			m_dual->SetEffect(DualPostProcess::BloomCombine);
+			m_dual->SetBloomCombineParameters(m_settings.bloomIntensity, m_settings.baseIntensity,
+				m_settings.bloomSaturation, m_settings.baseSaturation);
+			m_dual->SetSourceTexture(view(pass.source));
+			m_dual->SetSourceTexture2(view(pass.source2));
+			m_dual->Process(context);
+			break;
+		case PassKind_Fxaa:
+		{
+			// One triangle over the target, under the states the passes before left
+			ID3D11ShaderResourceView* source = view(pass.source);
+			context->IASetInputLayout(nullptr);
+			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			context->VSSetShader(fullScreenShader, nullptr, 0);
+			context->PSSetShader(fxaaShader, nullptr, 0);
+			context->PSSetShaderResources(0, 1, &source);
+			context->PSSetSamplers(0, 1, m_linearClamp.GetAddressOf());
+			context->Draw(3, 0);
+			break;
+		}
+		}
+
+		// A later pass may draw into what this one read
+		ID3D11ShaderResourceView* noSources[2] = {};
+		context->PSSetShaderResources(0, 2, noSources);
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "pch.h"
+#include "RenderTargetPool.h"
+#include <PostProcess.h>
+
+struct PostProcessSettings
+{
+	bool bloom = true;
+	bool fxaa = true;
+	float bloomThreshold = 0.25f;	// tone-mapped brightness where bloom starts
+	float bloomBlurSize = 4.0f;
+	float bloomBrightness = 1.0f;
+	float bloomIntensity = 1.25f;
+	float baseIntensity = 1.0f;
+	float bloomSaturation = 1.0f;
+	float baseSaturation = 1.0f;
+};
+
+// The passes from the HDR scene to the back buffer: tone mapping, then bloom (the bright
+// parts extracted at half size, blurred at half and at quarter size and added back) and
+// FXAA, each of the last two optional. The intermediate targets come from a
+// RenderTargetPool planned over the passes, so passes whose targets' lifetimes do not
+// overlap draw into the same textures. DirectXTK's post-processes and the FXAA pass
+// draw straight on the context and leave their shaders, states and viewports behind.
+class D3D11PostProcess
+{
+public:
+	explicit D3D11PostProcess(ID3D11Device* device);
+
+	// Plans the passes and creates their targets for a width x height output of
+	// outputFormat; call again when any of them changes.
+	void Configure(ID3D11Device* device, const PostProcessSettings& settings, uint32_t width, uint32_t height, DXGI_FORMAT outputFormat);
+	// Runs the passes from scene to output.
+	void Process(ID3D11DeviceContext* context, DirectX::ToneMapPostProcess& toneMap, ID3D11ShaderResourceView* scene,
+		ID3D11RenderTargetView* output, ID3D11VertexShader* fullScreenShader, ID3D11PixelShader* fxaaShader);
+
+	const PostProcessSettings& Settings() const { return m_settings; }
+	const RenderTargetPool& Pool() const { return m_pool; }
+
+private:
+	enum PassKind
+	{
+		PassKind_ToneMap,
+		PassKind_BloomExtract,
+		PassKind_BlurHorizontal,
+		PassKind_BlurVertical,
+		PassKind_DownScale,
+		PassKind_Merge,
+		PassKind_BloomCombine,
+		PassKind_Fxaa,
+	};
+
+	// Pool targets; NoTarget is the scene for a source and the output for the target
+	struct Pass
+	{
+		PassKind kind;
+		uint32_t source;
+		uint32_t source2;
+		uint32_t target;
+	};
+
+	struct Target
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> renderTarget;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+	};
+
+	void AddPass(PassKind kind, uint32_t source, uint32_t source2, uint32_t target);
+
+	std::unique_ptr<DirectX::BasicPostProcess> m_basic;
+	std::unique_ptr<DirectX::DualPostProcess> m_dual;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_linearClamp;
+	PostProcessSettings m_settings;
+	uint32_t m_width = 0, m_height = 0;
+	std::vector<Pass> m_passes;
+	RenderTargetPool m_pool;
+	std::vector<Target> m_targets;		// one per physical pool target
+};
@@ -0,0 +1,291 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct Calibration
+	{
+		uint64_t ticks0;
+		Clock::time_point time0;
+		std::atomic<double> ticksPerSecond;
+	};
+
+	Calibration& GetCalibration()
+	{
+		static Calibration c = { ProfileClock::Now(), Clock::now(), { 0.0 } };
+		return c;
+	}
+
+	struct OpenScope
+	{
+		const char* name;
+		uint64_t begin;
+	};
+
+	// Open CPU scopes and a small id for the calling thread.
+	thread_local std::vector<OpenScope> t_openScopes;
+	thread_local uint32_t t_threadId = UINT32_MAX;
+	std::atomic<uint32_t> g_nextThreadId(0);
+
+	uint32_t ThreadId()
+	{
+		if (t_threadId == UINT32_MAX)
+			t_threadId = g_nextThreadId++;
+		return t_threadId;
+	}
+
+	double TicksToMs(uint64_t ticks)
+	{
+		return double(ticks) * 1000.0 / ProfileClock::TicksPerSecond();
+	}
+
+	void AppendJsonString(std::string& out, const char* s)
+	{
+		out += '"';
+		for (; *s; s++) {
+			if (*s == '"' || *s == '\\')
+				out += '\\';
+			if ((unsigned char)*s >= 0x20)
+				out += *s;
+		}
+		out += '"';
+	}
+
+	double Percentile(const std::vector<double>& sorted, double p)
+	{
+		size_t rank = size_t(p * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(rank, sorted.size() - 1)];
+	}
+}
+
+uint64_t ProfileClock::Now()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Measured over the whole run so far; refined on every call once 50 ms have passed.
+double ProfileClock::TicksPerSecond()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	Calibration& c = GetCalibration();
+	double elapsed = std::chrono::duration<double>(Clock::now() - c.time0).count();
+	if (elapsed >= 0.05) {
+		double rate = double(Now() - c.ticks0) / elapsed;
+		c.ticksPerSecond = rate;
+		return rate;
+	}
+	double rate = c.ticksPerSecond;
+	if (rate > 0.0)
+		return rate;
+	// Too early to measure well; spin briefly for a first estimate.
+	uint64_t t0 = Now();
+	Clock::time_point start = Clock::now();
+	while (Clock::now() - start < std::chrono::milliseconds(10)) {}
+	rate = double(Now() - t0) / std::chrono::duration<double>(Clock::now() - start).count();
+	c.ticksPerSecond = rate;
+	return rate;
+#else
+	return 1e9;
+#endif
+}
+
+void FakeGpuTimer::BeginFrame(uint64_t frame)
+{
+	m_current.frame = frame;
+	m_current.start = ProfileClock::Now();
+	m_current.scopes.clear();
+	m_depth = 0;
+}
+
+int FakeGpuTimer::Begin(const char* name)
+{
+	m_current.scopes.push_back(Scope{ name, ProfileClock::Now(), 0, m_depth++ });
+	return int(m_current.scopes.size() - 1);
+}
+
+void FakeGpuTimer::End(int scope)
+{
+	m_current.scopes[scope].end = ProfileClock::Now();
+	m_depth--;
+}
+
+void FakeGpuTimer::EndFrame()
+{
+	m_inFlight.push_back(m_current);
+}
+
+bool FakeGpuTimer::Collect(GpuFrame& out)
+{
+	if (m_inFlight.size() <= m_latency)
+		return false;
+	const Frame& f = m_inFlight.front();
+	out.frame = f.frame;
+	out.samples.clear();
+	for (const Scope& s : f.scopes)
+		out.samples.push_back(GpuSample{ s.name, TicksToMs(s.begin - f.start), TicksToMs(s.end - f.start), s.depth });
+	m_inFlight.pop_front();
+	return true;
+}
+
+Profiler::Profiler(GpuTimer* gpu, size_t historyFrames) :
+	m_gpu(gpu), m_historyFrames(std::max<size_t>(historyFrames, 1))
+{
+	GetCalibration();
+}
+
+void Profiler::BeginFrame()
+{
+	m_frameBegin = ProfileClock::Now();
+	if (m_gpu)
+		m_gpu->BeginFrame(m_frame);
+}
+
+void Profiler::EndFrame()
+{
+	uint64_t frameEnd = ProfileClock::Now();
+	FrameRecord record;
+	record.frame = m_frame;
+	record.begin = m_frameBegin;
+	record.end = frameEnd;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		record.events.swap(m_events);
+	}
+
+	std::unordered_map<std::string, double> totals;
+	for (const Event& e : record.events)
+		totals[e.name] += TicksToMs(e.end - e.begin);
+	totals["Frame"] += TicksToMs(frameEnd - m_frameBegin);
+	AddTotals(m_cpuSeries, totals);
+
+	m_history.push_back(std::move(record));
+	if (m_history.size() > m_historyFrames)
+		m_history.pop_front();
+
+	if (m_gpu) {
+		m_gpu->EndFrame();
+		while (m_gpu->Collect(m_gpuFrame))
+			AddGpuFrame(m_gpuFrame);
+	}
+	m_frame++;
+}
+
+void Profiler::BeginScope(const char* name)
+{
+	t_openScopes.push_back(OpenScope{ name, ProfileClock::Now() });
+}
+
+void Profiler::EndScope()
+{
+	uint64_t end = ProfileClock::Now();
+	assert(!t_openScopes.empty());
+	OpenScope open = t_openScopes.back();
+	t_openScopes.pop_back();
+	Event e = { open.name, open.begin, end, ThreadId(), uint32_t(t_openScopes.size()) };
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_events.push_back(e);
+}
+
+void Profiler::AddTotals(SeriesMap& series, const std::unordered_map<std::string, double>& totals)
+{
+	for (const auto& total : totals) {
+		Series& s = series[total.first];
+		if (s.values.size() < m_historyFrames)
+			s.values.push_back(total.second);
+		else
+			s.values[s.next] = total.second;
+		s.next = (s.next + 1) % m_historyFrames;
+	}
+}
+
+void Profiler::AddGpuFrame(const GpuFrame& frame)
+{
+	std::unordered_map<std::string, double> totals;
+	for (const GpuSample& s : frame.samples)
+		totals[s.name] += s.endMs - s.beginMs;
+	AddTotals(m_gpuSeries, totals);
+
+	for (FrameRecord& record : m_history) {
+		if (record.frame == frame.frame) {
+			record.gpu = frame.samples;
+			break;
+		}
+	}
+}
+
+std::vector<Profiler::Stats> Profiler::Summary() const
+{
+	std::vector<Stats> stats;
+	std::vector<double> sorted;
+	for (int gpu = 0; gpu < 2; gpu++) {
+		for (const auto& entry : gpu ? m_gpuSeries : m_cpuSeries) {
+			sorted = entry.second.values;
+			std::sort(sorted.begin(), sorted.end());
+			double sum = 0.0;
+			for (double v : sorted)
+				sum += v;
+			stats.push_back(Stats{ entry.first, gpu != 0, sorted.size(), sum / sorted.size(),
+				Percentile(sorted, 0.50), Percentile(sorted, 0.95), Percentile(sorted, 0.99) });
+		}
+	}
+	std::sort(stats.begin(), stats.end(), [](const Stats& a, const Stats& b) {
+		return a.gpu != b.gpu ? b.gpu : a.name < b.name;
+	});
+	return stats;
+}
+
+std::string Profiler::ChromeTrace() const
+{
+	if (m_history.empty())
+		return "{\"traceEvents\":[]}\n";
+	const uint64_t origin = m_history.front().begin;
+	const double toUs = 1e6 / ProfileClock::TicksPerSecond();
+	const uint32_t gpuTrack = 1000;
+
+	std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	char buffer[160];
+	sprintf(buffer, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", gpuTrack);
+	out += buffer;
+	auto event = [&](const char* name, const char* category, double ts, double dur, uint32_t tid) {
+		out += ",\n{\"name\":";
+		AppendJsonString(out, name);
+		sprintf(buffer, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}", category, ts, dur, tid);
+		out += buffer;
+	};
+	for (const FrameRecord& f : m_history) {
+		double frameStart = (f.begin - origin) * toUs;
+		event("Frame", "frame", frameStart, (f.end - f.begin) * toUs, 0);
+		for (const Event& e : f.events)
+			event(e.name, "cpu", (e.begin - origin) * toUs, (e.end - e.begin) * toUs, e.thread);
+		for (const GpuSample& s : f.gpu)
+			event(s.name, "gpu", frameStart + s.beginMs * 1000.0, (s.endMs - s.beginMs) * 1000.0, gpuTrack);
+	}
+	out += "\n]}\n";
+	return out;
+}
+
+bool Profiler::WriteChromeTrace(const char* path) const
+{
+	FILE* fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	std::string json = ChromeTrace();
+	bool ok = fwrite(json.data(), 1, json.size(), fp) == json.size();
+	fclose(fp);
+	return ok;
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// CPU timestamps: the time stamp counter on x86, steady_clock nanoseconds elsewhere.
+// TicksPerSecond is calibrated against steady_clock while the program runs.
+namespace ProfileClock
+{
+	uint64_t Now();
+	double TicksPerSecond();
+}
+
+// One GPU scope of a finished frame, in milliseconds from the frame's first timestamp.
+struct GpuSample
+{
+	const char* name;
+	double beginMs;
+	double endMs;
+	uint32_t depth;
+};
+
+struct GpuFrame
+{
+	uint64_t frame;
+	std::vector<GpuSample> samples;
+};
+
+// Timestamp source for GPU scopes. Results arrive a few frames late; Collect
+// returns finished frames oldest first.
+class GpuTimer
+{
+public:
+	virtual ~GpuTimer() {}
+
+	virtual void BeginFrame(uint64_t frame) = 0;
+	// Returns the scope id for End, or -1 when the frame ran out of queries.
+	virtual int Begin(const char* name) = 0;
+	virtual void End(int scope) = 0;
+	virtual void EndFrame() = 0;
+	virtual bool Collect(GpuFrame& out) = 0;
+};
+
+// Stand-in for a GPU timer where there is no GPU: scopes are timed on the CPU
+// and handed back latency frames later, as a real timestamp ring would.
+class FakeGpuTimer : public GpuTimer
+{
+public:
+	explicit FakeGpuTimer(unsigned latency = 2) : m_latency(latency) {}
+
+	void BeginFrame(uint64_t frame) override;
+	int Begin(const char* name) override;
+	void End(int scope) override;
+	void EndFrame() override;
+	bool Collect(GpuFrame& out) override;
+
+private:
+	struct Scope
+	{
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+		uint32_t depth;
+	};
+	struct Frame
+	{
+		uint64_t frame;
+		uint64_t start;
+		std::vector<Scope> scopes;
+	};
+
+	unsigned m_latency;
+	uint32_t m_depth = 0;
+	Frame m_current;
+	std::deque<Frame> m_inFlight;
+};
+
+// Hierarchical frame profiler. CPU scopes may be opened on any thread; GPU scopes
+// only on the thread that owns the immediate context. Keeps the last historyFrames
+// frames for trace export and rolling percentiles per scope name.
+class Profiler
+{
+public:
+	explicit Profiler(GpuTimer* gpu = nullptr, size_t historyFrames = 240);
+
+	// gpu may be null; it is not owned.
+	void SetGpuTimer(GpuTimer* gpu) { m_gpu = gpu; }
+
+	void BeginFrame();
+	void EndFrame();
+
+	void BeginScope(const char* name);
+	void EndScope();
+	int BeginGpuScope(const char* name) { return m_gpu ? m_gpu->Begin(name) : -1; }
+	void EndGpuScope(int scope) { if (m_gpu && scope >= 0) m_gpu->End(scope); }
+
+	struct Stats
+	{
+		std::string name;
+		bool gpu;
+		size_t frames;			// frames in the window that had this scope
+		double meanMs;
+		double p50Ms;
+		double p95Ms;
+		double p99Ms;
+	};
+	// Per-frame totals of each scope over the history window, sorted by name.
+	std::vector<Stats> Summary() const;
+
+	// Chrome trace event format (chrome://tracing, Perfetto). GPU scopes are drawn
+	// on their own track, aligned to the start of the CPU frame they belong to.
+	std::string ChromeTrace() const;
+	bool WriteChromeTrace(const char* path) const;
+
+	uint64_t FrameIndex() const { return m_frame; }
+
+private:
+	struct Event
+	{
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+		uint32_t thread;
+		uint32_t depth;
+	};
+	struct FrameRecord
+	{
+		uint64_t frame;
+		uint64_t begin;
+		uint64_t end;
+		std::vector<Event> events;
+		std::vector<GpuSample> gpu;
+	};
+	struct Series
+	{
+		std::vector<double> values;		// ring of per-frame totals in ms
+		size_t next = 0;
+	};
+	typedef std::unordered_map<std::string, Series> SeriesMap;
+
+	void AddTotals(SeriesMap& series, const std::unordered_map<std::string, double>& totals);
+	void AddGpuFrame(const GpuFrame& frame);
+
+	GpuTimer* m_gpu;
+	size_t m_historyFrames;
+	uint64_t m_frame = 0;
+	uint64_t m_frameBegin = 0;
+
+	std::mutex m_lock;
+	std::vector<Event> m_events;		// closed scopes of the current frame
+	std::deque<FrameRecord> m_history;
+	SeriesMap m_cpuSeries;
+	SeriesMap m_gpuSeries;
+	GpuFrame m_gpuFrame;
+};
+
+// Times the enclosing block on the CPU.
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler& profiler, const char* name) : m_profiler(profiler) { profiler.BeginScope(name); }
+	~ProfileScope() { m_profiler.EndScope(); }
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	Profiler& m_profiler;
+};
+
+// Times the enclosing block on the CPU and on the GPU.
+class RenderProfileScope
+{
+public:
+	RenderProfileScope(Profiler& profiler, const char* name) :
+		m_profiler(profiler), m_gpuScope(profiler.BeginGpuScope(name)) { profiler.BeginScope(name); }
+	~RenderProfileScope() { m_profiler.EndScope(); m_profiler.EndGpuScope(m_gpuScope); }
+	RenderProfileScope(const RenderProfileScope&) = delete;
+	RenderProfileScope& operator=(const RenderProfileScope&) = delete;
+
+private:
+	Profiler& m_profiler;
+	int m_gpuScope;
+};
@@ -2,6 +2,8 @@
 #include "RModel.h"
 #include "FindMedia.h"
 #include "Utilities.h"
+#include "CubeMap.h"
+#include <DDSTextureLoader.h>
 
 RModel::RModel()
 {
@@ -40,6 +42,7 @@ void RModel::setTexture(ID3D11Device1* device, const wchar_t *path) {
 	DX::ThrowIfFailed(
 		device->CreateShaderResourceView(tex,
 			nullptr, &this->texture));
+	texturePath = path;
 }
 
 void RModel::setNormalMap(ID3D11Device1* device, const wchar_t *path) {
@@ -67,4 +70,46 @@ void RModel::setNormalMap(ID3D11Device1* device, const wchar_t *path) {
 	DX::ThrowIfFailed(
 		device->CreateShaderResourceView(tex,
 			nullptr, &this->normalMap));
-}
\ No newline at end of file
+	normalMapPath = path;
+}
+void RModel::setCubeMap(ID3D11Device1* device, const wchar_t *path) {
+	wchar_t buff[MAX_PATH];
+	DX::FindMediaFile(buff, MAX_PATH, path);
+
+	size_t length = wcslen(buff);
+	if (length > 4 && _wcsicmp(buff + length - 4, L".dds") == 0) {
+		// Cube maps authored as DDS carry their own faces and mips
+		DX::ThrowIfFailed(
+			DirectX::CreateDDSTextureFromFile(device, buff, nullptr, &this->texture));
+		texturePath = path;
+		return;
+	}
+
+	uint32_t width, height;
+	auto image = LoadBGRAImage(buff, width, height);
+	std::vector<uint32_t> faces;
+	uint32_t size = CubeMap::FromHorizontalCross(reinterpret_cast<const uint32_t*>(image.data()), width, height, faces);
+
+	D3D11_TEXTURE2D_DESC txtDesc = {};
+	txtDesc.Width = txtDesc.Height = size;
+	txtDesc.MipLevels = 1;
+	txtDesc.ArraySize = CubeFace_Count;
+	txtDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+	txtDesc.SampleDesc.Count = 1;
+	txtDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	txtDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	txtDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	D3D11_SUBRESOURCE_DATA initialData[CubeFace_Count] = {};
+	for (int face = 0; face < CubeFace_Count; face++) {
+		initialData[face].pSysMem = faces.data() + size_t(face) * size * size;
+		initialData[face].SysMemPitch = size * sizeof(uint32_t);
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> tex;
+	DX::ThrowIfFailed(
+		device->CreateTexture2D(&txtDesc, initialData, tex.GetAddressOf()));
+	DX::ThrowIfFailed(
+		device->CreateShaderResourceView(tex.Get(), nullptr, &this->texture));
+	texturePath = path;
+}
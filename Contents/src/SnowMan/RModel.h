@@ -1,6 +1,7 @@
 #pragma once
 #include "pch.h"
 #include <VertexTypes.h>
+#include "VertexCodec.h"
 
 struct MatrixBufferType
 {
@@ -29,6 +30,16 @@ struct Vertex
 	DirectX::XMFLOAT2 textureCoordinate;
 };
 
+// A coarser version of a model's mesh, in the model's vertex format
+struct RModelLod
+{
+	ID3D11Buffer* vertexBuffer;
+	ID3D11Buffer* indexBuffer;
+	UINT indexCount;
+	DXGI_FORMAT indexFormat;
+	VertexQuantization quantization;
+};
+
 class RModel
 {
 public:
@@ -38,13 +49,23 @@ public:
 	DirectX::XMMATRIX model;
 	DirectX::XMFLOAT4 color;
 	std::vector<DirectX::VertexPositionNormalTexture> vertices;
-	std::vector<uint16_t> indices;
+	std::vector<uint32_t> indices;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT;
+	VertexFormat vertexFormat = VertexFormat_Full;
+	VertexQuantization quantization;
 	ID3D11Buffer *vertexBuffer;
 	ID3D11Buffer *indexBuffer;
+	// Levels of detail after the mesh above, finest first; empty if it has none
+	std::vector<RModelLod> lods;
 	ID3D11ShaderResourceView* texture = nullptr;
 	ID3D11ShaderResourceView* normalMap = nullptr;
+	// Media paths the textures were loaded from, for hot reload
+	std::wstring texturePath;
+	std::wstring normalMapPath;
 
 	void setTexture(ID3D11Device1* device, const wchar_t *path);
 	void setNormalMap(ID3D11Device1* device, const wchar_t *path);
+	// A .dds cube map, or an image holding the faces as a horizontal cross
+	void setCubeMap(ID3D11Device1* device, const wchar_t *path);
 };
 
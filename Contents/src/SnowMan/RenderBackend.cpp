@@ -0,0 +1,575 @@
+#include "RenderBackend.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	struct NullBuffer
+	{
+		std::unique_ptr<uint8_t[]> data;
+		uint32_t bytes;
+	};
+
+	struct NullTexture
+	{
+		GpuTextureDesc desc;
+	};
+
+	NullBuffer* ToNull(GpuBuffer* buffer) { return reinterpret_cast<NullBuffer*>(buffer); }
+
+	size_t TextureBytes(const GpuTextureDesc& desc)
+	{
+		return size_t(desc.width) * desc.height * desc.bytesPerPixel;
+	}
+
+	// Reads what RecordingRenderBackend::Put wrote, in the same order.
+	class StreamReader
+	{
+	public:
+		StreamReader(const uint8_t* p, const uint8_t* end) : m_p(p), m_end(end) {}
+
+		bool Done() const { return m_p >= m_end; }
+
+		template <typename T>
+		T Get()
+		{
+			T value;
+			memcpy(&value, m_p, sizeof(T));
+			m_p += sizeof(T);
+			return value;
+		}
+
+		template <typename T>
+		const T* Array(uint32_t count)
+		{
+			m_array.resize(count * sizeof(T));
+			if (count)
+				memcpy(m_array.data(), m_p, count * sizeof(T));
+			m_p += count * sizeof(T);
+			return reinterpret_cast<const T*>(m_array.data());
+		}
+
+		const uint8_t* Bytes(uint32_t count)
+		{
+			const uint8_t* p = m_p;
+			m_p += count;
+			return p;
+		}
+
+	private:
+		const uint8_t* m_p;
+		const uint8_t* m_end;
+		std::vector<uint64_t> m_array;		// 8-byte aligned copy for pointer arrays
+	};
+}
+
+GpuBuffer* NullRenderBackend::CreateBuffer(const GpuBufferDesc& desc, const void* initialData)
+{
+	NullBuffer* buffer = new NullBuffer{ std::unique_ptr<uint8_t[]>(new uint8_t[desc.bytes ? desc.bytes : 1]), desc.bytes };
+	if (initialData)
+		memcpy(buffer->data.get(), initialData, desc.bytes);
+	return reinterpret_cast<GpuBuffer*>(buffer);
+}
+
+GpuTexture* NullRenderBackend::CreateTexture2D(const GpuTextureDesc& desc, const void*)
+{
+	return reinterpret_cast<GpuTexture*>(new NullTexture{ desc });
+}
+
+void NullRenderBackend::Release(GpuBuffer* buffer)
+{
+	delete ToNull(buffer);
+}
+
+void NullRenderBackend::Release(GpuTexture* texture)
+{
+	delete reinterpret_cast<NullTexture*>(texture);
+}
+
+void* NullRenderBackend::Map(GpuBuffer* buffer)
+{
+	return ToNull(buffer)->data.get();
+}
+
+uint64_t RenderStats::TotalCalls() const
+{
+	uint64_t total = 0;
+	for (uint64_t c : calls)
+		total += c;
+	return total;
+}
+
+const char* RenderStats::Name(GpuCommand command)
+{
+	static const char* names[GpuCommand_Count] = {
+		"CreateBuffer", "CreateTexture2D", "Release", "Map", "Unmap",
+		"IASetInputLayout", "IASetPrimitiveTopology", "IASetVertexBuffers", "IASetIndexBuffer",
+		"VSSetShader", "VSSetConstantBuffers", "VSSetShaderResources",
+		"PSSetShader", "PSSetConstantBuffers", "PSSetShaderResources", "PSSetSamplers",
+		"CSSetShader", "CSSetConstantBuffers", "CSSetShaderResources", "CSSetUnorderedAccessViews",
+		"OMSetRenderTargets", "OMSetDepthStencilState", "ClearRenderTarget", "ClearDepthStencil",
+		"DrawIndexed", "DrawIndexedInstanced", "Dispatch",
+	};
+	return command < GpuCommand_Count ? names[command] : "?";
+}
+
+RecordingRenderBackend::RecordingRenderBackend(RenderBackend* resources) :
+	m_resources(resources)
+{
+	if (!m_resources) {
+		m_null.reset(new NullRenderBackend());
+		m_resources = m_null.get();
+	}
+	Reset();
+}
+
+template <typename T>
+void RecordingRenderBackend::Put(const T& value)
+{
+	memcpy(Append(sizeof(T)), &value, sizeof(T));
+}
+
+// The stream vector only grows; m_streamBytes is how much of it holds commands.
+uint8_t* RecordingRenderBackend::Append(size_t bytes)
+{
+	if (m_streamBytes + bytes > m_stream.size())
+		m_stream.resize(std::max(m_stream.size() * 2, m_streamBytes + bytes + 4096));
+	uint8_t* p = m_stream.data() + m_streamBytes;
+	m_streamBytes += bytes;
+	return p;
+}
+
+void RecordingRenderBackend::Command(GpuCommand command)
+{
+	m_stats.calls[command]++;
+	Put(command);
+}
+
+void RecordingRenderBackend::Bind(GpuCommand command, uint32_t slot, const void* handle)
+{
+	if (slot >= BoundSlots)
+		return;
+	if (m_bound[command][slot] == handle)
+		m_stats.redundantCalls++;
+	m_bound[command][slot] = handle;
+}
+
+GpuBuffer* RecordingRenderBackend::CreateBuffer(const GpuBufferDesc& desc, const void* initialData)
+{
+	GpuBuffer* buffer = m_resources->CreateBuffer(desc, initialData);
+	m_stats.calls[GpuCommand_CreateBuffer]++;
+	if (initialData)
+		m_stats.createdBytes += desc.bytes;
+	m_bufferBytes[buffer] = desc.bytes;
+	return buffer;
+}
+
+GpuTexture* RecordingRenderBackend::CreateTexture2D(const GpuTextureDesc& desc, const void* initialData)
+{
+	GpuTexture* texture = m_resources->CreateTexture2D(desc, initialData);
+	m_stats.calls[GpuCommand_CreateTexture2D]++;
+	if (initialData)
+		m_stats.createdBytes += TextureBytes(desc);
+	return texture;
+}
+
+void RecordingRenderBackend::Release(GpuBuffer* buffer)
+{
+	m_stats.calls[GpuCommand_Release]++;
+	m_bufferBytes.erase(buffer);
+	m_resources->Release(buffer);
+}
+
+void RecordingRenderBackend::Release(GpuTexture* texture)
+{
+	m_stats.calls[GpuCommand_Release]++;
+	m_resources->Release(texture);
+}
+
+void* RecordingRenderBackend::Map(GpuBuffer* buffer)
+{
+	auto it = m_bufferBytes.find(buffer);
+	if (it == m_bufferBytes.end())
+		throw std::invalid_argument("RecordingRenderBackend::Map: buffer was not created by this backend");
+	m_stats.calls[GpuCommand_Map]++;
+	m_scratch.resize(it->second);
+	return m_scratch.data();
+}
+
+void RecordingRenderBackend::Unmap(GpuBuffer* buffer)
+{
+	uint32_t bytes = uint32_t(m_scratch.size());
+	Command(GpuCommand_Unmap);
+	Put(buffer);
+	Put(bytes);
+	if (bytes)
+		memcpy(Append(bytes), m_scratch.data(), bytes);
+	m_stats.mappedBytes += bytes;
+}
+
+void RecordingRenderBackend::IASetInputLayout(GpuInputLayout* layout)
+{
+	Command(GpuCommand_IASetInputLayout);
+	Put(layout);
+	Bind(GpuCommand_IASetInputLayout, 0, layout);
+}
+
+void RecordingRenderBackend::IASetPrimitiveTopology(GpuTopology topology)
+{
+	Command(GpuCommand_IASetPrimitiveTopology);
+	Put(topology);
+}
+
+void RecordingRenderBackend::IASetVertexBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers, const uint32_t* strides, const uint32_t* offsets)
+{
+	Command(GpuCommand_IASetVertexBuffers);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(buffers[i]);
+		Put(strides[i]);
+		Put(offsets[i]);
+		Bind(GpuCommand_IASetVertexBuffers, firstSlot + i, buffers[i]);
+	}
+}
+
+void RecordingRenderBackend::IASetIndexBuffer(GpuBuffer* buffer, GpuIndexFormat format, uint32_t offset)
+{
+	Command(GpuCommand_IASetIndexBuffer);
+	Put(buffer);
+	Put(format);
+	Put(offset);
+	Bind(GpuCommand_IASetIndexBuffer, 0, buffer);
+}
+
+void RecordingRenderBackend::VSSetShader(GpuVertexShader* shader)
+{
+	Command(GpuCommand_VSSetShader);
+	Put(shader);
+	Bind(GpuCommand_VSSetShader, 0, shader);
+}
+
+void RecordingRenderBackend::VSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers)
+{
+	Command(GpuCommand_VSSetConstantBuffers);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(buffers[i]);
+		Bind(GpuCommand_VSSetConstantBuffers, firstSlot + i, buffers[i]);
+	}
+}
+
+void RecordingRenderBackend::VSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures)
+{
+	Command(GpuCommand_VSSetShaderResources);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(textures[i]);
+		Bind(GpuCommand_VSSetShaderResources, firstSlot + i, textures[i]);
+	}
+}
+
+void RecordingRenderBackend::PSSetShader(GpuPixelShader* shader)
+{
+	Command(GpuCommand_PSSetShader);
+	Put(shader);
+	Bind(GpuCommand_PSSetShader, 0, shader);
+}
+
+void RecordingRenderBackend::PSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers)
+{
+	Command(GpuCommand_PSSetConstantBuffers);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(buffers[i]);
+		Bind(GpuCommand_PSSetConstantBuffers, firstSlot + i, buffers[i]);
+	}
+}
+
+void RecordingRenderBackend::PSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures)
+{
+	Command(GpuCommand_PSSetShaderResources);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(textures[i]);
+		Bind(GpuCommand_PSSetShaderResources, firstSlot + i, textures[i]);
+	}
+}
+
+void RecordingRenderBackend::PSSetSamplers(uint32_t firstSlot, uint32_t count, GpuSampler* const* samplers)
+{
+	Command(GpuCommand_PSSetSamplers);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(samplers[i]);
+		Bind(GpuCommand_PSSetSamplers, firstSlot + i, samplers[i]);
+	}
+}
+
+void RecordingRenderBackend::CSSetShader(GpuComputeShader* shader)
+{
+	Command(GpuCommand_CSSetShader);
+	Put(shader);
+	Bind(GpuCommand_CSSetShader, 0, shader);
+}
+
+void RecordingRenderBackend::CSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers)
+{
+	Command(GpuCommand_CSSetConstantBuffers);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(buffers[i]);
+		Bind(GpuCommand_CSSetConstantBuffers, firstSlot + i, buffers[i]);
+	}
+}
+
+void RecordingRenderBackend::CSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures)
+{
+	Command(GpuCommand_CSSetShaderResources);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(textures[i]);
+		Bind(GpuCommand_CSSetShaderResources, firstSlot + i, textures[i]);
+	}
+}
+
+void RecordingRenderBackend::CSSetUnorderedAccessViews(uint32_t firstSlot, uint32_t count, GpuUnorderedAccess* const* views)
+{
+	Command(GpuCommand_CSSetUnorderedAccessViews);
+	Put(firstSlot);
+	Put(count);
+	for (uint32_t i = 0; i < count; i++) {
+		Put(views[i]);
+		Bind(GpuCommand_CSSetUnorderedAccessViews, firstSlot + i, views[i]);
+	}
+}
+
+void RecordingRenderBackend::OMSetRenderTargets(GpuRenderTarget* target, GpuDepthTarget* depth)
+{
+	Command(GpuCommand_OMSetRenderTargets);
+	Put(target);
+	Put(depth);
+}
+
+void RecordingRenderBackend::OMSetDepthStencilState(GpuDepthState* state, uint32_t stencilRef)
+{
+	Command(GpuCommand_OMSetDepthStencilState);
+	Put(state);
+	Put(stencilRef);
+	Bind(GpuCommand_OMSetDepthStencilState, 0, state);
+}
+
+void RecordingRenderBackend::ClearRenderTarget(GpuRenderTarget* target, const float color[4])
+{
+	Command(GpuCommand_ClearRenderTarget);
+	Put(target);
+	for (int i = 0; i < 4; i++)
+		Put(color[i]);
+}
+
+void RecordingRenderBackend::ClearDepthStencil(GpuDepthTarget* depth, uint32_t clearFlags, float depthValue, uint8_t stencilValue)
+{
+	Command(GpuCommand_ClearDepthStencil);
+	Put(depth);
+	Put(clearFlags);
+	Put(depthValue);
+	Put(stencilValue);
+}
+
+void RecordingRenderBackend::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	Command(GpuCommand_DrawIndexed);
+	Put(indexCount);
+	Put(startIndex);
+	Put(baseVertex);
+	m_stats.draws++;
+	m_stats.indices += indexCount;
+}
+
+void RecordingRenderBackend::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	Command(GpuCommand_DrawIndexedInstanced);
+	Put(indexCount);
+	Put(instanceCount);
+	Put(startIndex);
+	Put(baseVertex);
+	Put(startInstance);
+	m_stats.draws++;
+	m_stats.indices += uint64_t(indexCount) * instanceCount;
+}
+
+void RecordingRenderBackend::Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+{
+	Command(GpuCommand_Dispatch);
+	Put(groupsX);
+	Put(groupsY);
+	Put(groupsZ);
+	m_stats.dispatches++;
+	m_stats.threadGroups += uint64_t(groupsX) * groupsY * groupsZ;
+}
+
+void RecordingRenderBackend::Reset()
+{
+	m_streamBytes = 0;
+	memset(m_bound, 0, sizeof(m_bound));
+}
+
+void RecordingRenderBackend::Replay(RenderBackend& target) const
+{
+	StreamReader in(m_stream.data(), m_stream.data() + m_streamBytes);
+	while (!in.Done()) {
+		GpuCommand command = in.Get<GpuCommand>();
+		switch (command) {
+		case GpuCommand_Unmap: {
+			GpuBuffer* buffer = in.Get<GpuBuffer*>();
+			uint32_t bytes = in.Get<uint32_t>();
+			void* p = target.Map(buffer);
+			memcpy(p, in.Bytes(bytes), bytes);
+			target.Unmap(buffer);
+			break;
+		}
+		case GpuCommand_IASetInputLayout:
+			target.IASetInputLayout(in.Get<GpuInputLayout*>());
+			break;
+		case GpuCommand_IASetPrimitiveTopology:
+			target.IASetPrimitiveTopology(in.Get<GpuTopology>());
+			break;
+		case GpuCommand_IASetVertexBuffers: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			GpuBuffer* buffers[BoundSlots];
+			uint32_t strides[BoundSlots], offsets[BoundSlots];
+			for (uint32_t i = 0; i < count; i++) {
+				GpuBuffer* buffer = in.Get<GpuBuffer*>();
+				uint32_t stride = in.Get<uint32_t>();
+				uint32_t offset = in.Get<uint32_t>();
+				if (i < BoundSlots) {
+					buffers[i] = buffer;
+					strides[i] = stride;
+					offsets[i] = offset;
+				}
+			}
+			target.IASetVertexBuffers(first, count < BoundSlots ? count : BoundSlots, buffers, strides, offsets);
+			break;
+		}
+		case GpuCommand_IASetIndexBuffer: {
+			GpuBuffer* buffer = in.Get<GpuBuffer*>();
+			GpuIndexFormat format = in.Get<GpuIndexFormat>();
+			target.IASetIndexBuffer(buffer, format, in.Get<uint32_t>());
+			break;
+		}
+		case GpuCommand_VSSetShader:
+			target.VSSetShader(in.Get<GpuVertexShader*>());
+			break;
+		case GpuCommand_VSSetConstantBuffers: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			target.VSSetConstantBuffers(first, count, in.Array<GpuBuffer*>(count));
+			break;
+		}
+		case GpuCommand_VSSetShaderResources: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			target.VSSetShaderResources(first, count, in.Array<GpuTexture*>(count));
+			break;
+		}
+		case GpuCommand_PSSetShader:
+			target.PSSetShader(in.Get<GpuPixelShader*>());
+			break;
+		case GpuCommand_PSSetConstantBuffers: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			target.PSSetConstantBuffers(first, count, in.Array<GpuBuffer*>(count));
+			break;
+		}
+		case GpuCommand_PSSetShaderResources: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			target.PSSetShaderResources(first, count, in.Array<GpuTexture*>(count));
+			break;
+		}
+		case GpuCommand_PSSetSamplers: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			target.PSSetSamplers(first, count, in.Array<GpuSampler*>(count));
+			break;
+		}
+		case GpuCommand_CSSetShader:
+			target.CSSetShader(in.Get<GpuComputeShader*>());
+			break;
+		case GpuCommand_CSSetConstantBuffers: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			target.CSSetConstantBuffers(first, count, in.Array<GpuBuffer*>(count));
+			break;
+		}
+		case GpuCommand_CSSetShaderResources: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			target.CSSetShaderResources(first, count, in.Array<GpuTexture*>(count));
+			break;
+		}
+		case GpuCommand_CSSetUnorderedAccessViews: {
+			uint32_t first = in.Get<uint32_t>();
+			uint32_t count = in.Get<uint32_t>();
+			target.CSSetUnorderedAccessViews(first, count, in.Array<GpuUnorderedAccess*>(count));
+			break;
+		}
+		case GpuCommand_OMSetRenderTargets: {
+			GpuRenderTarget* rt = in.Get<GpuRenderTarget*>();
+			target.OMSetRenderTargets(rt, in.Get<GpuDepthTarget*>());
+			break;
+		}
+		case GpuCommand_OMSetDepthStencilState: {
+			GpuDepthState* state = in.Get<GpuDepthState*>();
+			target.OMSetDepthStencilState(state, in.Get<uint32_t>());
+			break;
+		}
+		case GpuCommand_ClearRenderTarget: {
+			GpuRenderTarget* rt = in.Get<GpuRenderTarget*>();
+			float color[4];
+			for (float& c : color)
+				c = in.Get<float>();
+			target.ClearRenderTarget(rt, color);
+			break;
+		}
+		case GpuCommand_ClearDepthStencil: {
+			GpuDepthTarget* depth = in.Get<GpuDepthTarget*>();
+			uint32_t flags = in.Get<uint32_t>();
+			float value = in.Get<float>();
+			target.ClearDepthStencil(depth, flags, value, in.Get<uint8_t>());
+			break;
+		}
+		case GpuCommand_DrawIndexed: {
+			uint32_t count = in.Get<uint32_t>();
+			uint32_t start = in.Get<uint32_t>();
+			target.DrawIndexed(count, start, in.Get<int32_t>());
+			break;
+		}
+		case GpuCommand_DrawIndexedInstanced: {
+			uint32_t count = in.Get<uint32_t>();
+			uint32_t instances = in.Get<uint32_t>();
+			uint32_t start = in.Get<uint32_t>();
+			int32_t base = in.Get<int32_t>();
+			target.DrawIndexedInstanced(count, instances, start, base, in.Get<uint32_t>());
+			break;
+		}
+		case GpuCommand_Dispatch: {
+			uint32_t x = in.Get<uint32_t>();
+			uint32_t y = in.Get<uint32_t>();
+			target.Dispatch(x, y, in.Get<uint32_t>());
+			break;
+		}
+		default:
+			throw std::runtime_error("RecordingRenderBackend::Replay: corrupt command stream");
+		}
+	}
+}
@@ -0,0 +1,265 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Opaque resource handles. Each backend decides what they point at; the D3D11
+// backend hands out the D3D11 interface pointers themselves.
+struct GpuBuffer;
+struct GpuTexture;			// a sampled texture (shader resource view in D3D11)
+struct GpuSampler;
+struct GpuInputLayout;
+struct GpuVertexShader;
+struct GpuPixelShader;
+struct GpuComputeShader;
+struct GpuUnorderedAccess;	// an unordered access view in D3D11
+struct GpuRenderTarget;
+struct GpuDepthTarget;
+struct GpuDepthState;		// depth-stencil state object
+
+enum GpuBindFlags : uint32_t
+{
+	GpuBind_VertexBuffer = 1,
+	GpuBind_IndexBuffer = 2,
+	GpuBind_ConstantBuffer = 4,
+	GpuBind_ShaderResource = 8,
+};
+
+enum GpuUsage : uint32_t
+{
+	GpuUsage_Immutable,
+	GpuUsage_Default,
+	GpuUsage_Dynamic,		// CPU written through Map
+};
+
+enum GpuIndexFormat : uint32_t
+{
+	GpuIndex_16,
+	GpuIndex_32,
+};
+
+enum GpuTopology : uint32_t
+{
+	GpuTopology_TriangleList,
+	GpuTopology_TriangleStrip,
+	GpuTopology_LineList,
+	GpuTopology_PointList,
+};
+
+enum GpuClearFlags : uint32_t
+{
+	GpuClear_Depth = 1,
+	GpuClear_Stencil = 2,
+};
+
+struct GpuBufferDesc
+{
+	uint32_t bytes;
+	uint32_t bindFlags;		// GpuBind_*
+	GpuUsage usage;
+};
+
+struct GpuTextureDesc
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;		// DXGI_FORMAT value
+	uint32_t bytesPerPixel;
+	GpuUsage usage;
+};
+
+// The part of the D3D11 device and immediate context the renderer uses: buffer and
+// texture creation, Map/Unmap, the IA/VS/PS/CS/OM setters, clears, indexed draws and
+// dispatches.
+// Shaders, input layouts, samplers and targets are created by the D3D11 code and
+// passed in as handles. Failures throw.
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+
+	// initialData may be null for default and dynamic resources.
+	virtual GpuBuffer* CreateBuffer(const GpuBufferDesc& desc, const void* initialData) = 0;
+	// One mip level; initialData rows are width * bytesPerPixel bytes apart.
+	virtual GpuTexture* CreateTexture2D(const GpuTextureDesc& desc, const void* initialData) = 0;
+	virtual void Release(GpuBuffer* buffer) = 0;
+	virtual void Release(GpuTexture* texture) = 0;
+
+	// Write-discard of a whole dynamic buffer.
+	virtual void* Map(GpuBuffer* buffer) = 0;
+	virtual void Unmap(GpuBuffer* buffer) = 0;
+
+	virtual void IASetInputLayout(GpuInputLayout* layout) = 0;
+	virtual void IASetPrimitiveTopology(GpuTopology topology) = 0;
+	virtual void IASetVertexBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers, const uint32_t* strides, const uint32_t* offsets) = 0;
+	virtual void IASetIndexBuffer(GpuBuffer* buffer, GpuIndexFormat format, uint32_t offset) = 0;
+	virtual void VSSetShader(GpuVertexShader* shader) = 0;
+	virtual void VSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) = 0;
+	virtual void VSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) = 0;
+	virtual void PSSetShader(GpuPixelShader* shader) = 0;
+	virtual void PSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) = 0;
+	virtual void PSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) = 0;
+	virtual void PSSetSamplers(uint32_t firstSlot, uint32_t count, GpuSampler* const* samplers) = 0;
+	virtual void CSSetShader(GpuComputeShader* shader) = 0;
+	virtual void CSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) = 0;
+	virtual void CSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) = 0;
+	virtual void CSSetUnorderedAccessViews(uint32_t firstSlot, uint32_t count, GpuUnorderedAccess* const* views) = 0;
+	virtual void OMSetRenderTargets(GpuRenderTarget* target, GpuDepthTarget* depth) = 0;
+	// Null restores the default: less-than test with depth writes.
+	virtual void OMSetDepthStencilState(GpuDepthState* state, uint32_t stencilRef) = 0;
+	virtual void ClearRenderTarget(GpuRenderTarget* target, const float color[4]) = 0;
+	virtual void ClearDepthStencil(GpuDepthTarget* depth, uint32_t clearFlags, float depthValue, uint8_t stencilValue) = 0;
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+	virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) = 0;
+	virtual void Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) = 0;
+};
+
+// Does nothing but keep buffer memory, so Map hands back writable storage. Lets the
+// CPU side of rendering run where there is no GPU.
+class NullRenderBackend : public RenderBackend
+{
+public:
+	GpuBuffer* CreateBuffer(const GpuBufferDesc& desc, const void* initialData) override;
+	GpuTexture* CreateTexture2D(const GpuTextureDesc& desc, const void* initialData) override;
+	void Release(GpuBuffer* buffer) override;
+	void Release(GpuTexture* texture) override;
+	void* Map(GpuBuffer* buffer) override;
+	void Unmap(GpuBuffer*) override {}
+	void IASetInputLayout(GpuInputLayout*) override {}
+	void IASetPrimitiveTopology(GpuTopology) override {}
+	void IASetVertexBuffers(uint32_t, uint32_t, GpuBuffer* const*, const uint32_t*, const uint32_t*) override {}
+	void IASetIndexBuffer(GpuBuffer*, GpuIndexFormat, uint32_t) override {}
+	void VSSetShader(GpuVertexShader*) override {}
+	void VSSetConstantBuffers(uint32_t, uint32_t, GpuBuffer* const*) override {}
+	void VSSetShaderResources(uint32_t, uint32_t, GpuTexture* const*) override {}
+	void PSSetShader(GpuPixelShader*) override {}
+	void PSSetConstantBuffers(uint32_t, uint32_t, GpuBuffer* const*) override {}
+	void PSSetShaderResources(uint32_t, uint32_t, GpuTexture* const*) override {}
+	void PSSetSamplers(uint32_t, uint32_t, GpuSampler* const*) override {}
+	void CSSetShader(GpuComputeShader*) override {}
+	void CSSetConstantBuffers(uint32_t, uint32_t, GpuBuffer* const*) override {}
+	void CSSetShaderResources(uint32_t, uint32_t, GpuTexture* const*) override {}
+	void CSSetUnorderedAccessViews(uint32_t, uint32_t, GpuUnorderedAccess* const*) override {}
+	void OMSetRenderTargets(GpuRenderTarget*, GpuDepthTarget*) override {}
+	void OMSetDepthStencilState(GpuDepthState*, uint32_t) override {}
+	void ClearRenderTarget(GpuRenderTarget*, const float*) override {}
+	void ClearDepthStencil(GpuDepthTarget*, uint32_t, float, uint8_t) override {}
+	void DrawIndexed(uint32_t, uint32_t, int32_t) override {}
+	void DrawIndexedInstanced(uint32_t, uint32_t, uint32_t, int32_t, uint32_t) override {}
+	void Dispatch(uint32_t, uint32_t, uint32_t) override {}
+};
+
+enum GpuCommand : uint32_t
+{
+	GpuCommand_CreateBuffer,
+	GpuCommand_CreateTexture2D,
+	GpuCommand_Release,
+	GpuCommand_Map,
+	GpuCommand_Unmap,
+	GpuCommand_IASetInputLayout,
+	GpuCommand_IASetPrimitiveTopology,
+	GpuCommand_IASetVertexBuffers,
+	GpuCommand_IASetIndexBuffer,
+	GpuCommand_VSSetShader,
+	GpuCommand_VSSetConstantBuffers,
+	GpuCommand_VSSetShaderResources,
+	GpuCommand_PSSetShader,
+	GpuCommand_PSSetConstantBuffers,
+	GpuCommand_PSSetShaderResources,
+	GpuCommand_PSSetSamplers,
+	GpuCommand_CSSetShader,
+	GpuCommand_CSSetConstantBuffers,
+	GpuCommand_CSSetShaderResources,
+	GpuCommand_CSSetUnorderedAccessViews,
+	GpuCommand_OMSetRenderTargets,
+	GpuCommand_OMSetDepthStencilState,
+	GpuCommand_ClearRenderTarget,
+	GpuCommand_ClearDepthStencil,
+	GpuCommand_DrawIndexed,
+	GpuCommand_DrawIndexedInstanced,
+	GpuCommand_Dispatch,
+	GpuCommand_Count
+};
+
+struct RenderStats
+{
+	uint64_t calls[GpuCommand_Count] = {};
+	uint64_t redundantCalls = 0;		// setters that rebound what was already bound
+	uint64_t createdBytes = 0;			// initial data of created buffers and textures
+	uint64_t mappedBytes = 0;			// bytes written through Map
+	uint64_t draws = 0;
+	uint64_t indices = 0;				// indices submitted, times instances
+	uint64_t dispatches = 0;
+	uint64_t threadGroups = 0;
+
+	uint64_t TotalCalls() const;
+	static const char* Name(GpuCommand command);
+};
+
+// Records context calls into a command stream instead of executing them, counting
+// calls and bytes as it goes. Resources are created by the given backend (a null one
+// when there is none) so their handles are valid for Replay on that backend. Map
+// returns scratch memory; Unmap copies it into the stream.
+class RecordingRenderBackend : public RenderBackend
+{
+public:
+	// resources is not owned.
+	explicit RecordingRenderBackend(RenderBackend* resources = nullptr);
+
+	GpuBuffer* CreateBuffer(const GpuBufferDesc& desc, const void* initialData) override;
+	GpuTexture* CreateTexture2D(const GpuTextureDesc& desc, const void* initialData) override;
+	void Release(GpuBuffer* buffer) override;
+	void Release(GpuTexture* texture) override;
+	void* Map(GpuBuffer* buffer) override;
+	void Unmap(GpuBuffer* buffer) override;
+	void IASetInputLayout(GpuInputLayout* layout) override;
+	void IASetPrimitiveTopology(GpuTopology topology) override;
+	void IASetVertexBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers, const uint32_t* strides, const uint32_t* offsets) override;
+	void IASetIndexBuffer(GpuBuffer* buffer, GpuIndexFormat format, uint32_t offset) override;
+	void VSSetShader(GpuVertexShader* shader) override;
+	void VSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) override;
+	void VSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) override;
+	void PSSetShader(GpuPixelShader* shader) override;
+	void PSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) override;
+	void PSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) override;
+	void PSSetSamplers(uint32_t firstSlot, uint32_t count, GpuSampler* const* samplers) override;
+	void CSSetShader(GpuComputeShader* shader) override;
+	void CSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) override;
+	void CSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) override;
+	void CSSetUnorderedAccessViews(uint32_t firstSlot, uint32_t count, GpuUnorderedAccess* const* views) override;
+	void OMSetRenderTargets(GpuRenderTarget* target, GpuDepthTarget* depth) override;
+	void OMSetDepthStencilState(GpuDepthState* state, uint32_t stencilRef) override;
+	void ClearRenderTarget(GpuRenderTarget* target, const float color[4]) override;
+	void ClearDepthStencil(GpuDepthTarget* depth, uint32_t clearFlags, float depthValue, uint8_t stencilValue) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+	void Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) override;
+
+	// Executes the recorded context calls on target, which must own the resources.
+	void Replay(RenderBackend& target) const;
+	// Drops the stream and the bound state; stats keep accumulating until ResetStats.
+	void Reset();
+	void ResetStats() { m_stats = RenderStats(); }
+	const RenderStats& Stats() const { return m_stats; }
+	size_t StreamBytes() const { return m_streamBytes; }
+
+private:
+	template <typename T>
+	void Put(const T& value);
+	uint8_t* Append(size_t bytes);
+	void Command(GpuCommand command);
+	// Counts a rebinding of slot when it already holds handle, then stores handle.
+	void Bind(GpuCommand command, uint32_t slot, const void* handle);
+
+	RenderBackend* m_resources;
+	std::unique_ptr<NullRenderBackend> m_null;
+	std::unordered_map<GpuBuffer*, uint32_t> m_bufferBytes;
+	std::vector<uint8_t> m_scratch;
+	std::vector<uint8_t> m_stream;
+	size_t m_streamBytes = 0;
+	static const uint32_t BoundSlots = 16;
+	const void* m_bound[GpuCommand_Count][BoundSlots];
+	RenderStats m_stats;
+};
@@ -0,0 +1,213 @@
+#include "pch.h"
+#include "RenderBackendD3D11.h"
+
+namespace
+{
+	ID3D11Buffer* ToD3D(GpuBuffer* p) { return reinterpret_cast<ID3D11Buffer*>(p); }
+	ID3D11ShaderResourceView* ToD3D(GpuTexture* p) { return reinterpret_cast<ID3D11ShaderResourceView*>(p); }
+
+	template <typename T, typename Handle>
+	T* const* ToD3DArray(Handle* const* handles)
+	{
+		return reinterpret_cast<T* const*>(handles);
+	}
+
+	D3D11_USAGE Usage(GpuUsage usage)
+	{
+		switch (usage) {
+		case GpuUsage_Immutable: return D3D11_USAGE_IMMUTABLE;
+		case GpuUsage_Dynamic: return D3D11_USAGE_DYNAMIC;
+		default: return D3D11_USAGE_DEFAULT;
+		}
+	}
+
+	UINT BindFlags(uint32_t flags)
+	{
+		UINT bind = 0;
+		if (flags & GpuBind_VertexBuffer) bind |= D3D11_BIND_VERTEX_BUFFER;
+		if (flags & GpuBind_IndexBuffer) bind |= D3D11_BIND_INDEX_BUFFER;
+		if (flags & GpuBind_ConstantBuffer) bind |= D3D11_BIND_CONSTANT_BUFFER;
+		if (flags & GpuBind_ShaderResource) bind |= D3D11_BIND_SHADER_RESOURCE;
+		return bind;
+	}
+}
+
+GpuBuffer* D3D11RenderBackend::CreateBuffer(const GpuBufferDesc& desc, const void* initialData)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = desc.bytes;
+	bufferDesc.Usage = Usage(desc.usage);
+	bufferDesc.BindFlags = BindFlags(desc.bindFlags);
+	bufferDesc.CPUAccessFlags = desc.usage == GpuUsage_Dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = initialData;
+
+	ID3D11Buffer* buffer;
+	DX::ThrowIfFailed(m_device->CreateBuffer(&bufferDesc, initialData ? &data : nullptr, &buffer));
+	return ToGpu(buffer);
+}
+
+GpuTexture* D3D11RenderBackend::CreateTexture2D(const GpuTextureDesc& desc, const void* initialData)
+{
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = desc.width;
+	textureDesc.Height = desc.height;
+	textureDesc.MipLevels = textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT(desc.format);
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = Usage(desc.usage);
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.CPUAccessFlags = desc.usage == GpuUsage_Dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = initialData;
+	data.SysMemPitch = desc.width * desc.bytesPerPixel;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	DX::ThrowIfFailed(m_device->CreateTexture2D(&textureDesc, initialData ? &data : nullptr, texture.GetAddressOf()));
+	// The view keeps the texture alive.
+	ID3D11ShaderResourceView* view;
+	DX::ThrowIfFailed(m_device->CreateShaderResourceView(texture.Get(), nullptr, &view));
+	return ToGpu(view);
+}
+
+void D3D11RenderBackend::Release(GpuBuffer* buffer)
+{
+	if (buffer)
+		ToD3D(buffer)->Release();
+}
+
+void D3D11RenderBackend::Release(GpuTexture* texture)
+{
+	if (texture)
+		ToD3D(texture)->Release();
+}
+
+void* D3D11RenderBackend::Map(GpuBuffer* buffer)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(m_context->Map(ToD3D(buffer), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	return mapped.pData;
+}
+
+void D3D11RenderBackend::Unmap(GpuBuffer* buffer)
+{
+	m_context->Unmap(ToD3D(buffer), 0);
+}
+
+void D3D11RenderBackend::IASetInputLayout(GpuInputLayout* layout)
+{
+	m_context->IASetInputLayout(reinterpret_cast<ID3D11InputLayout*>(layout));
+}
+
+void D3D11RenderBackend::IASetPrimitiveTopology(GpuTopology topology)
+{
+	static const D3D11_PRIMITIVE_TOPOLOGY topologies[] = {
+		D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST,
+		D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP,
+		D3D11_PRIMITIVE_TOPOLOGY_LINELIST,
+		D3D11_PRIMITIVE_TOPOLOGY_POINTLIST,
+	};
+	m_context->IASetPrimitiveTopology(topologies[topology]);
+}
+
+void D3D11RenderBackend::IASetVertexBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers, const uint32_t* strides, const uint32_t* offsets)
+{
+	m_context->IASetVertexBuffers(firstSlot, count, ToD3DArray<ID3D11Buffer>(buffers), strides, offsets);
+}
+
+void D3D11RenderBackend::IASetIndexBuffer(GpuBuffer* buffer, GpuIndexFormat format, uint32_t offset)
+{
+	m_context->IASetIndexBuffer(ToD3D(buffer), format == GpuIndex_32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT, offset);
+}
+
+void D3D11RenderBackend::VSSetShader(GpuVertexShader* shader)
+{
+	m_context->VSSetShader(reinterpret_cast<ID3D11VertexShader*>(shader), nullptr, 0);
+}
+
+void D3D11RenderBackend::VSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers)
+{
+	m_context->VSSetConstantBuffers(firstSlot, count, ToD3DArray<ID3D11Buffer>(buffers));
+}
+
+void D3D11RenderBackend::VSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures)
+{
+	m_context->VSSetShaderResources(firstSlot, count, ToD3DArray<ID3D11ShaderResourceView>(textures));
+}
+
+void D3D11RenderBackend::PSSetShader(GpuPixelShader* shader)
+{
+	m_context->PSSetShader(reinterpret_cast<ID3D11PixelShader*>(shader), nullptr, 0);
+}
+
+void D3D11RenderBackend::PSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers)
+{
+	m_context->PSSetConstantBuffers(firstSlot, count, ToD3DArray<ID3D11Buffer>(buffers));
+}
+
+void D3D11RenderBackend::PSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures)
+{
+	m_context->PSSetShaderResources(firstSlot, count, ToD3DArray<ID3D11ShaderResourceView>(textures));
+}
+
+void D3D11RenderBackend::PSSetSamplers(uint32_t firstSlot, uint32_t count, GpuSampler* const* samplers)
+{
+	m_context->PSSetSamplers(firstSlot, count, ToD3DArray<ID3D11SamplerState>(samplers));
+}
+
+void D3D11RenderBackend::CSSetShader(GpuComputeShader* shader)
+{
+	m_context->CSSetShader(reinterpret_cast<ID3D11ComputeShader*>(shader), nullptr, 0);
+}
+
+void D3D11RenderBackend::CSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers)
+{
+	m_context->CSSetConstantBuffers(firstSlot, count, ToD3DArray<ID3D11Buffer>(buffers));
+}
+
+void D3D11RenderBackend::CSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures)
+{
+	m_context->CSSetShaderResources(firstSlot, count, ToD3DArray<ID3D11ShaderResourceView>(textures));
+}
+
+void D3D11RenderBackend::CSSetUnorderedAccessViews(uint32_t firstSlot, uint32_t count, GpuUnorderedAccess* const* views)
+{
+	m_context->CSSetUnorderedAccessViews(firstSlot, count, ToD3DArray<ID3D11UnorderedAccessView>(views), nullptr);
+}
+
+void D3D11RenderBackend::OMSetRenderTargets(GpuRenderTarget* target, GpuDepthTarget* depth)
+{
+	ID3D11RenderTargetView* view = reinterpret_cast<ID3D11RenderTargetView*>(target);
+	m_context->OMSetRenderTargets(view ? 1 : 0, view ? &view : nullptr, reinterpret_cast<ID3D11DepthStencilView*>(depth));
+}
+
+void D3D11RenderBackend::OMSetDepthStencilState(GpuDepthState* state, uint32_t stencilRef)
+{
+	m_context->OMSetDepthStencilState(reinterpret_cast<ID3D11DepthStencilState*>(state), stencilRef);
+}
+
+void D3D11RenderBackend::ClearRenderTarget(GpuRenderTarget* target, const float color[4])
+{
+	m_context->ClearRenderTargetView(reinterpret_cast<ID3D11RenderTargetView*>(target), color);
+}
+
+void D3D11RenderBackend::ClearDepthStencil(GpuDepthTarget* depth, uint32_t clearFlags, float depthValue, uint8_t stencilValue)
+{
+	UINT flags = ((clearFlags & GpuClear_Depth) ? D3D11_CLEAR_DEPTH : 0) | ((clearFlags & GpuClear_Stencil) ? D3D11_CLEAR_STENCIL : 0);
+	m_context->ClearDepthStencilView(reinterpret_cast<ID3D11DepthStencilView*>(depth), flags, depthValue, stencilValue);
+}
+
+void D3D11RenderBackend::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	m_context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderBackend::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	m_context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D11RenderBackend::Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+{
+	m_context->Dispatch(groupsX, groupsY, groupsZ);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "pch.h"
+#include "RenderBackend.h"
+
+// Handles of the D3D11 backend are the D3D11 interface pointers, so resources
+// created directly on the device can be passed through the backend as they are.
+inline GpuBuffer* ToGpu(ID3D11Buffer* p) { return reinterpret_cast<GpuBuffer*>(p); }
+inline GpuTexture* ToGpu(ID3D11ShaderResourceView* p) { return reinterpret_cast<GpuTexture*>(p); }
+inline GpuSampler* ToGpu(ID3D11SamplerState* p) { return reinterpret_cast<GpuSampler*>(p); }
+inline GpuInputLayout* ToGpu(ID3D11InputLayout* p) { return reinterpret_cast<GpuInputLayout*>(p); }
+inline GpuVertexShader* ToGpu(ID3D11VertexShader* p) { return reinterpret_cast<GpuVertexShader*>(p); }
+inline GpuPixelShader* ToGpu(ID3D11PixelShader* p) { return reinterpret_cast<GpuPixelShader*>(p); }
+inline GpuComputeShader* ToGpu(ID3D11ComputeShader* p) { return reinterpret_cast<GpuComputeShader*>(p); }
+inline GpuUnorderedAccess* ToGpu(ID3D11UnorderedAccessView* p) { return reinterpret_cast<GpuUnorderedAccess*>(p); }
+inline GpuRenderTarget* ToGpu(ID3D11RenderTargetView* p) { return reinterpret_cast<GpuRenderTarget*>(p); }
+inline GpuDepthTarget* ToGpu(ID3D11DepthStencilView* p) { return reinterpret_cast<GpuDepthTarget*>(p); }
+inline GpuDepthState* ToGpu(ID3D11DepthStencilState* p) { return reinterpret_cast<GpuDepthState*>(p); }
+inline GpuIndexFormat ToGpu(DXGI_FORMAT format) { return format == DXGI_FORMAT_R32_UINT ? GpuIndex_32 : GpuIndex_16; }
+
+// Forwards to an ID3D11Device and its immediate context.
+class D3D11RenderBackend : public RenderBackend
+{
+public:
+	D3D11RenderBackend(ID3D11Device* device, ID3D11DeviceContext* context) : m_device(device), m_context(context) {}
+
+	GpuBuffer* CreateBuffer(const GpuBufferDesc& desc, const void* initialData) override;
+	GpuTexture* CreateTexture2D(const GpuTextureDesc& desc, const void* initialData) override;
+	void Release(GpuBuffer* buffer) override;
+	void Release(GpuTexture* texture) override;
+	void* Map(GpuBuffer* buffer) override;
+	void Unmap(GpuBuffer* buffer) override;
+	void IASetInputLayout(GpuInputLayout* layout) override;
+	void IASetPrimitiveTopology(GpuTopology topology) override;
+	void IASetVertexBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers, const uint32_t* strides, const uint32_t* offsets) override;
+	void IASetIndexBuffer(GpuBuffer* buffer, GpuIndexFormat format, uint32_t offset) override;
+	void VSSetShader(GpuVertexShader* shader) override;
+	void VSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) override;
+	void VSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) override;
+	void PSSetShader(GpuPixelShader* shader) override;
+	void PSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) override;
+	void PSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) override;
+	void PSSetSamplers(uint32_t firstSlot, uint32_t count, GpuSampler* const* samplers) override;
+	void CSSetShader(GpuComputeShader* shader) override;
+	void CSSetConstantBuffers(uint32_t firstSlot, uint32_t count, GpuBuffer* const* buffers) override;
+	void CSSetShaderResources(uint32_t firstSlot, uint32_t count, GpuTexture* const* textures) override;
+	void CSSetUnorderedAccessViews(uint32_t firstSlot, uint32_t count, GpuUnorderedAccess* const* views) override;
+	void OMSetRenderTargets(GpuRenderTarget* target, GpuDepthTarget* depth) override;
+	void OMSetDepthStencilState(GpuDepthState* state, uint32_t stencilRef) override;
+	void ClearRenderTarget(GpuRenderTarget* target, const float color[4]) override;
+	void ClearDepthStencil(GpuDepthTarget* depth, uint32_t clearFlags, float depthValue, uint8_t stencilValue) override;
+	void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) override;
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) override;
+	void Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) override;
+
+private:
+	ID3D11Device* m_device;
+	ID3D11DeviceContext* m_context;
+};
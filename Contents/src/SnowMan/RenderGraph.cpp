@@ -0,0 +1,244 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <cstring>
+
+const uint32_t RenderGraph::NoPass;
+const uint32_t RenderGraph::Slots;
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_accesses.clear();
+	m_order.clear();
+	m_unbinds.clear();
+	m_pool.Reset();
+	m_stats = RenderGraphStats();
+}
+
+uint32_t RenderGraph::AddResource(const char* name, uintptr_t handle, uint32_t transient)
+{
+	m_resources.push_back({ name, handle, transient });
+	return uint32_t(m_resources.size() - 1);
+}
+
+uint32_t RenderGraph::Import(const char* name, GpuTexture* view)
+{
+	return AddResource(name, reinterpret_cast<uintptr_t>(view), RenderTargetPool::NoTarget);
+}
+
+uint32_t RenderGraph::Import(const char* name, GpuRenderTarget* target)
+{
+	return AddResource(name, reinterpret_cast<uintptr_t>(target), RenderTargetPool::NoTarget);
+}
+
+uint32_t RenderGraph::Import(const char* name, GpuDepthTarget* depth)
+{
+	return AddResource(name, reinterpret_cast<uintptr_t>(depth), RenderTargetPool::NoTarget);
+}
+
+uint32_t RenderGraph::CreateTransient(const char* name, const RenderTargetDesc& desc)
+{
+	return AddResource(name, 0, m_pool.AddTarget(desc));
+}
+
+uint32_t RenderGraph::AddPass(const char* name, ExecuteFunction execute)
+{
+	m_passes.push_back({ name, std::move(execute), NoPass, NoPass, false, false, 0, 0 });
+	return uint32_t(m_passes.size() - 1);
+}
+
+void RenderGraph::AddAccess(uint32_t pass, uint32_t resource, AccessKind kind, RenderGraphStage stage, uint32_t slot)
+{
+	Pass& p = m_passes[pass];
+	const uint32_t access = uint32_t(m_accesses.size());
+	m_accesses.push_back({ resource, kind, stage, slot, NoPass });
+	if (p.lastAccess == NoPass)
+		p.firstAccess = access;
+	else
+		m_accesses[p.lastAccess].next = access;
+	p.lastAccess = access;
+}
+
+void RenderGraph::Read(uint32_t pass, uint32_t resource, RenderGraphStage stage, uint32_t slot)
+{
+	AddAccess(pass, resource, Access_Read, stage, slot);
+}
+
+void RenderGraph::WriteTarget(uint32_t pass, uint32_t resource)
+{
+	AddAccess(pass, resource, Access_Target, RenderGraphStage_Pixel, 0);
+}
+
+void RenderGraph::WriteUnorderedAccess(uint32_t pass, uint32_t resource, uint32_t slot)
+{
+	AddAccess(pass, resource, Access_UnorderedAccess, RenderGraphStage_Compute, slot);
+}
+
+void RenderGraph::SetSideEffects(uint32_t pass)
+{
+	m_passes[pass].sideEffects = true;
+}
+
+uint64_t RenderGraph::Key(uint32_t resource) const
+{
+	// Transients are bound as their physical target, which is all the GPU sees
+	const Resource& r = m_resources[resource];
+	return r.transient == RenderTargetPool::NoTarget ? uint64_t(r.handle) :
+		(uint64_t(1) << 63) | m_pool.PhysicalTarget(r.transient);
+}
+
+uint32_t RenderGraph::PhysicalTarget(uint32_t resource) const
+{
+	const Resource& r = m_resources[resource];
+	return r.transient == RenderTargetPool::NoTarget ? RenderTargetPool::NoTarget : m_pool.PhysicalTarget(r.transient);
+}
+
+void RenderGraph::Compile()
+{
+	m_order.clear();
+	m_unbinds.clear();
+	m_stats = RenderGraphStats();
+
+	// Back to front: a pass is kept when a kept pass after it reads what it writes.
+	// Writes add to a resource, so every earlier writer of a needed one is kept too.
+	m_needed.assign(m_resources.size(), 0);
+	for (uint32_t p = uint32_t(m_passes.size()); p-- > 0;) {
+		Pass& pass = m_passes[p];
+		bool keep = pass.sideEffects;
+		for (uint32_t a = pass.firstAccess; !keep && a != NoPass; a = m_accesses[a].next)
+			keep = m_accesses[a].kind != Access_Read && m_needed[m_accesses[a].resource];
+		pass.culled = !keep;
+		pass.firstUnbind = 0;
+		pass.unbindCount = 0;
+		if (!keep) {
+			m_stats.culledPasses++;
+			continue;
+		}
+		for (uint32_t a = pass.firstAccess; a != NoPass; a = m_accesses[a].next) {
+			if (m_accesses[a].kind == Access_Read)
+				m_needed[m_accesses[a].resource] = 1;
+		}
+	}
+	for (uint32_t p = 0; p < uint32_t(m_passes.size()); p++) {
+		if (!m_passes[p].culled)
+			m_order.push_back(p);
+	}
+
+	// Transients live from the first kept pass using them to the last
+	m_pool.ClearPasses();
+	for (uint32_t p : m_order) {
+		m_poolUses.clear();
+		for (uint32_t a = m_passes[p].firstAccess; a != NoPass; a = m_accesses[a].next) {
+			const Resource& r = m_resources[m_accesses[a].resource];
+			if (r.transient != RenderTargetPool::NoTarget)
+				m_poolUses.push_back(r.transient);
+		}
+		m_pool.AddPass(m_poolUses.data(), m_poolUses.size(), RenderTargetPool::NoTarget);
+	}
+	m_pool.Plan();
+
+	// Play the bindings forward from where the last frame left them
+	Bindings& bound = m_compiled;
+	bound.targets.assign(m_bound.targets.begin(), m_bound.targets.end());
+	memcpy(bound.shaderResources, m_bound.shaderResources, sizeof(bound.shaderResources));
+	memcpy(bound.unorderedAccess, m_bound.unorderedAccess, sizeof(bound.unorderedAccess));
+	for (uint32_t p : m_order) {
+		Pass& pass = m_passes[p];
+		pass.firstUnbind = uint32_t(m_unbinds.size());
+		for (uint32_t a = pass.firstAccess; a != NoPass; a = m_accesses[a].next) {
+			const Access& access = m_accesses[a];
+			const uint64_t key = Key(access.resource);
+			// Written: not while any stage can read it
+			if (access.kind != Access_Read) {
+				for (uint32_t stage = 0; stage < RenderGraphStage_Count; stage++) {
+					for (uint32_t slot = 0; slot < Slots; slot++) {
+						if (bound.shaderResources[stage][slot] == key) {
+							m_unbinds.push_back({ RenderGraphUnbind_ShaderResource, RenderGraphStage(stage), slot });
+							bound.shaderResources[stage][slot] = 0;
+						}
+					}
+				}
+			}
+			// Read or written as unordered access: not while it is a target
+			if (access.kind != Access_Target && std::find(bound.targets.begin(), bound.targets.end(), key) != bound.targets.end()) {
+				m_unbinds.push_back({ RenderGraphUnbind_Targets, RenderGraphStage_Pixel, 0 });
+				bound.targets.clear();
+			}
+			// Read or a target: not while it is unordered access
+			if (access.kind != Access_UnorderedAccess) {
+				for (uint32_t slot = 0; slot < Slots; slot++) {
+					if (bound.unorderedAccess[slot] == key) {
+						m_unbinds.push_back({ RenderGraphUnbind_UnorderedAccess, RenderGraphStage_Compute, slot });
+						bound.unorderedAccess[slot] = 0;
+					}
+				}
+			}
+		}
+		pass.unbindCount = uint32_t(m_unbinds.size()) - pass.firstUnbind;
+
+		// What the pass leaves bound; setting targets replaces all of them
+		bool setsTargets = false;
+		for (uint32_t a = pass.firstAccess; a != NoPass; a = m_accesses[a].next) {
+			const Access& access = m_accesses[a];
+			const uint64_t key = Key(access.resource);
+			if (access.kind == Access_Read) {
+				bound.shaderResources[access.stage][access.slot] = key;
+			}
+			else if (access.kind == Access_UnorderedAccess) {
+				bound.unorderedAccess[access.slot] = key;
+			}
+			else {
+				if (!setsTargets)
+					bound.targets.clear();
+				setsTargets = true;
+				bound.targets.push_back(key);
+			}
+		}
+	}
+
+	m_stats.passes = m_passes.size();
+	m_stats.resources = m_resources.size();
+	m_stats.transients = m_pool.TargetCount();
+	m_stats.unbinds = m_unbinds.size();
+}
+
+void RenderGraph::Execute(RenderBackend& render)
+{
+	GpuTexture* noTexture = nullptr;
+	GpuUnorderedAccess* noAccess = nullptr;
+	for (uint32_t p : m_order) {
+		Pass& pass = m_passes[p];
+		for (uint32_t i = 0; i < pass.unbindCount; i++) {
+			const RenderGraphUnbind& unbind = m_unbinds[pass.firstUnbind + i];
+			switch (unbind.kind) {
+			case RenderGraphUnbind_ShaderResource:
+				if (unbind.stage == RenderGraphStage_Vertex)
+					render.VSSetShaderResources(unbind.slot, 1, &noTexture);
+				else if (unbind.stage == RenderGraphStage_Pixel)
+					render.PSSetShaderResources(unbind.slot, 1, &noTexture);
+				else
+					render.CSSetShaderResources(unbind.slot, 1, &noTexture);
+				break;
+			case RenderGraphUnbind_UnorderedAccess:
+				render.CSSetUnorderedAccessViews(unbind.slot, 1, &noAccess);
+				break;
+			case RenderGraphUnbind_Targets:
+				render.OMSetRenderTargets(nullptr, nullptr);
+				break;
+			}
+		}
+		if (pass.execute)
+			pass.execute(render);
+	}
+	m_bound.targets.assign(m_compiled.targets.begin(), m_compiled.targets.end());
+	memcpy(m_bound.shaderResources, m_compiled.shaderResources, sizeof(m_bound.shaderResources));
+	memcpy(m_bound.unorderedAccess, m_compiled.unorderedAccess, sizeof(m_bound.unorderedAccess));
+}
+
+void RenderGraph::ForgetBindings()
+{
+	m_bound.targets.clear();
+	memset(m_bound.shaderResources, 0, sizeof(m_bound.shaderResources));
+	memset(m_bound.unorderedAccess, 0, sizeof(m_bound.unorderedAccess));
+}
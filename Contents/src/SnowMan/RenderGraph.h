@@ -0,0 +1,155 @@
+#pragma once
+#include "RenderBackend.h"
+#include "RenderTargetPool.h"
+#include <functional>
+
+enum RenderGraphStage : uint32_t
+{
+	RenderGraphStage_Vertex,
+	RenderGraphStage_Pixel,
+	RenderGraphStage_Compute,
+	RenderGraphStage_Count
+};
+
+// What the graph does ahead of a pass so nothing it writes is still bound for reading,
+// and nothing it reads is still bound for writing.
+enum RenderGraphUnbindKind : uint32_t
+{
+	RenderGraphUnbind_ShaderResource,	// stage, slot
+	RenderGraphUnbind_UnorderedAccess,	// compute slot
+	RenderGraphUnbind_Targets,			// the output merger's render and depth targets
+};
+
+struct RenderGraphUnbind
+{
+	RenderGraphUnbindKind kind;
+	RenderGraphStage stage;
+	uint32_t slot;
+};
+
+struct RenderGraphStats
+{
+	size_t passes = 0;
+	size_t culledPasses = 0;
+	size_t resources = 0;
+	size_t transients = 0;
+	size_t unbinds = 0;
+};
+
+// A frame as passes declaring the resources they read (as shader resources at a stage
+// and slot) and write (as render or depth targets, or compute unordered access views),
+// rebuilt every frame. Compile keeps the passes in the order added and:
+// - culls the passes whose writes no later kept pass reads, unless they have side effects;
+// - plans the transient targets over the kept passes with a RenderTargetPool;
+// - works out, from what the passes leave bound, which shader resource, unordered access
+//   and target bindings each pass must drop first. A pass is taken to leave its reads
+//   bound at their slots, its unordered access views at theirs and its targets on the
+//   output merger; what the last frame's passes left bound carries over to the next.
+// Execute issues the unbinds through a RenderBackend and runs the passes. Imported
+// resources are told apart across frames by their handles, so the graph must see the
+// same handle for a resource every frame. Plain C++ with no D3D dependency, so it can
+// be compiled headlessly.
+class RenderGraph
+{
+public:
+	typedef std::function<void(RenderBackend&)> ExecuteFunction;
+	static const uint32_t NoPass = ~0u;
+	static const uint32_t Slots = 16;			// shader resource and unordered access slots tracked per stage
+
+	// Starts the next frame's graph; bindings stay as the last Execute left them.
+	void Reset();
+	// Resources that outlive the frame. Sampled ones are imported by their shader
+	// resource view; targets never sampled by their render or depth target.
+	uint32_t Import(const char* name, GpuTexture* view);
+	uint32_t Import(const char* name, GpuRenderTarget* target);
+	uint32_t Import(const char* name, GpuDepthTarget* depth);
+	// A target for this frame only, placed by Compile.
+	uint32_t CreateTransient(const char* name, const RenderTargetDesc& desc);
+
+	uint32_t AddPass(const char* name, ExecuteFunction execute);
+	void Read(uint32_t pass, uint32_t resource, RenderGraphStage stage, uint32_t slot);
+	void WriteTarget(uint32_t pass, uint32_t resource);
+	void WriteUnorderedAccess(uint32_t pass, uint32_t resource, uint32_t slot);
+	// Kept even when nothing reads what it writes (it presents, or reads back).
+	void SetSideEffects(uint32_t pass);
+
+	void Compile();
+	void Execute(RenderBackend& render);
+	// Forgets what is bound; for when the device and its views were recreated.
+	void ForgetBindings();
+
+	size_t PassCount() const { return m_passes.size(); }
+	size_t ResourceCount() const { return m_resources.size(); }
+	const char* PassName(uint32_t pass) const { return m_passes[pass].name; }
+	const char* ResourceName(uint32_t resource) const { return m_resources[resource].name; }
+	bool Culled(uint32_t pass) const { return m_passes[pass].culled; }
+	// The kept passes in execution order.
+	const std::vector<uint32_t>& Order() const { return m_order; }
+	// What Execute unbinds ahead of a kept pass.
+	size_t UnbindCount(uint32_t pass) const { return m_passes[pass].unbindCount; }
+	const RenderGraphUnbind& Unbind(uint32_t pass, size_t i) const { return m_unbinds[m_passes[pass].firstUnbind + i]; }
+	// Physical pool target of a transient; NoTarget if no kept pass uses it.
+	uint32_t PhysicalTarget(uint32_t resource) const;
+	const RenderTargetPool& Pool() const { return m_pool; }
+	const RenderGraphStats& Stats() const { return m_stats; }
+
+private:
+	struct Resource
+	{
+		const char* name;
+		uintptr_t handle;		// imported: its handle; transient: 0
+		uint32_t transient;		// pool target, or NoTarget if imported
+	};
+
+	enum AccessKind : uint32_t
+	{
+		Access_Read,
+		Access_Target,
+		Access_UnorderedAccess,
+	};
+
+	struct Access
+	{
+		uint32_t resource;
+		AccessKind kind;
+		RenderGraphStage stage;
+		uint32_t slot;
+		uint32_t next;			// the pass's next access, or NoPass
+	};
+
+	struct Pass
+	{
+		const char* name;
+		ExecuteFunction execute;
+		uint32_t firstAccess;
+		uint32_t lastAccess;
+		bool sideEffects;
+		bool culled;
+		uint32_t firstUnbind;
+		uint32_t unbindCount;
+	};
+
+	// Views of what is bound where, as resource keys; 0 is nothing.
+	struct Bindings
+	{
+		uint64_t shaderResources[RenderGraphStage_Count][Slots];
+		uint64_t unorderedAccess[Slots];
+		std::vector<uint64_t> targets;
+	};
+
+	uint32_t AddResource(const char* name, uintptr_t handle, uint32_t transient);
+	void AddAccess(uint32_t pass, uint32_t resource, AccessKind kind, RenderGraphStage stage, uint32_t slot);
+	uint64_t Key(uint32_t resource) const;
+
+	std::vector<Resource> m_resources;
+	std::vector<Pass> m_passes;
+	std::vector<Access> m_accesses;
+	std::vector<uint32_t> m_order;
+	std::vector<RenderGraphUnbind> m_unbinds;
+	std::vector<uint8_t> m_needed;			// per resource, while culling
+	std::vector<uint32_t> m_poolUses;
+	RenderTargetPool m_pool;
+	Bindings m_bound = {};			// as the last Execute left them
+	Bindings m_compiled = {};		// as this graph will leave them
+	RenderGraphStats m_stats;
+};
@@ -0,0 +1,98 @@
+#include "RenderTargetPool.h"
+#include <algorithm>
+
+const uint32_t RenderTargetPool::NoTarget;
+
+void RenderTargetPool::Reset()
+{
+	m_targets.clear();
+	m_physical.clear();
+	m_passCount = 0;
+	m_stats = RenderTargetPoolStats();
+}
+
+void RenderTargetPool::ClearPasses()
+{
+	for (Target& t : m_targets)
+		t.firstPass = t.lastPass = t.physical = NoTarget;
+	m_physical.clear();
+	m_passCount = 0;
+	m_stats = RenderTargetPoolStats();
+}
+
+uint32_t RenderTargetPool::AddTarget(const RenderTargetDesc& desc)
+{
+	m_targets.push_back({ desc, NoTarget, NoTarget, NoTarget });
+	return uint32_t(m_targets.size() - 1);
+}
+
+void RenderTargetPool::Use(uint32_t target, uint32_t pass)
+{
+	Target& t = m_targets[target];
+	if (t.firstPass == NoTarget)
+		t.firstPass = pass;
+	t.lastPass = pass;
+}
+
+void RenderTargetPool::AddPass(const uint32_t* reads, size_t readCount, uint32_t write)
+{
+	const uint32_t pass = m_passCount++;
+	for (size_t i = 0; i < readCount; i++)
+		Use(reads[i], pass);
+	if (write != NoTarget)
+		Use(write, pass);
+}
+
+void RenderTargetPool::Plan()
+{
+	m_physical.clear();
+	m_stats = RenderTargetPoolStats();
+
+	// Greedy in order of first use: for intervals this needs no more targets of a
+	// desc than are ever live at once
+	std::vector<uint32_t>& order = m_order;
+	order.clear();
+	for (uint32_t i = 0; i < uint32_t(m_targets.size()); i++) {
+		m_targets[i].physical = NoTarget;
+		if (m_targets[i].firstPass != NoTarget)
+			order.push_back(i);
+	}
+	// Ties in the order added; sort rather than stable_sort, which allocates
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		return m_targets[a].firstPass < m_targets[b].firstPass || (m_targets[a].firstPass == m_targets[b].firstPass && a < b);
+	});
+	std::vector<uint32_t>& busyUntil = m_busyUntil;
+	busyUntil.clear();
+	for (uint32_t i : order) {
+		Target& t = m_targets[i];
+		for (uint32_t p = 0; p < uint32_t(m_physical.size()); p++) {
+			if (busyUntil[p] < t.firstPass && m_physical[p] == t.desc) {
+				t.physical = p;
+				break;
+			}
+		}
+		if (t.physical == NoTarget) {
+			t.physical = uint32_t(m_physical.size());
+			m_physical.push_back(t.desc);
+			busyUntil.push_back(0);
+		}
+		busyUntil[t.physical] = t.lastPass;
+		m_stats.naiveBytes += t.desc.Bytes();
+	}
+
+	m_stats.targets = order.size();
+	m_stats.physicalTargets = m_physical.size();
+	for (const RenderTargetDesc& desc : m_physical)
+		m_stats.pooledBytes += desc.Bytes();
+	// Bytes coming alive at each pass less those that died after the one before
+	m_liveChange.assign(m_passCount + 1, 0);
+	for (uint32_t i : order) {
+		m_liveChange[m_targets[i].firstPass] += int64_t(m_targets[i].desc.Bytes());
+		m_liveChange[m_targets[i].lastPass + 1] -= int64_t(m_targets[i].desc.Bytes());
+	}
+	int64_t live = 0;
+	for (uint32_t pass = 0; pass < m_passCount; pass++) {
+		live += m_liveChange[pass];
+		m_stats.peakLiveBytes = std::max(m_stats.peakLiveBytes, uint64_t(live));
+	}
+}
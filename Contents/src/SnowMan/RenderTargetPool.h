@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+struct RenderTargetDesc
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;		// DXGI_FORMAT value
+	uint32_t bytesPerPixel;
+
+	uint64_t Bytes() const { return uint64_t(width) * height * bytesPerPixel; }
+	bool operator==(const RenderTargetDesc& o) const
+	{
+		return width == o.width && height == o.height && format == o.format && bytesPerPixel == o.bytesPerPixel;
+	}
+};
+
+struct RenderTargetPoolStats
+{
+	size_t targets = 0;				// used transient targets
+	size_t physicalTargets = 0;		// what they were packed into
+	uint64_t naiveBytes = 0;		// one allocation per transient target
+	uint64_t pooledBytes = 0;		// every physical target
+	uint64_t peakLiveBytes = 0;		// the most bytes live during any one pass
+};
+
+// Transient render targets of a frame, packed into as few real ones as lifetimes allow.
+// Passes are added in execution order with the transient targets they read and write.
+// A target lives from the first pass that writes it to the last that reads it; targets
+// whose lifetimes do not overlap and whose descs match share one physical target, so
+// a pass never reads and writes the same one. D3D11 cannot place two textures in the
+// same memory, so matching descs is what lets them alias. Plain C++ with no D3D
+// dependency, so it can be exercised headlessly.
+class RenderTargetPool
+{
+public:
+	static const uint32_t NoTarget = ~0u;
+
+	// Starts a new plan.
+	void Reset();
+	// Drops the passes but keeps the targets, to plan them over other passes.
+	void ClearPasses();
+	// A transient target; numbered from 0 in order of adding.
+	uint32_t AddTarget(const RenderTargetDesc& desc);
+	// The next pass. write may be NoTarget (a target outside the pool).
+	void AddPass(const uint32_t* reads, size_t readCount, uint32_t write);
+	void AddPass(std::initializer_list<uint32_t> reads, uint32_t write) { AddPass(reads.begin(), reads.size(), write); }
+
+	// Works out the lifetimes and assigns physical targets.
+	void Plan();
+
+	size_t TargetCount() const { return m_targets.size(); }
+	size_t PassCount() const { return m_passCount; }
+	// NoTarget for targets no pass uses.
+	uint32_t PhysicalTarget(uint32_t target) const { return m_targets[target].physical; }
+	uint32_t FirstPass(uint32_t target) const { return m_targets[target].firstPass; }
+	uint32_t LastPass(uint32_t target) const { return m_targets[target].lastPass; }
+	size_t PhysicalCount() const { return m_physical.size(); }
+	const RenderTargetDesc& PhysicalDesc(size_t physical) const { return m_physical[physical]; }
+	const RenderTargetPoolStats& Stats() const { return m_stats; }
+
+private:
+	struct Target
+	{
+		RenderTargetDesc desc;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		uint32_t physical;
+	};
+
+	void Use(uint32_t target, uint32_t pass);
+
+	std::vector<Target> m_targets;
+	std::vector<RenderTargetDesc> m_physical;
+	std::vector<uint32_t> m_order;			// used targets by first pass, while planning
+	std::vector<uint32_t> m_busyUntil;		// last pass of each physical target's current tenant
+	std::vector<int64_t> m_liveChange;		// per pass, while planning
+	uint32_t m_passCount = 0;
+	RenderTargetPoolStats m_stats;
+};
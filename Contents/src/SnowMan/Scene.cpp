@@ -10,6 +10,8 @@
 
 #include "ATGColors.h"
 #include "ReadData.h"
+#include "ShaderCompiler.h"
+#include <map>
 
 extern void ExitSample();
 
@@ -17,11 +19,150 @@ using namespace DirectX;
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+	std::string Utf8(const std::wstring& s)
+	{
+		int n = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), int(s.size()), nullptr, 0, nullptr, nullptr);
+		std::string out(n, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, s.c_str(), int(s.size()), &out[0], n, nullptr, nullptr);
+		return out;
+	}
+
+	std::wstring FullPath(const wchar_t* path)
+	{
+		wchar_t full[MAX_PATH];
+		return GetFullPathNameW(path, MAX_PATH, full, nullptr) ? full : path;
+	}
+
+	// Fixed-step updates, and input log ticks, per second
+	const uint32_t UpdatesPerSecond = 60;
+	const char* const InputLogPath = "SnowManInput.bin";
+	// Screenshots and raw frame sequences are named from this
+	const char* const CapturePrefix = "SnowManCapture";
+
+	// Shader model 5 for every stage, so a reload accepts whatever the offline build does
+	const char* ShaderTarget(ID3D11VertexShader*) { return "vs_5_0"; }
+	const char* ShaderTarget(ID3D11PixelShader*) { return "ps_5_0"; }
+	const char* ShaderTarget(ID3D11ComputeShader*) { return "cs_5_0"; }
+
+	HRESULT CreateShader(ID3D11Device* device, ID3DBlob* code, ID3D11VertexShader** shader)
+	{
+		return device->CreateVertexShader(code->GetBufferPointer(), code->GetBufferSize(), nullptr, shader);
+	}
+
+	HRESULT CreateShader(ID3D11Device* device, ID3DBlob* code, ID3D11PixelShader** shader)
+	{
+		return device->CreatePixelShader(code->GetBufferPointer(), code->GetBufferSize(), nullptr, shader);
+	}
+
+	HRESULT CreateShader(ID3D11Device* device, ID3DBlob* code, ID3D11ComputeShader** shader)
+	{
+		return device->CreateComputeShader(code->GetBufferPointer(), code->GetBufferSize(), nullptr, shader);
+	}
+
+	// Scale, then rotation, then translation.
+	XMMATRIX SceneNodeLocal(const SceneNodeRecord& n)
+	{
+		return XMMatrixScaling(n.scale[0], n.scale[1], n.scale[2]) *
+			XMMatrixRotationRollPitchYaw(n.rotation[0], n.rotation[1], n.rotation[2]) *
+			XMMatrixTranslation(n.translation[0], n.translation[1], n.translation[2]);
+	}
+
+	PointLight ToPointLight(const SceneLampRecord& lamp)
+	{
+		PointLight light = {
+			{ lamp.position[0], lamp.position[1], lamp.position[2] }, lamp.radius,
+			{ lamp.color[0], lamp.color[1], lamp.color[2] }, lamp.intensity
+		};
+		return light;
+	}
+
+	// Dynamic structured buffer of count elements, written whole with Map each frame.
+	void CreateDynamicStructuredBuffer(ID3D11Device* device, UINT stride, UINT count,
+		ComPtr<ID3D11Buffer>& buffer, ComPtr<ID3D11ShaderResourceView>& view)
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = stride * count;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+		DX::ThrowIfFailed(device->CreateBuffer(&desc, nullptr, buffer.ReleaseAndGetAddressOf()));
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+		viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		viewDesc.Buffer.NumElements = count;
+		DX::ThrowIfFailed(device->CreateShaderResourceView(buffer.Get(), &viewDesc, view.ReleaseAndGetAddressOf()));
+	}
+
+	bool SameString(const SceneFile& a, uint32_t sa, const SceneFile& b, uint32_t sb)
+	{
+		if (sa == SceneNoString || sb == SceneNoString)
+			return sa == sb;
+		return strcmp(a.String(sa), b.String(sb)) == 0;
+	}
+
+	// True when b differs from a only in values UpdateScene can apply in place.
+	bool SameSceneLayout(const SceneFile& a, const SceneFile& b)
+	{
+		if (a.NodeCount() != b.NodeCount() || a.MaterialCount() != b.MaterialCount() ||
+			a.DrawableCount() != b.DrawableCount() || a.LightCount() != b.LightCount() || a.LampCount() != b.LampCount())
+			return false;
+		for (uint32_t i = 0; i < a.NodeCount(); i++) {
+			const SceneNodeRecord& na = a.Nodes()[i];
+			const SceneNodeRecord& nb = b.Nodes()[i];
+			if (!SameString(a, na.name, b, nb.name) || na.parent != nb.parent || (na.spin != 0.0f) != (nb.spin != 0.0f))
+				return false;
+		}
+		for (uint32_t i = 0; i < a.MaterialCount(); i++) {
+			const SceneMaterialRecord& ma = a.Materials()[i];
+			const SceneMaterialRecord& mb = b.Materials()[i];
+			if (!SameString(a, ma.texture, b, mb.texture) || !SameString(a, ma.normalMap, b, mb.normalMap) ||
+				ma.flags != mb.flags || memcmp(ma.color, mb.color, sizeof(ma.color)) != 0)
+				return false;
+		}
+		for (uint32_t i = 0; i < a.DrawableCount(); i++) {
+			const SceneDrawableRecord& da = a.Drawables()[i];
+			const SceneDrawableRecord& db = b.Drawables()[i];
+			if (da.kind != db.kind || da.node != db.node || da.material != db.material ||
+				da.terrainDim != db.terrainDim || !SameString(a, da.heightMap, b, db.heightMap))
+				return false;
+		}
+		return true;
+	}
+}
+
 Scene::Scene()
 {
-    // Use gamma-correct rendering.
-    m_deviceResources = std::make_unique<DX::DeviceResources>(DXGI_FORMAT_B8G8R8A8_UNORM_SRGB);
+    // The scene is lit in linear HDR and tone-mapped into a 10 bit back buffer: HDR10
+	// on displays that support it, sRGB otherwise. Feature level 11 for the compute and
+	// structured buffer shaders (snowfall, clustered lights, luminance histogram).
+    m_deviceResources = std::make_unique<DX::DeviceResources>(DXGI_FORMAT_R10G10B10A2_UNORM,
+		DXGI_FORMAT_D32_FLOAT, 2, D3D_FEATURE_LEVEL_11_0, DX::DeviceResources::c_EnableHDR);
     m_deviceResources->RegisterDeviceNotify(this);
+
+	m_jobs = std::make_unique<JobSystem>();
+	m_frameMemory = std::make_unique<FrameAllocator>(256 * 1024, 2, m_jobs->ThreadCount());
+	m_hotReload = std::make_unique<HotReload>();
+	m_profiler = std::make_unique<Profiler>();
+	m_captureEncoder = std::make_unique<CaptureEncoder>(CapturePrefix);
+	m_occlusion = std::make_unique<OcclusionBuffer>();
+	m_snowEmitters.push_back(SnowEmitter());
+	m_lightClusters = std::make_unique<LightClusters>();
+	m_lodSettings.impostorSize = 0.02f;
+
+	// Shaders are recompiled on change only when their sources are around
+	try {
+		wchar_t buff[MAX_PATH];
+		DX::FindMediaFile(buff, MAX_PATH, L"src\\SnowMan\\VertexShader.hlsl");
+		m_shaderSourceDir = FullPath(buff);
+		m_shaderSourceDir.resize(m_shaderSourceDir.find_last_of(L"\\/") + 1);
+	}
+	catch (const std::exception&) {
+		m_shaderSourceDir.clear();
+	}
 }
 
 // Initialize the Direct3D resources required to run.
@@ -29,7 +170,7 @@ void Scene::Initialize(HWND window, int width, int height)
 {
 	//Set timer
 	m_timer.SetFixedTimeStep(true);
-	m_timer.SetTargetElapsedSeconds(1.f / 60.f);
+	m_timer.SetTargetElapsedSeconds(1.0 / UpdatesPerSecond);
 
     m_gamePad = std::make_unique<GamePad>();
 
@@ -39,7 +180,7 @@ void Scene::Initialize(HWND window, int width, int height)
 	m_mouse->SetWindow(window);
 	m_mouse->SetMode(Mouse::MODE_RELATIVE);
 
-	last_scroll_value = m_mouse->GetState().scrollWheelValue;
+	m_lastScroll = m_mouse->GetState().scrollWheelValue;
 	
 
     m_deviceResources->SetWindow(window, width, height);
@@ -52,9 +193,9 @@ void Scene::Initialize(HWND window, int width, int height)
 
 	Cam.SetPosition(12.0, 10.0, -12.0);
 	//Cam.SetPosition(-20.0, 20.0, -20.0); 
-	m_pitch = -0.25*PI;
-	m_yaw = -0.25*PI;
-	Cam.Turn(m_pitch, m_yaw);
+	m_flyCamera.pitch = -0.25f*PI;
+	m_flyCamera.yaw = -0.25f*PI;
+	Cam.Turn(m_flyCamera.pitch, m_flyCamera.yaw);
 	Cam.UpdateViewMatrix();
 
 }
@@ -63,17 +204,39 @@ void Scene::Initialize(HWND window, int width, int height)
 // Executes basic render loop.
 void Scene::Tick()
 {
+	m_frameMemory->BeginFrame();
+	m_profiler->BeginFrame();
+	// Swap in resources whose files changed before this frame uses them
+	{
+		ProfileScope scope(*m_profiler, "Hot reload");
+		m_hotReload->Update();
+	}
+
     m_timer.Tick([&]()
     {
+		ProfileScope scope(*m_profiler, "Update");
         Update(m_timer);
     });
 
 	Cam.UpdateViewMatrix();
     Render();
+
+	m_profiler->EndFrame();
+	m_hotReload->FramePresented();
+	for (const HotReload::Report& report : m_hotReload->TakeReports()) {
+		char line[256];
+		if (report.failed)
+			sprintf_s(line, "Hot reload of %s failed:\n", report.name.c_str());
+		else
+			sprintf_s(line, "Hot reload of %s: %.1f ms from change to screen\n", report.name.c_str(), report.latencyMs);
+		OutputDebugStringA(line);
+		if (report.failed)
+			OutputDebugStringA((report.error + "\n").c_str());
+	}
 }
 
 // Updates the world.
-void Scene::Update(DX::StepTimer const&)
+void Scene::Update(DX::StepTimer const& timer)
 {
     auto pad = m_gamePad->GetState(0);
     if (pad.IsConnected())
@@ -89,334 +252,898 @@ void Scene::Update(DX::StepTimer const&)
     {
         ExitSample();
     }
-	if (kb.W) {
-		Cam.Walk(0.05);
-	}
-	if (kb.A) {
-		Cam.Strafe(-0.05);
+	m_keys.Update(kb);
+	if (m_keys.pressed.F10) {
+		ToggleInputRecording();
 	}
-	if (kb.S) {
-		Cam.Walk(-0.05);
+	if (m_keys.pressed.F11) {
+		ToggleInputReplay();
 	}
-	if (kb.D) {
-		Cam.Strafe(0.05);
+	if (m_keys.pressed.T) {
+		m_captureShot = true;
+		m_captureShotEncoding = kb.LeftShift || kb.RightShift ? CaptureEncoding_Dds : CaptureEncoding_Png;
 	}
-	if (kb.Q) {
-		m_yaw -= 0.02;
+	if (m_keys.pressed.V) {
+		ToggleFrameCapture();
 	}
-	if (kb.E) {
-		m_yaw += 0.02;
-	}
-	if (kb.Z) {
-		m_pitch += 0.02;
+
+	// Everything below acts on the snapshot only, so a replayed log does what was recorded
+	InputSnapshot input = SampleInput(kb);
+	if (m_inputMode == InputMode_Replay && !m_inputLog.Next(input)) {
+		OutputDebugStringA("Input replay finished\n");
+		m_inputMode = InputMode_Live;
 	}
-	if (kb.C) {
-		m_pitch -= 0.02;
+	else if (m_inputMode == InputMode_Record) {
+		m_inputLog.Record(input);
 	}
-	if (kb.F) {
+	const uint32_t pressed = input.keys & ~m_lastInput.keys;
+	m_lastInput = input;
+
+	if (input.keys & InputKey_F) {
 		if (Cam.IsOnCar)
 			Cam.OffCar = true;
 	}
+	if (pressed & InputKey_O) {
+		m_occlusionCulling = !m_occlusionCulling;
+	}
+	if (pressed & InputKey_K) {
+		m_lodEnabled = !m_lodEnabled;
+	}
+	if (pressed & InputKey_P) {
+		m_depthPrePass = !m_depthPrePass;
+		m_pipelineStats->Reset();
+	}
+	if (pressed & InputKey_N) {
+		m_snowfall = !m_snowfall;
+	}
+	if (pressed & InputKey_L) {
+		m_clusteredLights = !m_clusteredLights;
+	}
+	if (pressed & InputKey_X) {
+		m_autoExposureEnabled = !m_autoExposureEnabled;
+		m_autoExposure.Reset();
+	}
+	if (pressed & (InputKey_B | InputKey_G)) {
+		m_postProcessSettings.bloom ^= (pressed & InputKey_B) != 0;
+		m_postProcessSettings.fxaa ^= (pressed & InputKey_G) != 0;
+		ConfigurePostProcess();
+	}
+	if (pressed & InputKey_F9) {
+		m_profiler->WriteChromeTrace("SnowManProfile.json");
+		char line[256];
+		for (const Profiler::Stats& s : m_profiler->Summary()) {
+			sprintf_s(line, "%s %-16s mean %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f ms (%zu frames)\n",
+				s.gpu ? "GPU" : "CPU", s.name.c_str(), s.meanMs, s.p50Ms, s.p95Ms, s.p99Ms, s.frames);
+			OutputDebugStringA(line);
+		}
+		auto viewport = m_deviceResources->GetScreenViewport();
+		double pixels = double(viewport.Width) * double(viewport.Height);
+		// Pixel shader invocations per screen pixel of each opaque pass; with the
+		// pre-pass each covered pixel is shaded once.
+		for (const char* pass : { "Depth pre-pass", "Objects", "Terrain", "Snow" }) {
+			if (const D3D11PipelineStats::Totals* t = m_pipelineStats->Find(pass)) {
+				double frames = double(t->frames);
+				sprintf_s(line, "%-16s %9.0f triangles  %9.0f pixels shaded  %.2f per screen pixel\n", pass,
+					double(t->sum.CPrimitives) / frames, double(t->sum.PSInvocations) / frames, double(t->sum.PSInvocations) / frames / pixels);
+				OutputDebugStringA(line);
+			}
+		}
+		// Pixels the sky would have shaded when drawn first, under the whole viewport
+		if (const D3D11PipelineStats::Totals* sky = m_pipelineStats->Find("Skybox")) {
+			double shaded = double(sky->sum.PSInvocations) / double(sky->frames);
+			sprintf_s(line, "Sky shaded %.0f of %.0f pixels per frame (%.1f%% saved by drawing it last)\n",
+				shaded, pixels, 100.0 * (1.0 - shaded / pixels));
+			OutputDebugStringA(line);
+		}
+		const LightClusterStats& clusters = m_lightClusters->Stats();
+		sprintf_s(line, "Lamps %zu: %zu cluster entries in %zu clusters, at most %u in one\n",
+			clusters.lights, clusters.indices, m_lightClusters->ClusterCount(), clusters.maxPerCluster);
+		OutputDebugStringA(line);
+		sprintf_s(line, "Exposure %+.2f stops, heading for %+.2f%s\n", m_autoExposure.Exposure(),
+			m_autoExposure.TargetExposure(), m_deviceResources->GetColorSpace() == DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020 ? " (HDR10)" : "");
+		OutputDebugStringA(line);
+		// Entities at each level, and the triangles they submit against all at full detail
+		size_t levels[LodSettings::MaxLevels] = {}, hidden = 0;
+		double triangles = 0.0, fullTriangles = 0.0;
+		const LodComponent* lods = m_entities.lods.Data();
+		for (size_t i = 0; i < m_entities.lods.Size(); i++) {
+			fullTriangles += lods[i].levels[0].indexCount / 3;
+			if (lods[i].hidden) {
+				hidden++;
+				continue;
+			}
+			levels[lods[i].level]++;
+			triangles += lods[i].levels[lods[i].level].indexCount / 3;
+		}
+		sprintf_s(line, "LOD%s: %zu/%zu/%zu/%zu entities per level, %zu as impostors, %.0f triangles of %.0f at full detail\n",
+			m_lodEnabled ? "" : " (off)", levels[0], levels[1], levels[2], levels[3], hidden, triangles, fullTriangles);
+		OutputDebugStringA(line);
+		sprintf_s(line, "Impostors: %zu drawables, %zu drawn this frame\n",
+			m_entities.impostors.Size(), m_entities.impostorInstanceCount);
+		OutputDebugStringA(line);
+		const RenderGraphStats& graph = m_frameGraph.Stats();
+		sprintf_s(line, "Render graph: %zu passes, %zu culled, %zu resources, %zu unbinds\n",
+			graph.passes, graph.culledPasses, graph.resources, graph.unbinds);
+		OutputDebugStringA(line);
+		const RenderTargetPoolStats& pool = m_postProcess->Pool().Stats();
+		sprintf_s(line, "Post-processing: %zu targets in %zu textures, %.1f MB against %.1f MB unpooled (%.1f MB live at most)\n",
+			pool.targets, pool.physicalTargets, pool.pooledBytes / 1048576.0, pool.naiveBytes / 1048576.0, pool.peakLiveBytes / 1048576.0);
+		OutputDebugStringA(line);
+		m_pipelineStats->Reset();
+	}
+	// Animation system, after any replay has set the turntable back to where the log starts
+	m_entities.Animate(m_sceneGraph, float(timer.GetElapsedSeconds()));
+
+	// Walk, strafe and turn from wherever the scene file left the camera
+	XMFLOAT3 position = Cam.GetPosition();
+	m_flyCamera.position[0] = position.x;
+	m_flyCamera.position[1] = position.y;
+	m_flyCamera.position[2] = position.z;
+	m_flyCamera.Step(input);
+	// Then ride the box on the turntable, once per tick so that a replay rides it the same
+	AnimationComponent* spin = m_entities.animations.Find(m_turntableSpin);
+	float spinAngle = spin ? spin->angle : 0.0f;
+	float deltaRot = spinAngle - totalRot;
+	totalRot = spinAngle;
+	const float halfWidth[3] = { Cam.BBoxHalfWidth.x, Cam.BBoxHalfWidth.y, Cam.BBoxHalfWidth.z };
+	Cam.IsOnCar = m_flyCamera.Ride(&carPos.x, &carScale.x, halfWidth, totalRot, deltaRot, Cam.OffCar);
+	Cam.OffCar = false;
+	Cam.SetPosition(m_flyCamera.position[0], m_flyCamera.position[1], m_flyCamera.position[2]);
+	Cam.Turn(m_flyCamera.pitch, m_flyCamera.yaw);
+	// A replay leaves the live cursor alone
+	if (m_inputMode != InputMode_Replay)
+		m_mouse->SetMode((input.buttons & InputButton_Left) ? Mouse::MODE_RELATIVE : Mouse::MODE_ABSOLUTE);
+}
+
+InputSnapshot Scene::SampleInput(const Keyboard::State& kb)
+{
+	InputSnapshot input = {};
+	const bool keys[] = { kb.W, kb.A, kb.S, kb.D, kb.Q, kb.E, kb.Z, kb.C, kb.F, kb.O, kb.K, kb.P, kb.N, kb.L, kb.X, kb.B, kb.G, kb.F9 };
+	// In InputKey order
+	for (uint32_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		input.keys |= keys[i] ? 1u << i : 0u;
+
 	auto mouse = m_mouse->GetState();
-	//Scroll
-	float move_forward = mouse.scrollWheelValue - last_scroll_value;
-	last_scroll_value = mouse.scrollWheelValue;
-	Cam.Walk(move_forward * 0.001);
-	if (mouse.positionMode == Mouse::MODE_RELATIVE)
-	{
-		float deltaX = float(mouse.x) * 0.01;
-		float deltaY = float(mouse.y) * 0.01;
-		m_pitch -= deltaY;
-		m_yaw += deltaX;
-	}
-	// limit pitch to straight up or straight down
-	// with a little fudge-factor to avoid gimbal lock
-	float limit = XM_PI / 2.0f - 0.01f;
-	m_pitch = std::max(-limit, m_pitch);
-	m_pitch = std::min(+limit, m_pitch);
-
-	// keep longitude in sane range by wrapping
-	if (m_yaw > XM_PI)
-	{
-		m_yaw -= XM_PI * 2.0f;
+	input.relative = mouse.positionMode == Mouse::MODE_RELATIVE ? 1 : 0;
+	if (input.relative) {
+		input.mouseX = mouse.x;
+		input.mouseY = mouse.y;
 	}
-	else if (m_yaw < -XM_PI)
-	{
-		m_yaw += XM_PI * 2.0f;
+	input.scroll = mouse.scrollWheelValue - m_lastScroll;
+	m_lastScroll = mouse.scrollWheelValue;
+	input.buttons = uint8_t((mouse.leftButton ? InputButton_Left : 0) | (mouse.rightButton ? InputButton_Right : 0) |
+		(mouse.middleButton ? InputButton_Middle : 0));
+	return input;
+}
+
+void Scene::ToggleInputRecording() {
+	if (m_inputMode == InputMode_Record) {
+		m_inputMode = InputMode_Live;
+		char line[256];
+		sprintf_s(line, "Input: %u ticks in %zu bytes %s %s\n", m_inputLog.TickCount(), m_inputLog.StreamBytes(),
+			m_inputLog.Save(InputLogPath) ? "saved to" : "could not be saved to", InputLogPath);
+		OutputDebugStringA(line);
+		return;
 	}
-	Cam.Turn(m_pitch, m_yaw);
-	m_mouse->SetMode(mouse.leftButton ? Mouse::MODE_RELATIVE : Mouse::MODE_ABSOLUTE);
+	XMFLOAT3 position = Cam.GetPosition();
+	m_flyCamera.position[0] = position.x;
+	m_flyCamera.position[1] = position.y;
+	m_flyCamera.position[2] = position.z;
+	InputOrigin origin;
+	m_flyCamera.Save(origin.camera);
+	origin.toggles = (m_occlusionCulling ? InputToggle_OcclusionCulling : 0) | (m_lodEnabled ? InputToggle_Lod : 0) |
+		(m_depthPrePass ? InputToggle_DepthPrePass : 0) | (m_snowfall ? InputToggle_Snowfall : 0) |
+		(m_clusteredLights ? InputToggle_ClusteredLights : 0) | (m_autoExposureEnabled ? InputToggle_AutoExposure : 0) |
+		(m_postProcessSettings.bloom ? InputToggle_Bloom : 0) | (m_postProcessSettings.fxaa ? InputToggle_Fxaa : 0);
+	AnimationComponent* spin = m_entities.animations.Find(m_turntableSpin);
+	origin.turntable = spin ? spin->angle : 0.0f;
+	m_inputLog.Reset(UpdatesPerSecond, origin);
+	RestoreInputOrigin(origin);
+	m_inputMode = InputMode_Record;
+}
+
+// Puts everything the ticks act on back to origin, so recording and replaying start alike.
+void Scene::RestoreInputOrigin(const InputOrigin& origin) {
+	m_flyCamera.Restore(origin.camera);
+	Cam.SetPosition(m_flyCamera.position[0], m_flyCamera.position[1], m_flyCamera.position[2]);
+	Cam.Turn(m_flyCamera.pitch, m_flyCamera.yaw);
+	Cam.IsOnCar = false;
+	Cam.OffCar = false;
+
+	m_occlusionCulling = (origin.toggles & InputToggle_OcclusionCulling) != 0;
+	m_lodEnabled = (origin.toggles & InputToggle_Lod) != 0;
+	m_depthPrePass = (origin.toggles & InputToggle_DepthPrePass) != 0;
+	m_snowfall = (origin.toggles & InputToggle_Snowfall) != 0;
+	m_clusteredLights = (origin.toggles & InputToggle_ClusteredLights) != 0;
+	m_autoExposureEnabled = (origin.toggles & InputToggle_AutoExposure) != 0;
+	m_postProcessSettings.bloom = (origin.toggles & InputToggle_Bloom) != 0;
+	m_postProcessSettings.fxaa = (origin.toggles & InputToggle_Fxaa) != 0;
+	m_pipelineStats->Reset();
+	m_autoExposure.Reset();
+	ConfigurePostProcess();
+
+	// The turntable's angle, with the box-riding camera already turned to it
+	if (AnimationComponent* spin = m_entities.animations.Find(m_turntableSpin))
+		spin->angle = origin.turntable;
+	totalRot = origin.turntable;
+
+	// Presses count from the first tick
+	m_lastInput = InputSnapshot();
+}
+
+void Scene::ToggleInputReplay() {
+	if (m_inputMode == InputMode_Replay) {
+		m_inputMode = InputMode_Live;
+		return;
+	}
+	std::string error;
+	if (!m_inputLog.Load(InputLogPath, &error)) {
+		OutputDebugStringA(("Input replay: " + error + "\n").c_str());
+		return;
+	}
+	if (m_inputLog.TicksPerSecond() != UpdatesPerSecond)
+		OutputDebugStringA("Input replay: the log was recorded at another tick rate\n");
+	RestoreInputOrigin(m_inputLog.Origin());
+	m_inputMode = InputMode_Replay;
+}
+
+void Scene::ToggleFrameCapture() {
+	// Until its last copies are read back a new sequence would run on into its file
+	if (!m_captureSequence && m_captureSequenceEnding) {
+		OutputDebugStringA("Capture: the last sequence is still being read back\n");
+		return;
+	}
+	m_captureSequence = !m_captureSequence;
+	if (m_captureSequence)
+		return;
+	m_captureSequenceEnding = true;
+	D3D11_TEXTURE2D_DESC desc;
+	m_deviceResources->GetRenderTarget()->GetDesc(&desc);
+	CaptureFormat format;
+	if (!D3D11FrameCapture::ToCaptureFormat(desc.Format, format)) {
+		OutputDebugStringA("Capture: the back buffer format can not be captured\n");
+		return;
+	}
+	// Counts since the start, without the sequence's frames still being read back or encoded
+	const CaptureStats stats = m_captureEncoder->Stats();
+	char line[256];
+	sprintf_s(line, "Capture: %s_<first frame>.raw is %ux%u %s; %llu frames written, %llu dropped by the encoder, %llu skipped by the readback\n",
+		CapturePrefix, desc.Width, desc.Height, CaptureEncoder::RawPixelFormat(format),
+		(unsigned long long)stats.encoded, (unsigned long long)stats.dropped, (unsigned long long)m_frameCapture->SkippedFrames());
+	OutputDebugStringA(line);
 }
 #pragma endregion
 
 #pragma region Frame Render
 
-void Scene::SetConstantBufferPars(const RModel* component, XMMATRIX worldM) {
-	auto context = m_deviceResources->GetD3DDeviceContext();
+void Scene::SetPassMatrices(FXMMATRIX view, CXMMATRIX projection, CXMMATRIX lightView, CXMMATRIX lightProjection) {
+	m_passMatrices.view = XMMatrixTranspose(view);
+	m_passMatrices.projection = XMMatrixTranspose(projection);
+	m_passMatrices.lightView = XMMatrixTranspose(lightView);
+	m_passMatrices.lightProjection = XMMatrixTranspose(lightProjection);
+	XMFLOAT3 camPos = Cam.GetPosition();
+	m_passMatrices.camPos = XMFLOAT4(camPos.x, camPos.y, camPos.z, 1.0f);
+}
+
+void Scene::SetConstantBufferPars(XMMATRIX world, const XMFLOAT4& color, VertexFormat vertexFormat, const VertexQuantization& quantization) {
 	// Constant Buffer
 	// Map Constant Buffer and Buffer Binding
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	void* mapped;
 	// Set Constant Buffer
 	MatrixBufferType* matrix_Buffer;
 	// Map Buffer to Write
-	DX::ThrowIfFailed(
-		context->Map(m_MatrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)
-	);
-	matrix_Buffer = (MatrixBufferType*)mappedResource.pData;
-	matrix_Buffer->world = XMMatrixTranspose(component->model * worldM);
-	matrix_Buffer->invTransWorld = XMMatrixInverse(nullptr, component->model * worldM);
-	matrix_Buffer->view = XMMatrixTranspose(Cam.View());
-	matrix_Buffer->projection = XMMatrixTranspose(Cam.Proj());
-	matrix_Buffer->lightView = XMMatrixTranspose(this->lightView);
-	matrix_Buffer->lightProjection = XMMatrixTranspose(this->lightProjection);
+	mapped = m_render->Map(ToGpu(m_MatrixBuffer.Get()));
+	matrix_Buffer = (MatrixBufferType*)mapped;
+	matrix_Buffer->world = XMMatrixTranspose(world);
+	matrix_Buffer->invTransWorld = XMMatrixInverse(nullptr, world);
+	matrix_Buffer->view = m_passMatrices.view;
+	matrix_Buffer->projection = m_passMatrices.projection;
+	matrix_Buffer->lightView = m_passMatrices.lightView;
+	matrix_Buffer->lightProjection = m_passMatrices.lightProjection;
 	// Unlock the constant buffer.
-	context->Unmap(m_MatrixBuffer.Get(), 0);
+	m_render->Unmap(ToGpu(m_MatrixBuffer.Get()));
 
 	CameraBufferType* camera_Buffer;
 	// Map Buffer to Write
-	DX::ThrowIfFailed(
-		context->Map(m_CameraBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)
-	);
-	camera_Buffer = (CameraBufferType*)mappedResource.pData;
-	camera_Buffer->camPos = XMFLOAT4(Cam.GetPosition().x, Cam.GetPosition().y, Cam.GetPosition().z, 1.0);
+	mapped = m_render->Map(ToGpu(m_CameraBuffer.Get()));
+	camera_Buffer = (CameraBufferType*)mapped;
+	camera_Buffer->camPos = m_passMatrices.camPos;
 	// Unlock the constant buffer.
-	context->Unmap(m_CameraBuffer.Get(), 0);
+	m_render->Unmap(ToGpu(m_CameraBuffer.Get()));
 
 	ColorBufferType* color_Buffer;
 	// Map Buffer to Write
-	DX::ThrowIfFailed(
-		context->Map(m_ColorBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)
-	);
-	color_Buffer = (ColorBufferType*)mappedResource.pData;
-	color_Buffer->c_color = component->color;
+	mapped = m_render->Map(ToGpu(m_ColorBuffer.Get()));
+	color_Buffer = (ColorBufferType*)mapped;
+	color_Buffer->c_color = color;
 	// Unlock the constant buffer.
-	context->Unmap(m_ColorBuffer.Get(), 0);
-}
-
-// Draws the scene.
-void Scene::Render()
-{
-    // Don't try to render anything before the first Update.
-    if (m_timer.GetFrameCount() == 0)
-    {
-        return;
-    }
+	m_render->Unmap(ToGpu(m_ColorBuffer.Get()));
 
-    Clear();
+	if (vertexFormat != VertexFormat_Full) {
+		mapped = m_render->Map(ToGpu(m_QuantBuffer.Get()));
+		memcpy(mapped, &quantization, sizeof(VertexQuantization));
+		m_render->Unmap(ToGpu(m_QuantBuffer.Get()));
+	}
+}
 
-	float deltaTime = float(m_timer.GetElapsedSeconds());
-	float frameCount = float(m_timer.GetFrameCount());
-    m_deviceResources->PIXBeginEvent(L"Render");
-    auto context = m_deviceResources->GetD3DDeviceContext();
+void Scene::SetConstantBufferPars(const RModel* component, XMMATRIX worldM) {
+	SetConstantBufferPars(component->model * worldM, component->color, component->vertexFormat, component->quantization);
+}
 
-    // Set input assembler state.
-    context->IASetInputLayout(m_spInputLayout.Get());
+// Binds the buffers SetConstantBufferPars writes: matrices and camera to the vertex shader, color to the pixel shader.
+void Scene::BindConstantBuffers() {
+	GpuBuffer* vsBuffers[2] = { ToGpu(m_MatrixBuffer.Get()), ToGpu(m_CameraBuffer.Get()) };
+	GpuBuffer* psBuffer = ToGpu(m_ColorBuffer.Get());
+	m_render->VSSetConstantBuffers(0, 2, vsBuffers);
+	m_render->PSSetConstantBuffers(0, 1, &psBuffer);
+}
 
-    UINT strides = sizeof(VertexPositionNormalTexture);
-    UINT offsets = 0;
-    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+// Binds vertex/index buffers with the input layout and vertex shader matching their vertex format.
+void Scene::SetVertexInput(ID3D11Buffer* vertexBuffer, ID3D11Buffer* indexBuffer, DXGI_FORMAT indexFormat, VertexFormat vertexFormat,
+	ID3D11VertexShader* fullVS, ID3D11VertexShader* compactVS, ID3D11VertexShader* heightVS) {
+	uint32_t stride = VertexCodec::Stride(vertexFormat);
+	uint32_t offset = 0;
+	switch (vertexFormat) {
+	case VertexFormat_Compact:
+		m_render->IASetInputLayout(ToGpu(m_compactInputLayout.Get()));
+		m_render->VSSetShader(ToGpu(compactVS));
+		break;
+	case VertexFormat_Height:
+		m_render->IASetInputLayout(ToGpu(m_heightInputLayout.Get()));
+		m_render->VSSetShader(ToGpu(heightVS));
+		break;
+	default:
+		m_render->IASetInputLayout(ToGpu(m_spInputLayout.Get()));
+		m_render->VSSetShader(ToGpu(fullVS));
+		break;
+	}
+	GpuBuffer* buffer = ToGpu(vertexBuffer);
+	m_render->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+	m_render->IASetIndexBuffer(ToGpu(indexBuffer), ToGpu(indexFormat), 0);
+}
 
-	auto renderTarget = m_deviceResources->GetRenderTargetView();
-	auto depthStencil = m_deviceResources->GetDepthStencilView();
+void Scene::SetVertexInput(const RModel* component, ID3D11VertexShader* fullVS, ID3D11VertexShader* compactVS, ID3D11VertexShader* heightVS) {
+	SetVertexInput(component->vertexBuffer, component->indexBuffer, component->indexFormat, component->vertexFormat, fullVS, compactVS, heightVS);
+}
 
-// Animation Obj 2 and 3
-	//Box
-	float deltaRot = deltaTime * XM_PI * 0.25;
-	totalRot += deltaRot;
-	XMMATRIX Rotation = XMMatrixRotationRollPitchYaw(0.0, totalRot, 0.0);
-	//XMMATRIX Rotation = XMMatrixIdentity();
-	Objs[2]->AnimM = Rotation;
-	Objs[3]->AnimM = Rotation;
-	//Check if in Box
-	XMFLOAT3 Box[8];
-	Box[0] = XMFLOAT3(carPos.x - carScale.x*0.5, carPos.y - carScale.y*0.5, carPos.z - carScale.z*0.5);
-	Box[1] = XMFLOAT3(carPos.x + carScale.x*0.5, carPos.y - carScale.y*0.5, carPos.z - carScale.z*0.5);
-	Box[2] = XMFLOAT3(carPos.x - carScale.x*0.5, carPos.y + carScale.y*0.5, carPos.z - carScale.z*0.5);
-	Box[3] = XMFLOAT3(carPos.x - carScale.x*0.5, carPos.y - carScale.y*0.5, carPos.z + carScale.z*0.5);
-	Box[4] = XMFLOAT3(carPos.x + carScale.x*0.5, carPos.y + carScale.y*0.5, carPos.z - carScale.z*0.5);
-	Box[5] = XMFLOAT3(carPos.x + carScale.x*0.5, carPos.y - carScale.y*0.5, carPos.z + carScale.z*0.5);
-	Box[6] = XMFLOAT3(carPos.x - carScale.x*0.5, carPos.y + carScale.y*0.5, carPos.z + carScale.z*0.5);
-	Box[7] = XMFLOAT3(carPos.x + carScale.x*0.5, carPos.y + carScale.y*0.5, carPos.z + carScale.z*0.5);
-
-	Cam.IsOnCar = IsIntersectBBox(Cam.GetPosition(), Cam.BBoxHalfWidth, Rotation, Box);
-	if (Cam.IsOnCar) {
-		XMFLOAT3 NewCamPos;
-		if (Cam.OffCar) {
-			//
-			float offset = sqrt(carScale.x*carScale.x + carScale.z*carScale.z);
-			XMStoreFloat3(&NewCamPos, XMVector3Transform(XMLoadFloat3(&XMFLOAT3(carPos.x + offset, carPos.y, carPos.z)), XMMatrixRotationRollPitchYaw(0.0, totalRot, 0.0)));
-			Cam.SetPosition(NewCamPos.x, NewCamPos.y, NewCamPos.z);
-			Cam.OffCar = false;
-		}
-		else {
-			XMStoreFloat3(&NewCamPos, XMVector3Transform(XMLoadFloat3(&Cam.GetPosition()), XMMatrixRotationRollPitchYaw(0.0, deltaRot, 0.0)));
-			Cam.SetPosition(NewCamPos.x, NewCamPos.y, NewCamPos.z);
-			Cam.UpdateViewMatrix();
-		}
-	}
-	else
-		Cam.OffCar = false;
+// Draws the shared terrain patch once per chunk inside the view frustum of viewProj.
+void Scene::DrawTerrainChunks(const RModel* component, ID3D11VertexShader* patchVS, XMMATRIX worldM, XMMATRIX viewProj) {
+	XMFLOAT4X4 localToClip;
+	XMStoreFloat4x4(&localToClip, component->model * worldM * viewProj);
+	auto visibleChunks = m_frameMemory->Arena().Allocate<TerrainChunkInstance>(Terrain->chunks.ChunkCount());
+	size_t visibleCount = Terrain->chunks.Select(&localToClip._11, Terrain->patchParams.grid.x, visibleChunks);
+	if (visibleCount == 0)
+		return;
+
+	void* mapped;
+	mapped = m_render->Map(ToGpu(Terrain->instanceBuffer));
+	memcpy(mapped, visibleChunks, visibleCount * sizeof(TerrainChunkInstance));
+	m_render->Unmap(ToGpu(Terrain->instanceBuffer));
+
+	mapped = m_render->Map(ToGpu(m_TerrainBuffer.Get()));
+	memcpy(mapped, &Terrain->patchParams, sizeof(TerrainBufferType));
+	m_render->Unmap(ToGpu(m_TerrainBuffer.Get()));
+
+	GpuBuffer* buffers[2] = { ToGpu(component->vertexBuffer), ToGpu(Terrain->instanceBuffer) };
+	uint32_t strides[2] = { sizeof(VertexPositionNormalTexture), sizeof(TerrainChunkInstance) };
+	uint32_t offsets[2] = { 0, 0 };
+	m_render->IASetInputLayout(ToGpu(m_patchInputLayout.Get()));
+	m_render->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	m_render->IASetIndexBuffer(ToGpu(component->indexBuffer), ToGpu(component->indexFormat), 0);
+	m_render->VSSetShader(ToGpu(patchVS));
+	GpuBuffer* terrainBuffer = ToGpu(m_TerrainBuffer.Get());
+	m_render->VSSetConstantBuffers(3, 1, &terrainBuffer);
+	auto heightMap = ToGpu(Terrain->heightMap);
+	m_render->VSSetShaderResources(0, 1, &heightMap);
+	m_render->DrawIndexedInstanced(UINT(component->indices.size()), UINT(visibleCount), 0, 0, 0);
+}
 
+// Rasterizes the terrain and the occluder entities on the CPU and hides the visible
+// entities behind them. Only the main pass is culled; hidden objects still cast shadows.
+void Scene::CullOccluded(XMMATRIX viewProj) {
+	ProfileScope scope(*m_profiler, "Occlusion");
+	XMFLOAT4X4 matrix;
+	XMStoreFloat4x4(&matrix, viewProj);
+	m_occlusion->BeginFrame(&matrix._11);
+	XMStoreFloat4x4(&matrix, Terrain->components[0]->model * ToXMMatrix(m_sceneGraph.World(m_terrainNode)));
+	m_occlusion->AddOccluder(m_terrainOccluder.data(), sizeof(float) * 3, m_terrainOccluder.size() / 3,
+		m_terrainOccluderIndices.data(), m_terrainOccluderIndices.size(), &matrix._11);
+	m_entities.AddOccluders(*m_occlusion);
+	m_occlusion->Rasterize(m_jobs.get());
+	m_entities.Occlude(*m_occlusion);
+}
 
-// Shadow Pass
-	context->OMSetRenderTargets(1, m_shadowTargetView.GetAddressOf(), m_shadowDepthView.Get());
-	float color[4] = {0.0,0.0,0.0,1.0};
-	context->ClearRenderTargetView(m_shadowTargetView.Get(), color);
-	context->ClearDepthStencilView(m_shadowDepthView.Get(),D3D11_CLEAR_DEPTH, 1.0f, 0);
-	// Set shaders
-	context->VSSetShader(m_shadowVertexShader.Get(), nullptr, 0);
-	context->GSSetShader(nullptr, nullptr, 0);
-	context->PSSetShader(m_shadowPixelShader.Get(), nullptr, 0);
-	////Terrain
-	{
-		// Set Vertex Buffer
-		context->IASetVertexBuffers(0, 1, &Objs[0]->geo->components[0]->vertexBuffer, &strides, &offsets);
-		context->IASetIndexBuffer(Objs[0]->geo->components[0]->indexBuffer, DXGI_FORMAT_R16_UINT, 0);
-		// Set the constant buffer.
-		SetConstantBufferPars(Objs[0]->geo->components[0], Objs[0]->WorldM * Objs[0]->AnimM);
-		context->VSSetConstantBuffers(0, 1, m_MatrixBuffer.GetAddressOf());
-		context->VSSetConstantBuffers(1, 1, m_CameraBuffer.GetAddressOf());
-		context->PSSetConstantBuffers(0, 1, m_ColorBuffer.GetAddressOf());
-		// Draw
-		context->DrawIndexed(Objs[0]->geo->components[0]->indices.size(), 0, 0);
-	}
-	// Render Objects
-	// Start From 1
-	for (int i = 1; i < Objs.size(); i++) {
-		for (int j = 0; j < Objs[i]->geo->components.size(); j++) {
-			// Set Vertex Buffer
-			context->IASetVertexBuffers(0, 1, &Objs[i]->geo->components[j]->vertexBuffer, &strides, &offsets);
-			context->IASetIndexBuffer(Objs[i]->geo->components[j]->indexBuffer, DXGI_FORMAT_R16_UINT, 0);
-			
+// Render system: draws every entity with a mesh, material and transform. The shadow
+// pass draws all of them; the depth and main passes draw the entities left after
+// culling, nearest first. The shadow and depth passes only write depth.
+void Scene::RenderEntities(RenderPass pass) {
+	auto draw = [&](const MeshComponent& mesh, const TransformComponent& transform, const MaterialComponent& material) {
+		if (pass != RenderPass_Main) {
+			// Set Vertex Buffer and shader
+			SetVertexInput(mesh.vertexBuffer, mesh.indexBuffer, mesh.indexFormat, mesh.vertexFormat,
+				m_shadowVertexShader.Get(), m_shadowCompactVertexShader.Get(), m_shadowHeightVertexShader.Get());
 			// Set the constant buffer.
-			SetConstantBufferPars(Objs[i]->geo->components[j], Objs[i]->WorldM * Objs[i]->AnimM);
-			context->VSSetConstantBuffers(0, 1, m_MatrixBuffer.GetAddressOf());
-			context->VSSetConstantBuffers(1, 1, m_CameraBuffer.GetAddressOf());
-			context->PSSetConstantBuffers(0, 1, m_ColorBuffer.GetAddressOf());
+			SetConstantBufferPars(transform.world, material.color, mesh.vertexFormat, mesh.quantization);
+			BindConstantBuffers();
 			// Draw
-			context->DrawIndexed(Objs[i]->geo->components[j]->indices.size(), 0, 0);
-		}
-	}
-
-	//set render targets
-	context->OMSetRenderTargets(1, &renderTarget, depthStencil);
-	//context->ClearRenderTargetView(renderTargetView, D3D11Color(0.6f, 0.6f, 0.6f, 0));
-	context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
-
-//Skybox
-	{
-		// Set Vertex Buffer
-		context->IASetVertexBuffers(0, 1, &SkyBox->components[0]->vertexBuffer, &strides, &offsets);
-		context->IASetIndexBuffer(SkyBox->components[0]->indexBuffer, DXGI_FORMAT_R16_UINT, 0);
-		// Set shaders
-		context->VSSetShader(m_skyboxVertexShader.Get(), nullptr, 0);
-		context->GSSetShader(nullptr, nullptr, 0);
-		context->PSSetShader(m_skyboxPixelShader.Get(), nullptr, 0);
-		// Set the constant buffer.
-		SetConstantBufferPars(SkyBox->components[0], XMMatrixIdentity());
-		context->VSSetConstantBuffers(0, 1, m_MatrixBuffer.GetAddressOf());
-		context->VSSetConstantBuffers(1, 1, m_CameraBuffer.GetAddressOf());
-		context->PSSetConstantBuffers(0, 1, m_ColorBuffer.GetAddressOf());
-		// Set Sampler and Tex
-		if (SkyBox->components[0]->texture != nullptr) {
-			// Set texture and sampler.
-			auto sampler = m_spSampler.Get();
-			context->PSSetSamplers(0, 1, &sampler);
-			auto texture = SkyBox->components[0]->texture;
-			context->PSSetShaderResources(0, 1, &texture);
+			m_render->DrawIndexed(mesh.indexCount, 0, 0);
+			return;
 		}
-		// Draw
-		context->DrawIndexed(SkyBox->components[0]->indices.size(), 0, 0);
-	}
 
-	//Terrain
-	{
 		// Set Vertex Buffer
-		context->IASetVertexBuffers(0, 1, &Objs[0]->geo->components[0]->vertexBuffer, &strides, &offsets);
-		context->IASetIndexBuffer(Objs[0]->geo->components[0]->indexBuffer, DXGI_FORMAT_R16_UINT, 0);
+		SetVertexInput(mesh.vertexBuffer, mesh.indexBuffer, mesh.indexFormat, mesh.vertexFormat,
+			m_spVertexShader.Get(), m_compactVertexShader.Get(), nullptr);
 		// Set shaders
-		context->VSSetShader(m_terrainVertexShader.Get(), nullptr, 0);
-		context->GSSetShader(nullptr, nullptr, 0);
-		context->PSSetShader(m_terrainPixelShader.Get(), nullptr, 0);
+		m_render->PSSetShader(ToGpu(m_spPixelShader.Get()));
 		// Set the constant buffer.
-		SetConstantBufferPars(Objs[0]->geo->components[0], Objs[0]->WorldM * Objs[0]->AnimM);
-		context->VSSetConstantBuffers(0, 1, m_MatrixBuffer.GetAddressOf());
-		context->VSSetConstantBuffers(1, 1, m_CameraBuffer.GetAddressOf());
-		context->PSSetConstantBuffers(0, 1, m_ColorBuffer.GetAddressOf());
+		SetConstantBufferPars(transform.world, material.color, mesh.vertexFormat, mesh.quantization);
+		BindConstantBuffers();
 		// Set Sampler and Tex
-		if (Objs[0]->geo->components[0]->texture != nullptr) {
+		if (material.texture != nullptr) {
 			// Set texture and sampler.
-			auto sampler = m_spSampler.Get();
-			context->PSSetSamplers(0, 1, &sampler);
-			auto texture = Objs[0]->geo->components[0]->texture;
-			context->PSSetShaderResources(0, 1, &texture);
+			auto sampler = ToGpu(m_spSampler.Get());
+			m_render->PSSetSamplers(0, 1, &sampler);
+			auto texture = ToGpu(material.texture);
+			m_render->PSSetShaderResources(0, 1, &texture);
 		}
 		// Normal Map
-		if (Objs[0]->geo->components[0]->normalMap != nullptr) {
+		if (material.normalMap != nullptr) {
 			// Set texture and sampler.
-			auto sampler = m_spSampler.Get();
-			context->PSSetSamplers(1, 1, &sampler);
-			auto normalMap = Objs[0]->geo->components[0]->normalMap;
-			context->PSSetShaderResources(1, 1, &normalMap);
+			auto sampler = ToGpu(m_spSampler.Get());
+			m_render->PSSetSamplers(1, 1, &sampler);
+			auto normalMap = ToGpu(material.normalMap);
+			m_render->PSSetShaderResources(1, 1, &normalMap);
 		}
 		// Set Shadow Map
 		{
-			auto sampler = m_spSampler.Get();
-			context->PSSetSamplers(2, 1, &sampler);
-			context->PSSetShaderResources(2, 1, m_shadowResourceView.GetAddressOf());
+			auto sampler = ToGpu(m_spSampler.Get());
+			m_render->PSSetSamplers(2, 1, &sampler);
+			auto shadowMap = ToGpu(m_shadowResourceView.Get());
+			m_render->PSSetShaderResources(2, 1, &shadowMap);
 		}
 		// Draw
-		context->DrawIndexed(Objs[0]->geo->components[0]->indices.size(), 0, 0);
+		m_render->DrawIndexed(mesh.indexCount, 0, 0);
+	};
+
+	if (pass == RenderPass_Shadow) {
+		ForEach(m_entities.meshes, m_entities.transforms, m_entities.materials,
+			[&](Entity, const MeshComponent& mesh, const TransformComponent& transform, const MaterialComponent& material) {
+			draw(mesh, transform, material);
+		});
+		return;
+	}
+	for (size_t i = 0; i < m_entities.drawOrderCount; i++) {
+		uint32_t slot = m_entities.drawOrder[i];
+		draw(m_entities.meshes.Data()[slot], m_entities.transforms.Data()[slot], m_entities.materials.Data()[slot]);
 	}
+}
 
-	
-	// Start From 1
-	for (int i = 1; i < Objs.size(); i++) {
-		for (int j = 0; j < Objs[i]->geo->components.size(); j++) {
-			// Set Vertex Buffer
-			context->IASetVertexBuffers(0, 1, &Objs[i]->geo->components[j]->vertexBuffer, &strides, &offsets);
-			context->IASetIndexBuffer(Objs[i]->geo->components[j]->indexBuffer, DXGI_FORMAT_R16_UINT, 0);
+// Terrain counterpart of RenderEntities.
+void Scene::RenderTerrain(RenderPass pass) {
+	XMMATRIX viewProj = pass == RenderPass_Shadow ? m_lightCamera.ViewProj() : Cam.ViewProj();
+	for (auto component : Terrain->components) {
+		if (pass == RenderPass_Main) {
 			// Set shaders
-			context->VSSetShader(m_spVertexShader.Get(), nullptr, 0);
-			context->GSSetShader(nullptr, nullptr, 0);
-			context->PSSetShader(m_spPixelShader.Get(), nullptr, 0);
-			// Set the constant buffer.
-			SetConstantBufferPars(Objs[i]->geo->components[j], Objs[i]->WorldM * Objs[i]->AnimM);
-			context->VSSetConstantBuffers(0, 1, m_MatrixBuffer.GetAddressOf());
-			context->VSSetConstantBuffers(1, 1, m_CameraBuffer.GetAddressOf());
-			context->PSSetConstantBuffers(0, 1, m_ColorBuffer.GetAddressOf());
+			m_render->PSSetShader(ToGpu(m_terrainPixelShader.Get()));
+		}
+		// Set the constant buffer.
+		SetConstantBufferPars(component, ToXMMatrix(m_sceneGraph.World(m_terrainNode)));
+		BindConstantBuffers();
+		if (pass == RenderPass_Main) {
 			// Set Sampler and Tex
-			if (Objs[i]->geo->components[j]->texture != nullptr) {
+			if (component->texture != nullptr) {
 				// Set texture and sampler.
-				auto sampler = m_spSampler.Get();
-				context->PSSetSamplers(0, 1, &sampler);
-				auto texture = Objs[i]->geo->components[j]->texture;
-				context->PSSetShaderResources(0, 1, &texture);
+				auto sampler = ToGpu(m_spSampler.Get());
+				m_render->PSSetSamplers(0, 1, &sampler);
+				auto texture = ToGpu(component->texture);
+				m_render->PSSetShaderResources(0, 1, &texture);
 			}
 			// Normal Map
-			if (Objs[i]->geo->components[j]->normalMap != nullptr) {
+			if (component->normalMap != nullptr) {
 				// Set texture and sampler.
-				auto sampler = m_spSampler.Get();
-				context->PSSetSamplers(1, 1, &sampler);
-				auto normalMap = Objs[i]->geo->components[j]->normalMap;
-				context->PSSetShaderResources(2, 1, &normalMap);
+				auto sampler = ToGpu(m_spSampler.Get());
+				m_render->PSSetSamplers(1, 1, &sampler);
+				auto normalMap = ToGpu(component->normalMap);
+				m_render->PSSetShaderResources(1, 1, &normalMap);
 			}
 			// Set Shadow Map
 			{
-				auto sampler = m_spSampler.Get();
-				context->PSSetSamplers(2, 1, &sampler);
-				context->PSSetShaderResources(2, 1, m_shadowResourceView.GetAddressOf());
+				auto sampler = ToGpu(m_spSampler.Get());
+				m_render->PSSetSamplers(2, 1, &sampler);
+				auto shadowMap = ToGpu(m_shadowResourceView.Get());
+				m_render->PSSetShaderResources(2, 1, &shadowMap);
 			}
-			// Draw
-			context->DrawIndexed(Objs[i]->geo->components[j]->indices.size(), 0, 0);
 		}
+		// Draw
+		if (Terrain->gpuDisplacement) {
+			DrawTerrainChunks(component, pass == RenderPass_Main ? m_terrainPatchVertexShader.Get() : m_shadowPatchVertexShader.Get(),
+				ToXMMatrix(m_sceneGraph.World(m_terrainNode)), viewProj);
+		}
+		else if (pass == RenderPass_Main) {
+			SetVertexInput(component, m_terrainVertexShader.Get(), m_compactVertexShader.Get(), m_terrainHeightVertexShader.Get());
+			m_render->DrawIndexed(component->indices.size(), 0, 0);
+		}
+		else {
+			SetVertexInput(component, m_shadowVertexShader.Get(), m_shadowCompactVertexShader.Get(), m_shadowHeightVertexShader.Get());
+			m_render->DrawIndexed(component->indices.size(), 0, 0);
+		}
+	}
+}
+
+// Lighting system: lamps follow their nodes, are binned into the camera's froxels on
+// the job system and uploaded with the per-cluster lists for the pixel shaders.
+void Scene::UpdateLightClusters() {
+	for (size_t i = 0; i < m_lamps.size(); i++) {
+		m_lamps[i] = m_lampsLocal[i];
+		if (m_lampNodes[i] >= 0) {
+			XMVECTOR position = XMVector3Transform(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(m_lampsLocal[i].position)),
+				ToXMMatrix(m_sceneGraph.World(m_sceneNodes[m_lampNodes[i]])));
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(m_lamps[i].position), position);
+		}
+	}
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, Cam.View());
+	if (Cam.ProjRevision() != m_clusterProjRevision) {
+		XMFLOAT4X4 projection;
+		XMStoreFloat4x4(&projection, Cam.Proj());
+		m_lightClusters->SetProjection(&projection._11, Cam.GetNearZ(), Cam.GetFarZ());
+		m_clusterProjRevision = Cam.ProjRevision();
 	}
+	m_lightClusters->Bin(m_lamps.data(), m_lamps.size(), &view._11, m_jobs.get());
 
+	const std::vector<uint32_t>& indices = m_lightClusters->LightIndices();
+	if (indices.size() > m_lightIndexCapacity) {
+		m_lightIndexCapacity = std::max(indices.size(), m_lightIndexCapacity * 2);
+		CreateDynamicStructuredBuffer(m_deviceResources->GetD3DDevice(), sizeof(uint32_t), UINT(m_lightIndexCapacity),
+			m_lightIndexBuffer, m_lightIndexView);
+	}
+	if (!m_lamps.empty()) {
+		memcpy(m_render->Map(ToGpu(m_lampBuffer.Get())), m_lamps.data(), m_lamps.size() * sizeof(PointLight));
+		m_render->Unmap(ToGpu(m_lampBuffer.Get()));
+	}
+	const std::vector<LightClusters::Cluster>& clusters = m_lightClusters->Clusters();
+	memcpy(m_render->Map(ToGpu(m_lightClusterBuffer.Get())), clusters.data(), clusters.size() * sizeof(LightClusters::Cluster));
+	m_render->Unmap(ToGpu(m_lightClusterBuffer.Get()));
+	if (!indices.empty()) {
+		memcpy(m_render->Map(ToGpu(m_lightIndexBuffer.Get())), indices.data(), indices.size() * sizeof(uint32_t));
+		m_render->Unmap(ToGpu(m_lightIndexBuffer.Get()));
+	}
+
+	auto viewport = m_deviceResources->GetScreenViewport();
+	LightClusterConstants constants = m_lightClusters->Constants(&view._11, viewport.Width, viewport.Height,
+		m_clusteredLights ? uint32_t(m_lamps.size()) : 0);
+	memcpy(m_render->Map(ToGpu(m_ClusterBuffer.Get())), &constants, sizeof(constants));
+	m_render->Unmap(ToGpu(m_ClusterBuffer.Get()));
+
+	GpuBuffer* clusterBuffer = ToGpu(m_ClusterBuffer.Get());
+	m_render->PSSetConstantBuffers(1, 1, &clusterBuffer);
+	GpuTexture* views[3] = { ToGpu(m_lampView.Get()), ToGpu(m_lightClusterView.Get()), ToGpu(m_lightIndexView.Get()) };
+	m_render->PSSetShaderResources(3, 3, views);
+}
+
+// Snowfall system: steps every emitter's flakes in snowfallCompute.hlsl. Emitters that
+// follow the camera are recentered first; flakes then wrap into the moved box.
+void Scene::SimulateSnow(float deltaTime) {
+	m_render->CSSetShader(ToGpu(m_snowfallComputeShader.Get()));
+	GpuBuffer* params = ToGpu(m_SnowfallBuffer.Get());
+	m_render->CSSetConstantBuffers(0, 1, &params);
+	GpuTexture* ground = ToGpu(m_snowGroundView.Get());
+	m_render->CSSetShaderResources(0, 1, &ground);
+	for (size_t i = 0; i < m_snowEmitters.size(); i++) {
+		SnowEmitter& emitter = m_snowEmitters[i];
+		if (emitter.followCamera) {
+			emitter.center[0] = Cam.GetPosition().x;
+			emitter.center[1] = Cam.GetPosition().y;
+			emitter.center[2] = Cam.GetPosition().z;
+		}
+		SnowfallParams step = Snowfall::MakeParams(emitter, m_snowGround, deltaTime);
+		memcpy(m_render->Map(params), &step, sizeof(step));
+		m_render->Unmap(params);
+		GpuUnorderedAccess* particles = ToGpu(m_snowEmitterResources[i].particleAccess.Get());
+		m_render->CSSetUnorderedAccessViews(0, 1, &particles);
+		m_render->Dispatch((emitter.count + 255) / 256, 1, 1);
+	}
+}
+
+// Draws every flake as a camera facing quad: no vertex buffer, six indices instanced
+// once per flake.
+void Scene::RenderSnow() {
+	m_render->OMSetDepthStencilState(nullptr, 0);
+	SetConstantBufferPars(XMMatrixIdentity(), XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), VertexFormat_Full, VertexQuantization());
+	BindConstantBuffers();
+	m_render->IASetInputLayout(nullptr);
+	m_render->IASetIndexBuffer(ToGpu(m_snowQuadIndices.Get()), GpuIndex_16, 0);
+	m_render->VSSetShader(ToGpu(m_snowVertexShader.Get()));
+	m_render->PSSetShader(ToGpu(m_snowPixelShader.Get()));
+	for (size_t i = 0; i < m_snowEmitters.size(); i++) {
+		GpuTexture* particles = ToGpu(m_snowEmitterResources[i].particleView.Get());
+		m_render->VSSetShaderResources(0, 1, &particles);
+		m_render->DrawIndexedInstanced(6, m_snowEmitters[i].count, 0, 0, 0);
+	}
+}
+
+// One billboard per visible impostor: six indices instanced once per impostor, the
+// frames sampled from the atlas.
+void Scene::RenderImpostors() {
+	const size_t instanceCount = m_entities.impostorInstanceCount;
+	if (!m_impostorAtlas || instanceCount == 0)
+		return;
+	m_impostorAtlas->Reserve(m_deviceResources->GetD3DDevice(), instanceCount);
+	memcpy(m_render->Map(ToGpu(m_impostorAtlas->Instances())), m_entities.impostorInstances, instanceCount * sizeof(ImpostorInstance));
+	m_render->Unmap(ToGpu(m_impostorAtlas->Instances()));
+	ImpostorBufferType constants = m_impostorAtlas->Constants(Cam.ViewProj(), Cam.GetPosition());
+	memcpy(m_render->Map(ToGpu(m_impostorAtlas->ConstantBuffer())), &constants, sizeof(constants));
+	m_render->Unmap(ToGpu(m_impostorAtlas->ConstantBuffer()));
+
+	m_render->OMSetDepthStencilState(nullptr, 0);
+	GpuBuffer* buffer = ToGpu(m_impostorAtlas->ConstantBuffer());
+	m_render->VSSetConstantBuffers(4, 1, &buffer);
+	m_render->PSSetConstantBuffers(4, 1, &buffer);
+	m_render->IASetInputLayout(nullptr);
+	m_render->IASetIndexBuffer(ToGpu(m_impostorAtlas->QuadIndices()), GpuIndex_16, 0);
+	m_render->VSSetShader(ToGpu(m_impostorVertexShader.Get()));
+	m_render->PSSetShader(ToGpu(m_impostorPixelShader.Get()));
+	GpuTexture* instanceView = ToGpu(m_impostorAtlas->InstanceView());
+	m_render->VSSetShaderResources(0, 1, &instanceView);
+	GpuTexture* frames[2] = { ToGpu(m_impostorAtlas->Albedo()), ToGpu(m_impostorAtlas->NormalDepth()) };
+	m_render->PSSetShaderResources(0, 2, frames);
+	GpuSampler* sampler = ToGpu(m_impostorAtlas->Sampler());
+	m_render->PSSetSamplers(0, 1, &sampler);
+	m_render->DrawIndexedInstanced(6, uint32_t(instanceCount), 0, 0, 0);
+}
+
+void Scene::RenderPostProcess(float deltaTime) {
+	float exposure = 0.0f;
+	if (m_autoExposureEnabled) {
+		// Histograms arrive a few frames late; adapt towards the newest every frame
+		uint32_t histogram[AutoExposure::HistogramBins];
+		if (m_luminanceHistogram->Collect(histogram))
+			m_autoExposure.SetHistogram(histogram);
+		exposure = m_autoExposure.Adapt(deltaTime);
+		auto viewport = m_deviceResources->GetScreenViewport();
+		m_luminanceHistogram->Build(m_luminanceComputeShader.Get(), m_hdrSceneView.Get(),
+			m_autoExposure.Constants(UINT(viewport.Width), UINT(viewport.Height)));
+	}
+	// The exposure only applies to the SDR curves; on HDR10 it scales paper white instead
+	m_toneMap->SetExposure(exposure);
+	m_toneMap->SetST2084Parameter(m_paperWhiteNits * std::exp2(exposure));
+	m_postProcess->Process(m_deviceResources->GetD3DDeviceContext(), *m_toneMap, m_hdrSceneView.Get(),
+		m_deviceResources->GetRenderTargetView(), m_fullScreenVertexShader.Get(), m_fxaaPixelShader.Get());
+}
+
+void Scene::ConfigurePostProcess() {
+	auto viewport = m_deviceResources->GetScreenViewport();
+	m_postProcess->Configure(m_deviceResources->GetD3DDevice(), m_postProcessSettings, UINT(viewport.Width), UINT(viewport.Height),
+		m_deviceResources->GetBackBufferFormat());
+}
+
+// Draws the scene.
+void Scene::Render()
+{
+    // Don't try to render anything before the first Update.
+    if (m_timer.GetFrameCount() == 0)
+    {
+        return;
+    }
+
+	float frameCount = float(m_timer.GetFrameCount());
+    m_deviceResources->PIXBeginEvent(L"Render");
+	m_pipelineStats->Collect();
+	m_pipelineStats->BeginFrame();
+
+    // Set input assembler state.
+    m_render->IASetPrimitiveTopology(GpuTopology_TriangleList);
+	GpuBuffer* quantBuffer = ToGpu(m_QuantBuffer.Get());
+	m_render->VSSetConstantBuffers(2, 1, &quantBuffer);
+
+	auto depthStencil = m_deviceResources->GetDepthStencilView();
+
+	// Animation: the turntable carrying the box and snowman 2 is spun, and the camera
+	// riding the box carried, by Update
+	// Transform system
+	{
+		ProfileScope scope(*m_profiler, "Transforms");
+		m_sceneGraph.Update();
+		m_entities.UpdateTransforms(m_sceneGraph);
+	}
+
+	// Levels of detail first: culling skips the parts of drawables drawn as impostors
+	{
+		ProfileScope scope(*m_profiler, "LOD selection");
+		LodSettings settings = m_lodSettings;
+		if (!m_lodEnabled) {
+			for (float& size : settings.screenSizes)
+				size = 0.0f;
+			settings.impostorSize = 0.0f;
+		}
+		XMFLOAT4X4 projection;
+		XMStoreFloat4x4(&projection, Cam.Proj());
+		m_entities.SelectLods(settings, Cam.View(), projection._22, m_jobs.get());
+	}
+	// Culling, then objects nearest first, ahead of the terrain they stand on
+	{
+		ProfileScope scope(*m_profiler, "Culling");
+		m_entities.Cull(Cam.Frustum(), m_jobs.get());
+		if (m_occlusionCulling)
+			CullOccluded(Cam.ViewProj());
+		m_entities.SortFrontToBack(Cam.View(), m_frameMemory->Arena());
+		m_entities.GatherImpostors(m_frameMemory->Arena());
+	}
+	{
+		ProfileScope scope(*m_profiler, "Light binning");
+		UpdateLightClusters();
+	}
+	SetPassMatrices(Cam.View(), Cam.Proj(), m_lightCamera.View(), m_lightCamera.Proj());
+
+	// The GPU passes, as a graph of what each reads and writes; the graph unbinds whatever
+	// a pass is about to write while it is still bound for sampling, and the other way round
+	RenderGraph& graph = m_frameGraph;
+	graph.Reset();
+	const uint32_t hdrScene = graph.Import("HDR scene", ToGpu(m_hdrSceneView.Get()));
+	const uint32_t depth = graph.Import("Depth", ToGpu(depthStencil));
+	const uint32_t shadowMap = graph.Import("Shadow map", ToGpu(m_shadowResourceView.Get()));
+	const uint32_t shadowDepth = graph.Import("Shadow depth", ToGpu(m_shadowDepthView.Get()));
+	const uint32_t backBuffer = graph.Import("Back buffer", ToGpu(m_deviceResources->GetRenderTargetView()));
+	const uint32_t snowGround = graph.Import("Snow ground", ToGpu(m_snowGroundView.Get()));
+	const uint32_t firstParticles = uint32_t(graph.ResourceCount());
+	for (const SnowEmitterResources& emitter : m_snowEmitterResources)
+		graph.Import("Snow particles", ToGpu(emitter.particleView.Get()));
+
+	uint32_t pass = graph.AddPass("Clear", [this](RenderBackend&) { Clear(); });
+	graph.WriteTarget(pass, hdrScene);
+	graph.WriteTarget(pass, depth);
+
+	if (m_snowfall) {
+		pass = graph.AddPass("Snowfall", [this](RenderBackend&) {
+			RenderProfileScope scope(*m_profiler, "Snowfall");
+			// Long frames (a breakpoint, a resize) would throw every flake to the ground at once
+			SimulateSnow(std::min(float(m_timer.GetElapsedSeconds()), 0.1f));
+		});
+		graph.Read(pass, snowGround, RenderGraphStage_Compute, 0);
+		for (uint32_t i = 0; i < uint32_t(m_snowEmitterResources.size()); i++)
+			graph.WriteUnorderedAccess(pass, firstParticles + i, 0);
+	}
+
+	pass = graph.AddPass("Shadow pass", [this](RenderBackend&) {
+		RenderProfileScope scope(*m_profiler, "Shadow pass");
+		m_render->OMSetRenderTargets(ToGpu(m_shadowTargetView.Get()), ToGpu(m_shadowDepthView.Get()));
+		float color[4] = {0.0,0.0,0.0,1.0};
+		m_render->ClearRenderTarget(ToGpu(m_shadowTargetView.Get()), color);
+		m_render->ClearDepthStencil(ToGpu(m_shadowDepthView.Get()), GpuClear_Depth, 1.0f, 0);
+		// Set shaders
+		m_render->PSSetShader(ToGpu(m_shadowPixelShader.Get()));
+		RenderTerrain(RenderPass_Shadow);
+		RenderEntities(RenderPass_Shadow);
+	});
+	graph.WriteTarget(pass, shadowMap);
+	graph.WriteTarget(pass, shadowDepth);
+
+	// Depth pre-pass: the main pass then shades each pixel once, under an EQUAL test
+	if (m_depthPrePass) {
+		pass = graph.AddPass("Depth pre-pass", [this](RenderBackend&) {
+			RenderProfileScope scope(*m_profiler, "Depth pre-pass");
+			PipelineStatsScope stats(m_pipelineStats.get(), "Depth pre-pass");
+			m_render->OMSetRenderTargets(ToGpu(m_hdrTargetView.Get()), ToGpu(m_deviceResources->GetDepthStencilView()));
+			// The shadow vertex shaders transform by the light matrices; point them at the camera
+			SetPassMatrices(Cam.View(), Cam.Proj(), Cam.View(), Cam.Proj());
+			m_render->PSSetShader(nullptr);
+			RenderEntities(RenderPass_Depth);
+			RenderTerrain(RenderPass_Depth);
+			SetPassMatrices(Cam.View(), Cam.Proj(), m_lightCamera.View(), m_lightCamera.Proj());
+			m_render->OMSetDepthStencilState(ToGpu(m_depthEqualState.Get()), 0);
+		});
+		graph.WriteTarget(pass, hdrScene);
+		graph.WriteTarget(pass, depth);
+	}
+
+	// Render Objects
+	pass = graph.AddPass("Objects", [this](RenderBackend&) {
+		RenderProfileScope scope(*m_profiler, "Objects");
+		PipelineStatsScope stats(m_pipelineStats.get(), "Objects");
+		m_render->OMSetRenderTargets(ToGpu(m_hdrTargetView.Get()), ToGpu(m_deviceResources->GetDepthStencilView()));
+		RenderEntities(RenderPass_Main);
+	});
+	graph.Read(pass, shadowMap, RenderGraphStage_Pixel, 2);
+	graph.WriteTarget(pass, hdrScene);
+	graph.WriteTarget(pass, depth);
+
+	//Terrain
+	pass = graph.AddPass("Terrain", [this](RenderBackend&) {
+		RenderProfileScope scope(*m_profiler, "Terrain");
+		PipelineStatsScope stats(m_pipelineStats.get(), "Terrain");
+		RenderTerrain(RenderPass_Main);
+	});
+	graph.Read(pass, shadowMap, RenderGraphStage_Pixel, 2);
+	graph.WriteTarget(pass, hdrScene);
+	graph.WriteTarget(pass, depth);
+
+	// Distant drawables as billboards; not in the pre-pass, so after the EQUAL tested passes
+	if (m_entities.impostorInstanceCount > 0) {
+		pass = graph.AddPass("Impostors", [this](RenderBackend&) {
+			RenderProfileScope scope(*m_profiler, "Impostors");
+			PipelineStatsScope stats(m_pipelineStats.get(), "Impostors");
+			RenderImpostors();
+		});
+		graph.Read(pass, graph.Import("Impostor albedo", ToGpu(m_impostorAtlas->Albedo())), RenderGraphStage_Pixel, 0);
+		graph.Read(pass, graph.Import("Impostor normal and depth", ToGpu(m_impostorAtlas->NormalDepth())), RenderGraphStage_Pixel, 1);
+		graph.WriteTarget(pass, hdrScene);
+		graph.WriteTarget(pass, depth);
+	}
+
+	// Snow, depth tested against everything opaque but not part of the pre-pass
+	if (m_snowfall) {
+		pass = graph.AddPass("Snow", [this](RenderBackend&) {
+			RenderProfileScope scope(*m_profiler, "Snow");
+			PipelineStatsScope stats(m_pipelineStats.get(), "Snow");
+			RenderSnow();
+		});
+		for (uint32_t i = 0; i < uint32_t(m_snowEmitterResources.size()); i++)
+			graph.Read(pass, firstParticles + i, RenderGraphStage_Vertex, 0);
+		graph.WriteTarget(pass, hdrScene);
+		graph.WriteTarget(pass, depth);
+	}
+
+	// Skybox, last so only the pixels nothing else covered are shaded
+	pass = graph.AddPass("Skybox", [this](RenderBackend&) {
+		RenderProfileScope scope(*m_profiler, "Skybox");
+		PipelineStatsScope stats(m_pipelineStats.get(), "Skybox");
+		m_render->OMSetDepthStencilState(ToGpu(m_skyDepthState.Get()), 0);
+		// Set Vertex Buffer
+		SetVertexInput(SkyBox->components[0], m_skyboxVertexShader.Get(), nullptr, nullptr);
+		// Set shaders
+		m_render->PSSetShader(ToGpu(m_skyboxPixelShader.Get()));
+		// Set the constant buffer.
+		SetConstantBufferPars(SkyBox->components[0], XMMatrixIdentity());
+		BindConstantBuffers();
+		// Set Sampler and Tex
+		if (SkyBox->components[0]->texture != nullptr) {
+			// Set texture and sampler.
+			auto sampler = ToGpu(m_spSampler.Get());
+			m_render->PSSetSamplers(0, 1, &sampler);
+			auto texture = ToGpu(SkyBox->components[0]->texture);
+			m_render->PSSetShaderResources(0, 1, &texture);
+		}
+		// Draw
+		m_render->DrawIndexed(SkyBox->components[0]->indices.size(), 0, 0);
+		m_render->OMSetDepthStencilState(nullptr, 0);
+	});
+	graph.WriteTarget(pass, hdrScene);
+	graph.WriteTarget(pass, depth);
+
+	// HDR scene to the back buffer
+	pass = graph.AddPass("Post-processing", [this](RenderBackend&) {
+		RenderProfileScope scope(*m_profiler, "Post-processing");
+		RenderPostProcess(float(m_timer.GetElapsedSeconds()));
+	});
+	graph.Read(pass, hdrScene, RenderGraphStage_Pixel, 0);
+	graph.WriteTarget(pass, backBuffer);
+	graph.SetSideEffects(pass);
+
+	graph.Compile();
+	graph.Execute(*m_render);
+
+	m_pipelineStats->EndFrame();
+	CaptureBackBuffer();
     m_deviceResources->PIXEndEvent();
     // Show the new frame.
     m_deviceResources->Present();
 }
 
+void Scene::CaptureBackBuffer() {
+	const uint64_t frame = m_timer.GetFrameCount();
+	ID3D11Texture2D* backBuffer = m_deviceResources->GetRenderTarget();
+	if (m_captureSequence)
+		m_frameCapture->Capture(backBuffer, frame, CaptureEncoding_Raw);
+	// A screenshot waits for a free staging texture rather than being lost
+	if (m_captureShot && m_frameCapture->Capture(backBuffer, frame, m_captureShotEncoding))
+		m_captureShot = false;
+	m_frameCapture->Collect(frame);
+	if (m_captureSequenceEnding && !m_frameCapture->Pending()) {
+		m_captureEncoder->EndSequence();
+		m_captureSequenceEnding = false;
+	}
+}
+
 // Helper method to clear the back buffers.
 void Scene::Clear()
 {
@@ -424,15 +1151,21 @@ void Scene::Clear()
 
     // Clear the views.
     auto context = m_deviceResources->GetD3DDeviceContext();
-    auto renderTarget = m_deviceResources->GetRenderTargetView();
     auto depthStencil = m_deviceResources->GetDepthStencilView();
 
-    // Use linear clear color for gamma-correct rendering.
-    context->ClearRenderTargetView(renderTarget, ATG::ColorsLinear::Background);
+    // Use linear clear color for gamma-correct rendering. The back buffer is
+    // entirely overwritten by the tone mapping, so only the HDR target is cleared.
+    m_render->ClearRenderTarget(ToGpu(m_hdrTargetView.Get()), ATG::ColorsLinear::Background);
+
+    m_render->ClearDepthStencil(ToGpu(depthStencil), GpuClear_Depth | GpuClear_Stencil, 1.0f, 0);
 
-    context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+    m_render->OMSetRenderTargets(ToGpu(m_hdrTargetView.Get()), ToGpu(depthStencil));
 
-    context->OMSetRenderTargets(1, &renderTarget, depthStencil);
+    // Back to the default blend, depth-stencil and rasterizer states the post-processing
+    // changed; its passes leave depth testing and writes off
+    context->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+    m_render->OMSetDepthStencilState(nullptr, 0);
+    context->RSSetState(nullptr);
 
     // Set the viewport.
     auto viewport = m_deviceResources->GetScreenViewport();
@@ -482,34 +1215,19 @@ void Scene::GetDefaultSize(int& width, int& height) const
 void Scene::CreateDeviceDependentResources()
 {
     auto device = m_deviceResources->GetD3DDevice();
+	m_render = std::make_unique<D3D11RenderBackend>(device, m_deviceResources->GetD3DDeviceContext());
 
-	D3D11_DEPTH_STENCIL_DESC dsDesc;
-
-	// Depth test parameters
+	// The sky is drawn last at the far plane: it passes only where nothing else was drawn
+	D3D11_DEPTH_STENCIL_DESC dsDesc = {};
 	dsDesc.DepthEnable = true;
-	dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
 	dsDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-
-	// Stencil test parameters
-	dsDesc.StencilEnable = true;
-	dsDesc.StencilReadMask = 0xFF;
-	dsDesc.StencilWriteMask = 0xFF;
-
-	// Stencil operations if pixel is front-facing
-	dsDesc.FrontFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
-	dsDesc.FrontFace.StencilDepthFailOp = D3D11_STENCIL_OP_INCR;
-	dsDesc.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
-	dsDesc.FrontFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
-
-	// Stencil operations if pixel is back-facing
-	dsDesc.BackFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
-	dsDesc.BackFace.StencilDepthFailOp = D3D11_STENCIL_OP_DECR;
-	dsDesc.BackFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
-	dsDesc.BackFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
-
-	// Create depth stencil state
-	ID3D11DepthStencilState * pDSState;	
-	device->CreateDepthStencilState(&dsDesc, &pDSState);
+	DX::ThrowIfFailed(
+		device->CreateDepthStencilState(&dsDesc, m_skyDepthState.ReleaseAndGetAddressOf()));
+	// After the depth pre-pass only the nearest surface of each pixel is shaded
+	dsDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+	DX::ThrowIfFailed(
+		device->CreateDepthStencilState(&dsDesc, m_depthEqualState.ReleaseAndGetAddressOf()));
 
    // Load and create shaders.
     auto vertexShaderBlob = DX::ReadData(L"VertexShader.cso");
@@ -559,6 +1277,121 @@ void Scene::CreateDeviceDependentResources()
 	DX::ThrowIfFailed(
 		device->CreatePixelShader(shadowPixelShaderBlob.data(), shadowPixelShaderBlob.size(),
 			nullptr, m_shadowPixelShader.ReleaseAndGetAddressOf()));
+
+	auto compactVertexShaderBlob = DX::ReadData(L"VertexShaderCompact.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(compactVertexShaderBlob.data(), compactVertexShaderBlob.size(),
+			nullptr, m_compactVertexShader.ReleaseAndGetAddressOf()));
+
+	auto terrainHeightVertexShaderBlob = DX::ReadData(L"terrainVertHeight.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(terrainHeightVertexShaderBlob.data(), terrainHeightVertexShaderBlob.size(),
+			nullptr, m_terrainHeightVertexShader.ReleaseAndGetAddressOf()));
+
+	auto shadowCompactVertexShaderBlob = DX::ReadData(L"shadowVertCompact.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(shadowCompactVertexShaderBlob.data(), shadowCompactVertexShaderBlob.size(),
+			nullptr, m_shadowCompactVertexShader.ReleaseAndGetAddressOf()));
+
+	auto shadowHeightVertexShaderBlob = DX::ReadData(L"shadowVertHeight.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(shadowHeightVertexShaderBlob.data(), shadowHeightVertexShaderBlob.size(),
+			nullptr, m_shadowHeightVertexShader.ReleaseAndGetAddressOf()));
+
+	auto terrainPatchVertexShaderBlob = DX::ReadData(L"terrainVertPatch.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(terrainPatchVertexShaderBlob.data(), terrainPatchVertexShaderBlob.size(),
+			nullptr, m_terrainPatchVertexShader.ReleaseAndGetAddressOf()));
+
+	auto shadowPatchVertexShaderBlob = DX::ReadData(L"shadowVertPatch.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(shadowPatchVertexShaderBlob.data(), shadowPatchVertexShaderBlob.size(),
+			nullptr, m_shadowPatchVertexShader.ReleaseAndGetAddressOf()));
+
+	auto snowfallComputeShaderBlob = DX::ReadData(L"snowfallCompute.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateComputeShader(snowfallComputeShaderBlob.data(), snowfallComputeShaderBlob.size(),
+			nullptr, m_snowfallComputeShader.ReleaseAndGetAddressOf()));
+
+	auto snowVertexShaderBlob = DX::ReadData(L"snowVert.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(snowVertexShaderBlob.data(), snowVertexShaderBlob.size(),
+			nullptr, m_snowVertexShader.ReleaseAndGetAddressOf()));
+
+	auto snowPixelShaderBlob = DX::ReadData(L"snowPixel.cso");
+
+	DX::ThrowIfFailed(
+		device->CreatePixelShader(snowPixelShaderBlob.data(), snowPixelShaderBlob.size(),
+			nullptr, m_snowPixelShader.ReleaseAndGetAddressOf()));
+
+	auto luminanceComputeShaderBlob = DX::ReadData(L"luminanceHistogram.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateComputeShader(luminanceComputeShaderBlob.data(), luminanceComputeShaderBlob.size(),
+			nullptr, m_luminanceComputeShader.ReleaseAndGetAddressOf()));
+
+	auto fullScreenVertexShaderBlob = DX::ReadData(L"fullScreenVert.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(fullScreenVertexShaderBlob.data(), fullScreenVertexShaderBlob.size(),
+			nullptr, m_fullScreenVertexShader.ReleaseAndGetAddressOf()));
+
+	auto fxaaPixelShaderBlob = DX::ReadData(L"fxaaPixel.cso");
+
+	DX::ThrowIfFailed(
+		device->CreatePixelShader(fxaaPixelShaderBlob.data(), fxaaPixelShaderBlob.size(),
+			nullptr, m_fxaaPixelShader.ReleaseAndGetAddressOf()));
+
+	auto impostorVertexShaderBlob = DX::ReadData(L"impostorVert.cso");
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(impostorVertexShaderBlob.data(), impostorVertexShaderBlob.size(),
+			nullptr, m_impostorVertexShader.ReleaseAndGetAddressOf()));
+
+	auto impostorPixelShaderBlob = DX::ReadData(L"impostorPixel.cso");
+
+	DX::ThrowIfFailed(
+		device->CreatePixelShader(impostorPixelShaderBlob.data(), impostorPixelShaderBlob.size(),
+			nullptr, m_impostorPixelShader.ReleaseAndGetAddressOf()));
+
+	auto impostorBakePixelShaderBlob = DX::ReadData(L"impostorBakePixel.cso");
+
+	DX::ThrowIfFailed(
+		device->CreatePixelShader(impostorBakePixelShaderBlob.data(), impostorBakePixelShaderBlob.size(),
+			nullptr, m_impostorBakePixelShader.ReleaseAndGetAddressOf()));
+
+	// Recompile shaders when their sources change
+	WatchShader(L"VertexShader.hlsl", m_spVertexShader);
+	WatchShader(L"PixelShader.hlsl", m_spPixelShader);
+	WatchShader(L"skyboxVert.hlsl", m_skyboxVertexShader);
+	WatchShader(L"skyboxPixel.hlsl", m_skyboxPixelShader);
+	WatchShader(L"terrainVert.hlsl", m_terrainVertexShader);
+	WatchShader(L"terrainPixel.hlsl", m_terrainPixelShader);
+	WatchShader(L"shadowVert.hlsl", m_shadowVertexShader);
+	WatchShader(L"shadowPixel.hlsl", m_shadowPixelShader);
+	WatchShader(L"VertexShaderCompact.hlsl", m_compactVertexShader);
+	WatchShader(L"terrainVertHeight.hlsl", m_terrainHeightVertexShader);
+	WatchShader(L"shadowVertCompact.hlsl", m_shadowCompactVertexShader);
+	WatchShader(L"shadowVertHeight.hlsl", m_shadowHeightVertexShader);
+	WatchShader(L"terrainVertPatch.hlsl", m_terrainPatchVertexShader);
+	WatchShader(L"shadowVertPatch.hlsl", m_shadowPatchVertexShader);
+	WatchShader(L"snowfallCompute.hlsl", m_snowfallComputeShader);
+	WatchShader(L"snowVert.hlsl", m_snowVertexShader);
+	WatchShader(L"snowPixel.hlsl", m_snowPixelShader);
+	WatchShader(L"luminanceHistogram.hlsl", m_luminanceComputeShader);
+	WatchShader(L"fullScreenVert.hlsl", m_fullScreenVertexShader);
+	WatchShader(L"fxaaPixel.hlsl", m_fxaaPixelShader);
+	WatchShader(L"impostorVert.hlsl", m_impostorVertexShader);
+	WatchShader(L"impostorPixel.hlsl", m_impostorPixelShader);
+	WatchShader(L"impostorBakePixel.hlsl", m_impostorBakePixelShader);
    // Create input layout.
     static const D3D11_INPUT_ELEMENT_DESC s_inputElementDesc[3] =
     {
@@ -582,6 +1415,43 @@ void Scene::CreateDeviceDependentResources()
 			terrainVertexShaderBlob.data(), terrainVertexShaderBlob.size(),
 			m_spInputLayout.ReleaseAndGetAddressOf()));
 
+	// Compact layouts (see VertexCodec.h)
+	static const D3D11_INPUT_ELEMENT_DESC s_compactElementDesc[3] =
+	{
+		{ "vs_Pos", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA,  0 },
+		{ "vs_Nor", 0, DXGI_FORMAT_R16G16_SNORM,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA , 0 },
+		{ "vs_Tex", 0, DXGI_FORMAT_R16G16_FLOAT,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA , 0 }
+	};
+
+	DX::ThrowIfFailed(
+		device->CreateInputLayout(s_compactElementDesc, _countof(s_compactElementDesc),
+			compactVertexShaderBlob.data(), compactVertexShaderBlob.size(),
+			m_compactInputLayout.ReleaseAndGetAddressOf()));
+
+	static const D3D11_INPUT_ELEMENT_DESC s_heightElementDesc[1] =
+	{
+		{ "vs_Height", 0, DXGI_FORMAT_R16_UNORM, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA,  0 }
+	};
+
+	DX::ThrowIfFailed(
+		device->CreateInputLayout(s_heightElementDesc, _countof(s_heightElementDesc),
+			terrainHeightVertexShaderBlob.data(), terrainHeightVertexShaderBlob.size(),
+			m_heightInputLayout.ReleaseAndGetAddressOf()));
+
+	// Terrain patch: shared grid in slot 0, chunk origins per instance in slot 1
+	static const D3D11_INPUT_ELEMENT_DESC s_patchElementDesc[4] =
+	{
+		{ "vs_Pos",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,  D3D11_INPUT_PER_VERTEX_DATA,  0 },
+		{ "vs_Nor",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA , 0 },
+		{ "vs_Tex",   0, DXGI_FORMAT_R32G32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA , 0 },
+		{ "vs_Chunk", 0, DXGI_FORMAT_R32G32_FLOAT,    1, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+	};
+
+	DX::ThrowIfFailed(
+		device->CreateInputLayout(s_patchElementDesc, _countof(s_patchElementDesc),
+			terrainPatchVertexShaderBlob.data(), terrainPatchVertexShaderBlob.size(),
+			m_patchInputLayout.ReleaseAndGetAddressOf()));
+
 // Create Constant buffer
 	// Fill in a buffer description.
 	D3D11_BUFFER_DESC cbDesc;
@@ -620,6 +1490,54 @@ void Scene::CreateDeviceDependentResources()
 		m_deviceResources->GetD3DDevice()->CreateBuffer(&color_cbDesc, NULL, m_ColorBuffer.GetAddressOf())
 	);
 
+	D3D11_BUFFER_DESC quant_cbDesc;
+	quant_cbDesc.ByteWidth = sizeof(VertexQuantization);
+	quant_cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	quant_cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	quant_cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	quant_cbDesc.MiscFlags = 0;
+	quant_cbDesc.StructureByteStride = 0;
+	// Create the buffer.
+	DX::ThrowIfFailed(
+		m_deviceResources->GetD3DDevice()->CreateBuffer(&quant_cbDesc, NULL, m_QuantBuffer.GetAddressOf())
+	);
+
+	D3D11_BUFFER_DESC terrain_cbDesc;
+	terrain_cbDesc.ByteWidth = sizeof(TerrainBufferType);
+	terrain_cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	terrain_cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	terrain_cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	terrain_cbDesc.MiscFlags = 0;
+	terrain_cbDesc.StructureByteStride = 0;
+	// Create the buffer.
+	DX::ThrowIfFailed(
+		m_deviceResources->GetD3DDevice()->CreateBuffer(&terrain_cbDesc, NULL, m_TerrainBuffer.GetAddressOf())
+	);
+
+	D3D11_BUFFER_DESC snowfall_cbDesc;
+	snowfall_cbDesc.ByteWidth = sizeof(SnowfallParams);
+	snowfall_cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	snowfall_cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	snowfall_cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	snowfall_cbDesc.MiscFlags = 0;
+	snowfall_cbDesc.StructureByteStride = 0;
+	// Create the buffer.
+	DX::ThrowIfFailed(
+		m_deviceResources->GetD3DDevice()->CreateBuffer(&snowfall_cbDesc, NULL, m_SnowfallBuffer.GetAddressOf())
+	);
+
+	D3D11_BUFFER_DESC cluster_cbDesc;
+	cluster_cbDesc.ByteWidth = sizeof(LightClusterConstants);
+	cluster_cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	cluster_cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cluster_cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	cluster_cbDesc.MiscFlags = 0;
+	cluster_cbDesc.StructureByteStride = 0;
+	// Create the buffer.
+	DX::ThrowIfFailed(
+		m_deviceResources->GetD3DDevice()->CreateBuffer(&cluster_cbDesc, NULL, m_ClusterBuffer.GetAddressOf())
+	);
+
 // Create Sampler
 // Create sampler.
 	D3D11_SAMPLER_DESC samplerDesc = {};
@@ -635,44 +1553,505 @@ void Scene::CreateDeviceDependentResources()
 		device->CreateSamplerState(&samplerDesc,
 			m_spSampler.ReleaseAndGetAddressOf()));
 
+	// GPU timestamps for the profiler
+	m_gpuTimer = std::make_unique<D3D11GpuTimer>(device, m_deviceResources->GetD3DDeviceContext());
+	m_profiler->SetGpuTimer(m_gpuTimer.get());
+	m_pipelineStats = std::make_unique<D3D11PipelineStats>(device, m_deviceResources->GetD3DDeviceContext());
+	// Tone mapping and the luminance histogram for its exposure, then bloom and FXAA
+	m_toneMap = std::make_unique<ToneMapPostProcess>(device);
+	m_postProcess = std::make_unique<D3D11PostProcess>(device);
+	m_luminanceHistogram = std::make_unique<D3D11LuminanceHistogram>(device, m_deviceResources->GetD3DDeviceContext());
+	m_autoExposure.Reset();
+	// Copies lost with an old device are never read back, so a sequence they ended is over
+	m_frameCapture = std::make_unique<D3D11FrameCapture>(device, m_deviceResources->GetD3DDeviceContext(), *m_captureEncoder);
+	if (m_captureSequenceEnding) {
+		m_captureEncoder->EndSequence();
+		m_captureSequenceEnding = false;
+	}
+
 // Create Shadow Map info
 	CreateRenderToTextureResources();
-	XMMATRIX lightView, lightProj;
-	Cam.SetPosition(-20.0, 20.0, -20.0);
-	m_pitch = -0.25*PI;
-	m_yaw = 0.25*PI;
-	Cam.Turn(m_pitch, m_yaw);
-	Cam.UpdateViewMatrix();
-	lightView = Cam.View();
-	lightProj = XMMatrixOrthographicLH(30.0, 30.0, Cam.GetNearZ(), Cam.GetFarZ());
-	this->lightView = lightView;
-	this->lightProjection = lightProj;
-// Create Skybox
-	this->SkyBox = new skybox();
-	SkyBox->create(device);
-// Create Objects of the scene
-	//Terrain
-	terrain* t = new terrain();
-	t->terrainDim = 16;
-	t->HP_filename = L"Media/terrainHM.r16";
-	t->create(device);
-	Objs.push_back(new Object(t, XMMatrixScaling(1.0, 1.0, 1.0) * XMMatrixTranslation(-96, 0.0, -96), XMMatrixIdentity()));
-	/*plane* p = new plane();
-	p->create(device);
-	Objs.push_back(new Object(p, XMMatrixScaling(10.0, 10.0, 10.0), XMMatrixIdentity()));*/
-	//Snowman 1
-	snowMan* sm = new snowMan();
-	sm->create(device);
-	Objs.push_back(new Object(sm, XMMatrixTranslation(0.0, t->GetHeight(-96, -96), 0.0), XMMatrixScaling(1.5,1.5,1.5)));
-	//Box
-	cube* cb = new cube();
-	cb->create(device);
-	carPos = XMFLOAT3(8.0, 1.725, 0.0);
-	carScale = XMFLOAT3(2.0, 2.0, 2.0);
-	Objs.push_back(new Object(cb, XMMatrixScaling(carScale.x, carScale.y, carScale.z) * XMMatrixTranslation(carPos.x, carPos.y, carPos.z), XMMatrixIdentity()));
-	//Snowman 2 
-	Objs.push_back(new Object(sm,  XMMatrixTranslation(carPos.x, carPos.y + carScale.y*0.5, carPos.z), XMMatrixIdentity()));
+// Create the scene
+	LoadScene(device, L"Media/scene.txt");
+// Snowfall over the terrain just loaded
+	CreateSnowfallResources(device);
+// Lamps of the scene
+	CreateLightClusterResources(device);
+}
+
+void Scene::LoadScene(ID3D11Device1* device, const wchar_t* path) {
+	wchar_t buff[MAX_PATH];
+	DX::FindMediaFile(buff, MAX_PATH, path);
+	m_sceneFile = std::make_shared<SceneFile>();
+	const SceneFile& file = *m_sceneFile;
+	std::string error;
+	if (!m_sceneFile->Load(_bstr_t(buff), &error))
+		throw std::runtime_error("Scene file: " + error);
+
+// Light
+	if (file.LightCount() > 0) {
+		const SceneLightRecord& light = file.Lights()[0];
+		PlaceLight(light);
+		// The viewer starts out looking from the light
+		m_flyCamera.pitch = light.pitch;
+		m_flyCamera.yaw = light.yaw;
+		Cam.SetPosition(light.position[0], light.position[1], light.position[2]);
+		Cam.Turn(m_flyCamera.pitch, m_flyCamera.yaw);
+		Cam.UpdateViewMatrix();
+	}
 
+// Nodes; parents always come before their children
+	m_sceneNodes.assign(file.NodeCount(), SceneNodeHandle());
+	m_sceneSpins.assign(file.NodeCount(), Entity());
+	for (uint32_t i = 0; i < file.NodeCount(); i++) {
+		const SceneNodeRecord& n = file.Nodes()[i];
+		XMMATRIX local = SceneNodeLocal(n);
+		m_sceneNodes[i] = m_sceneGraph.Create(ToSceneMatrix(local), n.parent < 0 ? SceneNodeHandle() : m_sceneNodes[n.parent]);
+		if (n.spin != 0.0f)
+			m_sceneSpins[i] = m_entities.AddAnimation(m_sceneNodes[i], n.spin, local);
+	}
+
+// Drawables; geometry is shared between drawables of the same kind
+	snowMan* sm = nullptr;
+	cube* cb = nullptr;
+	plane* pl = nullptr;
+	std::map<std::string, ID3D11ShaderResourceView*> textures, normalMaps;
+	// Every texture view loaded from each media file, for hot reload
+	std::map<std::wstring, std::vector<ID3D11ShaderResourceView*>> textureViews, normalMapViews, cubeMapViews;
+	auto collect = [&](const drawable* geo) {
+		for (const RModel* component : geo->components) {
+			if (component->texture)
+				(geo == SkyBox ? cubeMapViews : textureViews)[component->texturePath].push_back(component->texture);
+			if (component->normalMap)
+				normalMapViews[component->normalMapPath].push_back(component->normalMap);
+		}
+	};
+	std::vector<Entity> created;
+	std::vector<ImpostorSource> impostorSources;
+	for (uint32_t i = 0; i < file.DrawableCount(); i++) {
+		const SceneDrawableRecord& d = file.Drawables()[i];
+		const drawable* geo = nullptr;
+		switch (d.kind) {
+		case SceneDrawable_Terrain: {
+			terrain* t = new terrain();
+			_bstr_t heightMap(d.heightMap != SceneNoString ? file.String(d.heightMap) : "Media/terrainHM.r16");
+			t->terrainDim = d.terrainDim > 0.0f ? d.terrainDim : 16;
+			t->HP_filename = heightMap;
+			t->vertexFormat = m_terrainVertexFormat;
+			t->gpuDisplacement = m_terrainGpuDisplacement;
+			t->jobs = m_jobs.get();
+			t->create(device);
+			this->Terrain = t;
+			// One occluder vertex every 4 cells: 64x64 cells for the 256x256 height map
+			OcclusionBuffer::BuildHeightfieldOccluder(t->heights, t->width, 1, t->width - 2, 4, t->terrainDim / t->width,
+				m_terrainOccluder, m_terrainOccluderIndices);
+			m_terrainNode = m_sceneNodes[d.node];
+			collect(t);
+			break;
+		}
+		case SceneDrawable_Skybox:
+			this->SkyBox = new skybox();
+			SkyBox->create(device);
+			collect(SkyBox);
+			break;
+		case SceneDrawable_SnowMan:
+			if (!sm) {
+				sm = new snowMan();
+				sm->vertexFormat = m_objectVertexFormat;
+				sm->create(device);
+				collect(sm);
+			}
+			geo = sm;
+			break;
+		case SceneDrawable_Cube:
+			if (!cb) {
+				cb = new cube();
+				cb->vertexFormat = m_objectVertexFormat;
+				cb->create(device);
+				collect(cb);
+			}
+			geo = cb;
+			break;
+		case SceneDrawable_Plane:
+			if (!pl) {
+				pl = new plane();
+				pl->create(device);
+				collect(pl);
+			}
+			geo = pl;
+			break;
+		}
+		if (!geo)
+			continue;
+
+		// Material overrides; textures are loaded once per path
+		const SceneMaterialRecord* m = d.material >= 0 ? &file.Materials()[d.material] : nullptr;
+		ID3D11ShaderResourceView* texture = nullptr;
+		ID3D11ShaderResourceView* normalMap = nullptr;
+		if (m && m->texture != SceneNoString) {
+			auto& cached = textures[file.String(m->texture)];
+			if (!cached) {
+				RModel loader;
+				loader.setTexture(device, _bstr_t(file.String(m->texture)));
+				cached = loader.texture;
+				textureViews[loader.texturePath].push_back(cached);
+			}
+			texture = cached;
+		}
+		if (m && m->normalMap != SceneNoString) {
+			auto& cached = normalMaps[file.String(m->normalMap)];
+			if (!cached) {
+				RModel loader;
+				loader.setNormalMap(device, _bstr_t(file.String(m->normalMap)));
+				cached = loader.normalMap;
+				normalMapViews[loader.normalMapPath].push_back(cached);
+			}
+			normalMap = cached;
+		}
+
+		// Snowmen and boxes get an impostor, one atlas object per look
+		uint32_t impostor = SceneEntities::NoImpostor;
+		if (d.kind == SceneDrawable_SnowMan || d.kind == SceneDrawable_Cube) {
+			auto found = std::find_if(impostorSources.begin(), impostorSources.end(), [&](const ImpostorSource& s) {
+				return s.geo == geo && s.texture == texture;
+			});
+			impostor = uint32_t(found - impostorSources.begin());
+			if (found == impostorSources.end())
+				impostorSources.push_back(ImpostorSource{ geo, texture });
+		}
+
+		created.clear();
+		// The box is big and solid enough to hide what is behind it
+		m_entities.AddDrawable(geo, m_sceneNodes[d.node], &created, d.kind == SceneDrawable_Cube, impostor);
+		if (!m)
+			continue;
+		for (Entity e : created) {
+			MaterialComponent& material = m_entities.materials.Get(e);
+			if (m->flags & SceneMaterial_Color)
+				material.color = XMFLOAT4(m->color);
+			if (texture)
+				material.texture = texture;
+			if (normalMap)
+				material.normalMap = normalMap;
+		}
+	}
+
+	if (!Terrain || !SkyBox)
+		throw std::runtime_error("Scene file: needs a terrain and a skybox");
+
+// Lamps ride their nodes
+	m_lampsLocal.clear();
+	m_lampNodes.clear();
+	for (uint32_t i = 0; i < file.LampCount(); i++) {
+		m_lampsLocal.push_back(ToPointLight(file.Lamps()[i]));
+		m_lampNodes.push_back(file.Lamps()[i].node);
+	}
+	m_lamps = m_lampsLocal;
+
+// The camera can ride the box; it turns with the box's parent node
+	int box = file.FindNode("box");
+	if (box >= 0) {
+		const SceneNodeRecord& n = file.Nodes()[box];
+		carPos = XMFLOAT3(n.translation);
+		carScale = XMFLOAT3(n.scale);
+		if (n.parent >= 0)
+			m_turntableSpin = m_sceneSpins[n.parent];
+	}
+
+	m_entities.Compact();
+	m_sceneGraph.Update();
+	m_entities.UpdateTransforms(m_sceneGraph);
+
+// Impostors
+	if (!impostorSources.empty())
+		BakeImpostors(device, impostorSources);
+
+// Hot reload
+	for (auto& views : textureViews)
+		WatchTexture(views.first, TextureKind_Color, views.second);
+	for (auto& views : normalMapViews)
+		WatchTexture(views.first, TextureKind_NormalMap, views.second);
+	for (auto& views : cubeMapViews)
+		WatchTexture(views.first, TextureKind_Cube, views.second);
+	WatchScene(FullPath(buff));
+}
+
+// Draws each source from every frame direction of its atlas object, in the drawable's own
+// space: the views that replace it when it is small on screen.
+void Scene::BakeImpostors(ID3D11Device* device, const std::vector<ImpostorSource>& sources) {
+	// 8x8 frames of 128 pixels per object
+	m_impostorAtlas = std::make_unique<D3D11ImpostorAtlas>(device,
+		ImpostorAtlas::MakeLayout(uint32_t(sources.size()), 8, 128, D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION));
+	const ImpostorAtlasLayout& layout = m_impostorAtlas->Layout();
+	auto context = m_deviceResources->GetD3DDeviceContext();
+
+	m_impostorAtlas->BeginBake(context);
+	m_render->IASetPrimitiveTopology(GpuTopology_TriangleList);
+	GpuBuffer* quantBuffer = ToGpu(m_QuantBuffer.Get());
+	m_render->VSSetConstantBuffers(2, 1, &quantBuffer);
+	m_render->PSSetShader(ToGpu(m_impostorBakePixelShader.Get()));
+	GpuSampler* sampler = ToGpu(m_spSampler.Get());
+	m_render->PSSetSamplers(0, 1, &sampler);
+	for (uint32_t object = 0; object < uint32_t(sources.size()); object++) {
+		const drawable* geo = sources[object].geo;
+		// The sphere around every part, as SceneEntities::AddDrawable bounds the impostor
+		BoundingSphere bounds(XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f);
+		for (const RModel* component : geo->components) {
+			if (component->vertices.empty())
+				continue;
+			BoundingSphere part;
+			BoundingSphere::CreateFromPoints(part, component->vertices.size(),
+				&component->vertices[0].position, sizeof(VertexPositionNormalTexture));
+			part.Transform(part, component->model);
+			if (bounds.Radius > 0.0f)
+				BoundingSphere::CreateMerged(bounds, bounds, part);
+			else
+				bounds = part;
+		}
+		for (uint32_t frame = 0; frame < ImpostorAtlas::FrameCount(layout); frame++) {
+			XMMATRIX view, projection;
+			m_impostorAtlas->BakeFrame(context, object, frame, bounds, view, projection);
+			for (const RModel* component : geo->components) {
+				SetVertexInput(component, m_spVertexShader.Get(), m_compactVertexShader.Get(), nullptr);
+				SetPassMatrices(view, projection, view, projection);
+				SetConstantBufferPars(component->model, component->color, component->vertexFormat, component->quantization);
+				BindConstantBuffers();
+				auto texture = ToGpu(sources[object].texture ? sources[object].texture : component->texture);
+				m_render->PSSetShaderResources(0, 1, &texture);
+				m_render->DrawIndexed(UINT(component->indices.size()), 0, 0);
+			}
+		}
+	}
+	m_impostorAtlas->EndBake(context);
+}
+
+// Light view and shadow volume, spanning the viewer's depth range.
+void Scene::PlaceLight(const SceneLightRecord& light) {
+	m_lightCamera.SetVolume(light.width, light.height, Cam.GetNearZ(), Cam.GetFarZ());
+	m_lightCamera.Place(XMFLOAT3(light.position), light.pitch, light.yaw);
+}
+
+void Scene::UpdateScene(const SceneFile& file) {
+	const SceneFile& old = *m_sceneFile;
+	if (file.LightCount() > 0 && memcmp(&file.Lights()[0], &old.Lights()[0], sizeof(SceneLightRecord)) != 0) {
+		PlaceLight(file.Lights()[0]);
+	}
+	for (uint32_t i = 0; i < file.NodeCount(); i++) {
+		const SceneNodeRecord& n = file.Nodes()[i];
+		if (memcmp(&n, &old.Nodes()[i], sizeof(SceneNodeRecord)) == 0)
+			continue;
+		XMMATRIX local = SceneNodeLocal(n);
+		if (AnimationComponent* spin = m_entities.animations.Find(m_sceneSpins[i])) {
+			spin->base = local;
+			spin->angularSpeed = n.spin;
+		}
+		else
+			m_sceneGraph.SetLocal(m_sceneNodes[i], ToSceneMatrix(local));
+	}
+	for (uint32_t i = 0; i < file.LampCount(); i++) {
+		m_lampsLocal[i] = ToPointLight(file.Lamps()[i]);
+		m_lampNodes[i] = file.Lamps()[i].node;
+	}
+	int box = file.FindNode("box");
+	if (box >= 0) {
+		carPos = XMFLOAT3(file.Nodes()[box].translation);
+		carScale = XMFLOAT3(file.Nodes()[box].scale);
+	}
+}
+
+template <typename T>
+void Scene::WatchShader(const wchar_t* source, ComPtr<T>& shader) {
+	if (m_shaderSourceDir.empty())
+		return;
+	std::wstring path = m_shaderSourceDir + source;
+	auto device = m_deviceResources->GetD3DDevice();
+	uint32_t id = m_hotReload->Add(Utf8(source), [this, device, path, &shader](uint32_t resource) {
+		std::vector<std::wstring> includes;
+		ComPtr<ID3DBlob> code = CompileShaderFile(path.c_str(), ShaderTarget(shader.Get()), &includes);
+		ComPtr<T> fresh;
+		DX::ThrowIfFailed(CreateShader(device, code.Get(), fresh.GetAddressOf()));
+		return std::function<void()>([this, resource, path, includes, fresh, &shader]() {
+			shader = fresh;
+			std::vector<std::string> files(1, Utf8(path));
+			for (const std::wstring& include : includes)
+				files.push_back(Utf8(include));
+			m_hotReload->SetDependencies(resource, files);
+		});
+	});
+	m_hotReload->Depend(id, Utf8(path));
+	for (const std::wstring& include : FindShaderIncludes(path.c_str()))
+		m_hotReload->Depend(id, Utf8(include));
+}
+
+void Scene::WatchTexture(const std::wstring& mediaPath, TextureKind kind, std::vector<ID3D11ShaderResourceView*> views) {
+	if (mediaPath.empty())
+		return;
+	wchar_t buff[MAX_PATH];
+	DX::FindMediaFile(buff, MAX_PATH, mediaPath.c_str());
+	auto device = m_deviceResources->GetD3DDevice();
+	auto live = std::make_shared<std::vector<ID3D11ShaderResourceView*>>(std::move(views));
+	uint32_t id = m_hotReload->Add(Utf8(mediaPath), [this, device, mediaPath, kind, live](uint32_t) {
+		RModel loader;
+		if (kind == TextureKind_NormalMap)
+			loader.setNormalMap(device, mediaPath.c_str());
+		else if (kind == TextureKind_Cube)
+			loader.setCubeMap(device, mediaPath.c_str());
+		else
+			loader.setTexture(device, mediaPath.c_str());
+		ID3D11ShaderResourceView* fresh = kind == TextureKind_NormalMap ? loader.normalMap : loader.texture;
+		return std::function<void()>([this, live, fresh]() {
+			for (ID3D11ShaderResourceView* old : *live) {
+				ReplaceTexture(old, fresh);
+				old->Release();
+			}
+			live->assign(1, fresh);
+		});
+	});
+	m_hotReload->Depend(id, Utf8(FullPath(buff)));
+}
+
+// Only node transforms, spin speeds and the light are updated in place; other
+// edits are reported and need a restart.
+void Scene::WatchScene(const std::wstring& fullPath) {
+	uint32_t id = m_hotReload->Add("scene", [this, fullPath](uint32_t) {
+		auto file = std::make_shared<SceneFile>();
+		std::string error;
+		if (!file->Load(_bstr_t(fullPath.c_str()), &error))
+			throw std::runtime_error(error);
+		if (!SameSceneLayout(*m_sceneFile, *file))
+			throw std::runtime_error("nodes, materials, drawables or lamps added or removed; restart to apply");
+		return std::function<void()>([this, file]() {
+			UpdateScene(*file);
+			m_sceneFile = file;
+		});
+	});
+	m_hotReload->Depend(id, Utf8(fullPath));
+}
+
+void Scene::ReplaceTexture(ID3D11ShaderResourceView* old, ID3D11ShaderResourceView* texture) {
+	MaterialComponent* materials = m_entities.materials.Data();
+	for (size_t i = 0; i < m_entities.materials.Size(); i++) {
+		if (materials[i].texture == old)
+			materials[i].texture = texture;
+		if (materials[i].normalMap == old)
+			materials[i].normalMap = texture;
+	}
+	for (const drawable* geo : { static_cast<const drawable*>(SkyBox), static_cast<const drawable*>(Terrain) }) {
+		for (RModel* component : geo->components) {
+			if (component->texture == old)
+				component->texture = texture;
+			if (component->normalMap == old)
+				component->normalMap = texture;
+		}
+	}
+}
+
+void Scene::CreateLightClusterResources(ID3D11Device* device) {
+	// Sized for the scene's lamps and the whole grid; the index list grows as needed
+	CreateDynamicStructuredBuffer(device, sizeof(PointLight), UINT(std::max<size_t>(m_lamps.size(), 1)), m_lampBuffer, m_lampView);
+	CreateDynamicStructuredBuffer(device, sizeof(LightClusters::Cluster), UINT(m_lightClusters->ClusterCount()),
+		m_lightClusterBuffer, m_lightClusterView);
+	m_lightIndexCapacity = std::max<size_t>(m_lamps.size(), 1) * 16;
+	CreateDynamicStructuredBuffer(device, sizeof(uint32_t), UINT(m_lightIndexCapacity), m_lightIndexBuffer, m_lightIndexView);
+	// Rebuild the froxels on the next bin
+	m_clusterProjRevision = Cam.ProjRevision() - 1;
+}
+
+void Scene::AddSnowEmitter(const SnowEmitter& emitter) {
+	m_snowEmitters.push_back(emitter);
+	if (m_snowfallComputeShader)
+		CreateSnowEmitterResources(m_deviceResources->GetD3DDevice(), m_snowEmitters.size() - 1);
+}
+
+void Scene::ClearSnowEmitters() {
+	m_snowEmitters.clear();
+	m_snowEmitterResources.clear();
+}
+
+void Scene::CreateSnowfallResources(ID3D11Device* device) {
+	// Terrain heights in world space, cell by cell. Assumes the terrain is scaled and
+	// moved but not rotated, as every scene file places it.
+	XMMATRIX world = Terrain->components[0]->model * ToXMMatrix(m_sceneGraph.World(m_terrainNode));
+	float cellSize = Terrain->terrainDim / Terrain->width;
+	XMFLOAT3 origin, cellEnd, up;
+	XMStoreFloat3(&origin, XMVector3Transform(XMVectorZero(), world));
+	XMStoreFloat3(&cellEnd, XMVector3Transform(XMVectorSet(cellSize, 0.0f, 0.0f, 0.0f), world));
+	XMStoreFloat3(&up, XMVector3Transform(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), world));
+	uint32_t dim = uint32_t(Terrain->width);
+	m_snowGroundHeights.resize(size_t(dim) * dim);
+	for (size_t i = 0; i < m_snowGroundHeights.size(); i++)
+		m_snowGroundHeights[i] = origin.y + Terrain->heights[i] * (up.y - origin.y);
+	m_snowGround.heights = m_snowGroundHeights.data();
+	m_snowGround.dim = dim;
+	m_snowGround.origin[0] = origin.x;
+	m_snowGround.origin[1] = origin.z;
+	m_snowGround.cellSize = cellEnd.x - origin.x;
+
+	D3D11_BUFFER_DESC groundDesc = {};
+	groundDesc.ByteWidth = UINT(m_snowGroundHeights.size() * sizeof(float));
+	groundDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	groundDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	groundDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	groundDesc.StructureByteStride = sizeof(float);
+	D3D11_SUBRESOURCE_DATA groundData = { m_snowGroundHeights.data(), 0, 0 };
+	ComPtr<ID3D11Buffer> groundBuffer;
+	DX::ThrowIfFailed(device->CreateBuffer(&groundDesc, &groundData, groundBuffer.GetAddressOf()));
+	D3D11_SHADER_RESOURCE_VIEW_DESC groundViewDesc = {};
+	groundViewDesc.Format = DXGI_FORMAT_UNKNOWN;
+	groundViewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	groundViewDesc.Buffer.NumElements = UINT(m_snowGroundHeights.size());
+	DX::ThrowIfFailed(device->CreateShaderResourceView(groundBuffer.Get(), &groundViewDesc, m_snowGroundView.ReleaseAndGetAddressOf()));
+
+	// Corners 0..3 of snowVert.hlsl: top left, top right, bottom left, bottom right
+	static const uint16_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+	D3D11_BUFFER_DESC quadDesc = {};
+	quadDesc.ByteWidth = sizeof(quad);
+	quadDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	quadDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	D3D11_SUBRESOURCE_DATA quadData = { quad, 0, 0 };
+	DX::ThrowIfFailed(device->CreateBuffer(&quadDesc, &quadData, m_snowQuadIndices.ReleaseAndGetAddressOf()));
+
+	m_snowEmitterResources.clear();
+	for (size_t i = 0; i < m_snowEmitters.size(); i++)
+		CreateSnowEmitterResources(device, i);
+}
+
+// Particles start spread through the emitter's box, so the snow is already falling on
+// the first frame.
+void Scene::CreateSnowEmitterResources(ID3D11Device* device, size_t emitter) {
+	SnowEmitter& e = m_snowEmitters[emitter];
+	if (e.followCamera) {
+		e.center[0] = Cam.GetPosition().x;
+		e.center[1] = Cam.GetPosition().y;
+		e.center[2] = Cam.GetPosition().z;
+	}
+	std::vector<SnowParticle> particles(e.count);
+	Snowfall::Spawn(Snowfall::MakeParams(e, m_snowGround, 0.0f), uint32_t(emitter), particles.data(), particles.size());
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = UINT(particles.size() * sizeof(SnowParticle));
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = sizeof(SnowParticle);
+	D3D11_SUBRESOURCE_DATA data = { particles.data(), 0, 0 };
+	SnowEmitterResources r;
+	DX::ThrowIfFailed(device->CreateBuffer(&desc, &data, r.particles.GetAddressOf()));
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC accessDesc = {};
+	accessDesc.Format = DXGI_FORMAT_UNKNOWN;
+	accessDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	accessDesc.Buffer.NumElements = e.count;
+	DX::ThrowIfFailed(device->CreateUnorderedAccessView(r.particles.Get(), &accessDesc, r.particleAccess.GetAddressOf()));
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	viewDesc.Buffer.NumElements = e.count;
+	DX::ThrowIfFailed(device->CreateShaderResourceView(r.particles.Get(), &viewDesc, r.particleView.GetAddressOf()));
+
+	m_snowEmitterResources.resize(std::max(m_snowEmitterResources.size(), emitter + 1));
+	m_snowEmitterResources[emitter] = r;
 }
 
 void Scene::CreateRenderToTextureResources() {
@@ -767,10 +2146,56 @@ void Scene::CreateRenderToTextureResources() {
 // Allocate all memory resources that change on a window SizeChanged event.
 void Scene::CreateWindowSizeDependentResources()
 {
+	auto device = m_deviceResources->GetD3DDevice();
+	auto viewport = m_deviceResources->GetScreenViewport();
+
+	// The lit scene, in linear light with room above 1
+	CD3D11_TEXTURE2D_DESC hdrDesc(DXGI_FORMAT_R11G11B10_FLOAT, UINT(viewport.Width), UINT(viewport.Height), 1, 1,
+		D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+	DX::ThrowIfFailed(
+		device->CreateTexture2D(&hdrDesc, nullptr, m_hdrTarget.ReleaseAndGetAddressOf()));
+	DX::ThrowIfFailed(
+		device->CreateRenderTargetView(m_hdrTarget.Get(), nullptr, m_hdrTargetView.ReleaseAndGetAddressOf()));
+	DX::ThrowIfFailed(
+		device->CreateShaderResourceView(m_hdrTarget.Get(), nullptr, m_hdrSceneView.ReleaseAndGetAddressOf()));
+
+	// HDR10 displays get the scene in nits through the ST.2084 curve, the others a filmic curve in sRGB
+	if (m_deviceResources->GetColorSpace() == DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020) {
+		m_toneMap->SetOperator(ToneMapPostProcess::None);
+		m_toneMap->SetTransferFunction(ToneMapPostProcess::ST2084);
+	}
+	else {
+		m_toneMap->SetOperator(ToneMapPostProcess::ACESFilmic);
+		m_toneMap->SetTransferFunction(ToneMapPostProcess::SRGB);
+	}
+	ConfigurePostProcess();
 }
 
 void Scene::OnDeviceLost()
 {
+	m_hotReload->Clear();
+	m_profiler->SetGpuTimer(nullptr);
+	m_gpuTimer.reset();
+	m_pipelineStats.reset();
+	m_toneMap.reset();
+	m_postProcess.reset();
+	m_frameGraph.Reset();
+	m_frameGraph.ForgetBindings();
+	m_fullScreenVertexShader.Reset();
+	m_fxaaPixelShader.Reset();
+	m_impostorAtlas.reset();
+	m_impostorVertexShader.Reset();
+	m_impostorPixelShader.Reset();
+	m_impostorBakePixelShader.Reset();
+	m_luminanceHistogram.reset();
+	m_frameCapture.reset();
+	m_hdrTarget.Reset();
+	m_hdrTargetView.Reset();
+	m_hdrSceneView.Reset();
+	m_luminanceComputeShader.Reset();
+	m_render.reset();
+	m_skyDepthState.Reset();
+	m_depthEqualState.Reset();
     m_spInputLayout.Reset();
     m_spVertexShader.Reset();
     m_spPixelShader.Reset();
@@ -778,9 +2203,35 @@ void Scene::OnDeviceLost()
 	m_skyboxPixelShader.Reset();
 	m_terrainVertexShader.Reset();
 	m_terrainPixelShader.Reset();
+	m_compactInputLayout.Reset();
+	m_heightInputLayout.Reset();
+	m_compactVertexShader.Reset();
+	m_terrainHeightVertexShader.Reset();
+	m_shadowCompactVertexShader.Reset();
+	m_shadowHeightVertexShader.Reset();
+	m_patchInputLayout.Reset();
+	m_terrainPatchVertexShader.Reset();
+	m_shadowPatchVertexShader.Reset();
+	m_snowfallComputeShader.Reset();
+	m_snowVertexShader.Reset();
+	m_snowPixelShader.Reset();
+	m_snowEmitterResources.clear();
+	m_snowGroundView.Reset();
+	m_snowQuadIndices.Reset();
+	m_SnowfallBuffer.Reset();
+	m_ClusterBuffer.Reset();
+	m_lampBuffer.Reset();
+	m_lampView.Reset();
+	m_lightClusterBuffer.Reset();
+	m_lightClusterView.Reset();
+	m_lightIndexBuffer.Reset();
+	m_lightIndexView.Reset();
+	m_lightIndexCapacity = 0;
 	m_MatrixBuffer.Reset();
 	m_CameraBuffer.Reset();
 	m_ColorBuffer.Reset();
+	m_QuantBuffer.Reset();
+	m_TerrainBuffer.Reset();
 	m_spSampler.Reset();
 }
 
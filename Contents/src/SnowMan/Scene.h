@@ -11,6 +11,9 @@
 #include "StepTimer.h"
 #include "RModel.h"
 #include "Camera.h"
+#include "LightCamera.h"
+#include "FlyCamera.h"
+#include "InputLog.h"
 #include <GeometricPrimitive.h>
 #include "Utilities.h"
 #include "snowMan.h"
@@ -18,13 +21,25 @@
 #include "cube.h"
 #include "skybox.h"
 #include "terrain.h"
-
-struct Object {
-	drawable* geo;
-	DirectX::XMMATRIX WorldM;
-	DirectX::XMMATRIX AnimM;
-	Object(drawable* g, DirectX::XMMATRIX wm, DirectX::XMMATRIX am) :geo(g), WorldM(wm), AnimM(am) {}
-};
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "SceneGraph.h"
+#include "SceneEntities.h"
+#include "SceneFile.h"
+#include "HotReload.h"
+#include "Profiler.h"
+#include "GpuTimerD3D11.h"
+#include "RenderBackendD3D11.h"
+#include "OcclusionBuffer.h"
+#include "PipelineStatsD3D11.h"
+#include "Snowfall.h"
+#include "LightClusters.h"
+#include "AutoExposure.h"
+#include "LuminanceHistogramD3D11.h"
+#include "PostProcessD3D11.h"
+#include "RenderGraph.h"
+#include "FrameCaptureD3D11.h"
+#include "ImpostorAtlasD3D11.h"
 
 // A basic sample implementation that creates a D3D11 device and
 // provides a render loop.
@@ -54,42 +69,190 @@ public:
     // Properties
     void GetDefaultSize( int& width, int& height ) const;
 
+	// Snow falling over the scene; the scene starts with one box following the camera.
+	void AddSnowEmitter(const SnowEmitter& emitter);
+	void ClearSnowEmitters();
+
 	Camera Cam;
 private:
 
     void Update(DX::StepTimer const& timer);
+	// This tick's keyboard and mouse as Update acts on them
+	InputSnapshot SampleInput(const DirectX::Keyboard::State& kb);
+	// F10 starts recording input from the camera's pose, the toggles and the turntable, and
+	// saves the log when pressed again; F11 replays the saved log from where it was recorded
+	void ToggleInputRecording();
+	void ToggleInputReplay();
+	void RestoreInputOrigin(const InputOrigin& origin);
+	// V starts writing every frame raw, and ends the sequence when pressed again
+	void ToggleFrameCapture();
     void Render();
+	// Copies the finished frame for the capture requested and reads back earlier copies
+	void CaptureBackBuffer();
 
     void Clear();
 
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
 	void CreateRenderToTextureResources();
+	// Builds lights, nodes and drawables from a scene file (text or binary).
+	void LoadScene(ID3D11Device1* device, const wchar_t* path);
+	void PlaceLight(const SceneLightRecord& light);
+	// A drawable, with the texture its material puts on it, baked as one atlas object
+	struct ImpostorSource
+	{
+		const drawable* geo;
+		ID3D11ShaderResourceView* texture;		// nullptr for the drawable's own
+	};
+	void BakeImpostors(ID3D11Device* device, const std::vector<ImpostorSource>& sources);
+	// Applies edits to the loaded scene's light and node transforms.
+	void UpdateScene(const SceneFile& file);
 
+	// Hot reload registration
+	template <typename T>
+	void WatchShader(const wchar_t* source, Microsoft::WRL::ComPtr<T>& shader);
+	enum TextureKind { TextureKind_Color, TextureKind_NormalMap, TextureKind_Cube };
+	void WatchTexture(const std::wstring& mediaPath, TextureKind kind, std::vector<ID3D11ShaderResourceView*> views);
+	void WatchScene(const std::wstring& fullPath);
+	void ReplaceTexture(ID3D11ShaderResourceView* old, ID3D11ShaderResourceView* texture);
+
+	void SetConstantBufferPars(DirectX::XMMATRIX world, const DirectX::XMFLOAT4& color, VertexFormat vertexFormat, const VertexQuantization& quantization);
 	void SetConstantBufferPars(const RModel* component, DirectX::XMMATRIX worldM);
+	// The matrices SetConstantBufferPars gives every draw until the next call, transposed here once
+	void SetPassMatrices(DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection, DirectX::CXMMATRIX lightView,
+		DirectX::CXMMATRIX lightProjection);
+	void BindConstantBuffers();
+	void SetVertexInput(ID3D11Buffer* vertexBuffer, ID3D11Buffer* indexBuffer, DXGI_FORMAT indexFormat, VertexFormat vertexFormat,
+		ID3D11VertexShader* fullVS, ID3D11VertexShader* compactVS, ID3D11VertexShader* heightVS);
+	void SetVertexInput(const RModel* component, ID3D11VertexShader* fullVS, ID3D11VertexShader* compactVS, ID3D11VertexShader* heightVS);
+	enum RenderPass { RenderPass_Shadow, RenderPass_Depth, RenderPass_Main };
+	void RenderEntities(RenderPass pass);
+	void RenderTerrain(RenderPass pass);
+	void DrawTerrainChunks(const RModel* component, ID3D11VertexShader* patchVS, DirectX::XMMATRIX worldM, DirectX::XMMATRIX viewProj);
+	void CullOccluded(DirectX::XMMATRIX viewProj);
+	void RenderImpostors();
+	// Snowfall: particle buffers of each emitter, and the ground they land on
+	void CreateSnowfallResources(ID3D11Device* device);
+	void CreateSnowEmitterResources(ID3D11Device* device, size_t emitter);
+	void SimulateSnow(float deltaTime);
+	void RenderSnow();
+	// Clustered lamps: bins this frame's lamps and binds them for the pixel shaders
+	void CreateLightClusterResources(ID3D11Device* device);
+	void UpdateLightClusters();
+	// Exposes the HDR scene and runs the post-processing passes into the back buffer
+	void RenderPostProcess(float deltaTime);
+	void ConfigurePostProcess();
 
     // Device resources.
     std::unique_ptr<DX::DeviceResources>    m_deviceResources;
 
+	// Every per-frame context call goes through this
+	std::unique_ptr<RenderBackend>          m_render;
+	// The frame's passes, rebuilt by Render; keeps what they left bound between frames
+	RenderGraph                             m_frameGraph;
+
     // Rendering loop timer.
     DX::StepTimer                           m_timer;
 
+	// Worker threads for scene building and per-frame jobs.
+	std::unique_ptr<JobSystem>              m_jobs;
+	// Transient per-frame memory, reset at the start of each Tick.
+	std::unique_ptr<FrameAllocator>         m_frameMemory;
+	// Rebuilds shaders, textures and scene entries whose files changed, between frames.
+	std::unique_ptr<HotReload>              m_hotReload;
+	// Empty unless running next to the shader sources
+	std::wstring                            m_shaderSourceDir;
+	// CPU and GPU timing of the frame's stages; F9 writes a Chrome trace
+	std::unique_ptr<Profiler>               m_profiler;
+	std::unique_ptr<D3D11GpuTimer>          m_gpuTimer;
+	// Pipeline statistics of selected passes, reported with F9
+	std::unique_ptr<D3D11PipelineStats>     m_pipelineStats;
+	// Software depth of the terrain and the box; entities behind them are not drawn (O toggles)
+	std::unique_ptr<OcclusionBuffer>        m_occlusion;
+	bool                                    m_occlusionCulling = true;
+	// Entities drop to coarser meshes as they get smaller on screen, and snowmen and boxes to
+	// impostors below impostorSize (K toggles, off is full detail)
+	LodSettings                             m_lodSettings;
+	bool                                    m_lodEnabled = true;
+	// Views of each impostor object, baked when the scene loads
+	std::unique_ptr<D3D11ImpostorAtlas>     m_impostorAtlas;
+	// Lays down the camera's depth first so the main pass shades each pixel once (P toggles)
+	bool                                    m_depthPrePass = true;
+	// Lamps binned per froxel for the object and terrain pixel shaders (L toggles)
+	std::unique_ptr<LightClusters>          m_lightClusters;
+	bool                                    m_clusteredLights = true;
+	// Snowfall simulated by snowfallCompute.hlsl (N toggles)
+	bool                                    m_snowfall = true;
+	// The scene is lit into m_hdrTarget and tone-mapped into the back buffer; exposure
+	// follows the scene's luminance histogram of a few frames back (X toggles, off is 0 stops)
+	std::unique_ptr<DirectX::ToneMapPostProcess> m_toneMap;
+	// Tone mapping, bloom (B toggles) and FXAA (G toggles), through pooled targets
+	std::unique_ptr<D3D11PostProcess>       m_postProcess;
+	PostProcessSettings                     m_postProcessSettings;
+	std::unique_ptr<D3D11LuminanceHistogram> m_luminanceHistogram;
+	AutoExposure                            m_autoExposure;
+	bool                                    m_autoExposureEnabled = true;
+	// Brightness of scene value 1 on HDR10 displays
+	float                                   m_paperWhiteNits = 200.0f;
+	// T saves a PNG of the next frame (with Shift, a DDS of the back buffer as it is) and V
+	// dumps frames raw; read back through a staging ring and encoded on the encoder's thread
+	std::unique_ptr<CaptureEncoder>         m_captureEncoder;
+	std::unique_ptr<D3D11FrameCapture>      m_frameCapture;
+	bool                                    m_captureShot = false;
+	CaptureEncoding                         m_captureShotEncoding = CaptureEncoding_Png;
+	bool                                    m_captureSequence = false;
+	// The sequence's last copies are still to be read back before its file is closed
+	bool                                    m_captureSequenceEnding = false;
+
     // Input devices.
     std::unique_ptr<DirectX::GamePad>       m_gamePad;
     std::unique_ptr<DirectX::Keyboard>      m_keyboard;
 	std::unique_ptr<DirectX::Mouse>			m_mouse;
 	DirectX::Mouse::ButtonStateTracker				m_tracker;
-	float last_scroll_value;
-	float m_pitch, m_yaw;
+	DirectX::Keyboard::KeyboardStateTracker			m_keys;		// keys outside the input log: Escape, F10, F11, T, V
+	int32_t m_lastScroll;
+	enum InputMode { InputMode_Live, InputMode_Record, InputMode_Replay };
+	InputMode m_inputMode = InputMode_Live;
+	InputLog m_inputLog;
+	InputSnapshot m_lastInput = {};		// the tick before, for key presses
+	FlyCamera m_flyCamera;
 
     // Scene objects
     Microsoft::WRL::ComPtr<ID3D11InputLayout>       m_spInputLayout;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout>       m_compactInputLayout;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout>       m_heightInputLayout;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout>       m_patchInputLayout;
+
+	// Vertex layouts used when building scene geometry
+	VertexFormat m_objectVertexFormat = VertexFormat_Compact;
+	VertexFormat m_terrainVertexFormat = VertexFormat_Height;
+	// Terrain drawn as an instanced patch displaced in the vertex shader (ignores m_terrainVertexFormat)
+	bool m_terrainGpuDisplacement = true;
 
-	std::vector<Object*> Objs;
-	skybox* SkyBox;
+	SceneGraph m_sceneGraph;
+	// Scene objects other than the terrain and skybox, drawn by RenderEntities
+	SceneEntities m_entities;
+	SceneNodeHandle m_terrainNode;
+	// Coarse terrain under the real surface, in the terrain component's local space
+	std::vector<float> m_terrainOccluder;
+	std::vector<uint32_t> m_terrainOccluderIndices;
+	// Spins the parent node of the box and the snowman riding it
+	Entity m_turntableSpin;
+	// The loaded scene file, with the node and spin created for each of its nodes
+	std::shared_ptr<SceneFile> m_sceneFile;
+	std::vector<SceneNodeHandle> m_sceneNodes;
+	// Scene file lamps in their nodes' space, the node index of each (-1 for the world)
+	// and where they are this frame
+	std::vector<PointLight> m_lampsLocal;
+	std::vector<int32_t> m_lampNodes;
+	std::vector<PointLight> m_lamps;
+	uint32_t m_clusterProjRevision = 0;
+	std::vector<Entity> m_sceneSpins;
+	skybox* SkyBox = nullptr;
+	terrain* Terrain = nullptr;
 	float totalRot = 0.0f;
-	DirectX::XMFLOAT3 carPos;
-	DirectX::XMFLOAT3 carScale;
+	DirectX::XMFLOAT3 carPos = {};
+	DirectX::XMFLOAT3 carScale = {};
 
 	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_spVertexShader;
     Microsoft::WRL::ComPtr<ID3D11PixelShader>       m_spPixelShader;
@@ -99,22 +262,79 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader>       m_terrainPixelShader;
 	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_shadowVertexShader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader>       m_shadowPixelShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_compactVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_terrainHeightVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_shadowCompactVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_shadowHeightVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_terrainPatchVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_shadowPatchVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader>     m_snowfallComputeShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_snowVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader>       m_snowPixelShader;
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader>     m_luminanceComputeShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_fullScreenVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader>       m_fxaaPixelShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader>      m_impostorVertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader>       m_impostorPixelShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader>       m_impostorBakePixelShader;
+
+	// One per emitter; the particles live only on the GPU
+	struct SnowEmitterResources
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> particles;
+		Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> particleAccess;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> particleView;
+	};
+	std::vector<SnowEmitter> m_snowEmitters;
+	std::vector<SnowEmitterResources> m_snowEmitterResources;
+	// World space terrain heights, the same the CPU simulator reads (Snowfall.h)
+	SnowGround m_snowGround;
+	std::vector<float> m_snowGroundHeights;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_snowGroundView;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_SnowfallBuffer;
+	// Two triangles per flake, corners from SV_VertexID
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_snowQuadIndices;
 
 	std::vector<DirectX::VertexPositionNormalTexture> vertices;
 	std::vector<uint16_t> indices;
 
-	DirectX::XMMATRIX lightView;
-	DirectX::XMMATRIX lightProjection;
+	LightCamera m_lightCamera;
+	// Set by SetPassMatrices, already transposed for the constant buffers
+	struct PassMatrices
+	{
+		DirectX::XMMATRIX view;
+		DirectX::XMMATRIX projection;
+		DirectX::XMMATRIX lightView;
+		DirectX::XMMATRIX lightProjection;
+		DirectX::XMFLOAT4 camPos;
+	};
+	PassMatrices m_passMatrices;
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_MatrixBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_CameraBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_ColorBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_QuantBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_TerrainBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_ClusterBuffer;
+	// Lamps, cluster ranges and light indices read by ClusteredLights.hlsli
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_lampBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_lampView;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_lightClusterBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_lightClusterView;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_lightIndexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_lightIndexView;
+	size_t m_lightIndexCapacity = 0;
 
 
 	Microsoft::WRL::ComPtr<ID3D11SamplerState>          m_spSampler;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState>     m_skyDepthState;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState>     m_depthEqualState;
 	Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_renderTargetTexture;
 	Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_depthStencilBuffer;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView>          m_shadowDepthView;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>          m_shadowResourceView;
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> m_shadowTargetView;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D>          m_hdrTarget;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView>   m_hdrTargetView;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_hdrSceneView;
 };
\ No newline at end of file
@@ -0,0 +1,3568 @@
+//--------------------------------------------------------------------------------------
+// SceneBenchmark.cpp
+//
+// Headless benchmark and self-checks of the portable modules, with no window and no GPU.
+// The report is printed as JSON; the process exits with 1 when an argument is wrong or
+// any self-check fails, naming the failed checks on stderr. Each section is a Run
+// function below:
+//
+// scene         N snowmen turning in groups of 16 on M terrain chunks with K textures,
+//               loaded through a generated scene file, then F frames of update, cull,
+//               occlusion, sort, record and submit against a null backend: per-stage
+//               timings, heap allocations and backend calls.
+// occlusion     Occluder triangles per millisecond, scalar and AVX2, on one thread and on
+//               the job system, and the share of the screen the terrain leaves to the sky.
+//               Every variant must rasterize the same depth to the bit, and hide the
+//               snowmen behind a box but none in front of it or beside it.
+// terrain       The terrain baked into a mesh against the instanced patch: build time,
+//               GPU bytes, and baked normals that must match the patch's.
+// jobScaling    The terrain build and a fork/join tree on 1 to N threads (T with --threads):
+//               ms, speedup and steals, with the same results on every thread count.
+// frameArena    A frame's transient lists from the heap and from the frame allocator: ms
+//               and allocations per frame; the arenas must stop overflowing.
+// sceneGraph    100k nodes updated with 1% and with all of them changed, against a full
+//               pass over every node, whose world matrices they must match.
+// entityLayout  The snowman update over packed components and over the object/drawable/
+//               model pointers they replaced: ns and, where the kernel allows perf
+//               counters, cache misses per part.
+// sceneFile     100k snowmen parsed from a scene file's text and loaded from its binary:
+//               ms and bytes; duplicate materials and nameless nodes refused.
+// profiler      Scope cost with and without the fake GPU timer, and the summary and trace
+//               of a 16-frame window, which must hold every scope and GPU result once.
+// hotReload     What an include edit affects among 10k shaders; separators and "./" must
+//               not matter, and every replacement is built before any is swapped in.
+// indexCodec    Compressed index packs of the terrain grid and of a shuffled mesh: bytes
+//               per index and decode MB/s, SSE2 and scalar; malformed packs refused.
+// vertexCodec   The compact and height vertex formats against the full one: encode and
+//               decode MB/s, and round-trip errors within the quantization steps.
+// snowfall      P snowflakes stepped scalar and SSE2; every variant must end bit identical.
+// lightClusters L lamps binned into the first frame's froxels; every variant must agree.
+// exposure      The luminance histogram of a 1080p HDR frame, its accuracy on flat grey
+//               and the frames the exposure takes to settle.
+// renderTargetPool  The post-processing chain's memory, and random pass graphs that must
+//               never alias targets whose lifetimes overlap.
+// renderGraph   Build and compile cost of a 100-pass frame; the compiled unbinds and
+//               culling are replayed and checked.
+// lod           Level of detail over a crowd of C snowmen: triangles submitted and level
+//               switches per frame, with and without hysteresis.
+// impostors     Atlas layout and frame selection checks, then I distant snowmen drawn a
+//               part at a time against as impostors.
+// camera        Cached inverses, revisions and frustum planes checked over random poses;
+//               the cost of updates, plane extraction and culling.
+// input         Ten minutes of scripted input recorded, saved and replayed exactly, from
+//               the log's origin, riding the turntable box and flipping toggles. With
+//               --input the frames follow a recorded log's camera instead of circling;
+//               --save-input saves the scripted ticks for F frames as such a log.
+// capture       PNG and DDS files checked against an independent decoder, then R 1080p
+//               frames per encoding through the CaptureEncoder's thread.
+//
+// Built by SnowManBench.vcxproj, or anywhere with CMakeLists.txt; ctest runs the
+// self-checks at a small size.
+//
+// SnowManBench [--snowmen N] [--chunks M] [--textures K] [--frames F] [--threads T]
+//              [--particles P] [--lights L] [--crowd C] [--impostors I] [--captures R]
+//              [--out file.json] [--input file.bin] [--save-input file.bin]
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cfloat>
+#include <cstdarg>
+#include <cstddef>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "AllocationCounter.h"
+#include "AutoExposure.h"
+#include "CameraMatrices.h"
+#include "DrawOrder.h"
+#include "EntityStorage.h"
+#include "FlyCamera.h"
+#include "FrameCapture.h"
+#include "FrameArena.h"
+#include "HardwareCounter.h"
+#include "HotReload.h"
+#include "InputLog.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "LodSelection.h"
+#include "ImpostorAtlas.h"
+#include "IndexCodec.h"
+#include "OcclusionBuffer.h"
+#include "Profiler.h"
+#include "RenderBackend.h"
+#include "RenderGraph.h"
+#include "RenderTargetPool.h"
+#include "SceneFile.h"
+#include "SceneGraph.h"
+#include "Snowfall.h"
+#include "TerrainChunks.h"
+#include "VertexCodec.h"
+#include "ViewFrustum.h"
+
+// Timed loops store their results here, so they are not optimized away.
+static volatile float g_sink;
+
+namespace
+{
+	// Row-major, row vectors (v * M), the DirectXMath convention used by the app.
+	struct Mat4
+	{
+		float m[16];
+	};
+
+	Mat4 Identity()
+	{
+		Mat4 r = {};
+		r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+		return r;
+	}
+
+	Mat4 Multiply(const Mat4& a, const Mat4& b)
+	{
+		Mat4 r;
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) {
+				r.m[i * 4 + j] = a.m[i * 4 + 0] * b.m[0 * 4 + j] + a.m[i * 4 + 1] * b.m[1 * 4 + j] +
+					a.m[i * 4 + 2] * b.m[2 * 4 + j] + a.m[i * 4 + 3] * b.m[3 * 4 + j];
+			}
+		}
+		return r;
+	}
+
+	Mat4 ScaleRotateYTranslate(const float scale[3], float yaw, const float translation[3])
+	{
+		float c = cosf(yaw), s = sinf(yaw);
+		Mat4 r = {};
+		r.m[0] = c * scale[0];
+		r.m[2] = -s * scale[0];
+		r.m[5] = scale[1];
+		r.m[8] = s * scale[2];
+		r.m[10] = c * scale[2];
+		r.m[12] = translation[0];
+		r.m[13] = translation[1];
+		r.m[14] = translation[2];
+		r.m[15] = 1.0f;
+		return r;
+	}
+
+	Mat4 LookAtLH(const float eye[3], const float at[3])
+	{
+		float z[3] = { at[0] - eye[0], at[1] - eye[1], at[2] - eye[2] };
+		float zl = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (float& v : z)
+			v /= zl;
+		// x = normalize(up x z) with up = (0, 1, 0)
+		float x[3] = { z[2], 0.0f, -z[0] };
+		float xl = sqrtf(x[0] * x[0] + x[2] * x[2]);
+		x[0] /= xl;
+		x[2] /= xl;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+		Mat4 r = {};
+		for (int i = 0; i < 3; i++) {
+			r.m[i * 4 + 0] = x[i];
+			r.m[i * 4 + 1] = y[i];
+			r.m[i * 4 + 2] = z[i];
+		}
+		r.m[12] = -(x[0] * eye[0] + x[1] * eye[1] + x[2] * eye[2]);
+		r.m[13] = -(y[0] * eye[0] + y[1] * eye[1] + y[2] * eye[2]);
+		r.m[14] = -(z[0] * eye[0] + z[1] * eye[1] + z[2] * eye[2]);
+		r.m[15] = 1.0f;
+		return r;
+	}
+
+	Mat4 PerspectiveFovLH(float fovY, float aspect, float zn, float zf)
+	{
+		float h = 1.0f / tanf(fovY * 0.5f);
+		Mat4 r = {};
+		r.m[0] = h / aspect;
+		r.m[5] = h;
+		r.m[10] = zf / (zf - zn);
+		r.m[11] = 1.0f;
+		r.m[14] = -zn * zf / (zf - zn);
+		return r;
+	}
+
+	// Snowman parts as in snowMan.cpp: offset from the snowman's origin, bounding radius, mesh.
+	struct Part
+	{
+		float offset[3];
+		float radius;
+		uint32_t mesh;
+	};
+	const Part SnowManParts[] = {
+		{ { 0.0f, 0.5f, 0.0f }, 0.50f, 0 },		// body
+		{ { 0.0f, 1.2f, 0.0f }, 0.35f, 0 },		// head
+		{ { -0.1f, 1.3f, -0.3f }, 0.05f, 0 },	// eyes
+		{ { 0.1f, 1.3f, -0.3f }, 0.05f, 0 },
+		{ { 0.0f, 1.2f, -0.4f }, 0.10f, 1 },	// nose
+		{ { -0.6f, 0.8f, 0.0f }, 0.40f, 2 },	// arms
+		{ { 0.6f, 0.8f, 0.0f }, 0.40f, 2 },
+		{ { -1.0f, 1.0f, 0.0f }, 0.08f, 0 },	// hands
+		{ { 1.0f, 1.0f, 0.0f }, 0.08f, 0 },
+		{ { 0.0f, 1.5f, 0.0f }, 0.35f, 2 },		// hat
+		{ { 0.0f, 1.75f, 0.0f }, 0.25f, 2 },
+	};
+	const size_t PartCount = sizeof(SnowManParts) / sizeof(SnowManParts[0]);
+	const int ChunkCells = 32;
+
+	struct NodeComponent
+	{
+		int32_t parent;			// index into the node array, -1 for roots
+		float translation[3];
+		float scale[3];
+		float spin;				// radians per second
+		float angle;
+		Mat4 world;
+	};
+
+	struct DrawComponent
+	{
+		uint32_t node;
+		uint32_t mesh;
+		uint32_t material;
+		float offset[3];
+		float radius;
+		float center[3];		// world space, written by update
+		float worldRadius;
+	};
+
+	// Vertex and index counts of the GeometricPrimitive sphere, cone and cylinder snowMan uses.
+	const uint32_t MeshVertices[3] = { 153, 66, 134 };
+	const uint32_t MeshIndices[3] = { 768, 192, 372 };
+	const uint32_t CompactVertexBytes = 16;
+	// Index counts of the levels of detail snowMan builds for each mesh, by tessellation
+	// t: spheres 16, 10, 6, 4 (12t^2), cones 32, 16, 8 (6t), cylinders 32, 16, 8 (12t - 12)
+	const uint32_t LodIndices[3][LodSettings::MaxLevels] = { { 3072, 1200, 432, 192 }, { 192, 96, 48 }, { 372, 180, 84 } };
+	const uint8_t LodLevelCounts[3] = { 4, 3, 3 };
+	// sizeof(MatrixBufferType): six 4x4 matrices
+	const uint32_t MatrixBufferBytes = 6 * 64;
+
+	// Stand-ins for the shaders, layout, sampler and targets the D3D11 code creates.
+	char g_handles[6];
+	template <typename T>
+	T* Handle(int i) { return reinterpret_cast<T*>(&g_handles[i]); }
+
+	struct BenchResources
+	{
+		GpuBuffer* vertexBuffers[3];
+		GpuBuffer* indexBuffers[3];
+		GpuBuffer* matrixBuffer;
+		GpuBuffer* cameraBuffer;
+		GpuBuffer* colorBuffer;
+		std::vector<GpuTexture*> textures;
+	};
+
+	// The calls RenderEntities makes for one entity in the main pass.
+	void RecordEntityDraw(RecordingRenderBackend& recorder, const BenchResources& gpu, uint32_t mesh, uint32_t material,
+		const Mat4& world, const float eye[3])
+	{
+		GpuSampler* sampler = Handle<GpuSampler>(3);
+		GpuBuffer* vsBuffers[2] = { gpu.matrixBuffer, gpu.cameraBuffer };
+		uint32_t stride = CompactVertexBytes, offset = 0;
+		recorder.IASetInputLayout(Handle<GpuInputLayout>(0));
+		recorder.VSSetShader(Handle<GpuVertexShader>(1));
+		recorder.IASetVertexBuffers(0, 1, &gpu.vertexBuffers[mesh], &stride, &offset);
+		recorder.IASetIndexBuffer(gpu.indexBuffers[mesh], GpuIndex_16, 0);
+		recorder.PSSetShader(Handle<GpuPixelShader>(2));
+		memcpy(recorder.Map(gpu.matrixBuffer), world.m, sizeof(Mat4));
+		recorder.Unmap(gpu.matrixBuffer);
+		memcpy(recorder.Map(gpu.cameraBuffer), eye, 3 * sizeof(float));
+		recorder.Unmap(gpu.cameraBuffer);
+		memset(recorder.Map(gpu.colorBuffer), 0, 16);
+		recorder.Unmap(gpu.colorBuffer);
+		recorder.VSSetConstantBuffers(0, 2, vsBuffers);
+		recorder.PSSetConstantBuffers(0, 1, &gpu.colorBuffer);
+		recorder.PSSetSamplers(0, 1, &sampler);
+		recorder.PSSetShaderResources(0, 1, &gpu.textures[material % gpu.textures.size()]);
+		recorder.DrawIndexed(MeshIndices[mesh], 0, 0);
+	}
+
+	float Dot3(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	struct StageStats
+	{
+		const char* name;
+		std::vector<double> ms;
+		size_t allocations = 0;
+		size_t allocatedBytes = 0;
+	};
+
+	// Times one stage of one frame and counts the heap allocations made inside it.
+	class StageScope
+	{
+	public:
+		explicit StageScope(StageStats& stats) :
+			m_stats(stats), m_begin(ProfileClock::Now()), m_allocations(AllocationCounter::Allocations()), m_bytes(AllocationCounter::Bytes()) {}
+		~StageScope()
+		{
+			m_stats.ms.push_back(double(ProfileClock::Now() - m_begin) * 1000.0 / ProfileClock::TicksPerSecond());
+			m_stats.allocations += AllocationCounter::Allocations() - m_allocations;
+			m_stats.allocatedBytes += AllocationCounter::Bytes() - m_bytes;
+		}
+
+	private:
+		StageStats& m_stats;
+		uint64_t m_begin;
+		size_t m_allocations;
+		size_t m_bytes;
+	};
+
+	// A scripted session of fixed-step ticks, as a viewer flying around the scene gives:
+	// stretches of walking and strafing, turning by key, dragging the mouse, scrolling,
+	// tapping the toggle keys and standing still. It opens with four seconds of standing
+	// still, riding whatever carries the camera, and a tap of F to get off.
+	std::vector<InputSnapshot> ScriptInput(uint32_t ticks)
+	{
+		std::vector<InputSnapshot> script(std::min(ticks, 240u), InputSnapshot());
+		script.reserve(ticks);
+		if (script.size() < ticks) {
+			InputSnapshot getOff = {};
+			getOff.keys = InputKey_F;
+			script.push_back(getOff);
+		}
+		uint32_t seed = 2024;
+		auto next = [&seed](uint32_t n) {
+			seed = seed * 1664525u + 1013904223u;
+			return (seed >> 8) % n;
+		};
+		const uint32_t toggles[] = { InputKey_O, InputKey_K, InputKey_P, InputKey_N, InputKey_L, InputKey_X, InputKey_B, InputKey_G };
+		while (script.size() < ticks) {
+			InputSnapshot hold = {};
+			uint32_t length = 10 + next(110);
+			switch (next(6)) {
+			case 1:
+				hold.keys = next(2) ? InputKey_W : InputKey_S;
+				if (next(2))
+					hold.keys |= next(2) ? InputKey_A : InputKey_D;
+				break;
+			case 2:
+				hold.keys = next(2) ? InputKey_Q : InputKey_E;
+				if (next(3) == 0)
+					hold.keys |= next(2) ? InputKey_Z : InputKey_C;
+				break;
+			case 3:
+				hold.buttons = InputButton_Left;
+				hold.relative = 1;
+				break;
+			case 4:
+				hold.scroll = 1;
+				break;
+			case 5:
+				hold.keys = toggles[next(8)];
+				length = 3 + next(5);
+				break;
+			}
+			for (uint32_t t = 0; t < length && script.size() < ticks; t++) {
+				InputSnapshot input = hold;
+				if (hold.relative) {
+					input.mouseX = int32_t(next(21)) - 10;
+					input.mouseY = int32_t(next(9)) - 4;
+				}
+				// A wheel notch now and then
+				if (hold.scroll)
+					input.scroll = next(4) == 0 ? (next(2) ? 120 : -120) : 0;
+				script.push_back(input);
+			}
+		}
+		return script;
+	}
+
+	// A frame like the scene's: a sky gradient over shaded snow with snowmen drifting
+	// across it, and a little dither noise so it does not compress unrealistically well
+	void SyntheticFrame(uint32_t width, uint32_t height, CaptureFormat format, unsigned t, std::vector<uint8_t>& pixels)
+	{
+		pixels.resize(size_t(width) * height * 4);
+		uint32_t seed = t * 747796405u + 1;
+		uint8_t* p = pixels.data();
+		for (uint32_t y = 0; y < height; y++) {
+			const float v = (y + 0.5f) / height;
+			for (uint32_t x = 0; x < width; x++, p += 4) {
+				const float u = (x + 0.5f) / width;
+				float rgb[3];
+				if (v < 0.45f) {
+					rgb[0] = 0.35f + 0.3f * v;
+					rgb[1] = 0.5f + 0.3f * v;
+					rgb[2] = 0.85f;
+				}
+				else {
+					const float shade = 0.7f + 0.2f * sinf(u * 12.0f + t * 0.05f) * (v - 0.45f);
+					rgb[0] = rgb[1] = shade;
+					rgb[2] = shade + 0.05f;
+				}
+				for (unsigned k = 0; k < 6; k++) {
+					const float cx = fmodf(0.1f + 0.18f * k + t * 0.003f, 1.0f), cy = 0.6f + 0.05f * (k % 3);
+					const float dx = (u - cx) * width / height, dy = v - cy;
+					if (dx * dx + dy * dy < 0.0016f)
+						rgb[0] = rgb[1] = rgb[2] = 0.95f - 2.0f * dy * dy;
+				}
+				seed = seed * 1664525u + 1013904223u;
+				const float noise = (float(seed >> 24) / 255.0f - 0.5f) * 1.5f / 255.0f;
+				uint32_t c[3];
+				const float scale = format == CaptureFormat_R10G10B10A2 ? 1023.0f : 255.0f;
+				for (int i = 0; i < 3; i++)
+					c[i] = uint32_t(std::min(std::max(rgb[i] + noise, 0.0f), 1.0f) * scale + 0.5f);
+				if (format == CaptureFormat_R10G10B10A2) {
+					const uint32_t packed = c[0] | c[1] << 10 | c[2] << 20 | 3u << 30;
+					memcpy(p, &packed, 4);
+				}
+				else {
+					const bool bgra = format == CaptureFormat_B8G8R8A8;
+					p[0] = uint8_t(c[bgra ? 2 : 0]);
+					p[1] = uint8_t(c[1]);
+					p[2] = uint8_t(c[bgra ? 0 : 2]);
+					p[3] = 255;
+				}
+			}
+		}
+	}
+
+	// What a PNG of frame must decode to: 8-bit RGB, ten bit channels cut to their top eight
+	void ExpectedRgb(const CaptureFrame& frame, std::vector<uint8_t>& rgb)
+	{
+		rgb.resize(size_t(frame.width) * frame.height * 3);
+		for (size_t i = 0; i < size_t(frame.width) * frame.height; i++) {
+			const uint8_t* p = &frame.pixels[i * 4];
+			uint32_t packed;
+			memcpy(&packed, p, 4);
+			for (int c = 0; c < 3; c++) {
+				if (frame.format == CaptureFormat_R10G10B10A2)
+					rgb[i * 3 + c] = uint8_t((packed >> (10 * c + 2)) & 0xFF);
+				else
+					rgb[i * 3 + c] = p[frame.format == CaptureFormat_B8G8R8A8 ? 2 - c : c];
+			}
+		}
+	}
+
+	// Reads a zlib stream of stored and fixed-Huffman blocks, all EncodePng writes; false
+	// for dynamic blocks, anything malformed or a wrong checksum
+	bool Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+	{
+		static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+			35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+			257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+		out.clear();
+		if (size < 6 || (data[0] & 0x0F) != 8 || (data[0] << 8 | data[1]) % 31 != 0)
+			return false;
+		size_t at = 2;
+		uint64_t bits = 0;
+		unsigned count = 0;
+		auto get = [&](unsigned n, uint32_t& v) {
+			while (count < n) {
+				if (at >= size)
+					return false;
+				bits |= uint64_t(data[at++]) << count;
+				count += 8;
+			}
+			v = uint32_t(bits & ((uint64_t(1) << n) - 1));
+			bits >>= n;
+			count -= n;
+			return true;
+		};
+		// Huffman codes start at their most significant bit
+		auto getCode = [&](unsigned n, uint32_t& v) {
+			v = 0;
+			for (unsigned i = 0; i < n; i++) {
+				uint32_t b;
+				if (!get(1, b))
+					return false;
+				v = v << 1 | b;
+			}
+			return true;
+		};
+		uint32_t final = 0;
+		while (!final) {
+			uint32_t type;
+			if (!get(1, final) || !get(2, type))
+				return false;
+			if (type == 0) {
+				bits >>= count % 8;
+				count -= count % 8;
+				uint32_t length, complement, byte;
+				if (!get(16, length) || !get(16, complement) || (length ^ 0xFFFF) != complement)
+					return false;
+				for (uint32_t i = 0; i < length; i++) {
+					if (!get(8, byte))
+						return false;
+					out.push_back(uint8_t(byte));
+				}
+				continue;
+			}
+			if (type != 1)
+				return false;
+			for (;;) {
+				uint32_t code, symbol;
+				if (!getCode(7, code))
+					return false;
+				if (code <= 0x17)
+					symbol = 256 + code;
+				else {
+					uint32_t b;
+					if (!get(1, b))
+						return false;
+					code = code << 1 | b;
+					if (code >= 0x30 && code <= 0xBF)
+						symbol = code - 0x30;
+					else if (code >= 0xC0 && code <= 0xC7)
+						symbol = 280 + code - 0xC0;
+					else {
+						if (!get(1, b))
+							return false;
+						symbol = 144 + (code << 1 | b) - 0x190;
+					}
+				}
+				if (symbol < 256) {
+					out.push_back(uint8_t(symbol));
+					continue;
+				}
+				if (symbol == 256)
+					break;
+				if (symbol > 285)
+					return false;
+				uint32_t extra, distanceCode, distanceBits;
+				if (!get(lengthExtra[symbol - 257], extra) || !getCode(5, distanceCode) || distanceCode >= 30 ||
+					!get(distanceExtra[distanceCode], distanceBits))
+					return false;
+				const size_t length = lengthBase[symbol - 257] + extra, distance = distanceBase[distanceCode] + distanceBits;
+				if (distance > out.size())
+					return false;
+				for (size_t i = 0; i < length; i++)
+					out.push_back(out[out.size() - distance]);
+			}
+		}
+		bits >>= count % 8;
+		count -= count % 8;
+		uint32_t expected = 0, byte;
+		for (int i = 0; i < 4; i++) {
+			if (!get(8, byte))
+				return false;
+			expected = expected << 8 | byte;
+		}
+		uint32_t a = 1, b = 0;
+		for (uint8_t v : out) {
+			a = (a + v) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16 | a) == expected;
+	}
+
+	// Decodes an 8-bit RGB PNG, checking every chunk's CRC; false for anything else
+	bool DecodePng(const std::vector<uint8_t>& png, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgb)
+	{
+		const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (png.size() < 8 || memcmp(png.data(), signature, 8) != 0)
+			return false;
+		auto bigEndian = [](const uint8_t* p) { return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3]; };
+		std::vector<uint8_t> compressed;
+		width = height = 0;
+		bool ended = false;
+		for (size_t at = 8; !ended;) {
+			if (at + 12 > png.size())
+				return false;
+			const uint32_t length = bigEndian(&png[at]);
+			if (length > png.size() - at - 12)
+				return false;
+			const uint8_t* type = &png[at + 4];
+			const uint8_t* chunk = type + 4;
+			uint32_t crc = 0xFFFFFFFFu;
+			for (uint32_t i = 0; i < length + 4; i++) {
+				crc ^= type[i];
+				for (int k = 0; k < 8; k++)
+					crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+			}
+			if ((crc ^ 0xFFFFFFFFu) != bigEndian(chunk + length))
+				return false;
+			if (memcmp(type, "IHDR", 4) == 0) {
+				if (length != 13 || chunk[8] != 8 || chunk[9] != 2 || chunk[12] != 0)
+					return false;
+				width = bigEndian(chunk);
+				height = bigEndian(chunk + 4);
+			}
+			else if (memcmp(type, "IDAT", 4) == 0)
+				compressed.insert(compressed.end(), chunk, chunk + length);
+			else if (memcmp(type, "IEND", 4) == 0)
+				ended = true;
+			at += length + 12;
+		}
+		std::vector<uint8_t> filtered;
+		const size_t stride = size_t(width) * 3;
+		if (!Inflate(compressed.data(), compressed.size(), filtered) || filtered.size() != (stride + 1) * height)
+			return false;
+		rgb.assign(stride * height, 0);
+		for (uint32_t y = 0; y < height; y++) {
+			const uint8_t filter = filtered[y * (stride + 1)];
+			const uint8_t* in = &filtered[y * (stride + 1) + 1];
+			uint8_t* row = &rgb[y * stride];
+			const uint8_t* up = y > 0 ? row - stride : nullptr;
+			for (size_t i = 0; i < stride; i++) {
+				const int a = i >= 3 ? row[i - 3] : 0, b = up ? up[i] : 0, c = up && i >= 3 ? up[i - 3] : 0;
+				int predicted;
+				switch (filter) {
+				case 0: predicted = 0; break;
+				case 1: predicted = a; break;
+				case 2: predicted = b; break;
+				case 3: predicted = (a + b) / 2; break;
+				case 4: {
+					const int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+					predicted = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+					break;
+				}
+				default: return false;
+				}
+				row[i] = uint8_t(in[i] + predicted);
+			}
+		}
+		return true;
+	}
+
+	std::string GenerateScene(unsigned snowmen, unsigned textures)
+	{
+		std::string text = "light sun position -20 20 -20 pitch -45 yaw 45 size 30 30\nnode ground\n";
+		char line[160];
+		for (unsigned k = 0; k < textures; k++) {
+			sprintf(line, "material m%u texture Media/bench%u.jpg\n", k, k);
+			text += line;
+		}
+		const unsigned groupSize = 16;
+		const unsigned side = unsigned(ceil(sqrt(double(snowmen))));
+		for (unsigned i = 0; i < snowmen; i++) {
+			if (i % groupSize == 0) {
+				sprintf(line, "node group%u translate %.1f 0 %.1f spin %u\n", i / groupSize,
+					float(i % side) * 3.0f, float(i / side) * 3.0f, 15 + (i / groupSize) % 60);
+				text += line;
+			}
+			sprintf(line, "node s%u parent group%u translate %.1f 0 %.1f scale 1.5 1.5 1.5\ndrawable snowman s%u",
+				i, i / groupSize, float(i % 4) * 1.5f, float((i / 4) % 4) * 1.5f, i);
+			text += line;
+			// With no textures the snowmen are left without a material
+			if (textures > 0) {
+				sprintf(line, " material m%u", i % textures);
+				text += line;
+			}
+			text += "\n";
+		}
+		text += "drawable terrain ground size 16\n";
+		return text;
+	}
+
+	enum GraphAccessKind { GraphAccess_Read, GraphAccess_Target, GraphAccess_UnorderedAccess };
+
+	struct GraphAccess
+	{
+		uint32_t pass;
+		uint32_t resource;
+		GraphAccessKind kind;
+		RenderGraphStage stage;
+		uint32_t slot;
+	};
+
+	// A frame of passes drawing into transient targets of three sizes from what earlier
+	// passes drew, some into imported textures as unordered access, some into targets
+	// nothing reads; the last presents. accesses, when given, gets what was declared.
+	void BuildSyntheticGraph(RenderGraph& graph, uint32_t passes, GpuTexture* const* imported, uint32_t importedCount,
+		GpuRenderTarget* output, std::vector<GraphAccess>* accesses)
+	{
+		uint32_t seed = 0x6C8E9CF5u;
+		auto random = [&seed](uint32_t n) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			return seed % n;
+		};
+		auto declare = [&](uint32_t pass, uint32_t resource, GraphAccessKind kind, RenderGraphStage stage, uint32_t slot) {
+			if (kind == GraphAccess_Read)
+				graph.Read(pass, resource, stage, slot);
+			else if (kind == GraphAccess_Target)
+				graph.WriteTarget(pass, resource);
+			else
+				graph.WriteUnorderedAccess(pass, resource, slot);
+			if (accesses)
+				accesses->push_back({ pass, resource, kind, stage, slot });
+		};
+		static const RenderTargetDesc descs[3] = { { 1920, 1080, 10, 8 }, { 960, 540, 10, 8 }, { 480, 270, 28, 4 } };
+
+		graph.Reset();
+		if (accesses)
+			accesses->clear();
+		const uint32_t firstImported = uint32_t(graph.ResourceCount());
+		for (uint32_t i = 0; i < importedCount; i++)
+			graph.Import("Imported", imported[i]);
+		const uint32_t presented = graph.Import("Output", output);
+		uint32_t written[8] = {};		// the latest resources written, newest first
+		uint32_t writtenCount = 0;
+		for (uint32_t p = 0; p + 1 < passes; p++) {
+			const uint32_t pass = graph.AddPass("Synthetic", [](RenderBackend&) {});
+			// The newest output, and up to two older ones
+			const uint32_t reads = std::min(1 + random(3), writtenCount);
+			for (uint32_t r = 0; r < reads; r++) {
+				const uint32_t resource = written[r == 0 ? 0 : random(writtenCount)];
+				declare(pass, resource, GraphAccess_Read, RenderGraphStage(random(RenderGraphStage_Count)), random(8));
+			}
+			uint32_t write;
+			if (random(8) == 0) {
+				write = firstImported + random(importedCount);
+				declare(pass, write, GraphAccess_UnorderedAccess, RenderGraphStage_Compute, random(4));
+			}
+			else {
+				write = graph.CreateTransient("Transient", descs[random(3)]);
+				declare(pass, write, GraphAccess_Target, RenderGraphStage_Pixel, 0);
+			}
+			// Now and then a debug view nothing reads
+			if (random(10) == 0)
+				continue;
+			if (writtenCount < 8)
+				writtenCount++;
+			memmove(written + 1, written, (writtenCount - 1) * sizeof(uint32_t));
+			written[0] = write;
+		}
+		const uint32_t present = graph.AddPass("Present", [](RenderBackend&) {});
+		for (uint32_t r = 0; r < std::min(writtenCount, 2u); r++)
+			declare(present, written[r], GraphAccess_Read, RenderGraphStage_Pixel, r);
+		declare(present, presented, GraphAccess_Target, RenderGraphStage_Pixel, 0);
+		graph.SetSideEffects(present);
+	}
+
+	// Replays a compiled graph from nothing bound, applying its unbinds; false if any pass
+	// writes what a stage can still sample, or samples what is still a target or
+	// unordered access view, or if culling kept or dropped the wrong passes.
+	bool CheckCompiledGraph(const RenderGraph& graph, const std::vector<GraphAccess>& accesses)
+	{
+		auto key = [&graph](uint32_t resource) {
+			uint32_t physical = graph.PhysicalTarget(resource);
+			return physical == RenderTargetPool::NoTarget ? uint64_t(resource) + 1 : (uint64_t(1) << 32) | physical;
+		};
+		uint64_t shaderResources[RenderGraphStage_Count][RenderGraph::Slots] = {};
+		uint64_t unorderedAccess[RenderGraph::Slots] = {};
+		std::vector<uint64_t> targets;
+		for (uint32_t pass : graph.Order()) {
+			for (size_t i = 0; i < graph.UnbindCount(pass); i++) {
+				const RenderGraphUnbind& unbind = graph.Unbind(pass, i);
+				if (unbind.kind == RenderGraphUnbind_ShaderResource)
+					shaderResources[unbind.stage][unbind.slot] = 0;
+				else if (unbind.kind == RenderGraphUnbind_UnorderedAccess)
+					unorderedAccess[unbind.slot] = 0;
+				else
+					targets.clear();
+			}
+			bool setsTargets = false;
+			for (const GraphAccess& a : accesses) {
+				if (a.pass != pass)
+					continue;
+				const uint64_t k = key(a.resource);
+				const bool isTarget = std::find(targets.begin(), targets.end(), k) != targets.end() && !setsTargets;
+				bool isUnordered = false, isSampled = false;
+				for (uint64_t u : unorderedAccess)
+					isUnordered |= u == k;
+				for (auto& stage : shaderResources) {
+					for (uint64_t s : stage)
+						isSampled |= s == k;
+				}
+				if ((a.kind != GraphAccess_Read && isSampled) || (a.kind != GraphAccess_Target && isTarget) ||
+					(a.kind != GraphAccess_UnorderedAccess && isUnordered))
+					return false;
+			}
+			for (const GraphAccess& a : accesses) {
+				if (a.pass != pass)
+					continue;
+				if (a.kind == GraphAccess_Read)
+					shaderResources[a.stage][a.slot] = key(a.resource);
+				else if (a.kind == GraphAccess_UnorderedAccess)
+					unorderedAccess[a.slot] = key(a.resource);
+				else {
+					if (!setsTargets)
+						targets.clear();
+					setsTargets = true;
+					targets.push_back(key(a.resource));
+				}
+			}
+		}
+		// A pass is needed when a later kept pass reads what it writes, or it presents
+		for (uint32_t pass = 0; pass < graph.PassCount(); pass++) {
+			bool needed = pass + 1 == graph.PassCount();
+			for (const GraphAccess& w : accesses) {
+				if (w.pass != pass || w.kind == GraphAccess_Read)
+					continue;
+				for (const GraphAccess& r : accesses)
+					needed |= r.kind == GraphAccess_Read && r.resource == w.resource && r.pass > pass && !graph.Culled(r.pass);
+			}
+			if (needed == graph.Culled(pass))
+				return false;
+		}
+		return true;
+	}
+
+	void Summarize(std::string& json, StageStats& stage, unsigned frames, bool last)
+	{
+		std::vector<double> sorted = stage.ms;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (double v : sorted)
+			sum += v;
+		auto at = [&sorted](double p) { return sorted.empty() ? 0.0 : sorted[size_t(p * (sorted.size() - 1) + 0.5)]; };
+		char buffer[384];
+		sprintf(buffer, "    \"%s\": { \"meanMs\": %.4f, \"p50Ms\": %.4f, \"p95Ms\": %.4f, \"p99Ms\": %.4f, "
+			"\"allocationsPerFrame\": %.2f, \"allocatedBytesPerFrame\": %.1f }%s\n",
+			stage.name, sorted.empty() ? 0.0 : sum / sorted.size(), at(0.50), at(0.95), at(0.99),
+			double(stage.allocations) / frames, double(stage.allocatedBytes) / frames, last ? "" : ",");
+		json += buffer;
+	}
+
+	const char* Bool(bool value)
+	{
+		return value ? "true" : "false";
+	}
+
+	// Appends printf-style text to the report.
+	void Append(std::string& json, const char* format, ...)
+	{
+		va_list args;
+		va_start(args, format);
+		char buffer[1024];
+		const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+		va_end(args);
+		if (length < 0)
+			return;
+		if (size_t(length) < sizeof(buffer)) {
+			json.append(buffer, size_t(length));
+			return;
+		}
+		std::vector<char> longer(size_t(length) + 1);
+		va_start(args, format);
+		vsnprintf(longer.data(), longer.size(), format, args);
+		va_end(args);
+		json.append(longer.data(), size_t(length));
+	}
+
+	// " { "name": value, ... }" over the variants of a stage; negative values, as for the
+	// AVX2 variants on a machine without AVX2, are left out.
+	template <typename Variant, size_t N>
+	void AppendVariants(std::string& json, const Variant (&variants)[N], double Variant::*value, const char* format)
+	{
+		json += " {";
+		bool first = true;
+		for (const Variant& v : variants) {
+			if (v.*value < 0.0)
+				continue;
+			Append(json, first ? " \"%s\": " : ", \"%s\": ", v.name);
+			Append(json, format, v.*value);
+			first = false;
+		}
+		json += " }";
+	}
+
+	// Names the checks that failed on stderr; true when all of them passed.
+	bool Checks(const char* stage, std::initializer_list<std::pair<const char*, bool>> checks)
+	{
+		bool passed = true;
+		for (const auto& check : checks) {
+			if (!check.second)
+				fprintf(stderr, "%s: %s failed\n", stage, check.first);
+			passed = passed && check.second;
+		}
+		return passed;
+	}
+
+	const char* const Usage =
+		"usage: SnowManBench [--snowmen N] [--chunks M] [--textures K] [--frames F] [--threads T]\n"
+		"                    [--particles P] [--lights L] [--crowd C] [--impostors I] [--captures R]\n"
+		"                    [--out file.json] [--input file.bin] [--save-input file.bin]\n";
+
+
+	struct BenchOptions
+	{
+		unsigned snowmen = 1024;
+		unsigned chunks = 256;
+		unsigned textures = 8;
+		unsigned frames = 300;
+		unsigned threads = 0;				// 0 for one per core
+		unsigned particles = 1 << 20;
+		unsigned lights = 10000;
+		unsigned crowd = 10000;
+		unsigned impostors = 50000;
+		unsigned captures = 24;
+		const char* outPath = nullptr;
+		const char* inputPath = nullptr;
+		const char* saveInputPath = nullptr;
+		bool help = false;
+	};
+
+	// Every option takes a value; counts are whole numbers, frames and captures at least 1.
+	// False, with the usage on stderr, for anything else.
+	bool ParseOptions(int argc, char** argv, BenchOptions& options)
+	{
+		struct CountOption
+		{
+			const char* name;
+			unsigned* value;
+			unsigned least;
+		};
+		const CountOption countOptions[] = {
+			{ "--snowmen", &options.snowmen, 0 }, { "--chunks", &options.chunks, 0 }, { "--textures", &options.textures, 0 },
+			{ "--frames", &options.frames, 1 }, { "--threads", &options.threads, 0 }, { "--particles", &options.particles, 0 },
+			{ "--lights", &options.lights, 0 }, { "--crowd", &options.crowd, 0 }, { "--impostors", &options.impostors, 0 },
+			{ "--captures", &options.captures, 1 },
+		};
+		struct PathOption
+		{
+			const char* name;
+			const char** value;
+		};
+		const PathOption pathOptions[] = {
+			{ "--out", &options.outPath }, { "--input", &options.inputPath }, { "--save-input", &options.saveInputPath },
+		};
+		for (int i = 1; i < argc; i += 2) {
+			if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+				options.help = true;
+				return true;
+			}
+			const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			bool known = false;
+			for (const CountOption& option : countOptions) {
+				if (strcmp(argv[i], option.name) != 0)
+					continue;
+				char* end = nullptr;
+				const unsigned long count = value ? strtoul(value, &end, 10) : 0;
+				if (!value || !isdigit((unsigned char)value[0]) || *end || count > 0xFFFFFFFFul || count < option.least) {
+					fprintf(stderr, "%s needs a whole number%s\n%s", option.name, option.least ? " of at least 1" : "", Usage);
+					return false;
+				}
+				*option.value = unsigned(count);
+				known = true;
+			}
+			for (const PathOption& option : pathOptions) {
+				if (strcmp(argv[i], option.name) != 0)
+					continue;
+				if (!value) {
+					fprintf(stderr, "%s needs a file name\n%s", option.name, Usage);
+					return false;
+				}
+				*option.value = value;
+				known = true;
+			}
+			if (!known) {
+				fprintf(stderr, "unknown option %s\n%s", argv[i], Usage);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// What the scene stage leaves for the stages after it.
+	struct BenchScene
+	{
+		BenchScene() : recorder(&nullBackend) {}
+		~BenchScene()
+		{
+			for (int m = 0; m < 3; m++) {
+				recorder.Release(gpu.vertexBuffers[m]);
+				recorder.Release(gpu.indexBuffers[m]);
+			}
+			for (GpuBuffer* b : { gpu.matrixBuffer, gpu.cameraBuffer, gpu.colorBuffer })
+				recorder.Release(b);
+			for (GpuTexture* t : gpu.textures)
+				recorder.Release(t);
+		}
+
+		int dim = 0;						// terrain heights per side
+		std::vector<float> heights;
+		float extent = 0.0f;				// side of the square the snowmen and the terrain cover
+		std::vector<float> occluder;		// the terrain, a vertex every 4 cells
+		std::vector<uint32_t> occluderIndices;
+		OcclusionBuffer occlusion;
+		double skyPixelFraction = 0.0;
+		std::vector<float> replayPath;		// with --input, the eye and a point ahead of it per tick
+		NullRenderBackend nullBackend;
+		RecordingRenderBackend recorder;	// creates resources on nullBackend
+		BenchResources gpu = {};
+	};
+
+	// The camera circling the middle of the scene, or following the input log; returns
+	// the view-projection.
+	Mat4 SceneCamera(const BenchScene& scene, unsigned frame, float eye[3], Mat4& view)
+	{
+		const float extent = scene.extent;
+		float a = frame * 0.01f;
+		float at[3] = { extent * 0.5f, 0.0f, extent * 0.5f };
+		eye[0] = at[0] + cosf(a) * extent * 0.4f;
+		eye[1] = 20.0f;
+		eye[2] = at[2] + sinf(a) * extent * 0.4f;
+		if (!scene.replayPath.empty()) {
+			memcpy(eye, &scene.replayPath[frame * 6], 3 * sizeof(float));
+			memcpy(at, &scene.replayPath[frame * 6 + 3], 3 * sizeof(float));
+		}
+		view = LookAtLH(eye, at);
+		return Multiply(view, PerspectiveFovLH(0.785f, 16.0f / 9.0f, 0.1f, 1000.0f));
+	}
+
+	// Snowmen three units apart, as the bounding spheres of their parts.
+	struct Crowd
+	{
+		float extent;
+		std::vector<float> spheres;			// x, y, z and radius per part
+		std::vector<uint32_t> meshes;		// per part
+	};
+
+	Crowd BuildCrowd(unsigned snowmen)
+	{
+		Crowd crowd;
+		const unsigned side = std::max(1u, unsigned(ceil(sqrt(double(snowmen)))));
+		crowd.extent = float(side) * 3.0f;
+		crowd.spheres.reserve(size_t(snowmen) * PartCount * 4);
+		for (unsigned s = 0; s < snowmen; s++) {
+			float x = float(s % side) * 3.0f, z = float(s / side) * 3.0f;
+			for (const Part& part : SnowManParts) {
+				crowd.spheres.insert(crowd.spheres.end(), { x + part.offset[0], part.offset[1], z + part.offset[2], part.radius });
+				crowd.meshes.push_back(part.mesh);
+			}
+		}
+		return crowd;
+	}
+
+	// A camera circling inside the crowd with a little jitter, as a hand-held or bobbing camera has.
+	Mat4 CrowdView(const Crowd& crowd, unsigned frame)
+	{
+		float a = frame * 0.002f;
+		float jitter = 0.1f * sinf(frame * 2.1f);
+		float at[3] = { crowd.extent * 0.5f, 0.0f, crowd.extent * 0.5f };
+		float eye[3] = { at[0] + cosf(a) * crowd.extent * 0.3f + jitter, 3.0f + jitter, at[2] + sinf(a) * crowd.extent * 0.3f };
+		return LookAtLH(eye, at);
+	}
+
+	// The generated scene loaded, then the frame loop; false if the scene does not parse.
+	bool RunScene(const BenchOptions& options, InputLog* replayLog, JobSystem& jobs, BenchScene& scene, std::string& json)
+	{
+		const unsigned frames = options.frames;
+		FrameAllocator frameMemory(256 * 1024, 2, jobs.ThreadCount());
+
+		// Load: the generated scene goes through the same parser as Media/scene.txt.
+		size_t setupAllocations = AllocationCounter::Allocations();
+		uint64_t loadBegin = ProfileClock::Now();
+		std::string text = GenerateScene(options.snowmen, options.textures);
+		SceneFile file;
+		std::string error;
+		if (!file.ParseText(text.c_str(), text.size(), &error)) {
+			fprintf(stderr, "scene: %s\n", error.c_str());
+			return false;
+		}
+
+		EntityAllocator entities;
+		std::vector<NodeComponent> nodes(file.NodeCount());
+		for (uint32_t i = 0; i < file.NodeCount(); i++) {
+			const SceneNodeRecord& n = file.Nodes()[i];
+			NodeComponent& node = nodes[i];
+			node.parent = n.parent;
+			memcpy(node.translation, n.translation, sizeof(node.translation));
+			memcpy(node.scale, n.scale, sizeof(node.scale));
+			node.spin = n.spin;
+			node.angle = 0.0f;
+			node.world = Identity();
+		}
+		ComponentPool<DrawComponent> draws;
+		for (uint32_t i = 0; i < file.DrawableCount(); i++) {
+			const SceneDrawableRecord& d = file.Drawables()[i];
+			if (d.kind != SceneDrawable_SnowMan)
+				continue;
+			for (const Part& part : SnowManParts) {
+				DrawComponent c = { uint32_t(d.node), part.mesh, uint32_t(std::max(d.material, 0)),
+					{ part.offset[0], part.offset[1], part.offset[2] }, part.radius, { 0, 0, 0 }, 0 };
+				draws.Add(entities.Create(), c);
+			}
+		}
+
+		// Terrain of about M chunks with rolling hills.
+		int chunksPerSide = std::max(1, int(ceil(sqrt(double(options.chunks)))));
+		const int dim = scene.dim = chunksPerSide * ChunkCells + 1;
+		std::vector<float>& heights = scene.heights;
+		heights.assign(size_t(dim) * dim, 0.0f);
+		for (int z = 0; z < dim; z++) {
+			for (int x = 0; x < dim; x++)
+				heights[size_t(z) * dim + x] = 2.0f * sinf(x * 0.05f) * cosf(z * 0.07f);
+		}
+		TerrainChunkGrid terrain;
+		terrain.Build(heights.data(), dim, ChunkCells, 0, dim - 1, &jobs);
+		// Occluder vertex every 4 cells, as the app does
+		std::vector<float>& occluder = scene.occluder;
+		std::vector<uint32_t>& occluderIndices = scene.occluderIndices;
+		OcclusionBuffer::BuildHeightfieldOccluder(heights.data(), dim, 0, dim - 1, 4, 1.0f, occluder, occluderIndices);
+		OcclusionBuffer& occlusion = scene.occlusion;
+		double loadMs = double(ProfileClock::Now() - loadBegin) * 1000.0 / ProfileClock::TicksPerSecond();
+		setupAllocations = AllocationCounter::Allocations() - setupAllocations;
+
+		// GPU resources go through the recording backend, which creates them on the null one.
+		NullRenderBackend& nullBackend = scene.nullBackend;
+		RecordingRenderBackend& recorder = scene.recorder;
+		BenchResources& gpu = scene.gpu;
+		for (int m = 0; m < 3; m++) {
+			std::vector<uint8_t> vertices(MeshVertices[m] * CompactVertexBytes);
+			std::vector<uint16_t> indices(MeshIndices[m]);
+			gpu.vertexBuffers[m] = recorder.CreateBuffer({ uint32_t(vertices.size()), GpuBind_VertexBuffer, GpuUsage_Immutable }, vertices.data());
+			gpu.indexBuffers[m] = recorder.CreateBuffer({ uint32_t(indices.size() * 2), GpuBind_IndexBuffer, GpuUsage_Immutable }, indices.data());
+		}
+		gpu.matrixBuffer = recorder.CreateBuffer({ MatrixBufferBytes, GpuBind_ConstantBuffer, GpuUsage_Dynamic }, nullptr);
+		gpu.cameraBuffer = recorder.CreateBuffer({ 16, GpuBind_ConstantBuffer, GpuUsage_Dynamic }, nullptr);
+		gpu.colorBuffer = recorder.CreateBuffer({ 16, GpuBind_ConstantBuffer, GpuUsage_Dynamic }, nullptr);
+		std::vector<uint32_t> texels(256 * 256);
+		for (unsigned k = 0; k < std::max(options.textures, 1u); k++)
+			gpu.textures.push_back(recorder.CreateTexture2D({ 256, 256, 91 /* B8G8R8A8_UNORM_SRGB */, 4, GpuUsage_Immutable }, texels.data()));
+		RenderStats setupStats = recorder.Stats();
+		recorder.ResetStats();
+
+		StageStats update, cull, occlude, sort, record, submit;
+		update.name = "update";
+		cull.name = "cull";
+		occlude.name = "occlusion";
+		sort.name = "sort";
+		record.name = "record";
+		submit.name = "submit";
+		for (StageStats* s : { &update, &cull, &occlude, &sort, &record, &submit })
+			s->ms.reserve(frames);
+
+		size_t skyPixels = 0, screenPixels = 0;
+		size_t visibleTotal = 0, occludedTotal = 0, chunksTotal = 0, recordedBytes = 0;
+		const float dt = 1.0f / 60.0f;
+		scene.extent = float(std::max(dim, int(ceil(sqrt(double(options.snowmen)))) * 3));
+		// With --input the eye and a point ahead of it for each tick of the log
+		if (replayLog) {
+			FlyCamera fly;
+			fly.Restore(replayLog->Origin().camera);
+			replayLog->Rewind();
+			InputSnapshot input;
+			for (unsigned frame = 0; frame < frames && replayLog->Next(input); frame++) {
+				fly.Step(input);
+				float right[3], up[3], look[3];
+				fly.Basis(right, up, look);
+				scene.replayPath.insert(scene.replayPath.end(), { fly.position[0], fly.position[1], fly.position[2],
+					fly.position[0] + look[0], fly.position[1] + look[1], fly.position[2] + look[2] });
+			}
+		}
+		for (unsigned frame = 0; frame < frames; frame++) {
+			frameMemory.BeginFrame();
+			LinearArena& arena = frameMemory.Arena();
+
+			float eye[3];
+			Mat4 view;
+			Mat4 viewProj = SceneCamera(scene, frame, eye, view);
+
+			{
+				StageScope scope(update);
+				// Parents come before children, so one forward pass resolves the hierarchy.
+				for (NodeComponent& n : nodes) {
+					n.angle += n.spin * dt;
+					Mat4 local = ScaleRotateYTranslate(n.scale, n.angle, n.translation);
+					n.world = n.parent < 0 ? local : Multiply(local, nodes[n.parent].world);
+				}
+				DrawComponent* d = draws.Data();
+				jobs.ParallelFor(0, draws.Size(), 1024, [&](size_t first, size_t last) {
+					for (size_t i = first; i < last; i++) {
+						const Mat4& w = nodes[d[i].node].world;
+						const float* o = d[i].offset;
+						for (int c = 0; c < 3; c++)
+							d[i].center[c] = o[0] * w.m[c] + o[1] * w.m[4 + c] + o[2] * w.m[8 + c] + w.m[12 + c];
+						float sx = sqrtf(w.m[0] * w.m[0] + w.m[1] * w.m[1] + w.m[2] * w.m[2]);
+						d[i].worldRadius = d[i].radius * sx;
+					}
+				});
+			}
+
+			uint32_t* visible;
+			size_t visibleCount = 0, chunkCount;
+			{
+				StageScope scope(cull);
+				FrustumPlanes frustum;
+				ViewFrustum::ExtractSimd(viewProj.m, frustum);
+				const DrawComponent* d = draws.Data();
+				uint8_t* inside = arena.Allocate<uint8_t>(draws.Size());
+				if (draws.Size() > 0)
+					ViewFrustum::CullAll(frustum, d[0].center, sizeof(DrawComponent), inside, 1, draws.Size(), &jobs);
+				visible = arena.Allocate<uint32_t>(draws.Size());
+				for (size_t i = 0; i < draws.Size(); i++) {
+					if (inside[i])
+						visible[visibleCount++] = uint32_t(i);
+				}
+				TerrainChunkInstance* chunkList = arena.Allocate<TerrainChunkInstance>(terrain.ChunkCount());
+				chunkCount = terrain.Select(viewProj.m, 1.0f, chunkList);
+			}
+
+			{
+				StageScope scope(occlude);
+				occlusion.BeginFrame(viewProj.m);
+				occlusion.AddOccluder(occluder.data(), sizeof(float) * 3, occluder.size() / 3, occluderIndices.data(), occluderIndices.size());
+				occlusion.Rasterize(&jobs);
+				const DrawComponent* d = draws.Data();
+				size_t kept = 0;
+				for (size_t i = 0; i < visibleCount; i++) {
+					if (!occlusion.IsOccluded(d[visible[i]].center, d[visible[i]].worldRadius))
+						visible[kept++] = visible[i];
+				}
+				occludedTotal += visibleCount - kept;
+				visibleCount = kept;
+			}
+			int depthWidth, depthHeight;
+			const float* depth = occlusion.Level(0, &depthWidth, &depthHeight);
+			skyPixels += std::count(depth, depth + size_t(depthWidth) * depthHeight, 1.0f);
+			screenPixels += size_t(depthWidth) * depthHeight;
+
+			{
+				StageScope scope(sort);
+				// Nearest first, as the main pass draws for early-Z
+				DrawOrder::FrontToBack(view.m, draws.Data()->center, sizeof(DrawComponent), visible, visibleCount,
+					arena.Allocate<uint64_t>(visibleCount));
+			}
+
+			{
+				StageScope scope(record);
+				// The same calls RenderEntities makes for each visible entity in the main pass.
+				const float clearColor[4] = { 0, 0, 0, 1 };
+				recorder.Reset();
+				recorder.IASetPrimitiveTopology(GpuTopology_TriangleList);
+				recorder.OMSetRenderTargets(Handle<GpuRenderTarget>(4), Handle<GpuDepthTarget>(5));
+				recorder.ClearRenderTarget(Handle<GpuRenderTarget>(4), clearColor);
+				recorder.ClearDepthStencil(Handle<GpuDepthTarget>(5), GpuClear_Depth | GpuClear_Stencil, 1.0f, 0);
+				const DrawComponent* d = draws.Data();
+				for (size_t i = 0; i < visibleCount; i++) {
+					const DrawComponent& c = d[visible[i]];
+					RecordEntityDraw(recorder, gpu, c.mesh, c.material, nodes[c.node].world, eye);
+				}
+				recordedBytes += recorder.StreamBytes();
+			}
+
+			{
+				StageScope scope(submit);
+				recorder.Replay(nullBackend);
+			}
+			visibleTotal += visibleCount;
+			chunksTotal += chunkCount;
+		}
+
+		const RenderStats calls = recorder.Stats();
+		scene.skyPixelFraction = double(skyPixels) / double(std::max<size_t>(screenPixels, 1));
+
+		Append(json, "  \"config\": { \"snowmen\": %u, \"draws\": %zu, \"chunks\": %zu, \"textures\": %u, \"frames\": %u, \"threads\": %u },\n",
+			options.snowmen, draws.Size(), terrain.ChunkCount(), options.textures, frames, jobs.ThreadCount());
+		Append(json, "  \"load\": { \"ms\": %.3f, \"allocations\": %zu },\n", loadMs, setupAllocations);
+		json += "  \"stages\": {\n";
+		Summarize(json, update, frames, false);
+		Summarize(json, cull, frames, false);
+		Summarize(json, occlude, frames, false);
+		Summarize(json, sort, frames, false);
+		Summarize(json, record, frames, false);
+		Summarize(json, submit, frames, true);
+		json += "  },\n";
+		Append(json, "  \"backend\": {\n    \"setupCreatedBytes\": %llu,\n    \"callsPerFrame\": %.1f,\n"
+			"    \"redundantCallsPerFrame\": %.1f,\n    \"mappedBytesPerFrame\": %.1f,\n    \"indicesPerFrame\": %.1f,\n    \"calls\": {",
+			(unsigned long long)setupStats.createdBytes, double(calls.TotalCalls()) / frames,
+			double(calls.redundantCalls) / frames, double(calls.mappedBytes) / frames, double(calls.indices) / frames);
+		bool first = true;
+		for (uint32_t c = 0; c < GpuCommand_Count; c++) {
+			if (!calls.calls[c])
+				continue;
+			Append(json, "%s \"%s\": %.1f", first ? "" : ",", RenderStats::Name(GpuCommand(c)), double(calls.calls[c]) / frames);
+			first = false;
+		}
+		json += " }\n  },\n";
+		Append(json, "  \"frames\": {\n    \"visibleDrawsPerFrame\": %.1f,\n    \"occludedDrawsPerFrame\": %.1f,\n    \"visibleChunksPerFrame\": %.1f,\n"
+			"    \"commandStreamBytesPerFrame\": %.1f,\n    \"frameArenaPeakBytes\": %zu,\n    \"replayedFrames\": %zu\n  },\n",
+			double(visibleTotal) / frames, double(occludedTotal) / frames, double(chunksTotal) / frames, double(recordedBytes) / frames,
+			frameMemory.PeakBytes(), scene.replayPath.size() / 6);
+		return true;
+	}
+
+	// A unit cube's corners and triangles, as an occluder for the box the turntable carries
+	const float CubeCorners[8 * 3] = {
+		-0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f,
+		-0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f,
+	};
+	const uint32_t CubeIndices[12 * 3] = {
+		0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 4, 2, 2, 4, 6,
+		1, 3, 5, 3, 7, 5, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+	};
+
+	// Occluder throughput from the first frame's camera, per rasterizer and thread count.
+	// The scene camera looks down on hills too low to hide anything, so each rasterizer
+	// also draws a box in front of a standing viewer, with snowmen behind, in front of and
+	// beside it. Level 0 of every variant's depth must match the scalar one's to the bit.
+	bool RunOcclusion(const BenchOptions& options, BenchScene& scene, JobSystem& jobs, std::string& json)
+	{
+		struct Rasterizer
+		{
+			const char* name;
+			bool avx2;
+			JobSystem* jobs;
+			double trianglesPerMs;
+		};
+		Rasterizer rasterizers[] = {
+			{ "scalar", false, nullptr, -1.0 },
+			{ "avx2", true, nullptr, -1.0 },
+			{ "scalarThreads", false, &jobs, -1.0 },
+			{ "avx2Threads", true, &jobs, -1.0 },
+		};
+		float eye[3];
+		Mat4 firstView;
+		Mat4 firstViewProj = SceneCamera(scene, 0, eye, firstView);
+		const unsigned rasterRuns = std::max(options.frames / 4, 1u);
+		OcclusionBuffer& occlusion = scene.occlusion;
+		const std::vector<float>& occluder = scene.occluder;
+		const std::vector<uint32_t>& occluderIndices = scene.occluderIndices;
+
+		// A 4 unit box 3 to 7 units ahead of a viewer's eye, snowmen in a row 12 units
+		// ahead behind it, one at 1.5 units before it and one 10 units to the side
+		const float boxEye[3] = { 0.0f, 1.5f, 0.0f }, boxAt[3] = { 0.0f, 1.5f, 10.0f };
+		const Mat4 boxViewProj = Multiply(LookAtLH(boxEye, boxAt), PerspectiveFovLH(0.785f, 16.0f / 9.0f, 0.1f, 1000.0f));
+		const float boxScale[3] = { 4.0f, 4.0f, 4.0f }, boxTranslation[3] = { 0.0f, 1.5f, 5.0f };
+		const Mat4 boxWorld = ScaleRotateYTranslate(boxScale, 0.0f, boxTranslation);
+		const float snowmen[][3] = { { -1.5f, 0.0f, 12.0f }, { 0.0f, 0.0f, 12.0f }, { 1.5f, 0.0f, 12.0f },
+			{ 0.0f, 0.0f, 1.5f }, { 10.0f, 0.0f, 12.0f } };
+		const size_t hiddenSnowmen = 3;
+		size_t hiddenParts = 0;
+		bool occludesBehind = true, keepsVisible = true, identical = true;
+		OcclusionStats stats;
+		std::vector<float> referenceDepth, referenceBoxDepth;
+		auto sameDepth = [&](std::vector<float>& reference) {
+			int width, height;
+			const float* depth = occlusion.Level(0, &width, &height);
+			const size_t count = size_t(width) * height;
+			if (reference.empty()) {
+				reference.assign(depth, depth + count);
+				return true;
+			}
+			return reference.size() == count && memcmp(reference.data(), depth, count * sizeof(float)) == 0;
+		};
+
+		for (Rasterizer& r : rasterizers) {
+			if (r.avx2 && !OcclusionBuffer::HasAvx2())
+				continue;
+			occlusion.SetUseAvx2(r.avx2);
+			uint64_t begin = ProfileClock::Now();
+			for (unsigned run = 0; run < rasterRuns; run++) {
+				occlusion.BeginFrame(firstViewProj.m);
+				occlusion.AddOccluder(occluder.data(), sizeof(float) * 3, occluder.size() / 3, occluderIndices.data(), occluderIndices.size());
+				occlusion.Rasterize(r.jobs);
+			}
+			double ms = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond();
+			r.trianglesPerMs = double(occlusion.Stats().occluderTriangles) * rasterRuns / std::max(ms, 1e-6);
+			stats = occlusion.Stats();
+			identical = sameDepth(referenceDepth) && identical;
+
+			occlusion.BeginFrame(boxViewProj.m);
+			occlusion.AddOccluder(CubeCorners, sizeof(float) * 3, 8, CubeIndices, 36, boxWorld.m);
+			occlusion.Rasterize(r.jobs);
+			identical = sameDepth(referenceBoxDepth) && identical;
+			hiddenParts = 0;
+			for (size_t s = 0; s < sizeof(snowmen) / sizeof(snowmen[0]); s++) {
+				for (const Part& part : SnowManParts) {
+					const float center[3] = { snowmen[s][0] + part.offset[0], snowmen[s][1] + part.offset[1], snowmen[s][2] + part.offset[2] };
+					const bool occluded = occlusion.IsOccluded(center, part.radius);
+					hiddenParts += occluded ? 1 : 0;
+					occludesBehind = occludesBehind && (occluded || s >= hiddenSnowmen);
+					keepsVisible = keepsVisible && (!occluded || s < hiddenSnowmen);
+				}
+			}
+		}
+		occludesBehind = occludesBehind && hiddenParts > 0;
+
+		Append(json, "  \"occlusion\": {\n    \"width\": %d,\n    \"height\": %d,\n    \"occluderTriangles\": %zu,\n"
+			"    \"rasterizedTriangles\": %zu,\n    \"binnedTriangles\": %zu,\n    \"skyPixelFraction\": %.3f,\n    \"hasAvx2\": %s,\n"
+			"    \"boxView\": { \"parts\": %zu, \"hiddenParts\": %zu, \"occludesBehind\": %s, \"keepsVisible\": %s },\n"
+			"    \"identical\": %s,\n    \"trianglesPerMs\":",
+			occlusion.Width(), occlusion.Height(), stats.occluderTriangles, stats.rasterizedTriangles, stats.binnedTriangles,
+			scene.skyPixelFraction, Bool(OcclusionBuffer::HasAvx2()), sizeof(snowmen) / sizeof(snowmen[0]) * PartCount, hiddenParts,
+			Bool(occludesBehind), Bool(keepsVisible), Bool(identical));
+		AppendVariants(json, rasterizers, &Rasterizer::trianglesPerMs, "%.1f");
+		json += "\n  },\n";
+		return Checks("occlusion", { { "occludesBehind", occludesBehind }, { "keepsVisible", keepsVisible }, { "identical", identical } });
+	}
+
+	// The scene's heights built both ways terrain::create can: baked, a full vertex per grid
+	// point inside the border and a triangle list over them, and as the instanced patch, chunk
+	// bounds and one shared patch over a unorm16 heightmap. Build time and the bytes each puts
+	// on the GPU; the baked normals must match the ones the patch's vertex shader derives.
+	bool RunTerrain(const BenchOptions& options, const BenchScene& scene, JobSystem& jobs, std::string& json)
+	{
+		const int dim = scene.dim;
+		const float* heights = scene.heights.data();
+		const int row = dim - 2;
+		const int patchCells = 32;		// terrain::PatchCells
+		const unsigned runs = std::max(options.frames / 30, 1u);
+
+		std::vector<VertexFull> baked;
+		std::vector<uint32_t> bakedIndices;
+		uint64_t begin = ProfileClock::Now();
+		for (unsigned run = 0; run < runs; run++) {
+			baked.assign(size_t(row) * row, VertexFull());
+			jobs.ParallelFor(1, size_t(dim - 1), 16, [&](size_t firstRow, size_t lastRow) {
+				for (int z = int(firstRow); z < int(lastRow); z++) {
+					for (int x = 1; x < dim - 1; x++) {
+						VertexFull& v = baked[size_t(x - 1) + size_t(z - 1) * row];
+						v = { { float(x), heights[size_t(z) * dim + x], float(z) }, {}, { float(x) / dim, float(z) / dim } };
+						TerrainNormal(heights, dim, x, z, 1.0f, v.normal);
+					}
+				}
+			});
+			bakedIndices.clear();
+			bakedIndices.reserve(size_t(row - 1) * (row - 1) * 6);
+			for (uint32_t z = 1; z < uint32_t(row); z++) {
+				for (uint32_t x = 1; x < uint32_t(row); x++) {
+					bakedIndices.insert(bakedIndices.end(), { (x - 1) + (z - 1) * row, (x - 1) + z * row, x + (z - 1) * row,
+						(x - 1) + z * row, x + z * row, x + (z - 1) * row });
+				}
+			}
+		}
+		const double bakedMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / runs;
+
+		// The heightmap as the R16_UNORM texture createPatch uploads, over the heights' range
+		const float minHeight = *std::min_element(scene.heights.begin(), scene.heights.end());
+		const float heightScale = std::max(*std::max_element(scene.heights.begin(), scene.heights.end()) - minHeight, 1e-6f);
+		std::vector<uint16_t> heightMap(scene.heights.size());
+		TerrainChunkGrid chunks;
+		std::vector<VertexFull> patch;
+		std::vector<uint16_t> patchIndices;
+		begin = ProfileClock::Now();
+		for (unsigned run = 0; run < runs; run++) {
+			for (size_t i = 0; i < heightMap.size(); i++)
+				heightMap[i] = uint16_t((heights[i] - minHeight) / heightScale * 65535.0f + 0.5f);
+			chunks.Build(heights, dim, patchCells, 1, dim - 2, &jobs);
+			patch.clear();
+			patchIndices.clear();
+			for (int z = 0; z <= patchCells; z++) {
+				for (int x = 0; x <= patchCells; x++) {
+					const float u = float(x) / patchCells, v = float(z) / patchCells;
+					patch.push_back({ { u, 0.0f, v }, { 0.0f, 1.0f, 0.0f }, { u, v } });
+				}
+			}
+			const uint16_t patchRow = uint16_t(patchCells + 1);
+			for (uint16_t z = 1; z < patchRow; z++) {
+				for (uint16_t x = 1; x < patchRow; x++) {
+					patchIndices.insert(patchIndices.end(), { uint16_t((x - 1) + (z - 1) * patchRow), uint16_t((x - 1) + z * patchRow),
+						uint16_t(x + (z - 1) * patchRow), uint16_t((x - 1) + z * patchRow), uint16_t(x + z * patchRow),
+						uint16_t(x + (z - 1) * patchRow) });
+				}
+			}
+		}
+		const double patchMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / runs;
+
+		// DisplacePatchVertex's normal, written out: central differences of the texels around
+		// the vertex, clamped to the heightmap
+		float maxNormalError = 0.0f;
+		size_t flatNormals = 0;
+		auto texel = [&](int x, int z) {
+			return heightMap[size_t(std::min(std::max(z, 0), dim - 1)) * dim + std::min(std::max(x, 0), dim - 1)] / 65535.0f * heightScale + minHeight;
+		};
+		for (int z = 1; z < dim - 1; z++) {
+			for (int x = 1; x < dim - 1; x++) {
+				const float n[3] = { texel(x - 1, z) - texel(x + 1, z), 2.0f, texel(x, z - 1) - texel(x, z + 1) };
+				const VertexFull& v = baked[size_t(x - 1) + size_t(z - 1) * row];
+				const float cosine = (n[0] * v.normal[0] + n[1] * v.normal[1] + n[2] * v.normal[2]) / sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				maxNormalError = std::max(maxNormalError, acosf(std::min(cosine, 1.0f)));
+				flatNormals += v.normal[1] == 1.0f;
+			}
+		}
+		// Within a few unorm16 steps over a two-cell baseline, and lit like the patch
+		const bool normalsMatchPatch = maxNormalError <= 1e-3f && flatNormals < baked.size();
+
+		// Baked vertex bytes per format, with 32-bit indices as the height stream keeps them (the
+		// full and compact meshes are split into 16-bit parts, which repeat vertices at the seams)
+		const size_t bakedVertices = baked.size();
+		const size_t patchBytes = heightMap.size() * sizeof(uint16_t) + patch.size() * sizeof(VertexFull) +
+			patchIndices.size() * sizeof(uint16_t) + chunks.ChunkCount() * sizeof(TerrainChunkInstance);
+		Append(json, "  \"terrain\": {\n    \"gridVertices\": %zu,\n"
+			"    \"baked\": { \"buildMs\": %.3f, \"vertexBytes\": { \"full\": %zu, \"compact\": %zu, \"height\": %zu }, \"indexBytes\": %zu },\n"
+			"    \"patch\": { \"buildMs\": %.3f, \"bytes\": %zu, \"chunks\": %zu },\n"
+			"    \"maxNormalErrorRadians\": %.6f,\n    \"normalsMatchPatch\": %s\n  },\n",
+			bakedVertices, bakedMs, bakedVertices * VertexCodec::Stride(VertexFormat_Full), bakedVertices * VertexCodec::Stride(VertexFormat_Compact),
+			bakedVertices * VertexCodec::Stride(VertexFormat_Height), bakedIndices.size() * sizeof(uint32_t),
+			patchMs, patchBytes, chunks.ChunkCount(), maxNormalError, Bool(normalsMatchPatch));
+		return Checks("terrain", { { "normalsMatchPatch", normalsMatchPatch } });
+	}
+
+	// The terrain build (baked vertex rows and chunk bounds, as terrain::create runs them)
+	// and a fork/join tree of small jobs, on 1 to N threads: ms per run, speedup over one
+	// thread and jobs stolen. One thread runs the same code with no job system; every
+	// thread count must give the same vertices and the same sum.
+	bool RunJobScaling(const BenchOptions& options, const BenchScene& scene, std::string& json)
+	{
+		const int dim = scene.dim;
+		const float* heights = scene.heights.data();
+		const int row = dim - 2;
+		const unsigned maxThreads = std::max(options.threads ? options.threads : std::thread::hardware_concurrency(), 1u);
+		const unsigned runs = std::max(options.frames / 30, 1u);
+
+		struct ScalingPoint
+		{
+			unsigned threads;
+			double terrainMs;
+			double forkJoinMs;
+			uint64_t stolen;
+		};
+		std::vector<ScalingPoint> points;
+		std::vector<VertexFull> vertices, reference;
+		uint64_t referenceSum = 0;
+		bool identical = true;
+		// Touched once up front, so the first thread count does not pay for the page faults
+		vertices.assign(size_t(row) * row, VertexFull());
+		for (unsigned threads = 1; threads <= maxThreads; threads++) {
+			std::unique_ptr<JobSystem> pool(threads > 1 ? new JobSystem(threads - 1) : nullptr);
+			JobSystem* jobs = pool.get();
+			ScalingPoint point = { threads, 0.0, 0.0, 0 };
+
+			auto buildRows = [&](size_t firstRow, size_t lastRow) {
+				for (int z = int(firstRow); z < int(lastRow); z++) {
+					for (int x = 1; x < dim - 1; x++) {
+						VertexFull& v = vertices[size_t(x - 1) + size_t(z - 1) * row];
+						v = { { float(x), heights[size_t(z) * dim + x], float(z) }, {}, { float(x) / dim, float(z) / dim } };
+						TerrainNormal(heights, dim, x, z, 1.0f, v.normal);
+					}
+				}
+			};
+			TerrainChunkGrid chunks;
+			uint64_t begin = ProfileClock::Now();
+			for (unsigned run = 0; run < runs; run++) {
+				vertices.assign(size_t(row) * row, VertexFull());
+				if (jobs)
+					jobs->ParallelFor(1, size_t(dim - 1), 16, buildRows);
+				else
+					buildRows(1, size_t(dim - 1));
+				chunks.Build(heights, dim, 32, 1, dim - 2, jobs);
+			}
+			point.terrainMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / runs;
+
+			// 1024 leaves of 4096 hashes each, split in halves down from the root; parents
+			// wait on their children, so waiting threads run other jobs
+			std::function<uint64_t(uint32_t, uint32_t)> sum = [&](uint32_t first, uint32_t count) -> uint64_t {
+				if (count == 1) {
+					uint64_t h = first;
+					for (int i = 0; i < 4096; i++)
+						h = (h ^ (h >> 29)) * 0xBF58476D1CE4E5B9ull + 1;
+					return h;
+				}
+				if (!jobs)
+					return sum(first, count / 2) + sum(first + count / 2, count - count / 2);
+				uint64_t left = 0;
+				JobCounter counter;
+				jobs->Run([&] { left = sum(first, count / 2); }, &counter);
+				const uint64_t right = sum(first + count / 2, count - count / 2);
+				jobs->Wait(counter);
+				return left + right;
+			};
+			if (jobs)
+				jobs->ResetStats();
+			uint64_t total = 0;
+			begin = ProfileClock::Now();
+			for (unsigned run = 0; run < runs; run++)
+				total = sum(0, 1024);
+			point.forkJoinMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / runs;
+			point.stolen = jobs ? jobs->Stats().stolen : 0;
+
+			if (reference.empty()) {
+				reference = vertices;
+				referenceSum = total;
+			}
+			else {
+				identical = identical && total == referenceSum &&
+					memcmp(vertices.data(), reference.data(), vertices.size() * sizeof(VertexFull)) == 0;
+			}
+			points.push_back(point);
+		}
+
+		Append(json, "  \"jobScaling\": {\n    \"hardwareThreads\": %u,\n    \"points\": [\n", std::thread::hardware_concurrency());
+		for (const ScalingPoint& p : points) {
+			Append(json, "      { \"threads\": %u, \"terrainMs\": %.3f, \"terrainSpeedup\": %.2f, \"forkJoinMs\": %.3f, "
+				"\"forkJoinSpeedup\": %.2f, \"stolen\": %llu }%s\n", p.threads, p.terrainMs, points[0].terrainMs / std::max(p.terrainMs, 1e-9),
+				p.forkJoinMs, points[0].forkJoinMs / std::max(p.forkJoinMs, 1e-9), (unsigned long long)p.stolen, &p == &points.back() ? "" : ",");
+		}
+		Append(json, "    ],\n    \"identical\": %s\n  },\n", Bool(identical));
+		return Checks("jobScaling", { { "identical", identical } });
+	}
+
+	// A frame's transient lists, as Scene fills them: the cull mask, visible list, sort keys
+	// and impostor instances over every draw on the main thread, and 256 scratch lists of
+	// 64 to 288 entries filled by jobs. Once from the heap, a std::vector per list, and once
+	// from the frame allocator, per-thread arenas for the jobs: ms and heap allocations per
+	// frame. Past the first frames the arenas must have grown enough never to overflow.
+	bool RunFrameArena(const BenchOptions& options, JobSystem& jobs, std::string& json)
+	{
+		const size_t draws = size_t(options.snowmen) * 3;
+		const size_t scratchLists = 256;
+		const unsigned warmupFrames = 4;
+		struct FrameMemoryVariant
+		{
+			const char* name;
+			bool arena;
+			double msPerFrame;
+			double allocationsPerFrame;
+		};
+		FrameMemoryVariant variants[] = {
+			{ "heap", false, 0.0, 0.0 },
+			{ "arena", true, 0.0, 0.0 },
+		};
+		FrameAllocator frameMemory(256 * 1024, 2, jobs.ThreadCount());
+		size_t steadyOverflowBytes = 0;
+		uint64_t checksum[2] = { 0, 0 };
+		for (FrameMemoryVariant& variant : variants) {
+			uint64_t begin = 0;
+			size_t allocations = 0;
+			for (unsigned frame = 0; frame < warmupFrames + options.frames; frame++) {
+				if (frame == warmupFrames) {
+					begin = ProfileClock::Now();
+					allocations = AllocationCounter::Allocations();
+				}
+				std::atomic<uint64_t> sum{ 0 };
+				auto fillScratch = [&](uint32_t* list, size_t count, size_t job) {
+					for (size_t i = 0; i < count; i++)
+						list[i] = uint32_t(i * job);
+					sum += list[count - 1];
+				};
+				if (variant.arena) {
+					frameMemory.BeginFrame();
+					if (frame > warmupFrames)
+						steadyOverflowBytes += frameMemory.LastFrameStats().overflowBytes;
+					LinearArena& arena = frameMemory.Arena();
+					uint8_t* inside = arena.Allocate<uint8_t>(draws);
+					uint32_t* visible = arena.Allocate<uint32_t>(draws);
+					uint64_t* keys = arena.Allocate<uint64_t>(draws);
+					ImpostorInstance* instances = arena.Allocate<ImpostorInstance>(draws);
+					for (size_t i = 0; i < draws; i++) {
+						inside[i] = uint8_t(i & 1);
+						visible[i] = uint32_t(i);
+						keys[i] = i * 3;
+						instances[i].object = uint32_t(i);
+					}
+					jobs.ParallelFor(0, scratchLists, 8, [&](size_t first, size_t last) {
+						LinearArena& threadArena = frameMemory.ThreadArena(jobs);
+						for (size_t job = first; job < last; job++) {
+							const size_t count = 64 + job % 8 * 32;
+							fillScratch(threadArena.Allocate<uint32_t>(count), count, job);
+						}
+					});
+					sum += inside[draws / 2] + visible[draws / 2] + keys[draws / 2] + instances[draws / 2].object;
+				}
+				else {
+					std::vector<uint8_t> inside(draws);
+					std::vector<uint32_t> visible(draws);
+					std::vector<uint64_t> keys(draws);
+					std::vector<ImpostorInstance> instances(draws);
+					for (size_t i = 0; i < draws; i++) {
+						inside[i] = uint8_t(i & 1);
+						visible[i] = uint32_t(i);
+						keys[i] = i * 3;
+						instances[i].object = uint32_t(i);
+					}
+					jobs.ParallelFor(0, scratchLists, 8, [&](size_t first, size_t last) {
+						for (size_t job = first; job < last; job++) {
+							std::vector<uint32_t> list(64 + job % 8 * 32);
+							fillScratch(list.data(), list.size(), job);
+						}
+					});
+					sum += inside[draws / 2] + visible[draws / 2] + keys[draws / 2] + instances[draws / 2].object;
+				}
+				checksum[variant.arena] += sum;
+			}
+			variant.msPerFrame = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / options.frames;
+			variant.allocationsPerFrame = double(AllocationCounter::Allocations() - allocations) / options.frames;
+		}
+		// The jobs themselves allocate either way; the lists only cost the heap variant
+		const bool fewerAllocations = variants[1].allocationsPerFrame + scratchLists <= variants[0].allocationsPerFrame;
+		const bool noSteadyOverflow = steadyOverflowBytes == 0;
+		const bool sameResults = checksum[0] == checksum[1];
+
+		Append(json, "  \"frameArena\": {\n    \"draws\": %zu,\n    \"scratchLists\": %zu,\n    \"msPerFrame\":", draws, scratchLists);
+		AppendVariants(json, variants, &FrameMemoryVariant::msPerFrame, "%.4f");
+		json += ",\n    \"allocationsPerFrame\":";
+		AppendVariants(json, variants, &FrameMemoryVariant::allocationsPerFrame, "%.1f");
+		Append(json, ",\n    \"arenaPeakBytes\": %zu,\n    \"fewerAllocations\": %s,\n    \"noSteadyOverflow\": %s,\n    \"sameResults\": %s\n  },\n",
+			frameMemory.PeakBytes(), Bool(fewerAllocations), Bool(noSteadyOverflow), Bool(sameResults));
+		return Checks("frameArena", { { "fewerAllocations", fewerAllocations }, { "noSteadyOverflow", noSteadyOverflow },
+			{ "sameResults", sameResults } });
+	}
+
+	// 100k scene graph nodes, a thousand three-level groups, with 1% and with every node's
+	// local matrix changed before each Update: ms per update and nodes recomputed, against
+	// recomputing every node in one forward pass. The world matrices must come out the same
+	// as that full pass's.
+	bool RunSceneGraph(const BenchOptions& options, std::string& json)
+	{
+		const uint32_t groups = 1000, children = 9, grandchildren = 10;
+		auto localOf = [](uint32_t i, float angle) {
+			const float scale[3] = { 1.0f, 1.0f, 1.0f };
+			const float translation[3] = { float(i % 97), float(i % 7) * 0.5f, float(i % 89) };
+			const Mat4 m = ScaleRotateYTranslate(scale, angle + float(i) * 0.001f, translation);
+			SceneMatrix local;
+			memcpy(local.m, m.m, sizeof(local.m));
+			return local;
+		};
+		SceneGraph graph;
+		std::vector<SceneNodeHandle> nodes;
+		std::vector<uint32_t> parents;		// index into nodes, UINT32_MAX for roots
+		std::vector<SceneMatrix> locals;
+		auto create = [&](uint32_t parent) {
+			const uint32_t i = uint32_t(nodes.size());
+			locals.push_back(localOf(i, 0.0f));
+			nodes.push_back(graph.Create(locals.back(), parent == UINT32_MAX ? SceneNodeHandle() : nodes[parent]));
+			parents.push_back(parent);
+			return i;
+		};
+		uint64_t begin = ProfileClock::Now();
+		for (uint32_t g = 0; g < groups; g++) {
+			const uint32_t root = create(UINT32_MAX);
+			for (uint32_t c = 0; c < children; c++) {
+				const uint32_t child = create(root);
+				for (uint32_t gc = 0; gc < grandchildren; gc++)
+					create(child);
+			}
+		}
+		graph.Update();
+		const double buildMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond();
+
+		struct DirtyShare
+		{
+			const char* name;
+			uint32_t every;			// every Nth node changes
+			double msPerUpdate;
+			double nodesPerUpdate;
+		};
+		DirtyShare shares[] = {
+			{ "dirty1Percent", 100, 0.0, 0.0 },
+			{ "dirty100Percent", 1, 0.0, 0.0 },
+		};
+		const unsigned runs = std::max(options.frames, 1u);
+		std::vector<SceneMatrix> world(nodes.size());
+		bool matchesFullPass = true;
+		double fullPassMs = 0.0;
+		for (DirtyShare& share : shares) {
+			uint64_t ticks = 0;
+			size_t updated = 0;
+			for (unsigned run = 0; run < runs; run++) {
+				for (uint32_t i = run % share.every; i < nodes.size(); i += share.every)
+					locals[i] = localOf(i, float(run + 1) * 0.01f);
+				begin = ProfileClock::Now();
+				for (uint32_t i = run % share.every; i < nodes.size(); i += share.every)
+					graph.SetLocal(nodes[i], locals[i]);
+				graph.Update();
+				ticks += ProfileClock::Now() - begin;
+				updated += graph.LastUpdateCount();
+			}
+			share.msPerUpdate = double(ticks) * 1000.0 / ProfileClock::TicksPerSecond() / runs;
+			share.nodesPerUpdate = double(updated) / runs;
+
+			// Every node from scratch; parents were created before their children
+			begin = ProfileClock::Now();
+			for (size_t i = 0; i < nodes.size(); i++) {
+				if (parents[i] == UINT32_MAX)
+					world[i] = locals[i];
+				else
+					CameraMatrices::Multiply(locals[i].m, world[parents[i]].m, world[i].m);
+			}
+			fullPassMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond();
+			for (size_t i = 0; i < nodes.size(); i++)
+				matchesFullPass = matchesFullPass && memcmp(graph.World(nodes[i]).m, world[i].m, sizeof(SceneMatrix)) == 0;
+		}
+
+		Append(json, "  \"sceneGraph\": {\n    \"nodes\": %zu,\n    \"buildMs\": %.3f,\n    \"fullPassMs\": %.3f,\n",
+			nodes.size(), buildMs, fullPassMs);
+		for (const DirtyShare& share : shares)
+			Append(json, "    \"%s\": { \"msPerUpdate\": %.3f, \"nodesPerUpdate\": %.0f },\n", share.name, share.msPerUpdate, share.nodesPerUpdate);
+		Append(json, "    \"matchesFullPass\": %s\n  },\n", Bool(matchesFullPass));
+		return Checks("sceneGraph", { { "matchesFullPass", matchesFullPass } });
+	}
+
+	// The snowman update over 256k parts in the component layout, packed arrays walked front
+	// to back, and in the pointer layout the entities replaced: an object list pointing at
+	// drawables that point at individually allocated models, each allocated between the
+	// texture paths it carried. ns per part and, where perf_event_open is allowed, last level
+	// and L1 data cache misses per part; both layouts must compute the same centers.
+	bool RunEntityLayout(const BenchOptions& options, std::string& json)
+	{
+		const size_t partsPerObject = 3;
+		const size_t objects = 256 * 1024 / partsPerObject;
+		const size_t parts = objects * partsPerObject;
+		std::vector<Mat4> worlds(objects);
+		for (size_t o = 0; o < objects; o++) {
+			const float scale[3] = { 1.0f, 1.0f + float(o % 5) * 0.1f, 1.0f };
+			const float translation[3] = { float(o % 512) * 3.0f, 0.0f, float(o / 512) * 3.0f };
+			worlds[o] = ScaleRotateYTranslate(scale, float(o) * 0.1f, translation);
+		}
+
+		EntityAllocator entities;
+		ComponentPool<DrawComponent> draws;
+		for (size_t i = 0; i < parts; i++) {
+			const Part& part = SnowManParts[i % partsPerObject];
+			DrawComponent c = { uint32_t(i / partsPerObject), part.mesh, 0, { part.offset[0], part.offset[1], part.offset[2] },
+				part.radius, { 0, 0, 0 }, 0 };
+			draws.Add(entities.Create(), c);
+		}
+
+		struct LegacyModel
+		{
+			Mat4 model;
+			void* buffers[4];			// vertex, index, texture and normal map views
+			float offset[3];
+			float radius;
+			float center[3];
+			float worldRadius;
+		};
+		struct LegacyDrawable
+		{
+			std::vector<LegacyModel*> components;
+		};
+		struct LegacyObject
+		{
+			LegacyDrawable* geo;
+			const Mat4* world;
+		};
+		std::vector<std::unique_ptr<LegacyDrawable>> drawables;
+		std::vector<std::unique_ptr<LegacyModel>> models;
+		std::vector<std::wstring> paths;
+		std::vector<LegacyObject> legacy;
+		for (size_t o = 0; o < objects; o++) {
+			drawables.emplace_back(new LegacyDrawable());
+			for (size_t p = 0; p < partsPerObject; p++) {
+				const Part& part = SnowManParts[p];
+				models.emplace_back(new LegacyModel{ Identity(), {}, { part.offset[0], part.offset[1], part.offset[2] },
+					part.radius, { 0, 0, 0 }, 0 });
+				paths.push_back(L"Media/snowManTexture.jpg");
+				paths.push_back(L"Media/snowManNormalMap.jpg");
+				drawables.back()->components.push_back(models.back().get());
+			}
+			legacy.push_back(LegacyObject{ drawables.back().get(), &worlds[o] });
+		}
+
+		auto centerOf = [](const Mat4& w, const float offset[3], float center[3]) {
+			for (int c = 0; c < 3; c++)
+				center[c] = offset[0] * w.m[c] + offset[1] * w.m[4 + c] + offset[2] * w.m[8 + c] + w.m[12 + c];
+			return sqrtf(w.m[0] * w.m[0] + w.m[1] * w.m[1] + w.m[2] * w.m[2]);
+		};
+		struct Layout
+		{
+			const char* name;
+			double nsPerPart;
+			double cacheMissesPerPart;
+			double l1MissesPerPart;
+		};
+		Layout layouts[] = {
+			{ "components", 0.0, -1.0, -1.0 },
+			{ "pointers", 0.0, -1.0, -1.0 },
+		};
+		HardwareCounter cacheMisses(HardwareEvent_CacheMisses);
+		HardwareCounter l1Misses(HardwareEvent_L1DataMisses);
+		const unsigned runs = std::max(options.frames / 10, 1u);
+		for (Layout& layout : layouts) {
+			const bool components = &layout == &layouts[0];
+			uint64_t misses = 0, l1 = 0;
+			uint64_t begin = ProfileClock::Now();
+			for (unsigned run = 0; run < runs; run++) {
+				cacheMisses.Start();
+				l1Misses.Start();
+				if (components) {
+					DrawComponent* d = draws.Data();
+					for (size_t i = 0; i < draws.Size(); i++)
+						d[i].worldRadius = d[i].radius * centerOf(worlds[d[i].node], d[i].offset, d[i].center);
+				}
+				else {
+					for (const LegacyObject& object : legacy) {
+						for (LegacyModel* m : object.geo->components)
+							m->worldRadius = m->radius * centerOf(*object.world, m->offset, m->center);
+					}
+				}
+				misses += cacheMisses.Stop();
+				l1 += l1Misses.Stop();
+			}
+			layout.nsPerPart = double(ProfileClock::Now() - begin) * 1e9 / ProfileClock::TicksPerSecond() / runs / parts;
+			if (cacheMisses.Available())
+				layout.cacheMissesPerPart = double(misses) / runs / parts;
+			if (l1Misses.Available())
+				layout.l1MissesPerPart = double(l1) / runs / parts;
+		}
+
+		bool sameResults = true;
+		for (size_t i = 0; i < parts; i++) {
+			const DrawComponent& d = draws.Data()[i];
+			const LegacyModel& m = *models[i];
+			sameResults = sameResults && memcmp(d.center, m.center, sizeof(d.center)) == 0 && d.worldRadius == m.worldRadius;
+		}
+
+		Append(json, "  \"entityLayout\": {\n    \"parts\": %zu,\n    \"nsPerPart\":", parts);
+		AppendVariants(json, layouts, &Layout::nsPerPart, "%.2f");
+		json += ",\n    \"cacheMissesPerPart\":";
+		AppendVariants(json, layouts, &Layout::cacheMissesPerPart, "%.3f");
+		json += ",\n    \"l1MissesPerPart\":";
+		AppendVariants(json, layouts, &Layout::l1MissesPerPart, "%.3f");
+		// Without counters the miss rates are left out and the reason is given instead
+		const std::string& why = cacheMisses.Available() ? l1Misses.Error() : cacheMisses.Error();
+		Append(json, ",\n    \"counters\": \"%s\",\n    \"sameResults\": %s\n  },\n",
+			why.empty() ? "perf_event_open" : why.c_str(), Bool(sameResults));
+		return Checks("entityLayout", { { "sameResults", sameResults } });
+	}
+
+	// A generated scene of 100k snowmen parsed from text, then saved and loaded as the
+	// binary the text compiles to: ms and bytes of each. Duplicate material names and
+	// nameless nodes must be refused.
+	bool RunSceneFile(const BenchOptions& options, std::string& json)
+	{
+		const unsigned objects = 100000;
+		const std::string text = GenerateScene(objects, std::max(options.textures, 1u));
+		SceneFile parsed, loaded;
+		std::string error;
+		uint64_t begin = ProfileClock::Now();
+		const bool parsedText = parsed.ParseText(text.c_str(), text.size(), &error);
+		const double parseMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond();
+
+		const char* path = "SnowManBench.scene";
+		bool loadedSame = parsedText && parsed.SaveBinary(path);
+		begin = ProfileClock::Now();
+		loadedSame = loadedSame && loaded.Load(path, &error);
+		const double loadMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond();
+		char last[32];
+		sprintf(last, "s%u", objects - 1);
+		loadedSame = loadedSame && loaded.NodeCount() == parsed.NodeCount() && loaded.DrawableCount() == objects + 1 &&
+			loaded.FindNode(last) == parsed.FindNode(last) && loaded.FindNode(last) >= 0;
+
+		// The first node's name patched to SceneNoString in the saved binary
+		bool namelessNodeRejected = false;
+		long binaryBytes = 0;
+		if (FILE* fp = fopen(path, "r+b")) {
+			fseek(fp, 0, SEEK_END);
+			binaryBytes = ftell(fp);
+			fseek(fp, long(sizeof(SceneFileHeader) + offsetof(SceneNodeRecord, name)), SEEK_SET);
+			const uint32_t noName = SceneNoString;
+			namelessNodeRejected = fwrite(&noName, sizeof(noName), 1, fp) == 1;
+			fclose(fp);
+			SceneFile patched;
+			namelessNodeRejected = namelessNodeRejected && !patched.Load(path, &error);
+		}
+		remove(path);
+		const char duplicate[] = "material snow color 1 1 1 1\nmaterial snow texture Media/snow.jpg\n";
+		SceneFile twice;
+		const bool duplicateMaterialRejected = !twice.ParseText(duplicate, sizeof(duplicate) - 1, &error);
+
+		Append(json, "  \"sceneFile\": { \"nodes\": %u, \"drawables\": %u, \"textBytes\": %zu, \"parseMs\": %.2f, "
+			"\"binaryBytes\": %ld, \"loadMs\": %.2f,\n", parsed.NodeCount(), parsed.DrawableCount(), text.size(), parseMs,
+			binaryBytes, loadMs);
+		Append(json, "    \"loadedSame\": %s, \"namelessNodeRejected\": %s, \"duplicateMaterialRejected\": %s },\n",
+			Bool(loadedSame), Bool(namelessNodeRejected), Bool(duplicateMaterialRejected));
+		return Checks("sceneFile", { { "loadedSame", loadedSame }, { "namelessNodeRejected", namelessNodeRejected },
+			{ "duplicateMaterialRejected", duplicateMaterialRejected } });
+	}
+
+	// The hot reload dependency map over R shaders that share a few includes: ms to find
+	// what an include edit affects. Paths written with either separator, "./" or doubled
+	// slashes must match, and a reload must build every replacement before swapping any.
+	bool RunHotReload(const BenchOptions& options, std::string& json)
+	{
+		ReloadDependencies dependencies;
+		const uint32_t resources = 10000, includes = 16;
+		char file[64];
+		for (uint32_t r = 0; r < resources; r++) {
+			sprintf(file, "Shaders\\shader%u.hlsl", r);
+			dependencies.Add(r, file);
+			sprintf(file, "Shaders/include%u.hlsli", r % includes);
+			dependencies.Add(r, file);
+			dependencies.Add(r, file);
+		}
+		const unsigned runs = std::max(options.frames, 1u);
+		std::vector<uint32_t> affected;
+		const std::vector<std::string> edited = { "./Shaders//include3.hlsli", "Shaders\\.\\shader3.hlsl" };
+		uint64_t begin = ProfileClock::Now();
+		for (unsigned run = 0; run < runs; run++) {
+			affected.clear();
+			dependencies.Affected(edited, affected);
+		}
+		const double affectedMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / runs;
+		bool dependenciesMatch = dependencies.FileCount() == resources + includes && affected.size() == resources / includes;
+		for (size_t i = 0; i < affected.size(); i++)
+			dependenciesMatch = dependenciesMatch && affected[i] == 3 + i * includes;
+		dependencies.Remove(3);
+		affected.clear();
+		dependencies.Affected(edited, affected);
+		dependenciesMatch = dependenciesMatch && dependencies.FileCount() == resources + includes - 1 &&
+			affected.size() == resources / includes - 1 && affected.front() == 3 + includes;
+		const bool normalized = ReloadDependencies::Normalize(".\\a\\.//b/./c.hlsl") == ReloadDependencies::Normalize("a/b/c.hlsl");
+
+		// Two shaders sharing an include, one of which fails to build, edited twice in a row
+		typedef HotReload::Clock Clock;
+		HotReload reload(nullptr);
+		std::vector<std::string> log;
+		auto reloader = [&log](const char* name, bool fails) {
+			return [&log, name, fails](uint32_t) -> std::function<void()> {
+				log.push_back(std::string("build ") + name);
+				if (fails)
+					throw std::runtime_error("compile error");
+				return [&log, name]() { log.push_back(std::string("swap ") + name); };
+			};
+		};
+		const uint32_t sky = reload.Add("sky", reloader("sky", false));
+		const uint32_t snow = reload.Add("snow", reloader("snow", true));
+		const uint32_t terrain = reload.Add("terrain", reloader("terrain", false));
+		reload.Depend(sky, "Shaders/sky.hlsl");
+		reload.SetDependencies(snow, { "Shaders/snow.hlsl", "Shaders/common.hlsli" });
+		reload.Depend(terrain, "Shaders/common.hlsli");
+		const Clock::time_point start = Clock::now();
+		reload.FileChanged("Shaders\\common.hlsli", start);
+		reload.FileChanged("Shaders/./common.hlsli", start + std::chrono::milliseconds(30));
+		const size_t early = reload.Update(start + std::chrono::milliseconds(60));
+		const size_t settled = reload.Update(start + std::chrono::milliseconds(90));
+		reload.FramePresented(start + std::chrono::milliseconds(100));
+		const std::vector<HotReload::Report> reports = reload.TakeReports();
+		const std::vector<std::string> expected = { "build snow", "build terrain", "swap terrain" };
+		const bool swappedAfterBuilds = early == 0 && settled == 1 && log == expected && reports.size() == 2 &&
+			reports[0].name == "snow" && reports[0].failed && reports[1].name == "terrain" && !reports[1].failed &&
+			fabs(reports[1].latencyMs - 100.0) < 1e-3;
+
+		Append(json, "  \"hotReload\": { \"resources\": %u, \"files\": %zu, \"affectedMs\": %.4f, \"dependenciesMatch\": %s, "
+			"\"normalized\": %s, \"swappedAfterBuilds\": %s },\n", resources, dependencies.FileCount(), affectedMs,
+			Bool(dependenciesMatch), Bool(normalized), Bool(swappedAfterBuilds));
+		return Checks("hotReload", { { "dependenciesMatch", dependenciesMatch }, { "normalized", normalized },
+			{ "swappedAfterBuilds", swappedAfterBuilds } });
+	}
+
+	// The frame profiler over F frames of nested CPU scopes, job scopes on every thread and
+	// a GPU scope timed by the fake GPU timer: ns per scope, and the summary and trace of a
+	// 16-frame window, which must hold every frame, scope and late GPU result exactly once.
+	bool RunProfiler(const BenchOptions& options, JobSystem& jobs, std::string& json)
+	{
+		// The fake timer alone: each frame comes back latency frames late, nested as timed
+		const unsigned latency = 2;
+		bool gpuLatency = true;
+		{
+			FakeGpuTimer gpu(latency);
+			GpuFrame collected;
+			for (uint64_t frame = 0; frame < 8; frame++) {
+				gpu.BeginFrame(frame);
+				const int outer = gpu.Begin("outer");
+				const int inner = gpu.Begin("inner");
+				gpu.End(inner);
+				gpu.End(outer);
+				gpu.EndFrame();
+				const bool ready = gpu.Collect(collected);
+				gpuLatency = gpuLatency && ready == (frame >= latency) && !gpu.Collect(collected);
+				if (!ready)
+					continue;
+				const std::vector<GpuSample>& s = collected.samples;
+				gpuLatency = gpuLatency && collected.frame == frame - latency && s.size() == 2 &&
+					s[0].depth == 0 && s[1].depth == 1 && s[0].beginMs <= s[1].beginMs && s[1].endMs <= s[0].endMs &&
+					s[1].beginMs <= s[1].endMs;
+			}
+		}
+
+		const size_t history = 16;
+		const unsigned frames = std::max(options.frames, unsigned(history) + latency);
+		const double spinMs = 0.2;
+		FakeGpuTimer gpu(latency);
+		Profiler profiler(&gpu, history);
+		std::atomic<uint32_t> jobScopes(0), jobWork(0);
+		std::vector<uint32_t> jobScopesPerFrame;
+		for (unsigned frame = 0; frame < frames; frame++) {
+			profiler.BeginFrame();
+			{
+				ProfileScope update(profiler, "Update");
+				const uint64_t until = ProfileClock::Now() + uint64_t(spinMs * 1e-3 * ProfileClock::TicksPerSecond());
+				while (ProfileClock::Now() < until) {}
+			}
+			{
+				RenderProfileScope render(profiler, "Render");
+				jobScopes = 0;
+				jobs.ParallelFor(0, 4096, 256, [&](size_t first, size_t last) {
+					ProfileScope job(profiler, "Job");
+					uint32_t work = 0;
+					for (size_t i = first; i < last; i++)
+						work += uint32_t(i * 2654435761u);
+					jobWork += work;
+					jobScopes++;
+				});
+				jobScopesPerFrame.push_back(jobScopes);
+			}
+			profiler.EndFrame();
+		}
+		g_sink = float(jobWork);
+
+		// Scope cost on one thread, CPU only and with the fake GPU timer
+		const unsigned scopes = 100000;
+		double cpuScopeNs = 0.0, renderScopeNs = 0.0;
+		{
+			FakeGpuTimer overheadGpu(latency);
+			Profiler overhead(&overheadGpu, 1);
+			overhead.BeginFrame();
+			uint64_t begin = ProfileClock::Now();
+			for (unsigned i = 0; i < scopes; i++)
+				ProfileScope scope(overhead, "Scope");
+			cpuScopeNs = double(ProfileClock::Now() - begin) * 1e9 / ProfileClock::TicksPerSecond() / scopes;
+			begin = ProfileClock::Now();
+			for (unsigned i = 0; i < scopes; i++)
+				RenderProfileScope scope(overhead, "RenderScope");
+			renderScopeNs = double(ProfileClock::Now() - begin) * 1e9 / ProfileClock::TicksPerSecond() / scopes;
+			overhead.EndFrame();
+		}
+
+		// Every scope in the window once, GPU results for all but the last latency frames
+		const std::vector<Profiler::Stats> summary = profiler.Summary();
+		auto find = [&summary](const char* name, bool gpuScope) -> const Profiler::Stats* {
+			for (const Profiler::Stats& s : summary) {
+				if (s.name == name && s.gpu == gpuScope)
+					return &s;
+			}
+			return nullptr;
+		};
+		const Profiler::Stats* frameStats = find("Frame", false);
+		const Profiler::Stats* update = find("Update", false);
+		const Profiler::Stats* render = find("Render", false);
+		const Profiler::Stats* job = find("Job", false);
+		const Profiler::Stats* gpuRender = find("Render", true);
+		bool summaryComplete = summary.size() == 5 && frameStats && update && render && job && gpuRender &&
+			frameStats->frames == history && update->frames == history && render->frames == history &&
+			job->frames == history && gpuRender->frames == history;
+		for (const Profiler::Stats& s : summary)
+			summaryComplete = summaryComplete && s.p50Ms <= s.p95Ms && s.p95Ms <= s.p99Ms && s.meanMs >= 0.0;
+		summaryComplete = summaryComplete && update->p50Ms >= spinMs * 0.9 && frameStats->p50Ms >= update->p50Ms;
+
+		const std::string trace = profiler.ChromeTrace();
+		auto count = [&trace](const char* needle) {
+			size_t n = 0;
+			for (size_t at = trace.find(needle); at != std::string::npos; at = trace.find(needle, at + 1))
+				n++;
+			return n;
+		};
+		size_t cpuEvents = 0;
+		for (size_t f = frames - history; f < frames; f++)
+			cpuEvents += 2 + jobScopesPerFrame[f];
+		const bool traceComplete = count("\"cat\":\"frame\"") == history && count("\"cat\":\"cpu\"") == cpuEvents &&
+			count("\"cat\":\"gpu\"") == history - latency;
+
+		Append(json, "  \"profiler\": { \"frames\": %u, \"history\": %zu, \"cpuScopeNs\": %.1f, \"renderScopeNs\": %.1f, "
+			"\"updateP50Ms\": %.3f, \"traceBytes\": %zu,\n", frames, history, cpuScopeNs, renderScopeNs,
+			update ? update->p50Ms : 0.0, trace.size());
+		Append(json, "    \"gpuLatency\": %s, \"summaryComplete\": %s, \"traceComplete\": %s },\n", Bool(gpuLatency),
+			Bool(summaryComplete), Bool(traceComplete));
+		return Checks("profiler", { { "gpuLatency", gpuLatency }, { "summaryComplete", summaryComplete },
+			{ "traceComplete", traceComplete } });
+	}
+
+	// Index packs of the terrain's triangle list, whose deltas mostly fit a byte, and of
+	// the same list over shuffled vertices, whose deltas do not: bytes per index and decode
+	// throughput, SSE2 against scalar; both must decode exactly, and packs that are cut
+	// short or whose header overstates its counts must be refused without allocating.
+	bool RunIndexCodec(const BenchOptions& options, const BenchScene& scene, std::string& json)
+	{
+		// The grid terrain::create builds over the heights inside the border
+		const uint32_t row = uint32_t(std::max(scene.dim - 2, 2));
+		std::vector<uint32_t> grid;
+		grid.reserve(size_t(row - 1) * (row - 1) * 6);
+		for (uint32_t z = 1; z < row; z++) {
+			for (uint32_t x = 1; x < row; x++) {
+				grid.insert(grid.end(), { (x - 1) + (z - 1) * row, (x - 1) + z * row, x + (z - 1) * row,
+					(x - 1) + z * row, x + z * row, x + (z - 1) * row });
+			}
+		}
+		std::vector<uint32_t> shuffle(size_t(row) * row);
+		for (uint32_t v = 0; v < shuffle.size(); v++)
+			shuffle[v] = v;
+		uint32_t seed = 0x5A17C0DEu;
+		for (size_t v = shuffle.size() - 1; v > 0; v--) {
+			seed = seed * 1664525u + 1013904223u;
+			std::swap(shuffle[v], shuffle[seed % (v + 1)]);
+		}
+		std::vector<uint32_t> shuffled(grid.size());
+		for (size_t i = 0; i < grid.size(); i++)
+			shuffled[i] = shuffle[grid[i]];
+
+		struct IndexDecoder
+		{
+			const char* name;
+			bool simd;
+			double mbPerSecond;
+		};
+		struct IndexMesh
+		{
+			const char* name;
+			const std::vector<uint32_t>* indices;
+			double bytesPerIndex;
+			double encodeMs;
+			IndexDecoder decoders[2];
+		};
+		IndexMesh meshes[] = {
+			{ "grid", &grid, 0.0, 0.0, { { "scalar", false, 0.0 }, { "sse2", true, 0.0 } } },
+			{ "shuffled", &shuffled, 0.0, 0.0, { { "scalar", false, 0.0 }, { "sse2", true, 0.0 } } },
+		};
+		const unsigned runs = std::max(options.frames / 30, 1u);
+		bool decodedExact = true;
+		std::vector<uint32_t> decoded;
+		for (IndexMesh& mesh : meshes) {
+			const std::vector<uint32_t>& indices = *mesh.indices;
+			uint64_t begin = ProfileClock::Now();
+			const std::vector<uint8_t> encoded = IndexCodec::Encode(indices);
+			mesh.encodeMs = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond();
+			mesh.bytesPerIndex = double(encoded.size()) / double(std::max<size_t>(indices.size(), 1));
+			for (IndexDecoder& decoder : mesh.decoders) {
+				decoded.assign(indices.size(), 0);
+				begin = ProfileClock::Now();
+				size_t consumed = 0;
+				for (unsigned run = 0; run < runs; run++) {
+					consumed = decoder.simd ? IndexCodec::Decode(encoded.data(), encoded.size(), decoded.data(), decoded.size()) :
+						IndexCodec::DecodeScalar(encoded.data(), encoded.size(), decoded.data(), decoded.size());
+				}
+				const double seconds = double(ProfileClock::Now() - begin) / ProfileClock::TicksPerSecond();
+				decoder.mbPerSecond = double(indices.size() * sizeof(uint32_t)) * runs / std::max(seconds, 1e-9) / 1e6;
+				decodedExact = decodedExact && consumed == encoded.size() && decoded == indices;
+			}
+		}
+
+		// A pack round trip, then the same pack cut at every length, as it is and with the
+		// header's byte count patched to match, and with counts no file could hold
+		std::vector<uint8_t> pack;
+		IndexCodec::WritePack(grid.data(), grid.size(), pack);
+		const bool packRoundTrip = IndexCodec::ReadPack(pack.data(), pack.size(), decoded) && decoded == grid;
+		const std::vector<uint32_t> small(shuffled.begin(), shuffled.begin() + std::min<size_t>(shuffled.size(), 3000));
+		IndexCodec::WritePack(small.data(), small.size(), pack);
+		const size_t headerBytes = 3 * sizeof(uint32_t);
+		bool badPacksRejected = true;
+		for (size_t size = 0; size < pack.size(); size++) {
+			std::vector<uint8_t> cut(pack.begin(), pack.begin() + size);
+			badPacksRejected = badPacksRejected && !IndexCodec::ReadPack(cut.data(), cut.size(), decoded) && decoded.empty();
+			if (size < headerBytes)
+				continue;
+			const uint32_t byteCount = uint32_t(size - headerBytes);
+			memcpy(&cut[8], &byteCount, 4);
+			badPacksRejected = badPacksRejected && !IndexCodec::ReadPack(cut.data(), cut.size(), decoded) && decoded.empty();
+		}
+		std::vector<uint8_t> inflated = pack;
+		const size_t allocations = AllocationCounter::Allocations();
+		const uint32_t manyIndices = 0xFFFFFFF0u, manyBytes = 0xFFFFFFF0u;
+		memcpy(&inflated[4], &manyIndices, 4);
+		badPacksRejected = badPacksRejected && !IndexCodec::ReadPack(inflated.data(), inflated.size(), decoded);
+		memcpy(&inflated[4], &pack[4], 4);
+		memcpy(&inflated[8], &manyBytes, 4);
+		badPacksRejected = badPacksRejected && !IndexCodec::ReadPack(inflated.data(), inflated.size(), decoded);
+		const bool refusedWithoutAllocating = AllocationCounter::Allocations() == allocations;
+
+		Append(json, "  \"indexCodec\": {\n");
+		for (const IndexMesh& mesh : meshes) {
+			Append(json, "    \"%s\": { \"indices\": %zu, \"bytesPerIndex\": %.3f, \"encodeMs\": %.3f, \"decodeMBps\":",
+				mesh.name, mesh.indices->size(), mesh.bytesPerIndex, mesh.encodeMs);
+			AppendVariants(json, mesh.decoders, &IndexDecoder::mbPerSecond, "%.0f");
+			json += " },\n";
+		}
+		Append(json, "    \"decodedExact\": %s,\n    \"packRoundTrip\": %s,\n    \"badPacksRejected\": %s,\n"
+			"    \"refusedWithoutAllocating\": %s\n  },\n", Bool(decodedExact), Bool(packRoundTrip), Bool(badPacksRejected),
+			Bool(refusedWithoutAllocating));
+		return Checks("indexCodec", { { "decodedExact", decodedExact }, { "packRoundTrip", packRoundTrip },
+			{ "badPacksRejected", badPacksRejected }, { "refusedWithoutAllocating", refusedWithoutAllocating } });
+	}
+
+	// Every compact vertex format against the full one, over the terrain and a snowman-like
+	// sphere: bytes per vertex, encode and decode MB/s of the compact stream, and the largest
+	// round-trip errors, which must stay within the formats' quantization steps. Half floats
+	// are checked over all 65536 bit patterns.
+	bool RunVertexCodec(const BenchOptions& options, const BenchScene& scene, std::string& json)
+	{
+		// The terrain grid with its baked normals, and a UV sphere of radius 1
+		const int dim = scene.dim;
+		std::vector<VertexFull> terrain(size_t(dim) * dim);
+		std::vector<float> heights(terrain.size());
+		for (int z = 0; z < dim; z++) {
+			for (int x = 0; x < dim; x++) {
+				const size_t i = size_t(z) * dim + x;
+				heights[i] = scene.heights[i];
+				terrain[i] = { { float(x), heights[i], float(z) }, {}, { float(x) / float(dim), float(z) / float(dim) } };
+				TerrainNormal(scene.heights.data(), dim, x, z, 1.0f, terrain[i].normal);
+			}
+		}
+		const int slices = 256, stacks = 128;
+		std::vector<VertexFull> sphere;
+		sphere.reserve(size_t(slices + 1) * (stacks + 1));
+		for (int s = 0; s <= stacks; s++) {
+			const float phi = 3.14159265f * float(s) / stacks;
+			for (int t = 0; t <= slices; t++) {
+				const float theta = 6.28318531f * float(t) / slices;
+				const float n[3] = { sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta) };
+				sphere.push_back({ { n[0], n[1], n[2] }, { n[0], n[1], n[2] }, { float(t) / slices, float(s) / stacks } });
+			}
+		}
+
+		struct VertexStream
+		{
+			const char* name;
+			const std::vector<VertexFull>* vertices;
+			VertexFormat format;
+			double encodeMBps;
+			double decodeMBps;
+			VertexRoundTripError error;
+			bool withinSteps;
+		};
+		VertexStream streams[] = {
+			{ "terrainCompact", &terrain, VertexFormat_Compact, 0.0, 0.0, {}, false },
+			{ "terrainHeight", &terrain, VertexFormat_Height, 0.0, 0.0, {}, false },
+			{ "sphereCompact", &sphere, VertexFormat_Compact, 0.0, 0.0, {}, false },
+		};
+		// Half a unorm16 step over the axis' range, plus the rounding of the decode's floats
+		auto halfStep = [](const VertexQuantization& q, int axis) {
+			return q.scale[axis] * (0.5f / 65535.0f) + 4.0f * FLT_EPSILON * std::max(fabsf(q.offset[axis]), fabsf(q.offset[axis] + q.scale[axis]));
+		};
+		const unsigned runs = std::max(options.frames / 30, 1u);
+		std::vector<VertexCompact> compact;
+		std::vector<uint16_t> packedHeights;
+		std::vector<float> decodedHeights;
+		for (VertexStream& stream : streams) {
+			const std::vector<VertexFull>& vertices = *stream.vertices;
+			const VertexQuantization q = VertexCodec::ComputeQuantization(vertices.data(), vertices.size());
+			const double streamMB = double(vertices.size() * VertexCodec::Stride(stream.format)) * runs / 1e6;
+			float sink = 0.0f;
+			uint64_t begin = ProfileClock::Now();
+			if (stream.format == VertexFormat_Compact) {
+				compact.resize(vertices.size());
+				for (unsigned run = 0; run < runs; run++)
+					VertexCodec::EncodeCompact(vertices.data(), vertices.size(), q, compact.data());
+				stream.encodeMBps = streamMB / std::max(double(ProfileClock::Now() - begin) / ProfileClock::TicksPerSecond(), 1e-9);
+				begin = ProfileClock::Now();
+				for (unsigned run = 0; run < runs; run++) {
+					for (const VertexCompact& v : compact)
+						sink += VertexCodec::DecodeCompact(v, q).normal[1];
+				}
+				stream.decodeMBps = streamMB / std::max(double(ProfileClock::Now() - begin) / ProfileClock::TicksPerSecond(), 1e-9);
+				stream.error = VertexCodec::MeasureError(vertices.data(), vertices.size(), q, compact.data());
+				// 2^-12 for UVs in [0, 1], and about a snorm16 step of the octahedron in angle
+				const float positionStep = std::max(halfStep(q, 0), std::max(halfStep(q, 1), halfStep(q, 2)));
+				stream.withinSteps = stream.error.position <= positionStep &&
+					stream.error.texCoord <= 1.0f / 4096.0f && stream.error.normal <= 1e-3f;
+			}
+			else {
+				packedHeights.resize(vertices.size());
+				decodedHeights.resize(vertices.size());
+				for (unsigned run = 0; run < runs; run++)
+					VertexCodec::EncodeHeights(heights.data(), heights.size(), q, packedHeights.data());
+				stream.encodeMBps = streamMB / std::max(double(ProfileClock::Now() - begin) / ProfileClock::TicksPerSecond(), 1e-9);
+				begin = ProfileClock::Now();
+				for (unsigned run = 0; run < runs; run++) {
+					VertexCodec::DecodeHeights(packedHeights.data(), packedHeights.size(), q, decodedHeights.data());
+					sink += decodedHeights[run % decodedHeights.size()];
+				}
+				stream.decodeMBps = streamMB / std::max(double(ProfileClock::Now() - begin) / ProfileClock::TicksPerSecond(), 1e-9);
+				// x, z and UVs come from the vertex id, so only the height can be off
+				stream.error = { 0.0f, 0.0f, 0.0f };
+				for (size_t i = 0; i < heights.size(); i++)
+					stream.error.position = std::max(stream.error.position, fabsf(decodedHeights[i] - heights[i]));
+				stream.withinSteps = stream.error.position <= halfStep(q, 1);
+			}
+			g_sink = sink;
+		}
+
+		// Every half that is not a NaN comes back bit for bit, and ties round to even
+		bool halfRoundTrip = true;
+		for (uint32_t h = 0; h <= 0xFFFFu; h++) {
+			if ((h & 0x7C00u) == 0x7C00u && (h & 0x3FFu) != 0)
+				continue;
+			halfRoundTrip = halfRoundTrip && VertexCodec::FloatToHalf(VertexCodec::HalfToFloat(uint16_t(h))) == h;
+		}
+		halfRoundTrip = halfRoundTrip && VertexCodec::FloatToHalf(1.0f + 2.0f / 4096.0f) == 0x3C00u &&
+			VertexCodec::FloatToHalf(1.0f + 6.0f / 4096.0f) == 0x3C02u && VertexCodec::FloatToHalf(65520.0f) == 0x7C00u &&
+			VertexCodec::FloatToHalf(65519.0f) == 0x7BFFu;
+
+		bool withinSteps = true;
+		Append(json, "  \"vertexCodec\": {\n");
+		for (const VertexStream& stream : streams) {
+			Append(json, "    \"%s\": { \"vertices\": %zu, \"bytesPerVertex\": %u, \"encodeMBps\": %.0f, \"decodeMBps\": %.0f, "
+				"\"maxPositionError\": %.6f, \"maxNormalErrorRadians\": %.6f, \"maxTexCoordError\": %.6f },\n",
+				stream.name, stream.vertices->size(), VertexCodec::Stride(stream.format), stream.encodeMBps, stream.decodeMBps,
+				stream.error.position, stream.error.normal, stream.error.texCoord);
+			withinSteps = withinSteps && stream.withinSteps;
+		}
+		Append(json, "    \"withinQuantizationSteps\": %s,\n    \"halfRoundTrip\": %s\n  },\n", Bool(withinSteps), Bool(halfRoundTrip));
+		return Checks("vertexCodec", { { "withinQuantizationSteps", withinSteps }, { "halfRoundTrip", halfRoundTrip } });
+	}
+
+	// P snowflakes stepped over the terrain, from the same start for every simulator variant
+	bool RunSnowfall(const BenchOptions& options, const BenchScene& scene, JobSystem& jobs, std::string& json)
+	{
+		const unsigned particles = options.particles;
+		const int dim = scene.dim;
+		const std::vector<float>& heights = scene.heights;
+		struct SnowSimulator
+		{
+			const char* name;
+			bool simd;
+			JobSystem* jobs;
+			double msPerStep;
+		};
+		SnowSimulator snowSimulators[] = {
+			{ "scalar", false, nullptr, 0.0 },
+			{ "simd", true, nullptr, 0.0 },
+			{ "scalarThreads", false, &jobs, 0.0 },
+			{ "simdThreads", true, &jobs, 0.0 },
+		};
+		SnowEmitter snowEmitter;
+		snowEmitter.count = particles;
+		snowEmitter.center[0] = snowEmitter.center[2] = 0.5f * float(dim - 1);
+		snowEmitter.extent[0] = snowEmitter.extent[2] = 0.5f * float(dim - 1);
+		snowEmitter.center[1] = snowEmitter.extent[1] = 4.0f;
+		SnowGround snowGround;
+		snowGround.heights = heights.data();
+		snowGround.dim = uint32_t(dim);
+		const SnowfallParams snowParams = Snowfall::MakeParams(snowEmitter, snowGround, 1.0f / 60.0f);
+		std::vector<SnowParticle> snowStart(particles), snow, snowReference;
+		Snowfall::Spawn(snowParams, 0, snowStart.data(), snowStart.size());
+		const unsigned snowSteps = std::max(options.frames / 10, 1u);
+		bool snowIdentical = true;
+		for (SnowSimulator& sim : snowSimulators) {
+			snow = snowStart;
+			uint64_t begin = ProfileClock::Now();
+			for (unsigned step = 0; step < snowSteps; step++)
+				Snowfall::Simulate(snowParams, heights.data(), snow.data(), snow.size(), sim.jobs, sim.simd);
+			sim.msPerStep = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / snowSteps;
+			if (snowReference.empty())
+				snowReference = snow;
+			else if (memcmp(snow.data(), snowReference.data(), snow.size() * sizeof(SnowParticle)) != 0)
+				snowIdentical = false;
+		}
+
+		Append(json, "  \"snowfall\": {\n    \"particles\": %u,\n    \"steps\": %u,\n    \"bitIdentical\": %s,\n    \"msPerStep\":",
+			particles, snowSteps, Bool(snowIdentical));
+		AppendVariants(json, snowSimulators, &SnowSimulator::msPerStep, "%.3f");
+		json += "\n  },\n";
+		return Checks("snowfall", { { "bitIdentical", snowIdentical } });
+	}
+
+	// Light binning of the first frame's view, per variant
+	bool RunLightClusters(const BenchOptions& options, const BenchScene& scene, JobSystem& jobs, std::string& json)
+	{
+		struct LightBinner
+		{
+			const char* name;
+			bool simd;
+			JobSystem* jobs;
+			double msPerBin;
+		};
+		LightBinner lightBinners[] = {
+			{ "scalar", false, nullptr, 0.0 },
+			{ "simd", true, nullptr, 0.0 },
+			{ "scalarThreads", false, &jobs, 0.0 },
+			{ "simdThreads", true, &jobs, 0.0 },
+		};
+		std::vector<PointLight> lamps(options.lights);
+		const float extent = scene.extent;
+		uint32_t lampSeed = 0x9E3779B9u;
+		auto lampRandom = [&lampSeed]() {
+			lampSeed ^= lampSeed << 13;
+			lampSeed ^= lampSeed >> 17;
+			lampSeed ^= lampSeed << 5;
+			return float(lampSeed >> 8) / 16777216.0f;
+		};
+		for (PointLight& l : lamps) {
+			l.position[0] = lampRandom() * extent;
+			l.position[1] = lampRandom() * 6.0f;
+			l.position[2] = lampRandom() * extent;
+			l.radius = 2.0f + lampRandom() * 6.0f;
+			l.color[0] = l.color[1] = l.color[2] = 1.0f;
+			l.intensity = 1.0f;
+		}
+		Mat4 lampProjection = PerspectiveFovLH(0.785f, 16.0f / 9.0f, 0.1f, 1000.0f);
+		const unsigned rasterRuns = std::max(options.frames / 4, 1u);
+		float eye[3];
+		Mat4 firstView;
+		SceneCamera(scene, 0, eye, firstView);
+		LightClusters clusters;
+		clusters.SetProjection(lampProjection.m, 0.1f, 1000.0f);
+		std::vector<uint32_t> referenceIndices;
+		std::vector<LightClusters::Cluster> referenceClusters;
+		bool clustersIdentical = true;
+		for (LightBinner& b : lightBinners) {
+			clusters.SetUseSimd(b.simd);
+			uint64_t begin = ProfileClock::Now();
+			for (unsigned run = 0; run < rasterRuns; run++)
+				clusters.Bin(lamps.data(), lamps.size(), firstView.m, b.jobs);
+			b.msPerBin = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / rasterRuns;
+			if (referenceIndices.empty() && referenceClusters.empty()) {
+				referenceIndices = clusters.LightIndices();
+				referenceClusters = clusters.Clusters();
+			}
+			else if (clusters.LightIndices() != referenceIndices ||
+				memcmp(clusters.Clusters().data(), referenceClusters.data(), referenceClusters.size() * sizeof(LightClusters::Cluster)) != 0)
+				clustersIdentical = false;
+		}
+
+		const LightClusterStats& stats = clusters.Stats();
+		Append(json, "  \"lightClusters\": {\n    \"lights\": %u,\n    \"clusters\": [%d, %d, %d],\n    \"lightSlices\": %zu,\n"
+			"    \"indices\": %zu,\n    \"maxPerCluster\": %u,\n    \"identical\": %s,\n    \"msPerBin\":",
+			options.lights, clusters.DimX(), clusters.DimY(), clusters.DimZ(), stats.lightSlices, stats.indices,
+			stats.maxPerCluster, Bool(clustersIdentical));
+		AppendVariants(json, lightBinners, &LightBinner::msPerBin, "%.3f");
+		json += "\n  },\n";
+		return Checks("lightClusters", { { "identical", clustersIdentical } });
+	}
+
+	// Luminance histogram of a frame of dark ground under a bright sky, with a few lamps
+	bool RunExposure(const BenchOptions& options, JobSystem& jobs, std::string& json)
+	{
+		const uint32_t hdrWidth = 1920, hdrHeight = 1080;
+		std::vector<float> hdrFrame(size_t(hdrWidth) * hdrHeight * 3);
+		uint32_t hdrSeed = 0x2545F491u;
+		auto hdrRandom = [&hdrSeed]() {
+			hdrSeed ^= hdrSeed << 13;
+			hdrSeed ^= hdrSeed >> 17;
+			hdrSeed ^= hdrSeed << 5;
+			return float(hdrSeed >> 8) / 16777216.0f;
+		};
+		for (uint32_t y = 0; y < hdrHeight; y++) {
+			for (uint32_t x = 0; x < hdrWidth; x++) {
+				float* rgb = &hdrFrame[(size_t(y) * hdrWidth + x) * 3];
+				float v = y < hdrHeight / 3 ? 2.0f + 6.0f * float(y) / hdrHeight : 0.05f + 0.25f * hdrRandom();
+				if (hdrRandom() < 0.001f)
+					v = 50.0f;
+				rgb[0] = v * 0.9f;
+				rgb[1] = v;
+				rgb[2] = v * 1.1f;
+			}
+		}
+		AutoExposure exposure;
+		const ExposureSettings& exposureSettings = exposure.Settings();
+		uint32_t histogram[AutoExposure::HistogramBins], threadedHistogram[AutoExposure::HistogramBins];
+		const unsigned histogramRuns = std::max(options.frames / 30, 1u);
+		double histogramMs[2] = {};
+		for (int threaded = 0; threaded < 2; threaded++) {
+			uint64_t begin = ProfileClock::Now();
+			for (unsigned run = 0; run < histogramRuns; run++)
+				AutoExposure::BuildHistogram(hdrFrame.data(), hdrFrame.size() / 3, exposureSettings,
+					threaded ? threadedHistogram : histogram, threaded ? &jobs : nullptr);
+			histogramMs[threaded] = double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond() / histogramRuns;
+		}
+		const bool histogramsIdentical = memcmp(histogram, threadedHistogram, sizeof(histogram)) == 0;
+		// Flat grey frames should average to their own luminance, within half a bin
+		double maxAverageError = 0.0;
+		for (float grey : { 0.01f, 0.05f, 0.18f, 1.0f, 4.0f }) {
+			std::vector<float> flat(3 * 1024, grey);
+			uint32_t flatHistogram[AutoExposure::HistogramBins];
+			AutoExposure::BuildHistogram(flat.data(), flat.size() / 3, exposureSettings, flatHistogram);
+			double error = fabs(AutoExposure::AverageLogLuminance(flatHistogram, exposureSettings) - std::log2(grey));
+			maxAverageError = std::max(maxAverageError, error);
+		}
+		// Frames from 0 stops to settled on the synthetic frame
+		exposure.Reset();
+		exposure.SetHistogram(histogram);
+		unsigned adaptFrames = 0;
+		while (fabs(exposure.Exposure() - exposure.TargetExposure()) > 0.01f && adaptFrames < 6000) {
+			exposure.Adapt(1.0f / 60.0f);
+			adaptFrames++;
+		}
+		const float halfBin = 0.5f * (exposureSettings.maxLogLuminance - exposureSettings.minLogLuminance) / AutoExposure::HistogramBins;
+		const bool averageWithinHalfBin = maxAverageError <= halfBin, adapted = adaptFrames < 6000;
+
+		Append(json, "  \"exposure\": {\n    \"pixels\": %u,\n    \"bins\": %u,\n    \"histogramsIdentical\": %s,\n"
+			"    \"msPerHistogram\": { \"scalar\": %.3f, \"threads\": %.3f },\n    \"averageLogLuminance\": %.3f,\n"
+			"    \"maxAverageErrorStops\": %.3f,\n    \"averageWithinHalfBin\": %s,\n    \"targetExposure\": %.3f,\n    \"framesToAdapt\": %u\n  },\n",
+			hdrWidth * hdrHeight, AutoExposure::HistogramBins, Bool(histogramsIdentical), histogramMs[0], histogramMs[1],
+			AutoExposure::AverageLogLuminance(histogram, exposureSettings), maxAverageError, Bool(averageWithinHalfBin),
+			exposure.TargetExposure(), adaptFrames);
+		return Checks("exposure", { { "histogramsIdentical", histogramsIdentical }, { "averageWithinHalfBin", averageWithinHalfBin },
+			{ "adapted", adapted } });
+	}
+
+	// The post-processing chain as D3D11PostProcess builds it with bloom and FXAA on
+	bool RunRenderTargetPool(std::string& json)
+	{
+		RenderTargetPool pool;
+		{
+			const RenderTargetDesc full = { 1920, 1080, 24, 4 }, half = { 960, 540, 24, 4 }, quarter = { 480, 270, 24, 4 };
+			const uint32_t none = RenderTargetPool::NoTarget;
+			uint32_t image = pool.AddTarget(full), extracted = pool.AddTarget(half), halfBlurred = pool.AddTarget(half);
+			uint32_t halfBloom = pool.AddTarget(half), quarterSize = pool.AddTarget(quarter), quarterBlurred = pool.AddTarget(quarter);
+			uint32_t quarterBloom = pool.AddTarget(quarter), bloom = pool.AddTarget(half), combined = pool.AddTarget(full);
+			pool.AddPass({}, image);
+			pool.AddPass({ image }, extracted);
+			pool.AddPass({ extracted }, halfBlurred);
+			pool.AddPass({ halfBlurred }, halfBloom);
+			pool.AddPass({ halfBloom }, quarterSize);
+			pool.AddPass({ quarterSize }, quarterBlurred);
+			pool.AddPass({ quarterBlurred }, quarterBloom);
+			pool.AddPass({ halfBloom, quarterBloom }, bloom);
+			pool.AddPass({ image, bloom }, combined);
+			pool.AddPass({ combined }, none);
+			pool.Plan();
+		}
+		// Random graphs of 3 descs: no shared texture between overlapping lifetimes, and per
+		// desc no more textures than the most of its targets live during one pass
+		bool poolValid = true;
+		unsigned poolGraphs = 200;
+		uint32_t poolSeed = 0x9E3779B9u;
+		auto poolRandom = [&poolSeed](uint32_t n) {
+			poolSeed ^= poolSeed << 13;
+			poolSeed ^= poolSeed >> 17;
+			poolSeed ^= poolSeed << 5;
+			return poolSeed % n;
+		};
+		for (unsigned g = 0; g < poolGraphs && poolValid; g++) {
+			RenderTargetPool graph;
+			const RenderTargetDesc descs[3] = { { 64, 64, 1, 4 }, { 32, 32, 1, 4 }, { 64, 64, 2, 8 } };
+			const uint32_t targets = 4 + poolRandom(40), passes = 4 + poolRandom(60);
+			for (uint32_t t = 0; t < targets; t++)
+				graph.AddTarget(descs[poolRandom(3)]);
+			for (uint32_t p = 0; p < passes; p++) {
+				uint32_t reads[3];
+				const uint32_t readCount = poolRandom(4);
+				for (uint32_t r = 0; r < readCount; r++)
+					reads[r] = poolRandom(targets);
+				graph.AddPass(reads, readCount, poolRandom(4) ? poolRandom(targets) : RenderTargetPool::NoTarget);
+			}
+			graph.Plan();
+			for (uint32_t a = 0; a < targets; a++) {
+				if (graph.FirstPass(a) == RenderTargetPool::NoTarget)
+					continue;
+				for (uint32_t b = a + 1; b < targets; b++) {
+					if (graph.FirstPass(b) == RenderTargetPool::NoTarget || graph.PhysicalTarget(a) != graph.PhysicalTarget(b))
+						continue;
+					if (graph.FirstPass(a) <= graph.LastPass(b) && graph.FirstPass(b) <= graph.LastPass(a))
+						poolValid = false;
+				}
+			}
+			for (const RenderTargetDesc& desc : descs) {
+				size_t physical = 0, mostLive = 0;
+				for (size_t p = 0; p < graph.PhysicalCount(); p++)
+					physical += graph.PhysicalDesc(p) == desc;
+				for (uint32_t p = 0; p < passes; p++) {
+					size_t live = 0;
+					for (uint32_t t = 0; t < targets; t++) {
+						live += graph.FirstPass(t) != RenderTargetPool::NoTarget && graph.FirstPass(t) <= p && p <= graph.LastPass(t) &&
+							graph.PhysicalDesc(graph.PhysicalTarget(t)) == desc;
+					}
+					mostLive = std::max(mostLive, live);
+				}
+				if (physical != mostLive)
+					poolValid = false;
+			}
+		}
+
+		const RenderTargetPoolStats& stats = pool.Stats();
+		Append(json, "  \"renderTargetPool\": {\n    \"passes\": %zu,\n    \"targets\": %zu,\n    \"physicalTargets\": %zu,\n"
+			"    \"naiveBytes\": %llu,\n    \"pooledBytes\": %llu,\n    \"peakLiveBytes\": %llu,\n    \"randomGraphs\": %u,\n    \"valid\": %s\n  },\n",
+			pool.PassCount(), stats.targets, stats.physicalTargets, (unsigned long long)stats.naiveBytes,
+			(unsigned long long)stats.pooledBytes, (unsigned long long)stats.peakLiveBytes, poolGraphs, Bool(poolValid));
+		return Checks("renderTargetPool", { { "valid", poolValid } });
+	}
+
+	// The render graph: build and compile cost of a 100-pass frame, then its checks
+	bool RunRenderGraph(const BenchOptions& options, std::string& json)
+	{
+		NullRenderBackend graphBackend;
+		const GpuTextureDesc importedDesc = { 4, 4, 28, 4, GpuUsage_Default };
+		GpuTexture* imported[4];
+		for (GpuTexture*& t : imported)
+			t = graphBackend.CreateTexture2D(importedDesc, nullptr);
+		int presentTag = 0;
+		GpuRenderTarget* presentTarget = reinterpret_cast<GpuRenderTarget*>(&presentTag);
+		const uint32_t graphPasses = 100, graphRuns = std::max(options.frames * 10, 100u);
+		RenderGraph graph;
+		std::vector<GraphAccess> graphAccesses;
+		BuildSyntheticGraph(graph, graphPasses, imported, 4, presentTarget, &graphAccesses);
+		graph.Compile();
+		const bool graphValid = CheckCompiledGraph(graph, graphAccesses);
+		const RenderGraphStats graphStats = graph.Stats();
+		const size_t graphPhysical = graph.Pool().PhysicalCount();
+		graph.Execute(graphBackend);
+		double buildUs = 0.0, compileUs = 0.0;
+		size_t graphAllocations = AllocationCounter::Allocations();
+		for (unsigned run = 0; run < graphRuns; run++) {
+			uint64_t begin = ProfileClock::Now();
+			BuildSyntheticGraph(graph, graphPasses, imported, 4, presentTarget, nullptr);
+			uint64_t built = ProfileClock::Now();
+			graph.Compile();
+			uint64_t compiled = ProfileClock::Now();
+			graph.Execute(graphBackend);
+			buildUs += double(built - begin) * 1e6 / ProfileClock::TicksPerSecond();
+			compileUs += double(compiled - built) * 1e6 / ProfileClock::TicksPerSecond();
+		}
+		graphAllocations = AllocationCounter::Allocations() - graphAllocations;
+		// Two frames of shadow pass then main pass: the second frame's shadow pass must
+		// first unbind the shadow map the first frame's main pass left at t2
+		bool shadowMapUnbound = false;
+		{
+			RenderGraph frame;
+			int shadowTag = 0, backBufferTag = 0;
+			for (int f = 0; f < 2; f++) {
+				frame.Reset();
+				uint32_t shadowMap = frame.Import("Shadow map", reinterpret_cast<GpuTexture*>(&shadowTag));
+				uint32_t backBuffer = frame.Import("Back buffer", reinterpret_cast<GpuRenderTarget*>(&backBufferTag));
+				uint32_t shadow = frame.AddPass("Shadow pass", nullptr);
+				frame.WriteTarget(shadow, shadowMap);
+				uint32_t main = frame.AddPass("Main pass", nullptr);
+				frame.Read(main, shadowMap, RenderGraphStage_Pixel, 2);
+				frame.WriteTarget(main, backBuffer);
+				frame.SetSideEffects(main);
+				frame.Compile();
+				if (f == 1) {
+					shadowMapUnbound = frame.UnbindCount(shadow) == 1 && frame.Unbind(shadow, 0).kind == RenderGraphUnbind_ShaderResource &&
+						frame.Unbind(shadow, 0).stage == RenderGraphStage_Pixel && frame.Unbind(shadow, 0).slot == 2;
+				}
+				frame.Execute(graphBackend);
+			}
+		}
+		for (GpuTexture* t : imported)
+			graphBackend.Release(t);
+
+		Append(json, "  \"renderGraph\": {\n    \"passes\": %zu,\n    \"culledPasses\": %zu,\n    \"resources\": %zu,\n"
+			"    \"transients\": %zu,\n    \"physicalTargets\": %zu,\n    \"unbinds\": %zu,\n    \"usPerBuild\": %.2f,\n"
+			"    \"usPerCompile\": %.2f,\n    \"allocationsPerFrame\": %.2f,\n    \"valid\": %s,\n    \"shadowMapUnbound\": %s\n  },\n",
+			graphStats.passes, graphStats.culledPasses, graphStats.resources, graphStats.transients, graphPhysical, graphStats.unbinds,
+			buildUs / graphRuns, compileUs / graphRuns, double(graphAllocations) / graphRuns, Bool(graphValid), Bool(shadowMapUnbound));
+		return Checks("renderGraph", { { "valid", graphValid }, { "shadowMapUnbound", shadowMapUnbound } });
+	}
+
+	// Level of detail of a crowd of snowmen three units apart, seen from a camera circling
+	// inside it with a little jitter, as a hand-held or bobbing camera has
+	bool RunLod(const BenchOptions& options, const Crowd& crowd, JobSystem& jobs, std::string& json)
+	{
+		const std::vector<float>& crowdSpheres = crowd.spheres;
+		const std::vector<uint32_t>& crowdMeshes = crowd.meshes;
+		const size_t crowdParts = crowdMeshes.size();
+		const unsigned lodFrames = options.frames;
+		const float lodProjScale = PerspectiveFovLH(0.785f, 16.0f / 9.0f, 0.1f, 1000.0f).m[5];
+		struct LodSelector
+		{
+			const char* name;
+			bool simd;
+			JobSystem* jobs;
+			float hysteresis;
+			double msPerSelect;
+			size_t switches;
+			double triangles;
+		};
+		LodSelector lodSelectors[] = {
+			{ "scalar", false, nullptr, 0.1f, 0.0, 0, 0.0 },
+			{ "simd", true, nullptr, 0.1f, 0.0, 0, 0.0 },
+			{ "scalarThreads", false, &jobs, 0.1f, 0.0, 0, 0.0 },
+			{ "simdThreads", true, &jobs, 0.1f, 0.0, 0, 0.0 },
+			{ "noHysteresis", true, &jobs, 0.0f, 0.0, 0, 0.0 },
+		};
+		std::vector<uint8_t> lodBands, lodLevels, lodReference;
+		bool lodIdentical = true;
+		double fullTriangles = 0.0;
+		for (uint32_t mesh : crowdMeshes)
+			fullTriangles += LodIndices[mesh][0] / 3;
+		for (LodSelector& selector : lodSelectors) {
+			LodSettings settings;
+			settings.hysteresis = selector.hysteresis;
+			lodBands.assign(crowdParts, 0);
+			lodLevels.assign(crowdParts, 0);
+			uint64_t ticks = 0;
+			for (unsigned frame = 0; frame < lodFrames; frame++) {
+				Mat4 view = CrowdView(crowd, frame);
+				uint64_t begin = ProfileClock::Now();
+				LodSelection::SelectAll(settings, view.m, lodProjScale, crowdSpheres.data(), 4 * sizeof(float),
+					lodBands.data(), 1, crowdParts, selector.jobs, selector.simd);
+				ticks += ProfileClock::Now() - begin;
+				for (size_t i = 0; i < crowdParts; i++) {
+					uint8_t level = LodSelection::Level(lodBands[i], LodLevelCounts[crowdMeshes[i]], false);
+					selector.switches += level != lodLevels[i];
+					selector.triangles += LodIndices[crowdMeshes[i]][level] / 3;
+					lodLevels[i] = level;
+				}
+			}
+			selector.msPerSelect = double(ticks) * 1000.0 / ProfileClock::TicksPerSecond() / lodFrames;
+			if (selector.hysteresis == 0.0f)
+				continue;
+			if (lodReference.empty())
+				lodReference = lodBands;
+			else if (lodBands != lodReference)
+				lodIdentical = false;
+		}
+		// The first frame switches from full detail everywhere; count the ones after it
+		size_t lodFirstSwitches = 0;
+		{
+			LodSettings settings;
+			lodBands.assign(crowdParts, 0);
+			Mat4 view = CrowdView(crowd, 0);
+			LodSelection::Select(settings, view.m, lodProjScale, crowdSpheres.data(), 4 * sizeof(float), lodBands.data(), 1, 0, crowdParts);
+			for (size_t i = 0; i < crowdParts; i++)
+				lodFirstSwitches += LodSelection::Level(lodBands[i], LodLevelCounts[crowdMeshes[i]], false) != 0;
+		}
+		const LodSelector& lodDefault = lodSelectors[1];
+		const LodSelector& lodNoHysteresis = lodSelectors[4];
+		const double lodSwitchFrames = double(std::max(lodFrames, 2u) - 1);
+
+		Append(json, "  \"lod\": {\n    \"snowmen\": %u,\n    \"parts\": %zu,\n    \"frames\": %u,\n    \"identical\": %s,\n"
+			"    \"fullDetailTrianglesPerFrame\": %.0f,\n    \"selectedTrianglesPerFrame\": %.0f,\n    \"triangleRatio\": %.3f,\n"
+			"    \"switchesPerFrame\": %.1f,\n    \"switchesPerFrameWithoutHysteresis\": %.1f,\n    \"msPerSelect\":",
+			options.crowd, crowdParts, lodFrames, Bool(lodIdentical), fullTriangles, lodDefault.triangles / lodFrames,
+			lodDefault.triangles / lodFrames / std::max(fullTriangles, 1.0),
+			double(lodDefault.switches - std::min(lodDefault.switches, lodFirstSwitches)) / lodSwitchFrames,
+			double(lodNoHysteresis.switches - std::min(lodNoHysteresis.switches, lodFirstSwitches)) / lodSwitchFrames);
+		AppendVariants(json, lodSelectors, &LodSelector::msPerSelect, "%.3f");
+		json += "\n  },\n";
+		return Checks("lod", { { "identical", lodIdentical } });
+	}
+
+	// Impostor atlas layout: every frame of every object in its own rectangle of the atlas
+	bool RunImpostors(const BenchOptions& options, BenchScene& scene, JobSystem& jobs, std::string& json)
+	{
+		bool atlasValid = true;
+		const uint32_t atlasConfigs[][4] = { { 1, 8, 128, 16384 }, { 2, 8, 128, 16384 }, { 37, 8, 128, 4096 }, { 5, 12, 64, 1000 }, { 3, 1, 32, 16 } };
+		for (const auto& config : atlasConfigs) {
+			ImpostorAtlasLayout layout = ImpostorAtlas::MakeLayout(config[0], config[1], config[2], config[3]);
+			// Rectangles are whole frames, so each covers one cell of a frame-sized grid
+			const uint32_t columns = layout.width / layout.frameSize, rows = layout.height / layout.frameSize;
+			std::vector<uint8_t> covered(size_t(columns) * rows, 0);
+			for (uint32_t object = 0; object < layout.objectCount; object++) {
+				for (uint32_t frame = 0; frame < ImpostorAtlas::FrameCount(layout); frame++) {
+					uint32_t rect[4];
+					ImpostorAtlas::FrameRect(layout, object, frame, rect);
+					if (rect[0] % layout.frameSize || rect[1] % layout.frameSize || rect[2] != layout.frameSize || rect[3] != layout.frameSize ||
+						rect[0] + rect[2] > layout.width || rect[1] + rect[3] > layout.height || covered[size_t(rect[1] / layout.frameSize) * columns + rect[0] / layout.frameSize]++) {
+						atlasValid = false;
+					}
+				}
+			}
+			// No wider than asked unless a single object already is
+			if (layout.width > std::max(config[3], layout.framesPerSide * layout.frameSize))
+				atlasValid = false;
+		}
+
+		// Frame selection over an 8x8 layout, on random directions from a fixed seed
+		const ImpostorAtlasLayout viewLayout = ImpostorAtlas::MakeLayout(1, 8, 128, 1024);
+		const uint32_t viewFrames = ImpostorAtlas::FrameCount(viewLayout);
+		uint32_t seed = 12345;
+		auto random = [&seed]() {
+			seed = seed * 1664525u + 1013904223u;
+			return float(seed >> 8) / float(1 << 24);
+		};
+		auto randomDirection = [&](float dir[3]) {
+			float length;
+			do {
+				for (int c = 0; c < 3; c++)
+					dir[c] = random() * 2.0f - 1.0f;
+				length = sqrtf(Dot3(dir, dir));
+			} while (length < 0.1f || length > 1.0f);
+			for (int c = 0; c < 3; c++)
+				dir[c] /= length;
+		};
+		const unsigned viewSamples = 100000;
+		// Round trips through the square, and each frame's basis against its direction
+		float maxRoundTripError = 0.0f, maxBasisError = 0.0f;
+		for (unsigned i = 0; i < viewSamples; i++) {
+			float dir[3], uv[2], back[3];
+			randomDirection(dir);
+			dir[1] = fabsf(dir[1]);
+			ImpostorAtlas::Encode(dir, uv);
+			ImpostorAtlas::Decode(uv, back);
+			maxRoundTripError = std::max(maxRoundTripError, 1.0f - Dot3(dir, back));
+		}
+		bool framesSelectThemselves = true;
+		// The widest angle between a frame's direction and the corners and edge midpoints of
+		// its cell: how far off any direction's frame may be
+		float cellBound = 0.0f;
+		for (uint32_t frame = 0; frame < viewFrames; frame++) {
+			float dir[3], right[3], up[3];
+			ImpostorAtlas::FrameDirection(viewLayout, frame, dir);
+			framesSelectThemselves = framesSelectThemselves && ImpostorAtlas::SelectFrame(viewLayout, dir) == frame;
+			ImpostorAtlas::FrameBasis(dir, right, up);
+			maxBasisError = std::max({ maxBasisError, fabsf(Dot3(right, up)), fabsf(Dot3(right, dir)), fabsf(Dot3(up, dir)),
+				fabsf(Dot3(right, right) - 1.0f), fabsf(Dot3(up, up) - 1.0f) });
+			const float n = float(viewLayout.framesPerSide);
+			for (int corner = 0; corner < 9; corner++) {
+				float uv[2] = { (float(frame % viewLayout.framesPerSide) + 0.5f * (corner % 3)) / n,
+					(float(frame / viewLayout.framesPerSide) + 0.5f * (corner / 3)) / n };
+				float edge[3];
+				ImpostorAtlas::Decode(uv, edge);
+				cellBound = std::max(cellBound, acosf(std::min(Dot3(dir, edge), 1.0f)));
+			}
+		}
+		float maxSelectAngle = 0.0f;
+		size_t belowHorizonMismatches = 0, yawMismatches = 0;
+		for (unsigned i = 0; i < viewSamples; i++) {
+			float dir[3], frameDir[3];
+			randomDirection(dir);
+			uint32_t frame = ImpostorAtlas::SelectFrame(viewLayout, dir);
+			if (dir[1] < 0.0f) {
+				// From below: the frame on the horizon under the view
+				const float horizon[3] = { dir[0], 0.0f, dir[2] };
+				belowHorizonMismatches += ImpostorAtlas::SelectFrame(viewLayout, horizon) != frame;
+				continue;
+			}
+			ImpostorAtlas::FrameDirection(viewLayout, frame, frameDir);
+			maxSelectAngle = std::max(maxSelectAngle, acosf(std::min(Dot3(dir, frameDir), 1.0f)));
+		}
+		// An object turned by any yaw, seen from the same place relative to it, shows the same
+		// frame; directions are kept off the cell edges, where rounding may pick the neighbour
+		for (unsigned i = 0; i < viewSamples; i++) {
+			uint32_t frame = uint32_t(random() * float(viewFrames)) % viewFrames;
+			const float n = float(viewLayout.framesPerSide);
+			float uv[2] = { (float(frame % viewLayout.framesPerSide) + 0.1f + 0.8f * random()) / n,
+				(float(frame / viewLayout.framesPerSide) + 0.1f + 0.8f * random()) / n };
+			float object[3], world[3], back[3];
+			ImpostorAtlas::Decode(uv, object);
+			float yaw = random() * 6.2831853f;
+			const float axis[2] = { cosf(yaw), sinf(yaw) };
+			ImpostorAtlas::ToWorld(axis, object, world);
+			ImpostorAtlas::ToObject(axis, world, back);
+			yawMismatches += ImpostorAtlas::SelectFrame(viewLayout, back) != frame;
+		}
+		const bool viewSelectionValid = maxRoundTripError < 1e-5f && maxBasisError < 1e-5f && framesSelectThemselves &&
+			maxSelectAngle <= cellBound * 1.001f && belowHorizonMismatches == 0 && yawMismatches == 0;
+
+		// Submission of I distant snowmen, three units apart and from 300 units away: a draw
+		// per part against the impostor path, which selects, gathers and draws them instanced
+		const unsigned impostors = options.impostors;
+		const unsigned impostorSide = std::max(1u, unsigned(ceil(sqrt(double(impostors)))));
+		const float snowManScale = 1.5f;
+		// The snowman's bounding sphere around all its parts
+		float snowManCenter[3] = { 0.0f, 0.0f, 0.0f }, snowManRadius = 0.0f;
+		{
+			float lo[3] = { 1e9f, 1e9f, 1e9f }, hi[3] = { -1e9f, -1e9f, -1e9f };
+			for (const Part& part : SnowManParts) {
+				for (int c = 0; c < 3; c++) {
+					lo[c] = std::min(lo[c], part.offset[c] - part.radius);
+					hi[c] = std::max(hi[c], part.offset[c] + part.radius);
+				}
+			}
+			for (int c = 0; c < 3; c++)
+				snowManCenter[c] = (lo[c] + hi[c]) * 0.5f;
+			for (const Part& part : SnowManParts) {
+				float offset[3] = { part.offset[0] - snowManCenter[0], part.offset[1] - snowManCenter[1], part.offset[2] - snowManCenter[2] };
+				snowManRadius = std::max(snowManRadius, sqrtf(Dot3(offset, offset)) + part.radius);
+			}
+		}
+		struct DistantSnowMan
+		{
+			float sphere[4];
+			float axis[2];
+			uint8_t band;
+			Mat4 world;
+		};
+		std::vector<DistantSnowMan> distant(impostors);
+		for (unsigned s = 0; s < impostors; s++) {
+			DistantSnowMan& man = distant[s];
+			float yaw = float(s % 360) * 0.0174533f;
+			const float scale[3] = { snowManScale, snowManScale, snowManScale };
+			const float position[3] = { float(s % impostorSide) * 3.0f, 0.0f, 300.0f + float(s / impostorSide) * 3.0f };
+			man.world = ScaleRotateYTranslate(scale, yaw, position);
+			for (int c = 0; c < 3; c++)
+				man.sphere[c] = position[c] + snowManCenter[c] * snowManScale;
+			man.sphere[3] = snowManRadius * snowManScale;
+			man.axis[0] = cosf(yaw);
+			man.axis[1] = -sinf(yaw);
+			man.band = 0;
+		}
+		const float impostorEye[3] = { float(impostorSide) * 1.5f, 20.0f, 0.0f };
+		const float impostorAt[3] = { float(impostorSide) * 1.5f, 0.0f, 300.0f };
+		const Mat4 impostorView = LookAtLH(impostorEye, impostorAt);
+		const unsigned impostorFrames = std::min(options.frames, 10u);
+		const float projScale = PerspectiveFovLH(0.785f, 16.0f / 9.0f, 0.1f, 1000.0f).m[5];
+		RecordingRenderBackend& recorder = scene.recorder;
+		const BenchResources& gpu = scene.gpu;
+		LodSettings impostorSettings;
+		impostorSettings.impostorSize = 0.02f;
+		std::vector<ImpostorInstance> impostorInstances;
+		impostorInstances.reserve(impostors);
+		GpuBuffer* instanceBuffer = recorder.CreateBuffer({ uint32_t(std::max(impostors, 1u) * sizeof(ImpostorInstance)),
+			GpuBind_ShaderResource, GpuUsage_Dynamic }, nullptr);
+		GpuBuffer* quadIndices = recorder.CreateBuffer({ 12, GpuBind_IndexBuffer, GpuUsage_Immutable }, nullptr);
+		double meshSubmitMs = 0.0, impostorSubmitMs = 0.0;
+		size_t meshCalls = 0, impostorCalls = 0, impostorsDrawn = 0;
+		for (unsigned frame = 0; frame < impostorFrames; frame++) {
+			recorder.Reset();
+			recorder.ResetStats();
+			uint64_t begin = ProfileClock::Now();
+			for (const DistantSnowMan& man : distant) {
+				for (const Part& part : SnowManParts)
+					RecordEntityDraw(recorder, gpu, part.mesh, 0, man.world, impostorEye);
+			}
+			meshSubmitMs += double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond();
+			meshCalls += recorder.Stats().TotalCalls();
+
+			recorder.Reset();
+			recorder.ResetStats();
+			begin = ProfileClock::Now();
+			LodSelection::SelectAll(impostorSettings, impostorView.m, projScale, distant[0].sphere, sizeof(DistantSnowMan),
+				&distant[0].band, sizeof(DistantSnowMan), distant.size(), &jobs);
+			impostorInstances.clear();
+			for (const DistantSnowMan& man : distant) {
+				if (LodSelection::Level(man.band, 1, true) != LodSelection::Impostor)
+					continue;
+				impostorInstances.push_back(ImpostorInstance{ { man.sphere[0], man.sphere[1], man.sphere[2] }, man.sphere[3],
+					{ man.axis[0], man.axis[1] }, 0, 0 });
+			}
+			// The calls Scene::RenderImpostors makes
+			memcpy(recorder.Map(instanceBuffer), impostorInstances.data(), impostorInstances.size() * sizeof(ImpostorInstance));
+			recorder.Unmap(instanceBuffer);
+			memset(recorder.Map(gpu.colorBuffer), 0, 16);
+			recorder.Unmap(gpu.colorBuffer);
+			recorder.VSSetConstantBuffers(4, 1, &gpu.colorBuffer);
+			recorder.PSSetConstantBuffers(4, 1, &gpu.colorBuffer);
+			recorder.IASetInputLayout(nullptr);
+			recorder.IASetIndexBuffer(quadIndices, GpuIndex_16, 0);
+			recorder.VSSetShader(Handle<GpuVertexShader>(1));
+			recorder.PSSetShader(Handle<GpuPixelShader>(2));
+			recorder.VSSetShaderResources(0, 1, &gpu.textures[0]);
+			recorder.PSSetShaderResources(0, 1, &gpu.textures[0]);
+			GpuSampler* sampler = Handle<GpuSampler>(3);
+			recorder.PSSetSamplers(0, 1, &sampler);
+			recorder.DrawIndexedInstanced(6, uint32_t(impostorInstances.size()), 0, 0, 0);
+			impostorSubmitMs += double(ProfileClock::Now() - begin) * 1000.0 / ProfileClock::TicksPerSecond();
+			impostorCalls += recorder.Stats().TotalCalls();
+			impostorsDrawn += impostorInstances.size();
+		}
+		recorder.Reset();
+		recorder.Release(instanceBuffer);
+		recorder.Release(quadIndices);
+		const bool allImpostors = impostorsDrawn == size_t(impostors) * impostorFrames;
+
+		Append(json, "  \"impostors\": {\n    \"atlasValid\": %s,\n    \"viewSelectionValid\": %s,\n    \"maxRoundTripError\": %.2e,\n"
+			"    \"maxSelectDegrees\": %.2f,\n    \"cellBoundDegrees\": %.2f,\n    \"distantSnowmen\": %u,\n    \"allImpostors\": %s,\n"
+			"    \"meshes\": { \"msPerFrame\": %.3f, \"callsPerFrame\": %.1f },\n"
+			"    \"impostors\": { \"msPerFrame\": %.3f, \"callsPerFrame\": %.1f },\n    \"speedup\": %.1f\n  },\n",
+			Bool(atlasValid), Bool(viewSelectionValid), double(maxRoundTripError), double(maxSelectAngle) * 57.29578,
+			double(cellBound) * 57.29578, impostors, Bool(allImpostors), meshSubmitMs / impostorFrames, double(meshCalls) / impostorFrames,
+			impostorSubmitMs / impostorFrames, double(impostorCalls) / impostorFrames, meshSubmitMs / std::max(impostorSubmitMs, 1e-6));
+		return Checks("impostors", { { "atlasValid", atlasValid }, { "viewSelectionValid", viewSelectionValid }, { "allImpostors", allImpostors } });
+	}
+
+	// Camera matrices for random poses and lenses: the cached inverses must undo their
+	// matrices, view and projection must match the reference LookAtLH and PerspectiveFovLH,
+	// the corners of clip space taken back to the world must lie on their frustum planes,
+	// and setting what is already set must rebuild nothing
+	bool RunCamera(const BenchOptions& options, const Crowd& crowd, JobSystem& jobs, std::string& json)
+	{
+		uint32_t cameraSeed = 12345;
+		auto cameraRandom = [&cameraSeed](float lo, float hi) {
+			cameraSeed = cameraSeed * 1664525u + 1013904223u;
+			return lo + (hi - lo) * float(cameraSeed >> 8) / float(1 << 24);
+		};
+		// How far a * b is from the identity, each element against the size of the terms summed
+		// for it, so the error is that of the inverse and not of the cancellation
+		auto identityError = [](const float* a, const float* b) {
+			float product[16], error = 0.0f;
+			CameraMatrices::Multiply(a, b, product);
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					float scale = 0.0f;
+					for (int k = 0; k < 4; k++)
+						scale += fabsf(a[i * 4 + k] * b[k * 4 + j]);
+					error = std::max(error, fabsf(product[i * 4 + j] - (i == j ? 1.0f : 0.0f)) / std::max(scale, 1.0f));
+				}
+			}
+			return error;
+		};
+		const unsigned cameraTrials = 1000;
+		float maxInverseError = 0.0f, maxReferenceError = 0.0f, maxCornerDistance = 0.0f, maxFarCornerDistance = 0.0f;
+		bool revisionsValid = true, planesIdentical = true;
+		CameraMatrices cameraMatrices;
+		for (unsigned trial = 0; trial < cameraTrials; trial++) {
+			float eye[3] = { cameraRandom(-100.0f, 100.0f), cameraRandom(-100.0f, 100.0f), cameraRandom(-100.0f, 100.0f) };
+			float at[3] = { eye[0] + cameraRandom(-1.0f, 1.0f), eye[1] + cameraRandom(-0.9f, 0.9f), eye[2] + cameraRandom(-1.0f, 1.0f) };
+			if (fabsf(at[0] - eye[0]) + fabsf(at[2] - eye[2]) < 0.1f)
+				at[0] += 0.5f;
+			const Mat4 view = LookAtLH(eye, at);
+			const float right[3] = { view.m[0], view.m[4], view.m[8] };
+			const float up[3] = { view.m[1], view.m[5], view.m[9] };
+			const float look[3] = { view.m[2], view.m[6], view.m[10] };
+			const bool perspective = trial % 2 == 0;
+			const float lens[4] = { perspective ? cameraRandom(0.3f, 2.0f) : cameraRandom(5.0f, 200.0f),
+				perspective ? cameraRandom(0.5f, 2.5f) : cameraRandom(5.0f, 200.0f), cameraRandom(0.05f, 1.0f), cameraRandom(100.0f, 2000.0f) };
+			auto setLens = [&](const float* l) {
+				if (perspective)
+					cameraMatrices.SetPerspective(l[0], l[1], l[2], l[3]);
+				else
+					cameraMatrices.SetOrthographic(l[0], l[1], l[2], l[3]);
+			};
+			cameraMatrices.SetPose(eye, right, up, look);
+			setLens(lens);
+			cameraMatrices.Update();
+
+			maxInverseError = std::max(maxInverseError, identityError(cameraMatrices.View(), cameraMatrices.InverseView()));
+			maxInverseError = std::max(maxInverseError, identityError(cameraMatrices.Projection(), cameraMatrices.InverseProjection()));
+			maxInverseError = std::max(maxInverseError, identityError(cameraMatrices.ViewProjection(), cameraMatrices.InverseViewProjection()));
+			const Mat4 projection = perspective ? PerspectiveFovLH(lens[0], lens[1], lens[2], lens[3]) : Mat4();
+			for (int i = 0; i < 16; i++) {
+				maxReferenceError = std::max(maxReferenceError, fabsf(cameraMatrices.View()[i] - view.m[i]) / std::max(1.0f, fabsf(view.m[i])));
+				if (perspective)
+					maxReferenceError = std::max(maxReferenceError, fabsf(cameraMatrices.Projection()[i] - projection.m[i]));
+			}
+
+			// The SSE2 planes, the scalar planes and the cached ones are the same to the bit
+			FrustumPlanes scalarPlanes, simdPlanes;
+			ViewFrustum::Extract(cameraMatrices.ViewProjection(), scalarPlanes);
+			ViewFrustum::ExtractSimd(cameraMatrices.ViewProjection(), simdPlanes);
+			planesIdentical = planesIdentical && memcmp(&scalarPlanes, &simdPlanes, sizeof(FrustumPlanes)) == 0 &&
+				memcmp(&simdPlanes, &cameraMatrices.Frustum(), sizeof(FrustumPlanes)) == 0;
+			// Corner (x, y, z) of clip space is on the left or right, bottom or top, and near or far plane
+			for (int corner = 0; corner < 8; corner++) {
+				const float clip[4] = { corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : 0.0f, 1.0f };
+				const float* inv = cameraMatrices.InverseViewProjection();
+				float world[4];
+				for (int c = 0; c < 4; c++)
+					world[c] = clip[0] * inv[c] + clip[1] * inv[4 + c] + clip[2] * inv[8 + c] + clip[3] * inv[12 + c];
+				const int planes[3] = { corner & 1 ? 1 : 0, corner & 2 ? 3 : 2, corner & 4 ? 5 : 4 };
+				for (int p : planes) {
+					const float* plane = simdPlanes.planes[p];
+					float distance = (plane[0] * world[0] + plane[1] * world[1] + plane[2] * world[2]) / world[3] + plane[3];
+					float& maxDistance = p == 5 ? maxFarCornerDistance : maxCornerDistance;
+					maxDistance = std::max(maxDistance, fabsf(distance) / lens[3]);
+				}
+			}
+
+			// The same pose and lens again rebuild nothing; a new pose only the view, a new lens only the projection
+			const uint32_t viewRevision = cameraMatrices.ViewRevision(), projectionRevision = cameraMatrices.ProjectionRevision();
+			cameraMatrices.SetPose(eye, right, up, look);
+			setLens(lens);
+			revisionsValid = revisionsValid && !cameraMatrices.Update() && cameraMatrices.ViewRevision() == viewRevision &&
+				cameraMatrices.ProjectionRevision() == projectionRevision;
+			eye[1] += 1.0f;
+			cameraMatrices.SetPose(eye, right, up, look);
+			revisionsValid = revisionsValid && cameraMatrices.Update() && cameraMatrices.ViewRevision() == viewRevision + 1 &&
+				cameraMatrices.ProjectionRevision() == projectionRevision;
+			const float wider[4] = { lens[0] * 1.1f, lens[1], lens[2], lens[3] };
+			setLens(wider);
+			revisionsValid = revisionsValid && cameraMatrices.Update() && cameraMatrices.ViewRevision() == viewRevision + 1 &&
+				cameraMatrices.ProjectionRevision() == projectionRevision + 1;
+		}
+		// The far plane of a deep perspective frustum comes from 1 - far / (far - near), which
+		// keeps few bits, so it is held to a looser bound than the others
+		const bool inversesValid = maxInverseError < 1e-5f && maxReferenceError < 1e-5f && maxCornerDistance < 1e-3f &&
+			maxFarCornerDistance < 1e-2f;
+
+		// What the camera costs a frame: Update when it moved and when it did not, extracting
+		// the planes, and culling the crowd's parts against them
+		const unsigned cameraUpdates = 100000;
+		double movingNs = 0.0, stillNs = 0.0, extractNs[2] = {};
+		{
+			const float right[3] = { 1.0f, 0.0f, 0.0f }, up[3] = { 0.0f, 1.0f, 0.0f }, look[3] = { 0.0f, 0.0f, 1.0f };
+			for (int moving = 0; moving < 2; moving++) {
+				uint64_t begin = ProfileClock::Now();
+				for (unsigned i = 0; i < cameraUpdates; i++) {
+					const float eye[3] = { moving ? float(i) * 0.001f : 0.0f, 2.0f, -10.0f };
+					cameraMatrices.SetPose(eye, right, up, look);
+					cameraMatrices.SetPerspective(0.785f, 16.0f / 9.0f, 0.1f, 1000.0f);
+					cameraMatrices.Update();
+					g_sink = cameraMatrices.ViewProjection()[12];
+				}
+				(moving ? movingNs : stillNs) = double(ProfileClock::Now() - begin) * 1e9 / ProfileClock::TicksPerSecond() / cameraUpdates;
+			}
+			for (int simd = 0; simd < 2; simd++) {
+				FrustumPlanes planes;
+				float matrix[16];
+				memcpy(matrix, cameraMatrices.ViewProjection(), sizeof(matrix));
+				uint64_t begin = ProfileClock::Now();
+				for (unsigned i = 0; i < cameraUpdates; i++) {
+					matrix[12] += 0.001f;
+					if (simd)
+						ViewFrustum::ExtractSimd(matrix, planes);
+					else
+						ViewFrustum::Extract(matrix, planes);
+					g_sink = planes.planes[5][3];
+				}
+				extractNs[simd] = double(ProfileClock::Now() - begin) * 1e9 / ProfileClock::TicksPerSecond() / cameraUpdates;
+			}
+		}
+		struct SphereCuller
+		{
+			const char* name;
+			bool simd;
+			JobSystem* jobs;
+			double msPerCull;
+		};
+		SphereCuller sphereCullers[] = {
+			{ "scalar", false, nullptr, 0.0 },
+			{ "simd", true, nullptr, 0.0 },
+			{ "scalarThreads", false, &jobs, 0.0 },
+			{ "simdThreads", true, &jobs, 0.0 },
+		};
+		const std::vector<float>& crowdSpheres = crowd.spheres;
+		const size_t crowdParts = crowd.meshes.size();
+		const unsigned lodFrames = options.frames;
+		std::vector<uint8_t> insideFlags, insideReference(crowdParts);
+		const Mat4 crowdProjection = PerspectiveFovLH(0.785f, 16.0f / 9.0f, 0.1f, 1000.0f);
+		{
+			FrustumPlanes planes;
+			ViewFrustum::Extract(Multiply(CrowdView(crowd, lodFrames - 1), crowdProjection).m, planes);
+			for (size_t i = 0; i < crowdParts; i++)
+				insideReference[i] = ViewFrustum::IntersectsSphere(planes, &crowdSpheres[i * 4]);
+		}
+		bool cullIdentical = true;
+		size_t insideCount = 0;
+		for (SphereCuller& culler : sphereCullers) {
+			insideFlags.assign(crowdParts, 0);
+			uint64_t ticks = 0;
+			for (unsigned frame = 0; frame < lodFrames; frame++) {
+				FrustumPlanes planes;
+				ViewFrustum::Extract(Multiply(CrowdView(crowd, frame), crowdProjection).m, planes);
+				uint64_t begin = ProfileClock::Now();
+				ViewFrustum::CullAll(planes, crowdSpheres.data(), 4 * sizeof(float), insideFlags.data(), 1, crowdParts, culler.jobs, culler.simd);
+				ticks += ProfileClock::Now() - begin;
+			}
+			culler.msPerCull = double(ticks) * 1000.0 / ProfileClock::TicksPerSecond() / lodFrames;
+			// Against the last frame's sphere by sphere test
+			cullIdentical = cullIdentical && insideFlags == insideReference;
+			insideCount = size_t(std::count(insideFlags.begin(), insideFlags.end(), uint8_t(1)));
+		}
+
+		Append(json, "  \"camera\": {\n    \"trials\": %u,\n    \"inversesValid\": %s,\n    \"maxInverseError\": %.2e,\n"
+			"    \"maxReferenceError\": %.2e,\n    \"maxCornerDistance\": %.2e,\n    \"maxFarCornerDistance\": %.2e,\n    \"revisionsValid\": %s,\n"
+			"    \"planesIdentical\": %s,\n    \"cullIdentical\": %s,\n    \"insideParts\": %zu,\n    \"nsPerUpdate\": { \"moving\": %.1f, \"still\": %.1f },\n"
+			"    \"nsPerExtract\": { \"scalar\": %.1f, \"simd\": %.1f },\n    \"msPerCull\":",
+			cameraTrials, Bool(inversesValid), double(maxInverseError), double(maxReferenceError), double(maxCornerDistance),
+			double(maxFarCornerDistance), Bool(revisionsValid), Bool(planesIdentical), Bool(cullIdentical), insideCount,
+			movingNs, stillNs, extractNs[0], extractNs[1]);
+		AppendVariants(json, sphereCullers, &SphereCuller::msPerCull, "%.3f");
+		json += "\n  },\n";
+		return Checks("camera", { { "inversesValid", inversesValid }, { "revisionsValid", revisionsValid },
+			{ "planesIdentical", planesIdentical }, { "cullIdentical", cullIdentical } });
+	}
+
+	// What Scene::Update keeps from tick to tick: the fly camera riding the box on a
+	// turntable, the toggles, and the keys held the tick before
+	struct InputTickState
+	{
+		FlyCamera fly;
+		uint32_t toggles;
+		float turntable;		// the turntable's angle, and the angle the camera was last carried to
+		float carried;
+		bool onBox;
+		uint32_t lastKeys;
+	};
+
+	InputTickState StartTicks(const InputOrigin& origin)
+	{
+		InputTickState state = {};
+		state.fly.Restore(origin.camera);
+		state.toggles = origin.toggles;
+		state.turntable = state.carried = origin.turntable;
+		return state;
+	}
+
+	// One fixed-step tick of Scene::Update, in its order
+	void StepTick(InputTickState& state, const InputSnapshot& input, const float boxCenter[3], const float boxSize[3])
+	{
+		const float spin = 0.25f, dt = 1.0f / 60.0f, halfWidth[3] = { 1.0f, 1.0f, 1.0f };
+		const bool getOff = (input.keys & InputKey_F) && state.onBox;
+		state.toggles = FlipToggles(state.toggles, input.keys & ~state.lastKeys);
+		state.lastKeys = input.keys;
+		state.turntable += spin * dt;
+		state.fly.Step(input);
+		const float delta = state.turntable - state.carried;
+		state.carried = state.turntable;
+		state.onBox = state.fly.Ride(boxCenter, boxSize, halfWidth, state.turntable, delta, getOff);
+	}
+
+	bool SameTicks(const InputTickState& a, const InputTickState& b)
+	{
+		return memcmp(&a.fly, &b.fly, sizeof(FlyCamera)) == 0 && a.toggles == b.toggles && a.turntable == b.turntable &&
+			a.carried == b.carried && a.onBox == b.onBox && a.lastKeys == b.lastKeys;
+	}
+
+	// Input log: ten minutes of scripted ticks must read back exactly as recorded, through
+	// the saved bytes. Replayed from the log's origin they must steer the app's state along
+	// the same path to the bit: the camera riding the turntable box and getting off it, and
+	// the toggles flipped from where they were. Every truncation of a log must be refused
+	// rather than misread.
+	bool RunInput(const BenchOptions& options, const BenchScene& scene, std::string& json)
+	{
+		const uint32_t inputTicks = 60 * 60 * 10;
+		const std::vector<InputSnapshot> script = ScriptInput(inputTicks);
+		const float extent = scene.extent;
+		InputOrigin origin = { { extent * 0.9f, 20.0f, extent * 0.5f, -atanf(20.0f / (extent * 0.4f)), -1.5707963f },
+			InputToggle_Lod | InputToggle_DepthPrePass | InputToggle_Bloom, 0.3f };
+		const float* inputOrigin = origin.camera;
+		// A box on the turntable that has the camera in it at the start
+		const float boxSize[3] = { 4.0f, 4.0f, 4.0f };
+		const float c = cosf(origin.turntable), s = sinf(origin.turntable);
+		const float boxCenter[3] = { inputOrigin[0] * c - inputOrigin[2] * s, inputOrigin[1], inputOrigin[0] * s + inputOrigin[2] * c };
+		InputLog inputLog;
+		uint64_t recordBegin = ProfileClock::Now();
+		inputLog.Reset(60, origin);
+		for (const InputSnapshot& input : script)
+			inputLog.Record(input);
+		std::vector<uint8_t> inputBytes;
+		inputLog.Serialize(inputBytes);
+		const double recordNs = double(ProfileClock::Now() - recordBegin) * 1e9 / ProfileClock::TicksPerSecond() / inputTicks;
+
+		InputLog inputReplay;
+		bool inputRoundTrip = inputReplay.Parse(inputBytes.data(), inputBytes.size()) && inputReplay.TickCount() == inputTicks;
+		uint64_t replayBegin = ProfileClock::Now();
+		std::vector<InputSnapshot> replayed;
+		replayed.reserve(inputTicks);
+		InputSnapshot replayedInput;
+		while (inputReplay.Next(replayedInput))
+			replayed.push_back(replayedInput);
+		const double replayNs = double(ProfileClock::Now() - replayBegin) * 1e9 / ProfileClock::TicksPerSecond() / inputTicks;
+		inputRoundTrip = inputRoundTrip && replayed == script &&
+			memcmp(&inputReplay.Origin(), &origin, sizeof(InputOrigin)) == 0;
+
+		// The ride has to happen, and end with F, for the replay to cover it
+		bool replayExact = replayed.size() == script.size();
+		InputTickState recorded = StartTicks(origin), replayedState = StartTicks(inputReplay.Origin());
+		uint32_t rideTicks = 0;
+		bool settingDown = false, gotOff = false;
+		for (size_t t = 0; t < script.size() && replayExact; t++) {
+			settingDown = settingDown || (recorded.onBox && (script[t].keys & InputKey_F));
+			StepTick(recorded, script[t], boxCenter, boxSize);
+			StepTick(replayedState, replayed[t], boxCenter, boxSize);
+			replayExact = SameTicks(recorded, replayedState);
+			rideTicks += recorded.onBox ? 1 : 0;
+			gotOff = gotOff || (settingDown && !recorded.onBox);
+		}
+		replayExact = replayExact && rideTicks > 0 && gotOff && recorded.toggles != origin.toggles;
+		// A second replay of the same log, rewound, ends where the first did
+		InputTickState rewound = StartTicks(inputReplay.Origin());
+		inputReplay.Rewind();
+		while (inputReplay.Next(replayedInput))
+			StepTick(rewound, replayedInput, boxCenter, boxSize);
+		replayExact = replayExact && SameTicks(rewound, replayedState);
+		// Replayed from the app's defaults instead of the log's origin, it must not
+		InputOrigin defaults = origin;
+		defaults.toggles = 0;
+		defaults.turntable = 0.0f;
+		InputTickState unrestored = StartTicks(defaults);
+		for (const InputSnapshot& input : replayed)
+			StepTick(unrestored, input, boxCenter, boxSize);
+		const bool originNeeded = !SameTicks(unrestored, replayedState);
+		const FlyCamera& replayedFly = replayedState.fly;
+		const float pathDistance = sqrtf((replayedFly.position[0] - inputOrigin[0]) * (replayedFly.position[0] - inputOrigin[0]) +
+			(replayedFly.position[1] - inputOrigin[1]) * (replayedFly.position[1] - inputOrigin[1]) +
+			(replayedFly.position[2] - inputOrigin[2]) * (replayedFly.position[2] - inputOrigin[2]));
+
+		// Cut short both as it is and with the header's stream size patched to match, so the
+		// stream itself has to give the cut away
+		bool truncationsRejected = true;
+		InputLog truncated;
+		const size_t headerBytes = sizeof(InputLogHeader);
+		for (size_t size = 0; size < std::min(inputBytes.size(), headerBytes + 4096); size++) {
+			truncationsRejected = truncationsRejected && !truncated.Parse(inputBytes.data(), size);
+			if (size < headerBytes)
+				continue;
+			std::vector<uint8_t> patched(inputBytes.begin(), inputBytes.begin() + size);
+			InputLogHeader header;
+			memcpy(&header, patched.data(), sizeof(header));
+			header.streamBytes = uint32_t(size - headerBytes);
+			memcpy(patched.data(), &header, sizeof(header));
+			truncationsRejected = truncationsRejected && !truncated.Parse(patched.data(), patched.size());
+		}
+
+		bool saved = true;
+		if (options.saveInputPath) {
+			// The scripted ticks for this many frames, from the circling camera's first eye
+			// looking at the middle of the scene, for replaying with --input
+			InputLog log;
+			log.Reset(60, origin);
+			for (unsigned t = 0; t < options.frames; t++)
+				log.Record(script[t % script.size()]);
+			saved = log.Save(options.saveInputPath);
+			if (!saved)
+				fprintf(stderr, "cannot write %s\n", options.saveInputPath);
+		}
+
+		Append(json, "  \"input\": {\n    \"ticks\": %u,\n    \"logBytes\": %zu,\n    \"bytesPerTick\": %.3f,\n"
+			"    \"snapshotBytes\": %zu,\n    \"roundTrip\": %s,\n    \"replayExact\": %s,\n    \"rideTicks\": %u,\n"
+			"    \"originNeeded\": %s,\n    \"truncationsRejected\": %s,\n"
+			"    \"pathDistance\": %.2f,\n    \"nsPerTick\": { \"record\": %.1f, \"replay\": %.1f }\n  },\n",
+			inputTicks, inputBytes.size(), double(inputBytes.size()) / inputTicks, sizeof(InputSnapshot), Bool(inputRoundTrip),
+			Bool(replayExact), rideTicks, Bool(originNeeded), Bool(truncationsRejected), double(pathDistance), recordNs, replayNs);
+		return Checks("input", { { "roundTrip", inputRoundTrip }, { "replayExact", replayExact },
+			{ "originNeeded", originNeeded }, { "truncationsRejected", truncationsRejected } }) && saved;
+	}
+
+	// Capture: PNGs of every capture format must decode, through an independent decoder,
+	// to exactly the top eight bits of each channel, for a scene-like frame, a single
+	// pixel, flat colour and noise; DDS files must carry their header and the pixels as
+	// they are
+	bool RunCapture(const BenchOptions& options, std::string& json)
+	{
+		const uint32_t dxgiFormats[] = { 28, 87, 24 };
+		bool pngRoundTrip = true, ddsValid = true;
+		for (CaptureFormat format : { CaptureFormat_R8G8B8A8, CaptureFormat_B8G8R8A8, CaptureFormat_R10G10B10A2 }) {
+			enum { Scene, Flat, Noise };
+			struct { uint32_t width, height; int content; } cases[] = { { 320, 180, Scene }, { 1, 1, Scene }, { 257, 3, Flat }, { 97, 61, Noise } };
+			for (const auto& c : cases) {
+				CaptureFrame frame;
+				frame.width = c.width;
+				frame.height = c.height;
+				frame.format = format;
+				SyntheticFrame(c.width, c.height, format, 7, frame.pixels);
+				uint32_t seed = 99;
+				for (size_t i = 4; i < frame.pixels.size(); i++) {
+					seed = seed * 1664525u + 1013904223u;
+					if (c.content != Scene)
+						frame.pixels[i] = c.content == Flat ? frame.pixels[i % 4] : uint8_t(seed >> 24);
+				}
+				std::vector<uint8_t> encoded, decoded, expected;
+				uint32_t width, height;
+				CaptureEncoder::EncodePng(frame, encoded);
+				ExpectedRgb(frame, expected);
+				pngRoundTrip = pngRoundTrip && DecodePng(encoded, width, height, decoded) && width == c.width &&
+					height == c.height && decoded == expected;
+
+				// Magic, header size, height, width, the DX10 four CC, then the DXGI format
+				CaptureEncoder::EncodeDds(frame, encoded);
+				const size_t ddsHeaderBytes = 4 + 124 + 20;
+				uint32_t fields[4] = {}, dxgiFormat = 0;
+				if (encoded.size() == ddsHeaderBytes + frame.pixels.size()) {
+					memcpy(fields, &encoded[4], 4);
+					memcpy(fields + 1, &encoded[12], 8);
+					memcpy(fields + 3, &encoded[84], 4);
+					memcpy(&dxgiFormat, &encoded[128], 4);
+				}
+				ddsValid = ddsValid && memcmp(encoded.data(), "DDS ", 4) == 0 && fields[0] == 124 && fields[1] == c.height &&
+					fields[2] == c.width && memcmp(&fields[3], "DX10", 4) == 0 && dxgiFormat == dxgiFormats[format] &&
+					memcmp(&encoded[ddsHeaderBytes], frame.pixels.data(), frame.pixels.size()) == 0;
+			}
+		}
+
+		// Then R 1920x1080 frames of the back buffer's format per encoding go through the
+		// encoder's thread as fast as they can be handed over. The frame loop pays for copying
+		// a frame into an acquired buffer and submitting it; frames the bounded queue refuses
+		// are dropped, and every frame must be accounted for as encoded or dropped
+		struct CaptureRun
+		{
+			const char* name;
+			CaptureEncoding encoding;
+			double frameLoopMs;
+			double encodeMs;
+			double ratio;
+			uint64_t dropped;
+		};
+		CaptureRun captureRuns[] = {
+			{ "png", CaptureEncoding_Png, 0.0, 0.0, 0.0, 0 },
+			{ "dds", CaptureEncoding_Dds, 0.0, 0.0, 0.0, 0 },
+			{ "raw", CaptureEncoding_Raw, 0.0, 0.0, 0.0, 0 },
+		};
+		const unsigned captures = options.captures;
+		const uint32_t captureWidth = 1920, captureHeight = 1080;
+		std::vector<std::vector<uint8_t>> captureSources(4);
+		for (unsigned i = 0; i < 4; i++)
+			SyntheticFrame(captureWidth, captureHeight, CaptureFormat_R10G10B10A2, i * 15, captureSources[i]);
+		bool capturesAccounted = true, fullFrameValid = true;
+		for (CaptureRun& run : captureRuns) {
+			std::vector<uint8_t> firstEncoded;
+			CaptureEncoder encoder("", 8, [&firstEncoded](const CaptureFrame& frame, const std::vector<uint8_t>& encoded) {
+				if (frame.frame == 0)
+					firstEncoded = encoded;
+			});
+			uint64_t ticks = 0;
+			for (unsigned f = 0; f < captures; f++) {
+				uint64_t begin = ProfileClock::Now();
+				CaptureFrame frame = encoder.Acquire(captureWidth, captureHeight, CaptureFormat_R10G10B10A2);
+				frame.frame = f;
+				frame.encoding = run.encoding;
+				memcpy(frame.pixels.data(), captureSources[f % 4].data(), frame.pixels.size());
+				encoder.Submit(std::move(frame));
+				ticks += ProfileClock::Now() - begin;
+			}
+			encoder.EndSequence();
+			encoder.Flush();
+			const CaptureStats stats = encoder.Stats();
+			run.frameLoopMs = double(ticks) * 1000.0 / ProfileClock::TicksPerSecond() / captures;
+			run.encodeMs = stats.encodeSeconds * 1000.0 / std::max<uint64_t>(stats.encoded, 1);
+			run.ratio = double(stats.bytesOut) / double(std::max<uint64_t>(stats.bytesIn, 1));
+			run.dropped = stats.dropped;
+			capturesAccounted = capturesAccounted && stats.submitted + stats.dropped == captures && stats.encoded == stats.submitted &&
+				stats.failed == 0 && stats.bytesIn == stats.encoded * captureSources[0].size();
+
+			// The first frame is never refused; it must come out as it went in
+			CaptureFrame first;
+			first.width = captureWidth;
+			first.height = captureHeight;
+			first.format = CaptureFormat_R10G10B10A2;
+			first.pixels = captureSources[0];
+			if (run.encoding == CaptureEncoding_Png) {
+				std::vector<uint8_t> decoded, expected;
+				uint32_t width, height;
+				ExpectedRgb(first, expected);
+				fullFrameValid = fullFrameValid && DecodePng(firstEncoded, width, height, decoded) && decoded == expected;
+			}
+			else {
+				first.encoding = run.encoding;
+				std::vector<uint8_t> expected;
+				CaptureEncoder::Encode(first, expected);
+				fullFrameValid = fullFrameValid && firstEncoded == expected;
+			}
+		}
+
+		Append(json, "  \"capture\": {\n    \"pngRoundTrip\": %s,\n    \"ddsValid\": %s,\n    \"fullFrameValid\": %s,\n"
+			"    \"accounted\": %s,\n    \"width\": %u,\n    \"height\": %u,\n    \"framesPerEncoding\": %u,\n",
+			Bool(pngRoundTrip), Bool(ddsValid), Bool(fullFrameValid), Bool(capturesAccounted), captureWidth, captureHeight, captures);
+		for (const CaptureRun& run : captureRuns) {
+			Append(json, "    \"%s\": { \"frameLoopMs\": %.3f, \"encodeMs\": %.3f, \"ratio\": %.3f, \"dropped\": %llu }%s\n",
+				run.name, run.frameLoopMs, run.encodeMs, run.ratio, (unsigned long long)run.dropped, &run == &captureRuns[2] ? "" : ",");
+		}
+		json += "  },\n";
+		return Checks("capture", { { "pngRoundTrip", pngRoundTrip }, { "ddsValid", ddsValid }, { "fullFrameValid", fullFrameValid },
+			{ "accounted", capturesAccounted } });
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, options))
+		return 1;
+	if (options.help) {
+		fputs(Usage, stdout);
+		return 0;
+	}
+
+	// A recorded input log steers the camera instead of the circling one, a frame per tick
+	InputLog replayLog;
+	if (options.inputPath) {
+		std::string inputError;
+		if (!replayLog.Load(options.inputPath, &inputError)) {
+			fprintf(stderr, "input: %s\n", inputError.c_str());
+			return 1;
+		}
+		if (replayLog.TickCount() == 0) {
+			fprintf(stderr, "input: %s has no ticks\n", options.inputPath);
+			return 1;
+		}
+		options.frames = std::min(options.frames, replayLog.TickCount());
+	}
+
+	const unsigned threads = options.threads;
+	JobSystem jobs(threads > 1 ? threads - 1 : threads == 1 ? 1 : 0);
+	BenchScene scene;
+	std::string json = "{\n";
+	if (!RunScene(options, options.inputPath ? &replayLog : nullptr, jobs, scene, json))
+		return 1;
+	// Every stage runs even after one fails, so the report is complete
+	bool passed = RunOcclusion(options, scene, jobs, json);
+	passed = RunTerrain(options, scene, jobs, json) && passed;
+	passed = RunJobScaling(options, scene, json) && passed;
+	passed = RunFrameArena(options, jobs, json) && passed;
+	passed = RunSceneGraph(options, json) && passed;
+	passed = RunEntityLayout(options, json) && passed;
+	passed = RunSceneFile(options, json) && passed;
+	passed = RunProfiler(options, jobs, json) && passed;
+	passed = RunHotReload(options, json) && passed;
+	passed = RunIndexCodec(options, scene, json) && passed;
+	passed = RunVertexCodec(options, scene, json) && passed;
+	passed = RunSnowfall(options, scene, jobs, json) && passed;
+	passed = RunLightClusters(options, scene, jobs, json) && passed;
+	passed = RunExposure(options, jobs, json) && passed;
+	passed = RunRenderTargetPool(json) && passed;
+	passed = RunRenderGraph(options, json) && passed;
+	const Crowd crowd = BuildCrowd(options.crowd);
+	passed = RunLod(options, crowd, jobs, json) && passed;
+	passed = RunImpostors(options, scene, jobs, json) && passed;
+	passed = RunCamera(options, crowd, jobs, json) && passed;
+	passed = RunInput(options, scene, json) && passed;
+	passed = RunCapture(options, json) && passed;
+	Append(json, "  \"passed\": %s\n}\n", Bool(passed));
+
+	fputs(json.c_str(), stdout);
+	if (options.outPath) {
+		FILE* fp = fopen(options.outPath, "wb");
+		if (!fp || fwrite(json.data(), 1, json.size(), fp) != json.size()) {
+			fprintf(stderr, "cannot write %s\n", options.outPath);
+			if (fp)
+				fclose(fp);
+			return 1;
+		}
+		fclose(fp);
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include "pch.h"
+#include "SceneEntities.h"
+#include <cmath>
+
+using namespace DirectX;
+
+const uint32_t SceneEntities::NoImpostor;
+
+void SceneEntities::AddDrawable(const drawable* geo, SceneNodeHandle node, std::vector<Entity>* created, bool occluder,
+	uint32_t impostorObject)
+{
+	Entity owner;
+	if (impostorObject != NoImpostor) {
+		owner = entities.Create();
+		ImpostorComponent impostor = {};
+		impostor.local.Radius = 0.0f;		// grown by the parts below
+		impostor.node = node;
+		impostor.axis = XMFLOAT2(1.0f, 0.0f);
+		impostor.object = impostorObject;
+		impostors.Add(owner, impostor);
+	}
+
+	for (const RModel* component : geo->components) {
+		Entity e = entities.Create();
+		if (created)
+			created->push_back(e);
+		transforms.Add(e, TransformComponent{ node, component->model, component->model });
+		meshes.Add(e, MeshComponent{ component->vertexBuffer, component->indexBuffer, UINT(component->indices.size()),
+			component->indexFormat, component->vertexFormat, component->quantization });
+		materials.Add(e, MaterialComponent{ component->texture, component->normalMap, component->color });
+
+		LodComponent lod = {};
+		lod.levels[0] = meshes.Get(e);
+		for (const RModelLod& level : component->lods) {
+			if (lod.levelCount + 1 == LodSettings::MaxLevels)
+				break;
+			lod.levels[++lod.levelCount] = MeshComponent{ level.vertexBuffer, level.indexBuffer, level.indexCount,
+				level.indexFormat, component->vertexFormat, level.quantization };
+		}
+		lod.levelCount++;
+		lod.impostor = owner;
+		lods.Add(e, lod);
+
+		BoundsComponent b = {};
+		if (!component->vertices.empty()) {
+			BoundingSphere::CreateFromPoints(b.local, component->vertices.size(),
+				&component->vertices[0].position, sizeof(VertexPositionNormalTexture));
+		}
+		b.world = b.local;
+		b.visible = true;
+		bounds.Add(e, b);
+
+		if (ImpostorComponent* impostor = impostors.Find(owner)) {
+			BoundingSphere part;
+			b.local.Transform(part, component->model);
+			if (impostor->local.Radius > 0.0f)
+				BoundingSphere::CreateMerged(impostor->local, impostor->local, part);
+			else
+				impostor->local = part;
+			impostor->world = impostor->local;
+		}
+
+		if (occluder && !component->vertices.empty()) {
+			occluders.Add(e, OccluderComponent{ &component->vertices[0].position.x, UINT(sizeof(VertexPositionNormalTexture)),
+				UINT(component->vertices.size()), component->indices.data(), UINT(component->indices.size()) });
+		}
+	}
+}
+
+Entity SceneEntities::AddAnimation(SceneNodeHandle node, float angularSpeed, FXMMATRIX base)
+{
+	Entity e = entities.Create();
+	animations.Add(e, AnimationComponent{ node, base, angularSpeed, 0.0f });
+	return e;
+}
+
+void SceneEntities::Compact()
+{
+	transforms.SortAs(meshes);
+	materials.SortAs(meshes);
+	bounds.SortAs(meshes);
+	lods.SortAs(meshes);
+}
+
+void SceneEntities::Animate(SceneGraph& graph, float deltaTime)
+{
+	animations.ForEach([&](Entity, AnimationComponent& a) {
+		a.angle += a.angularSpeed * deltaTime;
+		graph.SetLocal(a.node, ToSceneMatrix(XMMatrixRotationY(a.angle) * a.base));
+	});
+}
+
+void SceneEntities::UpdateTransforms(const SceneGraph& graph)
+{
+	TransformComponent* t = transforms.Data();
+	for (size_t i = 0; i < transforms.Size(); i++)
+		t[i].world = t[i].model * ToXMMatrix(graph.World(t[i].node));
+
+	ForEach(bounds, transforms, [](Entity, BoundsComponent& b, const TransformComponent& t) {
+		b.local.Transform(b.world, t.world);
+	});
+
+	impostors.ForEach([&](Entity, ImpostorComponent& impostor) {
+		XMMATRIX world = ToXMMatrix(graph.World(impostor.node));
+		impostor.local.Transform(impostor.world, world);
+		XMFLOAT4X4 matrix;
+		XMStoreFloat4x4(&matrix, world);
+		float length = std::sqrt(matrix._11 * matrix._11 + matrix._13 * matrix._13);
+		impostor.axis = length > 0.0f ? XMFLOAT2(matrix._11 / length, matrix._13 / length) : XMFLOAT2(1.0f, 0.0f);
+	});
+}
+
+void SceneEntities::Cull(const FrustumPlanes& frustum, JobSystem* jobs)
+{
+	BoundsComponent* b = bounds.Data();
+	const LodComponent* l = lods.Data();
+	const size_t count = bounds.Size();
+	if (count > 0) {
+		// BoundingSphere is the center then the radius, the four floats the planes test
+		ViewFrustum::CullAll(frustum, &b[0].world.Center.x, sizeof(BoundsComponent),
+			reinterpret_cast<uint8_t*>(&b[0].visible), sizeof(BoundsComponent), count, jobs);
+	}
+	for (size_t i = 0; i < count; i++)
+		b[i].visible = b[i].visible && !l[i].hidden;
+
+	impostors.ForEach([&](Entity, ImpostorComponent& impostor) {
+		impostor.visible = impostor.drawn && ViewFrustum::IntersectsSphere(frustum, &impostor.world.Center.x);
+	});
+}
+
+void SceneEntities::AddOccluders(OcclusionBuffer& buffer) const
+{
+	for (size_t i = 0; i < occluders.Size(); i++) {
+		const OccluderComponent& o = occluders.Data()[i];
+		Entity e = occluders.EntityAt(i);
+		if (!transforms.Has(e))
+			continue;
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, transforms.Get(e).world);
+		buffer.AddOccluder(o.positions, o.stride, o.vertexCount, o.indices, o.indexCount, &world._11);
+	}
+}
+
+size_t SceneEntities::Occlude(const OcclusionBuffer& buffer)
+{
+	size_t culled = 0;
+	BoundsComponent* b = bounds.Data();
+	for (size_t i = 0; i < bounds.Size(); i++) {
+		if (!b[i].visible)
+			continue;
+		const XMFLOAT3& c = b[i].world.Center;
+		if (buffer.IsOccluded(&c.x, b[i].world.Radius)) {
+			b[i].visible = false;
+			culled++;
+		}
+	}
+	impostors.ForEach([&](Entity, ImpostorComponent& impostor) {
+		if (impostor.visible && buffer.IsOccluded(&impostor.world.Center.x, impostor.world.Radius)) {
+			impostor.visible = false;
+			culled++;
+		}
+	});
+	return culled;
+}
+
+void SceneEntities::SortFrontToBack(FXMMATRIX view, LinearArena& arena)
+{
+	drawOrder = arena.Allocate<uint32_t>(bounds.Size());
+	drawOrderCount = 0;
+	const BoundsComponent* b = bounds.Data();
+	for (size_t i = 0; i < bounds.Size(); i++) {
+		if (b[i].visible)
+			drawOrder[drawOrderCount++] = uint32_t(i);
+	}
+	if (drawOrderCount == 0)
+		return;
+	XMFLOAT4X4 matrix;
+	XMStoreFloat4x4(&matrix, view);
+	DrawOrder::FrontToBack(&matrix._11, &b[0].world.Center.x, sizeof(BoundsComponent),
+		drawOrder, drawOrderCount, arena.Allocate<uint64_t>(drawOrderCount));
+}
+
+size_t SceneEntities::SelectLods(const LodSettings& settings, FXMMATRIX view, float projScale, JobSystem* jobs)
+{
+	if (lods.Size() == 0)
+		return 0;
+	XMFLOAT4X4 matrix;
+	XMStoreFloat4x4(&matrix, view);
+	LodComponent* l = lods.Data();
+	// A bounding sphere's center and radius are four floats in a row
+	LodSelection::SelectAll(settings, &matrix._11, projScale, &bounds.Data()[0].world.Center.x, sizeof(BoundsComponent),
+		&l[0].band, sizeof(LodComponent), lods.Size(), jobs);
+
+	size_t changed = 0;
+	if (impostors.Size() > 0) {
+		ImpostorComponent* p = impostors.Data();
+		LodSelection::SelectAll(settings, &matrix._11, projScale, &p[0].world.Center.x, sizeof(ImpostorComponent),
+			&p[0].band, sizeof(ImpostorComponent), impostors.Size(), jobs);
+		for (size_t i = 0; i < impostors.Size(); i++) {
+			bool drawn = LodSelection::Level(p[i].band, 1, true) == LodSelection::Impostor;
+			changed += drawn != p[i].drawn;
+			p[i].drawn = drawn;
+		}
+	}
+
+	MeshComponent* m = meshes.Data();
+	for (size_t i = 0; i < lods.Size(); i++) {
+		const ImpostorComponent* impostor = impostors.Find(l[i].impostor);
+		l[i].hidden = impostor && impostor->drawn;
+		uint8_t level = LodSelection::Level(l[i].band, l[i].levelCount, false);
+		if (level != l[i].level) {
+			l[i].level = level;
+			m[i] = l[i].levels[level];
+			changed++;
+		}
+	}
+	return changed;
+}
+
+void SceneEntities::GatherImpostors(LinearArena& arena)
+{
+	impostorInstances = arena.Allocate<ImpostorInstance>(impostors.Size());
+	impostorInstanceCount = 0;
+	impostors.ForEach([&](Entity, const ImpostorComponent& impostor) {
+		if (!impostor.visible)
+			return;
+		const XMFLOAT3& c = impostor.world.Center;
+		impostorInstances[impostorInstanceCount++] = ImpostorInstance{ { c.x, c.y, c.z }, impostor.world.Radius,
+			{ impostor.axis.x, impostor.axis.y }, impostor.object, 0 };
+	});
+}
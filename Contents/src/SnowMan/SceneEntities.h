@@ -0,0 +1,160 @@
+#pragma once
+#include "pch.h"
+#include <DirectXCollision.h>
+#include "EntityStorage.h"
+#include "SceneGraph.h"
+#include "OcclusionBuffer.h"
+#include "DrawOrder.h"
+#include "LodSelection.h"
+#include "ImpostorAtlas.h"
+#include "ViewFrustum.h"
+#include "FrameArena.h"
+#include "drawable.h"
+
+// SceneGraph matrices have XMFLOAT4X4's layout.
+inline SceneMatrix XM_CALLCONV ToSceneMatrix(DirectX::FXMMATRIX matrix)
+{
+	SceneMatrix m;
+	DirectX::XMStoreFloat4x4(reinterpret_cast<DirectX::XMFLOAT4X4*>(m.m), matrix);
+	return m;
+}
+
+inline DirectX::XMMATRIX XM_CALLCONV ToXMMatrix(const SceneMatrix& matrix)
+{
+	return DirectX::XMLoadFloat4x4(reinterpret_cast<const DirectX::XMFLOAT4X4*>(matrix.m));
+}
+
+// Component types. Each RModel of a drawable becomes one entity, so the render
+// system reads buffers, material and world matrix from packed arrays instead of
+// going through Object -> drawable -> RModel pointers.
+struct TransformComponent
+{
+	SceneNodeHandle node;
+	DirectX::XMMATRIX model;	// RModel::model, applied before the node's world matrix
+	DirectX::XMMATRIX world;	// model * node world, refreshed by UpdateTransforms
+};
+
+struct MeshComponent
+{
+	ID3D11Buffer* vertexBuffer;
+	ID3D11Buffer* indexBuffer;
+	UINT indexCount;
+	DXGI_FORMAT indexFormat;
+	VertexFormat vertexFormat;
+	VertexQuantization quantization;
+};
+
+struct MaterialComponent
+{
+	ID3D11ShaderResourceView* texture;
+	ID3D11ShaderResourceView* normalMap;
+	DirectX::XMFLOAT4 color;
+};
+
+struct BoundsComponent
+{
+	DirectX::BoundingSphere local;
+	DirectX::BoundingSphere world;
+	bool visible;
+};
+
+// The mesh levels of an entity, finest first, and where LodSelection has it. Level 0 is
+// the entity's own mesh; one level if its RModel has no levels of detail.
+struct LodComponent
+{
+	MeshComponent levels[LodSettings::MaxLevels];
+	uint8_t levelCount;
+	uint8_t band;
+	uint8_t level;			// in the MeshComponent
+	bool hidden;			// drawn by its impostor instead
+	Entity impostor;		// the drawable's ImpostorComponent, if it has one
+};
+
+// A whole drawable as one billboard of an impostor atlas object, on an entity of its own
+// the drawable's parts point to. Far enough away it replaces all of them.
+struct ImpostorComponent
+{
+	DirectX::BoundingSphere local;	// of all the parts, in the node's space
+	DirectX::BoundingSphere world;
+	SceneNodeHandle node;
+	DirectX::XMFLOAT2 axis;			// the node's x axis in the xz plane
+	uint32_t object;				// in the atlas
+	uint8_t band;
+	bool drawn;						// instead of the parts
+	bool visible;
+};
+
+// Geometry rasterized into the occlusion buffer, kept in the RModel it came from.
+struct OccluderComponent
+{
+	const float* positions;
+	uint32_t stride;
+	uint32_t vertexCount;
+	const uint32_t* indices;
+	uint32_t indexCount;
+};
+
+// Spins a scene node around the y axis, before its base local transform.
+struct AnimationComponent
+{
+	SceneNodeHandle node;
+	DirectX::XMMATRIX base;
+	float angularSpeed;		// radians per second
+	float angle;
+};
+
+class SceneEntities
+{
+public:
+	EntityAllocator entities;
+	ComponentPool<TransformComponent> transforms;
+	ComponentPool<MeshComponent> meshes;
+	ComponentPool<MaterialComponent> materials;
+	ComponentPool<BoundsComponent> bounds;
+	ComponentPool<LodComponent> lods;
+	ComponentPool<AnimationComponent> animations;
+	ComponentPool<OccluderComponent> occluders;
+	ComponentPool<ImpostorComponent> impostors;
+	// Slots of the visible entities in the render pools, nearest first (SortFrontToBack).
+	// Like impostorInstances, in the arena passed to the call that fills it.
+	uint32_t* drawOrder = nullptr;
+	size_t drawOrderCount = 0;
+	// The visible impostors, filled by GatherImpostors
+	ImpostorInstance* impostorInstances = nullptr;
+	size_t impostorInstanceCount = 0;
+
+	static const uint32_t NoImpostor = UINT32_MAX;
+
+	// One renderable entity per component of geo, attached to node. The new
+	// entities are appended to created if given. Large solid drawables can also be
+	// occluders; geo must then outlive the entities. Drawables baked into the impostor
+	// atlas as impostorObject switch to it when small on screen.
+	void AddDrawable(const drawable* geo, SceneNodeHandle node, std::vector<Entity>* created = nullptr, bool occluder = false,
+		uint32_t impostorObject = NoImpostor);
+	Entity AddAnimation(SceneNodeHandle node, float angularSpeed, DirectX::FXMMATRIX base = DirectX::XMMatrixIdentity());
+
+	// Puts the render pools in mesh order so the render loop walks them in lockstep.
+	void Compact();
+
+	// Systems
+	void Animate(SceneGraph& graph, float deltaTime);
+	void UpdateTransforms(const SceneGraph& graph);
+	// frustum is in world space. Sets BoundsComponent::visible and ImpostorComponent::visible;
+	// entities drawn by their impostor are not visible. The bounds are spread over jobs when given.
+	void Cull(const FrustumPlanes& frustum, JobSystem* jobs = nullptr);
+	// Adds the occluder entities to buffer at their world transforms.
+	void AddOccluders(OcclusionBuffer& buffer) const;
+	// Clears BoundsComponent::visible and ImpostorComponent::visible of visible entities
+	// and impostors hidden in buffer; returns how many.
+	size_t Occlude(const OcclusionBuffer& buffer);
+	// Fills drawOrder from BoundsComponent::visible and the view matrix, in arena along
+	// with the sort keys. Needs Compact.
+	void SortFrontToBack(DirectX::FXMMATRIX view, LinearArena& arena);
+	// Picks each entity's level by its projected size and puts that level's mesh in its
+	// MeshComponent; projScale is the projection's _22. Drawables with an impostor switch
+	// to it as a whole below settings.impostorSize. Needs Compact. Returns how many
+	// entities changed level.
+	size_t SelectLods(const LodSettings& settings, DirectX::FXMMATRIX view, float projScale, JobSystem* jobs = nullptr);
+	// Fills impostorInstances from the visible impostors, in arena.
+	void GatherImpostors(LinearArena& arena);
+};
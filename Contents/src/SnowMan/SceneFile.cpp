@@ -0,0 +1,382 @@
+#include "SceneFile.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace
+{
+	const char SceneMagic[4] = { 'S', 'C', 'N', '1' };
+	const float DegreesToRadians = 3.14159265f / 180.0f;
+
+	bool Fail(std::string* error, const std::string& message)
+	{
+		if (error)
+			*error = message;
+		return false;
+	}
+
+	// Collects records while parsing text, then packs them into the binary layout.
+	struct SceneBuilder
+	{
+		std::vector<SceneNodeRecord> nodes;
+		std::vector<SceneMaterialRecord> materials;
+		std::vector<SceneDrawableRecord> drawables;
+		std::vector<SceneLightRecord> lights;
+		std::vector<SceneLampRecord> lamps;
+		std::vector<char> strings;
+
+		uint32_t AddString(const std::string& s)
+		{
+			uint32_t offset = uint32_t(strings.size());
+			strings.insert(strings.end(), s.begin(), s.end());
+			strings.push_back('\0');
+			return offset;
+		}
+
+		template <typename T>
+		static void Append(std::vector<uint8_t>& blob, const std::vector<T>& records)
+		{
+			if (!records.empty()) {
+				const uint8_t* p = reinterpret_cast<const uint8_t*>(records.data());
+				blob.insert(blob.end(), p, p + records.size() * sizeof(T));
+			}
+		}
+
+		std::vector<uint8_t> Pack() const
+		{
+			SceneFileHeader header;
+			memcpy(header.magic, SceneMagic, sizeof(header.magic));
+			header.version = SceneFileVersion;
+			header.nodeCount = uint32_t(nodes.size());
+			header.materialCount = uint32_t(materials.size());
+			header.drawableCount = uint32_t(drawables.size());
+			header.lightCount = uint32_t(lights.size());
+			header.lampCount = uint32_t(lamps.size());
+			header.stringBytes = uint32_t(strings.size());
+
+			std::vector<uint8_t> blob(reinterpret_cast<const uint8_t*>(&header), reinterpret_cast<const uint8_t*>(&header + 1));
+			Append(blob, nodes);
+			Append(blob, materials);
+			Append(blob, drawables);
+			Append(blob, lights);
+			Append(blob, lamps);
+			blob.insert(blob.end(), strings.begin(), strings.end());
+			return blob;
+		}
+	};
+
+	bool ParseFloats(const std::vector<std::string>& tokens, size_t& i, float* out, int count)
+	{
+		for (int k = 0; k < count; k++) {
+			if (++i >= tokens.size())
+				return false;
+			char* end;
+			out[k] = strtof(tokens[i].c_str(), &end);
+			if (*end != '\0')
+				return false;
+		}
+		return true;
+	}
+
+	bool ParseWord(const std::vector<std::string>& tokens, size_t& i, std::string& out)
+	{
+		if (++i >= tokens.size())
+			return false;
+		out = tokens[i];
+		return true;
+	}
+}
+
+bool SceneFile::Load(const char* path, std::string* error)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return Fail(error, std::string("cannot open ") + path);
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	std::unique_ptr<uint8_t[]> blob(new uint8_t[size > 0 ? size : 1]);
+	size_t read = size > 0 ? fread(blob.get(), 1, size_t(size), fp) : 0;
+	fclose(fp);
+	if (read != size_t(size))
+		return Fail(error, std::string("short read on ") + path);
+
+	if (read >= sizeof(SceneMagic) && memcmp(blob.get(), SceneMagic, sizeof(SceneMagic)) == 0) {
+		m_blob = std::move(blob);
+		m_size = read;
+		return Bind(error);
+	}
+	return ParseText(reinterpret_cast<const char*>(blob.get()), read, error);
+}
+
+bool SceneFile::ParseText(const char* text, size_t length, std::string* error)
+{
+	SceneBuilder b;
+	std::map<std::string, int> nodeIndex, materialIndex;
+	static const char* kinds[] = { "terrain", "snowman", "cube", "plane", "skybox" };
+
+	size_t pos = 0;
+	int lineNumber = 0;
+	while (pos < length) {
+		size_t eol = pos;
+		while (eol < length && text[eol] != '\n')
+			eol++;
+		std::string line(text + pos, eol - pos);
+		pos = eol + 1;
+		lineNumber++;
+
+		size_t hash = line.find('#');
+		if (hash != std::string::npos)
+			line.resize(hash);
+		std::vector<std::string> tokens;
+		size_t t = 0;
+		while (t < line.size()) {
+			while (t < line.size() && isspace((unsigned char)line[t]))
+				t++;
+			size_t start = t;
+			while (t < line.size() && !isspace((unsigned char)line[t]))
+				t++;
+			if (t > start)
+				tokens.push_back(line.substr(start, t - start));
+		}
+		if (tokens.empty())
+			continue;
+
+		const std::string where = "line " + std::to_string(lineNumber) + ": ";
+		if (tokens.size() < 2)
+			return Fail(error, where + "missing name");
+		const std::string& type = tokens[0];
+		bool ok = true;
+
+		if (type == "node") {
+			if (nodeIndex.count(tokens[1]))
+				return Fail(error, where + "duplicate node " + tokens[1]);
+			SceneNodeRecord n = { b.AddString(tokens[1]), -1, { 0, 0, 0 }, { 0, 0, 0 }, { 1, 1, 1 }, 0 };
+			for (size_t i = 2; ok && i < tokens.size(); i++) {
+				std::string parent;
+				if (tokens[i] == "parent" && (ok = ParseWord(tokens, i, parent))) {
+					auto it = nodeIndex.find(parent);
+					if (it == nodeIndex.end())
+						return Fail(error, where + "unknown parent " + parent);
+					n.parent = it->second;
+				}
+				else if (tokens[i] == "translate")
+					ok = ParseFloats(tokens, i, n.translation, 3);
+				else if (tokens[i] == "rotate") {
+					ok = ParseFloats(tokens, i, n.rotation, 3);
+					for (float& r : n.rotation)
+						r *= DegreesToRadians;
+				}
+				else if (tokens[i] == "scale")
+					ok = ParseFloats(tokens, i, n.scale, 3);
+				else if (tokens[i] == "spin") {
+					ok = ParseFloats(tokens, i, &n.spin, 1);
+					n.spin *= DegreesToRadians;
+				}
+				else
+					ok = false;
+			}
+			nodeIndex[tokens[1]] = int(b.nodes.size());
+			b.nodes.push_back(n);
+		}
+		else if (type == "material") {
+			if (materialIndex.count(tokens[1]))
+				return Fail(error, where + "duplicate material " + tokens[1]);
+			SceneMaterialRecord m = { b.AddString(tokens[1]), { 1, 1, 1, 1 }, SceneNoString, SceneNoString, 0 };
+			for (size_t i = 2; ok && i < tokens.size(); i++) {
+				std::string path;
+				if (tokens[i] == "color") {
+					ok = ParseFloats(tokens, i, m.color, 4);
+					m.flags |= SceneMaterial_Color;
+				}
+				else if (tokens[i] == "texture" && (ok = ParseWord(tokens, i, path)))
+					m.texture = b.AddString(path);
+				else if (tokens[i] == "normalmap" && (ok = ParseWord(tokens, i, path)))
+					m.normalMap = b.AddString(path);
+				else if (tokens[i] != "texture" && tokens[i] != "normalmap")
+					ok = false;
+			}
+			materialIndex[tokens[1]] = int(b.materials.size());
+			b.materials.push_back(m);
+		}
+		else if (type == "drawable") {
+			SceneDrawableRecord d = { 0, -1, -1, SceneNoString, 0 };
+			size_t kind = 0;
+			while (kind < sizeof(kinds) / sizeof(kinds[0]) && tokens[1] != kinds[kind])
+				kind++;
+			if (kind == sizeof(kinds) / sizeof(kinds[0]))
+				return Fail(error, where + "unknown drawable " + tokens[1]);
+			d.kind = uint32_t(kind);
+			if (tokens.size() < 3 || !nodeIndex.count(tokens[2]))
+				return Fail(error, where + "drawable needs a declared node");
+			d.node = nodeIndex[tokens[2]];
+			for (size_t i = 3; ok && i < tokens.size(); i++) {
+				std::string word;
+				if (tokens[i] == "material" && (ok = ParseWord(tokens, i, word))) {
+					auto it = materialIndex.find(word);
+					if (it == materialIndex.end())
+						return Fail(error, where + "unknown material " + word);
+					d.material = it->second;
+				}
+				else if (tokens[i] == "heightmap" && (ok = ParseWord(tokens, i, word)))
+					d.heightMap = b.AddString(word);
+				else if (tokens[i] == "size")
+					ok = ParseFloats(tokens, i, &d.terrainDim, 1);
+				else if (tokens[i] != "material" && tokens[i] != "heightmap")
+					ok = false;
+			}
+			b.drawables.push_back(d);
+		}
+		else if (type == "light") {
+			SceneLightRecord l = { b.AddString(tokens[1]), { 0, 0, 0 }, 0, 0, 30, 30 };
+			for (size_t i = 2; ok && i < tokens.size(); i++) {
+				if (tokens[i] == "position")
+					ok = ParseFloats(tokens, i, l.position, 3);
+				else if (tokens[i] == "pitch") {
+					ok = ParseFloats(tokens, i, &l.pitch, 1);
+					l.pitch *= DegreesToRadians;
+				}
+				else if (tokens[i] == "yaw") {
+					ok = ParseFloats(tokens, i, &l.yaw, 1);
+					l.yaw *= DegreesToRadians;
+				}
+				else if (tokens[i] == "size") {
+					ok = ParseFloats(tokens, i, &l.width, 1) && ParseFloats(tokens, i, &l.height, 1);
+				}
+				else
+					ok = false;
+			}
+			b.lights.push_back(l);
+		}
+		else if (type == "lamp") {
+			SceneLampRecord l = { b.AddString(tokens[1]), -1, { 0, 0, 0 }, 5, { 1, 1, 1 }, 1 };
+			for (size_t i = 2; ok && i < tokens.size(); i++) {
+				std::string parent;
+				if (tokens[i] == "parent" && (ok = ParseWord(tokens, i, parent))) {
+					auto it = nodeIndex.find(parent);
+					if (it == nodeIndex.end())
+						return Fail(error, where + "unknown parent " + parent);
+					l.node = it->second;
+				}
+				else if (tokens[i] == "position")
+					ok = ParseFloats(tokens, i, l.position, 3);
+				else if (tokens[i] == "radius")
+					ok = ParseFloats(tokens, i, &l.radius, 1);
+				else if (tokens[i] == "color")
+					ok = ParseFloats(tokens, i, l.color, 3);
+				else if (tokens[i] == "intensity")
+					ok = ParseFloats(tokens, i, &l.intensity, 1);
+				else if (tokens[i] != "parent")
+					ok = false;
+			}
+			b.lamps.push_back(l);
+		}
+		else
+			return Fail(error, where + "unknown record " + type);
+
+		if (!ok)
+			return Fail(error, where + "bad " + type + " attributes");
+	}
+
+	std::vector<uint8_t> packed = b.Pack();
+	m_blob.reset(new uint8_t[packed.size()]);
+	memcpy(m_blob.get(), packed.data(), packed.size());
+	m_size = packed.size();
+	return Bind(error);
+}
+
+bool SceneFile::SaveBinary(const char* path) const
+{
+	if (!m_blob)
+		return false;
+	FILE* fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(m_blob.get(), 1, m_size, fp) == m_size;
+	fclose(fp);
+	return ok;
+}
+
+// Points the record arrays into the blob and checks every index and string offset,
+// so the accessors never have to.
+bool SceneFile::Bind(std::string* error)
+{
+	m_header = nullptr;
+	if (m_size < sizeof(SceneFileHeader))
+		return Fail(error, "scene file too small");
+	const SceneFileHeader* h = reinterpret_cast<const SceneFileHeader*>(m_blob.get());
+	if (memcmp(h->magic, SceneMagic, sizeof(SceneMagic)) != 0 || h->version != SceneFileVersion)
+		return Fail(error, "not a scene file of this version");
+
+	uint64_t expected = sizeof(SceneFileHeader) +
+		uint64_t(h->nodeCount) * sizeof(SceneNodeRecord) +
+		uint64_t(h->materialCount) * sizeof(SceneMaterialRecord) +
+		uint64_t(h->drawableCount) * sizeof(SceneDrawableRecord) +
+		uint64_t(h->lightCount) * sizeof(SceneLightRecord) +
+		uint64_t(h->lampCount) * sizeof(SceneLampRecord) +
+		h->stringBytes;
+	if (expected != m_size)
+		return Fail(error, "scene file size does not match its header");
+
+	const uint8_t* p = m_blob.get() + sizeof(SceneFileHeader);
+	m_nodes = reinterpret_cast<const SceneNodeRecord*>(p);
+	p += h->nodeCount * sizeof(SceneNodeRecord);
+	m_materials = reinterpret_cast<const SceneMaterialRecord*>(p);
+	p += h->materialCount * sizeof(SceneMaterialRecord);
+	m_drawables = reinterpret_cast<const SceneDrawableRecord*>(p);
+	p += h->drawableCount * sizeof(SceneDrawableRecord);
+	m_lights = reinterpret_cast<const SceneLightRecord*>(p);
+	p += h->lightCount * sizeof(SceneLightRecord);
+	m_lamps = reinterpret_cast<const SceneLampRecord*>(p);
+	p += h->lampCount * sizeof(SceneLampRecord);
+	m_strings = reinterpret_cast<const char*>(p);
+
+	if (h->stringBytes && m_strings[h->stringBytes - 1] != '\0')
+		return Fail(error, "unterminated string table");
+	// Names are required; only paths are optional.
+	auto validName = [h](uint32_t s) { return s < h->stringBytes; };
+	auto validString = [h](uint32_t s) { return s == SceneNoString || s < h->stringBytes; };
+	for (uint32_t i = 0; i < h->nodeCount; i++) {
+		if (!validName(m_nodes[i].name) || m_nodes[i].parent >= int32_t(i) || m_nodes[i].parent < -1)
+			return Fail(error, "bad node record");
+	}
+	for (uint32_t i = 0; i < h->materialCount; i++) {
+		const SceneMaterialRecord& m = m_materials[i];
+		if (!validName(m.name) || !validString(m.texture) || !validString(m.normalMap))
+			return Fail(error, "bad material record");
+	}
+	for (uint32_t i = 0; i < h->drawableCount; i++) {
+		const SceneDrawableRecord& d = m_drawables[i];
+		if (d.kind > SceneDrawable_Skybox || d.node < 0 || d.node >= int32_t(h->nodeCount) ||
+			d.material < -1 || d.material >= int32_t(h->materialCount) || !validString(d.heightMap))
+			return Fail(error, "bad drawable record");
+	}
+	for (uint32_t i = 0; i < h->lightCount; i++) {
+		if (!validName(m_lights[i].name))
+			return Fail(error, "bad light record");
+	}
+	for (uint32_t i = 0; i < h->lampCount; i++) {
+		const SceneLampRecord& l = m_lamps[i];
+		if (!validName(l.name) || l.node < -1 || l.node >= int32_t(h->nodeCount))
+			return Fail(error, "bad lamp record");
+	}
+	m_header = h;
+	return true;
+}
+
+const char* SceneFile::String(uint32_t offset) const
+{
+	return offset == SceneNoString ? nullptr : m_strings + offset;
+}
+
+int SceneFile::FindNode(const char* name) const
+{
+	for (uint32_t i = 0; i < NodeCount(); i++) {
+		if (strcmp(String(m_nodes[i].name), name) == 0)
+			return int(i);
+	}
+	return -1;
+}
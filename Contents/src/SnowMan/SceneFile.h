@@ -0,0 +1,135 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Scene description: nodes (transform hierarchy), materials, drawables, lights and lamps.
+//
+// Text form, one record per line, '#' starts a comment, angles in degrees:
+//   light    <name> position x y z  pitch p  yaw y  size w h
+//   node     <name> [parent <node>] [translate x y z] [rotate pitch yaw roll] [scale x y z] [spin degreesPerSecond]
+//   material <name> [color r g b a] [texture path] [normalmap path]
+//   drawable terrain|snowman|cube|plane|skybox <node> [material <name>] [heightmap path] [size terrainDim]
+//   lamp     <name> [parent <node>] [position x y z] [radius r] [color r g b] [intensity i]
+// Parents must be declared before their children.
+//
+// Binary form is the header, the five record arrays and a string table laid out back
+// to back. It is loaded with one read into one buffer and used in place; the text
+// form is packed into the same layout, so both are accessed the same way.
+
+const uint32_t SceneFileVersion = 2;
+const uint32_t SceneNoString = UINT32_MAX;
+
+enum SceneDrawableKind : uint32_t
+{
+	SceneDrawable_Terrain,
+	SceneDrawable_SnowMan,
+	SceneDrawable_Cube,
+	SceneDrawable_Plane,
+	SceneDrawable_Skybox,
+};
+
+struct SceneFileHeader
+{
+	char magic[4];			// "SCN1"
+	uint32_t version;
+	uint32_t nodeCount;
+	uint32_t materialCount;
+	uint32_t drawableCount;
+	uint32_t lightCount;
+	uint32_t lampCount;
+	uint32_t stringBytes;
+};
+
+// Local transform is scale, then rotation (pitch, yaw, roll in radians), then translation.
+struct SceneNodeRecord
+{
+	uint32_t name;			// string table offset
+	int32_t parent;			// node index, -1 for roots
+	float translation[3];
+	float rotation[3];
+	float scale[3];
+	float spin;				// radians per second around y, 0 for static nodes
+};
+
+struct SceneMaterialRecord
+{
+	uint32_t name;
+	float color[4];
+	uint32_t texture;		// SceneNoString keeps the drawable's own texture
+	uint32_t normalMap;
+	uint32_t flags;			// SceneMaterial_* bits
+};
+
+const uint32_t SceneMaterial_Color = 1;
+
+struct SceneDrawableRecord
+{
+	uint32_t kind;			// SceneDrawableKind
+	int32_t node;
+	int32_t material;		// -1 keeps the drawable's built-in materials
+	uint32_t heightMap;		// terrain only
+	float terrainDim;		// terrain only
+};
+
+// Orthographic shadow-casting light.
+struct SceneLightRecord
+{
+	uint32_t name;
+	float position[3];
+	float pitch;
+	float yaw;
+	float width;
+	float height;
+};
+
+// Point light, in its parent node's space.
+struct SceneLampRecord
+{
+	uint32_t name;
+	int32_t node;			// -1 for world space
+	float position[3];
+	float radius;
+	float color[3];
+	float intensity;
+};
+
+class SceneFile
+{
+public:
+	// Reads the whole file with one read. Binary files are used in place, anything
+	// else is parsed as text. On failure error (if given) says why.
+	bool Load(const char* path, std::string* error = nullptr);
+	bool ParseText(const char* text, size_t length, std::string* error = nullptr);
+	bool SaveBinary(const char* path) const;
+
+	uint32_t NodeCount() const { return m_header ? m_header->nodeCount : 0; }
+	uint32_t MaterialCount() const { return m_header ? m_header->materialCount : 0; }
+	uint32_t DrawableCount() const { return m_header ? m_header->drawableCount : 0; }
+	uint32_t LightCount() const { return m_header ? m_header->lightCount : 0; }
+	uint32_t LampCount() const { return m_header ? m_header->lampCount : 0; }
+
+	const SceneNodeRecord* Nodes() const { return m_nodes; }
+	const SceneMaterialRecord* Materials() const { return m_materials; }
+	const SceneDrawableRecord* Drawables() const { return m_drawables; }
+	const SceneLightRecord* Lights() const { return m_lights; }
+	const SceneLampRecord* Lamps() const { return m_lamps; }
+
+	// nullptr for SceneNoString.
+	const char* String(uint32_t offset) const;
+	int FindNode(const char* name) const;
+
+private:
+	bool Bind(std::string* error);
+
+	std::unique_ptr<uint8_t[]> m_blob;
+	size_t m_size = 0;
+	const SceneFileHeader* m_header = nullptr;
+	const SceneNodeRecord* m_nodes = nullptr;
+	const SceneMaterialRecord* m_materials = nullptr;
+	const SceneDrawableRecord* m_drawables = nullptr;
+	const SceneLightRecord* m_lights = nullptr;
+	const SceneLampRecord* m_lamps = nullptr;
+	const char* m_strings = nullptr;
+};
@@ -0,0 +1,204 @@
+#include "SceneGraph.h"
+#include "CameraMatrices.h"
+#include <algorithm>
+#include <stdexcept>
+
+const uint32_t SceneGraph::None;
+
+SceneNodeHandle SceneGraph::Create(const SceneMatrix& local, SceneNodeHandle parent)
+{
+	uint32_t parentDense = None;
+	if (parent.slot != None) {
+		if (!IsValid(parent))
+			throw std::invalid_argument("SceneGraph: invalid parent");
+		parentDense = Dense(parent);
+	}
+
+	uint32_t slot;
+	if (!m_freeSlots.empty()) {
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else {
+		slot = uint32_t(m_slots.size());
+		m_slots.push_back(Slot{ None, 0 });
+	}
+	uint32_t dense = uint32_t(m_local.size());
+	m_slots[slot].dense = dense;
+	m_local.push_back(local);
+	m_world.push_back(local);
+	m_parent.push_back(parentDense);
+	m_subtreeSize.push_back(1);
+	m_slotOf.push_back(slot);
+
+	// Appending keeps parents before children but not subtrees contiguous.
+	if (parentDense != None)
+		m_orderDirty = true;
+
+	SceneNodeHandle node = { slot, m_slots[slot].generation };
+	m_dirty.push_back(node);
+	return node;
+}
+
+bool SceneGraph::IsValid(SceneNodeHandle node) const
+{
+	return node.slot < m_slots.size() && m_slots[node.slot].generation == node.generation &&
+		m_slots[node.slot].dense != None;
+}
+
+void SceneGraph::Destroy(SceneNodeHandle node)
+{
+	if (!IsValid(node))
+		return;
+	if (m_orderDirty)
+		Rebuild();
+	// Unlink the subtree now; the arrays are compacted by the next Rebuild.
+	uint32_t first = Dense(node);
+	uint32_t last = first + m_subtreeSize[first];
+	for (uint32_t i = first; i < last; i++) {
+		Slot& s = m_slots[m_slotOf[i]];
+		s.dense = None;
+		s.generation++;
+		m_freeSlots.push_back(m_slotOf[i]);
+		m_slotOf[i] = None;
+	}
+	m_orderDirty = true;
+}
+
+void SceneGraph::SetParent(SceneNodeHandle node, SceneNodeHandle parent)
+{
+	if (!IsValid(node))
+		throw std::invalid_argument("SceneGraph: invalid node");
+	uint32_t dense = Dense(node);
+	uint32_t parentDense = None;
+	if (parent.slot != None) {
+		if (!IsValid(parent))
+			throw std::invalid_argument("SceneGraph: invalid parent");
+		parentDense = Dense(parent);
+		for (uint32_t p = parentDense; p != None; p = m_parent[p]) {
+			if (p == dense)
+				throw std::invalid_argument("SceneGraph: parent is inside the node's subtree");
+		}
+	}
+	m_parent[dense] = parentDense;
+	m_orderDirty = true;
+	m_dirty.push_back(node);
+}
+
+void SceneGraph::SetLocal(SceneNodeHandle node, const SceneMatrix& local)
+{
+	m_local[Dense(node)] = local;
+	m_dirty.push_back(node);
+}
+
+// Re-sorts the arrays into depth-first order, dropping destroyed nodes.
+void SceneGraph::Rebuild()
+{
+	const uint32_t count = uint32_t(m_local.size());
+
+	// Children of each node, in dense order, as one flat list.
+	std::vector<uint32_t> childStart(count + 1, 0);
+	for (uint32_t i = 0; i < count; i++) {
+		if (m_slotOf[i] != None && m_parent[i] != None)
+			childStart[m_parent[i] + 1]++;
+	}
+	for (uint32_t i = 0; i < count; i++)
+		childStart[i + 1] += childStart[i];
+	std::vector<uint32_t> children(childStart[count]);
+	std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+	for (uint32_t i = 0; i < count; i++) {
+		if (m_slotOf[i] != None && m_parent[i] != None)
+			children[fill[m_parent[i]]++] = i;
+	}
+
+	// Preorder walk from every root.
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	std::vector<uint32_t> stack;
+	for (uint32_t root = 0; root < count; root++) {
+		if (m_slotOf[root] == None || m_parent[root] != None)
+			continue;
+		stack.push_back(root);
+		while (!stack.empty()) {
+			uint32_t n = stack.back();
+			stack.pop_back();
+			order.push_back(n);
+			for (uint32_t c = childStart[n + 1]; c > childStart[n]; c--)
+				stack.push_back(children[c - 1]);
+		}
+	}
+
+	std::vector<uint32_t> newIndex(count, None);
+	for (uint32_t i = 0; i < uint32_t(order.size()); i++)
+		newIndex[order[i]] = i;
+
+	std::vector<SceneMatrix> local(order.size()), world(order.size());
+	std::vector<uint32_t> parent(order.size()), slotOf(order.size()), subtreeSize(order.size(), 1);
+	for (uint32_t i = 0; i < uint32_t(order.size()); i++) {
+		uint32_t old = order[i];
+		local[i] = m_local[old];
+		world[i] = m_world[old];
+		parent[i] = m_parent[old] == None ? None : newIndex[m_parent[old]];
+		slotOf[i] = m_slotOf[old];
+		m_slots[slotOf[i]].dense = i;
+	}
+	for (uint32_t i = uint32_t(order.size()); i-- > 0;) {
+		if (parent[i] != None)
+			subtreeSize[parent[i]] += subtreeSize[i];
+	}
+
+	m_local.swap(local);
+	m_world.swap(world);
+	m_parent.swap(parent);
+	m_slotOf.swap(slotOf);
+	m_subtreeSize.swap(subtreeSize);
+	m_orderDirty = false;
+}
+
+void SceneGraph::Update()
+{
+	if (m_orderDirty)
+		Rebuild();
+
+	// With a large share of the nodes flagged, sorting them costs more than recomputing
+	// the nodes nobody touched: one pass over everything.
+	if (m_dirty.size() >= m_local.size() / 8) {
+		m_dirty.clear();
+		for (uint32_t i = 0; i < uint32_t(m_local.size()); i++) {
+			if (m_parent[i] == None)
+				m_world[i] = m_local[i];
+			else
+				CameraMatrices::Multiply(m_local[i].m, m_world[m_parent[i]].m, m_world[i].m);
+		}
+		m_lastUpdateCount = m_local.size();
+		return;
+	}
+
+	std::vector<uint32_t>& roots = m_updateRoots;
+	roots.clear();
+	for (const SceneNodeHandle& node : m_dirty) {
+		if (IsValid(node))
+			roots.push_back(Dense(node));
+	}
+	m_dirty.clear();
+	std::sort(roots.begin(), roots.end());
+
+	// Ascending order visits a dirty parent's range before anything inside it,
+	// and lets nested dirty nodes be skipped.
+	size_t updated = 0;
+	uint32_t processedEnd = 0;
+	for (uint32_t first : roots) {
+		if (first < processedEnd)
+			continue;
+		uint32_t last = first + m_subtreeSize[first];
+		for (uint32_t i = first; i < last; i++) {
+			if (m_parent[i] == None)
+				m_world[i] = m_local[i];
+			else
+				CameraMatrices::Multiply(m_local[i].m, m_world[m_parent[i]].m, m_world[i].m);
+		}
+		updated += last - first;
+		processedEnd = last;
+	}
+	m_lastUpdateCount = updated;
+}
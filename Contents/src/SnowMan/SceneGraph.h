@@ -0,0 +1,79 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stable reference to a scene graph node. Stays valid while nodes are added,
+// removed or reordered; a destroyed node's handle fails IsValid().
+struct SceneNodeHandle
+{
+	uint32_t slot = UINT32_MAX;
+	uint32_t generation = 0;
+};
+
+// Row-major, row-vector 4x4 matrix, laid out as DirectX::XMFLOAT4X4.
+struct SceneMatrix
+{
+	float m[16];
+};
+
+// Transform hierarchy stored as flat arrays in depth-first order, so every
+// subtree is a contiguous range that starts at its root. SetLocal only flags a
+// node; Update() recomputes world matrices for the flagged subtrees, or for every
+// node once an eighth of them are flagged, in one forward pass, where parents
+// always come before their children.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+class SceneGraph
+{
+public:
+	SceneNodeHandle Create(const SceneMatrix& local, SceneNodeHandle parent = SceneNodeHandle());
+	// Destroys the node and its whole subtree.
+	void Destroy(SceneNodeHandle node);
+	bool IsValid(SceneNodeHandle node) const;
+
+	void SetParent(SceneNodeHandle node, SceneNodeHandle parent);
+	// These three take live handles only; a stale or out-of-range one asserts.
+	void SetLocal(SceneNodeHandle node, const SceneMatrix& local);
+	const SceneMatrix& Local(SceneNodeHandle node) const { return m_local[Dense(node)]; }
+	// Valid after Update().
+	const SceneMatrix& World(SceneNodeHandle node) const { return m_world[Dense(node)]; }
+
+	void Update();
+
+	size_t Size() const { return m_local.size(); }
+	// Nodes whose world matrix was recomputed by the last Update().
+	size_t LastUpdateCount() const { return m_lastUpdateCount; }
+
+private:
+	static const uint32_t None = UINT32_MAX;
+
+	struct Slot
+	{
+		uint32_t dense;
+		uint32_t generation;
+	};
+
+	uint32_t Dense(SceneNodeHandle node) const
+	{
+		assert(IsValid(node));
+		return m_slots[node.slot].dense;
+	}
+	void Rebuild();
+
+	// Indexed by handle slot.
+	std::vector<Slot> m_slots;
+	std::vector<uint32_t> m_freeSlots;
+
+	// Indexed by dense position, depth-first order once Rebuild() has run.
+	std::vector<SceneMatrix> m_local;
+	std::vector<SceneMatrix> m_world;
+	std::vector<uint32_t> m_parent;			// dense index, None for roots
+	std::vector<uint32_t> m_subtreeSize;	// including the node itself
+	std::vector<uint32_t> m_slotOf;
+
+	std::vector<SceneNodeHandle> m_dirty;	// nodes flagged since the last Update
+	std::vector<uint32_t> m_updateRoots;
+	bool m_orderDirty = false;
+	size_t m_lastUpdateCount = 0;
+};
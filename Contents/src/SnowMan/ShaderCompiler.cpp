@@ -0,0 +1,86 @@
+#include "pch.h"
+#include "ShaderCompiler.h"
+#include <comdef.h>
+
+namespace
+{
+	// Reads includes from the shader's directory and remembers which files it opened.
+	class RecordingInclude : public ID3DInclude
+	{
+	public:
+		RecordingInclude(const std::wstring& directory, std::vector<std::wstring>* opened) :
+			m_directory(directory), m_opened(opened) {}
+
+		HRESULT __stdcall Open(D3D_INCLUDE_TYPE, LPCSTR fileName, LPCVOID, LPCVOID* data, UINT* bytes) override
+		{
+			std::wstring path = m_directory + std::wstring(_bstr_t(fileName));
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file)
+				return E_FAIL;
+			std::streamoff size = file.tellg();
+			file.seekg(0);
+			char* text = new char[size_t(size)];
+			file.read(text, size);
+			*data = text;
+			*bytes = UINT(size);
+			if (m_opened)
+				m_opened->push_back(path);
+			return S_OK;
+		}
+
+		HRESULT __stdcall Close(LPCVOID data) override
+		{
+			delete[] static_cast<const char*>(data);
+			return S_OK;
+		}
+
+	private:
+		std::wstring m_directory;
+		std::vector<std::wstring>* m_opened;
+	};
+
+	std::wstring Directory(const wchar_t* path)
+	{
+		std::wstring source(path);
+		size_t slash = source.find_last_of(L"\\/");
+		return slash == std::wstring::npos ? std::wstring() : source.substr(0, slash + 1);
+	}
+}
+
+Microsoft::WRL::ComPtr<ID3DBlob> CompileShaderFile(const wchar_t* path, const char* target,
+	std::vector<std::wstring>* includes)
+{
+	RecordingInclude handler(Directory(path), includes);
+
+	UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#ifdef _DEBUG
+	flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+	Microsoft::WRL::ComPtr<ID3DBlob> code, errors;
+	HRESULT hr = D3DCompileFromFile(path, nullptr, &handler, "main", target, flags, 0,
+		code.GetAddressOf(), errors.GetAddressOf());
+	if (FAILED(hr)) {
+		std::string message = errors ? std::string(static_cast<const char*>(errors->GetBufferPointer()), errors->GetBufferSize())
+			: "D3DCompileFromFile failed";
+		throw std::runtime_error(message);
+	}
+	return code;
+}
+
+std::vector<std::wstring> FindShaderIncludes(const wchar_t* path)
+{
+	std::vector<std::wstring> includes;
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return includes;
+	std::vector<char> text(size_t(file.tellg()));
+	file.seekg(0);
+	file.read(text.data(), text.size());
+
+	RecordingInclude handler(Directory(path), &includes);
+	Microsoft::WRL::ComPtr<ID3DBlob> output, errors;
+	if (FAILED(D3DPreprocess(text.data(), text.size(), _bstr_t(path), nullptr, &handler,
+		output.GetAddressOf(), errors.GetAddressOf())))
+		includes.clear();
+	return includes;
+}
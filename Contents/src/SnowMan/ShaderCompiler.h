@@ -0,0 +1,15 @@
+#pragma once
+#include "pch.h"
+#include <d3dcompiler.h>
+#include <string>
+
+// Compiles an HLSL file at run time with entry point "main", as the FXC build step
+// does. Local includes are resolved next to path; when includes is given it
+// receives the full path of every file that was included.
+// Throws std::runtime_error with the compiler output on failure.
+Microsoft::WRL::ComPtr<ID3DBlob> CompileShaderFile(const wchar_t* path, const char* target,
+	std::vector<std::wstring>* includes = nullptr);
+
+// Files included by the shader at path, found by running only the preprocessor.
+// Empty if the file cannot be read or preprocessed.
+std::vector<std::wstring> FindShaderIncludes(const wchar_t* path);
@@ -0,0 +1,244 @@
+#include "Snowfall.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <emmintrin.h>
+
+namespace
+{
+	inline uint32_t XorShift(uint32_t x)
+	{
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return x;
+	}
+
+	// 24 random bits in [0, 1), exactly representable
+	inline float Unit(uint32_t x)
+	{
+		return float(x >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// D3D11 flushes denormal inputs and results to zero; so does the CPU while this lives.
+	class FlushDenormals
+	{
+	public:
+		FlushDenormals() : m_saved(_mm_getcsr()) { _mm_setcsr(m_saved | 0x8040); }	// FTZ | DAZ
+		~FlushDenormals() { _mm_setcsr(m_saved); }
+
+	private:
+		unsigned m_saved;
+	};
+
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline __m128i XorShift(__m128i x)
+	{
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+		return x;
+	}
+
+	inline __m128 Unit(__m128i x)
+	{
+		return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+	}
+}
+
+SnowfallParams Snowfall::MakeParams(const SnowEmitter& emitter, const SnowGround& ground, float deltaTime)
+{
+	SnowfallParams p = {};
+	for (int i = 0; i < 3; i++) {
+		p.boundsMin[i] = emitter.center[i] - emitter.extent[i];
+		p.boundsMax[i] = emitter.center[i] + emitter.extent[i];
+		p.boundsSize[i] = p.boundsMax[i] - p.boundsMin[i];
+		p.wind[i] = emitter.wind[i];
+	}
+	p.deltaTime = deltaTime;
+	p.dragStep = std::min(emitter.drag * deltaTime, 1.0f);
+	p.gravityStep = emitter.fallSpeed * emitter.drag * deltaTime;
+	p.turbulenceStep = emitter.turbulence * deltaTime;
+	if (ground.heights && ground.dim > 0) {
+		p.groundOrigin[0] = ground.origin[0];
+		p.groundOrigin[1] = ground.origin[1];
+		p.invCellSize = 1.0f / ground.cellSize;
+		p.lastCell = float(ground.dim - 1);
+		p.groundDim = ground.dim;
+	}
+	p.minSize = emitter.minSize;
+	p.sizeRange = emitter.maxSize - emitter.minSize;
+	p.particleCount = emitter.count;
+	return p;
+}
+
+void Snowfall::Spawn(const SnowfallParams& params, uint32_t id, SnowParticle* particles, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		uint32_t s = (uint32_t(i) * 2654435761u) ^ (id * 0x85EBCA6Bu) ^ 0x6A09E667u;
+		s = XorShift(s ? s : 1u);
+		SnowParticle& p = particles[i];
+		for (int axis = 0; axis < 3; axis++) {
+			s = XorShift(s);
+			p.position[axis] = params.boundsMin[axis] + Unit(s) * params.boundsSize[axis];
+			p.velocity[axis] = params.wind[axis];
+		}
+		s = XorShift(s);
+		p.size = params.minSize + Unit(s) * params.sizeRange;
+		p.seed = XorShift(s);
+	}
+}
+
+// The order of every operation below is the compute shader's; change both together.
+void Snowfall::Step(const SnowfallParams& params, const float* heights, SnowParticle* particles, size_t first, size_t last)
+{
+	FlushDenormals flush;
+	const SnowfallParams& c = params;
+	if (c.groundDim == 0)
+		heights = nullptr;
+	for (size_t i = first; i < last; i++) {
+		SnowParticle& p = particles[i];
+		uint32_t s = XorShift(p.seed);
+		float kickX = (Unit(s) - 0.5f) * c.turbulenceStep;
+		s = XorShift(s);
+		float kickZ = (Unit(s) - 0.5f) * c.turbulenceStep;
+
+		float vx = p.velocity[0] + (c.wind[0] - p.velocity[0]) * c.dragStep + kickX;
+		float vy = p.velocity[1] + (c.wind[1] - p.velocity[1]) * c.dragStep - c.gravityStep;
+		float vz = p.velocity[2] + (c.wind[2] - p.velocity[2]) * c.dragStep + kickZ;
+		float px = p.position[0] + vx * c.deltaTime;
+		float py = p.position[1] + vy * c.deltaTime;
+		float pz = p.position[2] + vz * c.deltaTime;
+
+		// Around the sides
+		px = px < c.boundsMin[0] ? px + c.boundsSize[0] : (px >= c.boundsMax[0] ? px - c.boundsSize[0] : px);
+		pz = pz < c.boundsMin[2] ? pz + c.boundsSize[2] : (pz >= c.boundsMax[2] ? pz - c.boundsSize[2] : pz);
+
+		bool landed = py < c.boundsMin[1];
+		if (heights) {
+			float fx = std::min(std::max((px - c.groundOrigin[0]) * c.invCellSize, 0.0f), c.lastCell);
+			float fz = std::min(std::max((pz - c.groundOrigin[1]) * c.invCellSize, 0.0f), c.lastCell);
+			landed = landed || py < heights[uint32_t(fz) * c.groundDim + uint32_t(fx)];
+		}
+		if (landed) {
+			s = XorShift(s);
+			px = c.boundsMin[0] + Unit(s) * c.boundsSize[0];
+			s = XorShift(s);
+			pz = c.boundsMin[2] + Unit(s) * c.boundsSize[2];
+			py = c.boundsMax[1];
+			vx = c.wind[0];
+			vy = c.wind[1];
+			vz = c.wind[2];
+		}
+
+		p.position[0] = px;
+		p.position[1] = py;
+		p.position[2] = pz;
+		p.velocity[0] = vx;
+		p.velocity[1] = vy;
+		p.velocity[2] = vz;
+		p.seed = s;
+	}
+}
+
+void Snowfall::StepSimd(const SnowfallParams& params, const float* heights, SnowParticle* particles, size_t first, size_t last)
+{
+	FlushDenormals flush;
+	const SnowfallParams& c = params;
+	if (c.groundDim == 0)
+		heights = nullptr;
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 turbulence = _mm_set1_ps(c.turbulenceStep);
+	const __m128 drag = _mm_set1_ps(c.dragStep);
+	const __m128 gravity = _mm_set1_ps(c.gravityStep);
+	const __m128 dt = _mm_set1_ps(c.deltaTime);
+	const __m128 windX = _mm_set1_ps(c.wind[0]), windY = _mm_set1_ps(c.wind[1]), windZ = _mm_set1_ps(c.wind[2]);
+	const __m128 minX = _mm_set1_ps(c.boundsMin[0]), minY = _mm_set1_ps(c.boundsMin[1]), minZ = _mm_set1_ps(c.boundsMin[2]);
+	const __m128 maxX = _mm_set1_ps(c.boundsMax[0]), maxY = _mm_set1_ps(c.boundsMax[1]), maxZ = _mm_set1_ps(c.boundsMax[2]);
+	const __m128 sizeX = _mm_set1_ps(c.boundsSize[0]), sizeZ = _mm_set1_ps(c.boundsSize[2]);
+	const __m128 originX = _mm_set1_ps(c.groundOrigin[0]), originZ = _mm_set1_ps(c.groundOrigin[1]);
+	const __m128 invCell = _mm_set1_ps(c.invCellSize), lastCell = _mm_set1_ps(c.lastCell);
+
+	size_t i = first;
+	for (; i + 4 <= last; i += 4) {
+		// Four particles are two 4x4 blocks: position and size, velocity and seed
+		float* base = &particles[i].position[0];
+		__m128 px = _mm_loadu_ps(base), vx = _mm_loadu_ps(base + 4);
+		__m128 py = _mm_loadu_ps(base + 8), vy = _mm_loadu_ps(base + 12);
+		__m128 pz = _mm_loadu_ps(base + 16), vz = _mm_loadu_ps(base + 20);
+		__m128 size = _mm_loadu_ps(base + 24), seed = _mm_loadu_ps(base + 28);
+		_MM_TRANSPOSE4_PS(px, py, pz, size);
+		_MM_TRANSPOSE4_PS(vx, vy, vz, seed);
+
+		__m128i s = XorShift(_mm_castps_si128(seed));
+		__m128 kickX = _mm_mul_ps(_mm_sub_ps(Unit(s), half), turbulence);
+		s = XorShift(s);
+		__m128 kickZ = _mm_mul_ps(_mm_sub_ps(Unit(s), half), turbulence);
+
+		vx = _mm_add_ps(_mm_add_ps(vx, _mm_mul_ps(_mm_sub_ps(windX, vx), drag)), kickX);
+		vy = _mm_sub_ps(_mm_add_ps(vy, _mm_mul_ps(_mm_sub_ps(windY, vy), drag)), gravity);
+		vz = _mm_add_ps(_mm_add_ps(vz, _mm_mul_ps(_mm_sub_ps(windZ, vz), drag)), kickZ);
+		px = _mm_add_ps(px, _mm_mul_ps(vx, dt));
+		py = _mm_add_ps(py, _mm_mul_ps(vy, dt));
+		pz = _mm_add_ps(pz, _mm_mul_ps(vz, dt));
+
+		px = Select(_mm_cmplt_ps(px, minX), _mm_add_ps(px, sizeX), Select(_mm_cmpge_ps(px, maxX), _mm_sub_ps(px, sizeX), px));
+		pz = Select(_mm_cmplt_ps(pz, minZ), _mm_add_ps(pz, sizeZ), Select(_mm_cmpge_ps(pz, maxZ), _mm_sub_ps(pz, sizeZ), pz));
+
+		__m128 landed = _mm_cmplt_ps(py, minY);
+		if (heights) {
+			__m128 fx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(px, originX), invCell), _mm_setzero_ps()), lastCell);
+			__m128 fz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(pz, originZ), invCell), _mm_setzero_ps()), lastCell);
+			alignas(16) int32_t cellX[4], cellZ[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(cellX), _mm_cvttps_epi32(fx));
+			_mm_store_si128(reinterpret_cast<__m128i*>(cellZ), _mm_cvttps_epi32(fz));
+			__m128 ground = _mm_setr_ps(heights[uint32_t(cellZ[0]) * c.groundDim + uint32_t(cellX[0])],
+				heights[uint32_t(cellZ[1]) * c.groundDim + uint32_t(cellX[1])],
+				heights[uint32_t(cellZ[2]) * c.groundDim + uint32_t(cellX[2])],
+				heights[uint32_t(cellZ[3]) * c.groundDim + uint32_t(cellX[3])]);
+			landed = _mm_or_ps(landed, _mm_cmplt_ps(py, ground));
+		}
+		if (_mm_movemask_ps(landed)) {
+			__m128i s1 = XorShift(s);
+			__m128i s2 = XorShift(s1);
+			px = Select(landed, _mm_add_ps(minX, _mm_mul_ps(Unit(s1), sizeX)), px);
+			pz = Select(landed, _mm_add_ps(minZ, _mm_mul_ps(Unit(s2), sizeZ)), pz);
+			py = Select(landed, maxY, py);
+			vx = Select(landed, windX, vx);
+			vy = Select(landed, windY, vy);
+			vz = Select(landed, windZ, vz);
+			s = _mm_castps_si128(Select(landed, _mm_castsi128_ps(s2), _mm_castsi128_ps(s)));
+		}
+
+		seed = _mm_castsi128_ps(s);
+		_MM_TRANSPOSE4_PS(px, py, pz, size);
+		_MM_TRANSPOSE4_PS(vx, vy, vz, seed);
+		_mm_storeu_ps(base, px);
+		_mm_storeu_ps(base + 4, vx);
+		_mm_storeu_ps(base + 8, py);
+		_mm_storeu_ps(base + 12, vy);
+		_mm_storeu_ps(base + 16, pz);
+		_mm_storeu_ps(base + 20, vz);
+		_mm_storeu_ps(base + 24, size);
+		_mm_storeu_ps(base + 28, seed);
+	}
+	Step(params, heights, particles, i, last);
+}
+
+void Snowfall::Simulate(const SnowfallParams& params, const float* heights, SnowParticle* particles, size_t count,
+	JobSystem* jobs, bool simd)
+{
+	auto step = [&](size_t first, size_t last) {
+		if (simd)
+			StepSimd(params, heights, particles, first, last);
+		else
+			Step(params, heights, particles, first, last);
+	};
+	if (jobs)
+		jobs->ParallelFor(0, count, 16384, step);
+	else
+		step(0, count);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class JobSystem;
+
+// One flake, as laid out in the structured buffer snowfallCompute.hlsl updates.
+struct SnowParticle
+{
+	float position[3];
+	float size;				// quad half size
+	float velocity[3];
+	uint32_t seed;			// xorshift32 state, never zero
+};
+
+// A box of falling snow in world space. Flakes that drift out of a side come back
+// in the opposite one; flakes that reach the ground respawn at the top.
+struct SnowEmitter
+{
+	float center[3] = { 0.0f, 0.0f, 0.0f };
+	float extent[3] = { 20.0f, 15.0f, 20.0f };	// half size
+	uint32_t count = 65536;
+	float wind[3] = { 0.6f, 0.0f, 0.3f };		// metres per second
+	float fallSpeed = 1.2f;						// terminal speed in still air
+	float drag = 2.0f;							// per second, pulls velocity towards the wind
+	float turbulence = 3.0f;					// random acceleration, metres per second squared
+	float minSize = 0.02f;
+	float maxSize = 0.05f;
+	bool followCamera = true;					// recentered on the camera each frame
+};
+
+// Heights the flakes land on: a dim x dim grid of world space heights, cellSize
+// apart from origin (x, z).
+struct SnowGround
+{
+	const float* heights = nullptr;
+	uint32_t dim = 0;
+	float origin[2] = { 0.0f, 0.0f };
+	float cellSize = 1.0f;
+};
+
+// One step for one emitter; mirrors the SnowfallBuffer cbuffer of snowfallCompute.hlsl.
+// Everything the step multiplies by the time step is premultiplied here, once, so the
+// CPU and the compute shader run the same additions and multiplications in the same
+// order and agree bit for bit.
+struct SnowfallParams
+{
+	float boundsMin[3];
+	float deltaTime;
+	float boundsMax[3];
+	float gravityStep;		// fallSpeed * drag * deltaTime
+	float wind[3];
+	float dragStep;			// drag * deltaTime, at most 1
+	float boundsSize[3];
+	float turbulenceStep;	// turbulence * deltaTime
+	float groundOrigin[2];
+	float invCellSize;
+	float lastCell;			// ground dim - 1, 0 without ground
+	float minSize;
+	float sizeRange;
+	uint32_t particleCount;
+	uint32_t groundDim;		// 0 without ground
+};
+
+// CPU side of the snowfall: the reference simulation the compute shader matches,
+// scalar and 4-wide SSE2, with no D3D dependency. Denormals are flushed to zero
+// while stepping, as D3D11 does.
+namespace Snowfall
+{
+	SnowfallParams MakeParams(const SnowEmitter& emitter, const SnowGround& ground, float deltaTime);
+
+	// Spreads count flakes through the emitter box; seeds come from id, so each
+	// emitter should use a different one.
+	void Spawn(const SnowfallParams& params, uint32_t id, SnowParticle* particles, size_t count);
+
+	// Advances particles [first, last) by one step. heights may be null (no ground).
+	void Step(const SnowfallParams& params, const float* heights, SnowParticle* particles, size_t first, size_t last);
+	// Same results as Step, four flakes at a time.
+	void StepSimd(const SnowfallParams& params, const float* heights, SnowParticle* particles, size_t first, size_t last);
+
+	// Steps every particle, spread over jobs when given.
+	void Simulate(const SnowfallParams& params, const float* heights, SnowParticle* particles, size_t count,
+		JobSystem* jobs = nullptr, bool simd = true);
+}
@@ -0,0 +1,98 @@
+#include "TerrainChunks.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+void TerrainNormal(const float* heights, int dim, int x, int z, float cellSize, float normal[3])
+{
+	auto h = [heights, dim](int hx, int hz) {
+		return heights[size_t(std::min(std::max(hz, 0), dim - 1)) * dim + std::min(std::max(hx, 0), dim - 1)];
+	};
+	float nx = h(x - 1, z) - h(x + 1, z);
+	float ny = 2.0f * cellSize;
+	float nz = h(x, z - 1) - h(x, z + 1);
+	float invLength = 1.0f / sqrtf(nx * nx + ny * ny + nz * nz);
+	normal[0] = nx * invLength;
+	normal[1] = ny * invLength;
+	normal[2] = nz * invLength;
+}
+
+void TerrainChunkGrid::Build(const float* heights, int dim, int chunkCells, int firstCell, int lastCell, JobSystem* jobs)
+{
+	m_chunks.clear();
+	m_chunkCells = chunkCells;
+	m_lastCell = lastCell;
+
+	for (int z0 = firstCell; z0 < lastCell; z0 += chunkCells) {
+		for (int x0 = firstCell; x0 < lastCell; x0 += chunkCells) {
+			Chunk c;
+			c.instance.originX = float(x0);
+			c.instance.originZ = float(z0);
+			m_chunks.push_back(c);
+		}
+	}
+
+	// Height bounds are independent per chunk.
+	auto bounds = [this, heights, dim](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) {
+			Chunk& c = m_chunks[i];
+			int x0 = int(c.instance.originX);
+			int z0 = int(c.instance.originZ);
+			int x1 = std::min(x0 + m_chunkCells, m_lastCell);
+			int z1 = std::min(z0 + m_chunkCells, m_lastCell);
+			c.minHeight = heights[x0 + z0 * dim];
+			c.maxHeight = c.minHeight;
+			for (int z = z0; z <= z1; z++) {
+				for (int x = x0; x <= x1; x++) {
+					c.minHeight = std::min(c.minHeight, heights[x + z * dim]);
+					c.maxHeight = std::max(c.maxHeight, heights[x + z * dim]);
+				}
+			}
+		}
+	};
+	if (jobs)
+		jobs->ParallelFor(0, m_chunks.size(), 1, bounds);
+	else
+		bounds(0, m_chunks.size());
+}
+
+size_t TerrainChunkGrid::Select(const float localToClip[16], float cellSize, TerrainChunkInstance* out) const
+{
+	// Gribb/Hartmann plane extraction for row vectors: clip = v * M, planes from the columns of M.
+	const float* m = localToClip;
+	auto column = [m](int c, float* p) { for (int r = 0; r < 4; r++) p[r] = m[r * 4 + c]; };
+	float c0[4], c1[4], c2[4], c3[4];
+	column(0, c0);
+	column(1, c1);
+	column(2, c2);
+	column(3, c3);
+	float planes[6][4];
+	for (int i = 0; i < 4; i++) {
+		planes[0][i] = c3[i] + c0[i];	// left
+		planes[1][i] = c3[i] - c0[i];	// right
+		planes[2][i] = c3[i] + c1[i];	// bottom
+		planes[3][i] = c3[i] - c1[i];	// top
+		planes[4][i] = c2[i];			// near
+		planes[5][i] = c3[i] - c2[i];	// far
+	}
+
+	size_t added = 0;
+	for (const Chunk& c : m_chunks) {
+		float minX = c.instance.originX * cellSize;
+		float minZ = c.instance.originZ * cellSize;
+		float maxX = std::min(c.instance.originX + m_chunkCells, float(m_lastCell)) * cellSize;
+		float maxZ = std::min(c.instance.originZ + m_chunkCells, float(m_lastCell)) * cellSize;
+
+		bool visible = true;
+		for (int p = 0; p < 6 && visible; p++) {
+			// Box corner furthest along the plane normal.
+			float x = planes[p][0] >= 0 ? maxX : minX;
+			float y = planes[p][1] >= 0 ? c.maxHeight : c.minHeight;
+			float z = planes[p][2] >= 0 ? maxZ : minZ;
+			visible = planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] >= 0;
+		}
+		if (visible)
+			out[added++] = c.instance;
+	}
+	return added;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class JobSystem;
+
+// Per-instance data for one chunk of the shared terrain patch, in heightmap grid coordinates.
+struct TerrainChunkInstance
+{
+	float originX;
+	float originZ;
+};
+
+// Unit normal at grid coordinate (x, z) from central differences of the neighbouring
+// heights, clamped to the grid, cellSize apart; the same normal TerrainPatch.hlsli computes.
+void TerrainNormal(const float* heights, int dim, int x, int z, float cellSize, float normal[3]);
+
+// Splits a heightmap grid into square chunks of chunkCells cells and keeps their height
+// bounds, so visible chunks can be picked every frame without touching the heights again.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+class TerrainChunkGrid
+{
+public:
+	// heights is dim x dim, row-major. Chunks cover grid coordinates [firstCell, lastCell].
+	// With jobs, chunk bounds are computed in parallel.
+	void Build(const float* heights, int dim, int chunkCells, int firstCell, int lastCell, JobSystem* jobs = nullptr);
+
+	// localToClip maps grid space (x, height, z) scaled by cellSize to clip space.
+	// Row-major, row-vector convention (DirectXMath), D3D clip depth 0..w.
+	// Writes visible chunks to out, which must have room for ChunkCount(), and returns how many.
+	size_t Select(const float localToClip[16], float cellSize, TerrainChunkInstance* out) const;
+
+	size_t ChunkCount() const { return m_chunks.size(); }
+	int ChunkCells() const { return m_chunkCells; }
+	int LastCell() const { return m_lastCell; }
+
+private:
+	struct Chunk
+	{
+		TerrainChunkInstance instance;
+		float minHeight;
+		float maxHeight;
+	};
+
+	std::vector<Chunk> m_chunks;
+	int m_chunkCells = 0;
+	int m_lastCell = 0;
+};
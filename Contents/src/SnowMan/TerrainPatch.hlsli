@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------
+// TerrainPatch.hlsli
+//
+// Vertex displacement for the instanced terrain patch (terrain::gpuDisplacement).
+//--------------------------------------------------------------------------------------
+cbuffer TerrainBuffer : register(b3)
+{
+	float4 terrainGrid;		// cell size, height scale, height offset, last grid coordinate
+	float4 terrainPatch;	// 1 / heightmap dim, cells per patch
+};
+
+Texture2D<float> txHeight : register(t0);
+
+float TerrainHeight(int2 g)
+{
+	g = clamp(g, 0, (int)terrainGrid.w + 1);
+	return txHeight.Load(int3(g, 0)) * terrainGrid.y + terrainGrid.z;
+}
+
+// local: patch vertex in [0,1]^2, chunk: grid coordinate of the patch origin
+void DisplacePatchVertex(float2 local, float2 chunk, out float3 position, out float3 normal, out float2 tex)
+{
+	int2 g = (int2)min(chunk + local * terrainPatch.y + 0.5, terrainGrid.w);
+	float h = TerrainHeight(g);
+	position = float3(g.x * terrainGrid.x, h, g.y * terrainGrid.x);
+	tex = g * terrainPatch.x;
+
+	// Central differences over neighbouring texels
+	float hl = TerrainHeight(g - int2(1, 0));
+	float hr = TerrainHeight(g + int2(1, 0));
+	float hd = TerrainHeight(g - int2(0, 1));
+	float hu = TerrainHeight(g + int2(0, 1));
+	normal = normalize(float3(hl - hr, 2.0 * terrainGrid.x, hd - hu));
+}
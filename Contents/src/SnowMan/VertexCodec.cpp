@@ -0,0 +1,210 @@
+#include "VertexCodec.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	float Sign(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	uint16_t ToUnorm16(float v)
+	{
+		return uint16_t(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	}
+
+	int16_t ToSnorm16(float v)
+	{
+		v = std::min(std::max(v, -1.0f), 1.0f) * 32767.0f;
+		return int16_t(v + (v >= 0.0f ? 0.5f : -0.5f));
+	}
+
+	float FromSnorm16(int16_t v)
+	{
+		return std::max(float(v) / 32767.0f, -1.0f);
+	}
+}
+
+uint32_t VertexCodec::Stride(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat_Compact:
+		return sizeof(VertexCompact);
+	case VertexFormat_Height:
+		return sizeof(uint16_t);
+	default:
+		return sizeof(VertexFull);
+	}
+}
+
+VertexQuantization VertexCodec::ComputeQuantization(const VertexFull* vertices, size_t count)
+{
+	float minP[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maxP[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t i = 0; i < count; i++) {
+		for (int c = 0; c < 3; c++) {
+			minP[c] = std::min(minP[c], vertices[i].position[c]);
+			maxP[c] = std::max(maxP[c], vertices[i].position[c]);
+		}
+	}
+
+	VertexQuantization q;
+	for (int c = 0; c < 3 && count > 0; c++) {
+		// Flat axes get a unit range so the decode never divides by zero.
+		float extent = maxP[c] - minP[c];
+		q.scale[c] = extent > 0.0f ? extent : 1.0f;
+		q.offset[c] = minP[c];
+	}
+	return q;
+}
+
+void VertexCodec::EncodeOctahedral(const float normal[3], float out[2])
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower hemisphere over the diagonals.
+	float l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	if (l1 <= 0.0f) {
+		out[0] = out[1] = 0.0f;
+		return;
+	}
+	float x = normal[0] / l1, y = normal[1] / l1;
+	if (normal[2] < 0.0f) {
+		out[0] = (1.0f - fabsf(y)) * Sign(x);
+		out[1] = (1.0f - fabsf(x)) * Sign(y);
+	}
+	else {
+		out[0] = x;
+		out[1] = y;
+	}
+}
+
+void VertexCodec::DecodeOctahedral(const float encoded[2], float out[3])
+{
+	float x = encoded[0], y = encoded[1];
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f) {
+		x = (1.0f - fabsf(encoded[1])) * Sign(encoded[0]);
+		y = (1.0f - fabsf(encoded[0])) * Sign(encoded[1]);
+	}
+	float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+	out[0] = x * invLength;
+	out[1] = y * invLength;
+	out[2] = z * invLength;
+}
+
+uint16_t VertexCodec::FloatToHalf(float value)
+{
+	// Round to nearest even, as the GPU's R16G16_FLOAT conversion does
+	uint32_t f;
+	memcpy(&f, &value, sizeof(f));
+	uint32_t sign = (f >> 16) & 0x8000u;
+	f &= 0x7fffffffu;
+	uint32_t h;
+	if (f >= 0x47800000u) {
+		// 65536 and up: infinity, or NaN
+		h = f > 0x7f800000u ? 0x7e00u : 0x7c00u;
+	}
+	else if (f < 0x38800000u) {
+		// Denormal: adding 0.5 lines the half's mantissa up with the bottom of the float's
+		float d;
+		memcpy(&d, &f, sizeof(d));
+		d += 0.5f;
+		memcpy(&h, &d, sizeof(h));
+		h -= 0x3f000000u;
+	}
+	else {
+		uint32_t odd = (f >> 13) & 1u;
+		f += 0xc8000fffu + odd;		// rebias the exponent from 127 to 15 and round
+		h = f >> 13;
+	}
+	return uint16_t(sign | h);
+}
+
+float VertexCodec::HalfToFloat(uint16_t value)
+{
+	uint32_t sign = uint32_t(value & 0x8000u) << 16;
+	uint32_t exponent = (value >> 10) & 0x1fu;
+	uint32_t mantissa = value & 0x3ffu;
+	uint32_t f;
+	if (exponent == 0) {
+		float d = float(mantissa) * (1.0f / 16777216.0f);
+		memcpy(&f, &d, sizeof(f));
+		f |= sign;
+	}
+	else if (exponent == 31) {
+		f = sign | 0x7f800000u | (mantissa << 13);
+	}
+	else {
+		f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float result;
+	memcpy(&result, &f, sizeof(result));
+	return result;
+}
+
+void VertexCodec::EncodeCompact(const VertexFull* vertices, size_t count, const VertexQuantization& quantization, VertexCompact* out)
+{
+	const float invScale[3] = { 1.0f / quantization.scale[0], 1.0f / quantization.scale[1], 1.0f / quantization.scale[2] };
+	for (size_t i = 0; i < count; i++) {
+		const VertexFull& v = vertices[i];
+		for (int c = 0; c < 3; c++)
+			out[i].position[c] = ToUnorm16((v.position[c] - quantization.offset[c]) * invScale[c]);
+		out[i].position[3] = 0;
+		float octahedral[2];
+		EncodeOctahedral(v.normal, octahedral);
+		out[i].normal[0] = ToSnorm16(octahedral[0]);
+		out[i].normal[1] = ToSnorm16(octahedral[1]);
+		out[i].textureCoordinate[0] = FloatToHalf(v.textureCoordinate[0]);
+		out[i].textureCoordinate[1] = FloatToHalf(v.textureCoordinate[1]);
+	}
+}
+
+VertexFull VertexCodec::DecodeCompact(const VertexCompact& vertex, const VertexQuantization& quantization)
+{
+	VertexFull v;
+	for (int c = 0; c < 3; c++)
+		v.position[c] = quantization.offset[c] + float(vertex.position[c]) / 65535.0f * quantization.scale[c];
+	const float octahedral[2] = { FromSnorm16(vertex.normal[0]), FromSnorm16(vertex.normal[1]) };
+	DecodeOctahedral(octahedral, v.normal);
+	v.textureCoordinate[0] = HalfToFloat(vertex.textureCoordinate[0]);
+	v.textureCoordinate[1] = HalfToFloat(vertex.textureCoordinate[1]);
+	return v;
+}
+
+void VertexCodec::EncodeHeights(const float* heights, size_t count, const VertexQuantization& quantization, uint16_t* out)
+{
+	const float offset = quantization.offset[1];
+	const float invScale = 1.0f / quantization.scale[1];
+	for (size_t i = 0; i < count; i++)
+		out[i] = ToUnorm16((heights[i] - offset) * invScale);
+}
+
+void VertexCodec::DecodeHeights(const uint16_t* encoded, size_t count, const VertexQuantization& quantization, float* out)
+{
+	const float offset = quantization.offset[1];
+	const float scale = quantization.scale[1] / 65535.0f;
+	for (size_t i = 0; i < count; i++)
+		out[i] = offset + float(encoded[i]) * scale;
+}
+
+VertexRoundTripError VertexCodec::MeasureError(const VertexFull* vertices, size_t count,
+	const VertexQuantization& quantization, const VertexCompact* encoded)
+{
+	VertexRoundTripError err = { 0, 0, 0 };
+	for (size_t i = 0; i < count; i++) {
+		VertexFull d = DecodeCompact(encoded[i], quantization);
+		const VertexFull& v = vertices[i];
+		for (int c = 0; c < 3; c++)
+			err.position = std::max(err.position, fabsf(d.position[c] - v.position[c]));
+		for (int c = 0; c < 2; c++)
+			err.texCoord = std::max(err.texCoord, fabsf(d.textureCoordinate[c] - v.textureCoordinate[c]));
+		float length = sqrtf(v.normal[0] * v.normal[0] + v.normal[1] * v.normal[1] + v.normal[2] * v.normal[2]);
+		if (length > 0.0f) {
+			float cosine = (d.normal[0] * v.normal[0] + d.normal[1] * v.normal[1] + d.normal[2] * v.normal[2]) / length;
+			err.normal = std::max(err.normal, acosf(std::min(std::max(cosine, -1.0f), 1.0f)));
+		}
+	}
+	return err;
+}
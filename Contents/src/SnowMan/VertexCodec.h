@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+enum VertexFormat
+{
+	VertexFormat_Full,		// VertexPositionNormalTexture, 32 bytes
+	VertexFormat_Compact,	// VertexCompact, 16 bytes
+	VertexFormat_Height,	// one 16-bit height per grid vertex, 2 bytes
+};
+
+// The full vertex, laid out as DirectX::VertexPositionNormalTexture.
+struct VertexFull
+{
+	float position[3];
+	float normal[3];
+	float textureCoordinate[2];
+};
+
+// Quantized position (unorm16 x4), octahedral normal (snorm16 x2) and half-float UV.
+struct VertexCompact
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t textureCoordinate[2];
+};
+
+// Per-mesh decode parameters, uploaded as-is to the QuantBuffer constant buffer.
+struct VertexQuantization
+{
+	float scale[4] = { 1.0f, 1.0f, 1.0f, 1.0f };	// position = offset + unorm * scale
+	float offset[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float grid[4] = { 0.0f, 0.0f, 0.0f, 0.0f };		// height streams: row length, cell size, 1 / heightmap dim, first grid coordinate
+};
+
+struct VertexRoundTripError
+{
+	float position;		// max absolute error, object space
+	float normal;		// max angle, radians
+	float texCoord;		// max absolute error
+};
+
+// Plain C++ with no D3D dependency, so it can be exercised headlessly. The decodes
+// match VertexDecode.hlsli.
+namespace VertexCodec
+{
+	uint32_t Stride(VertexFormat format);
+
+	VertexQuantization ComputeQuantization(const VertexFull* vertices, size_t count);
+
+	void EncodeCompact(const VertexFull* vertices, size_t count, const VertexQuantization& quantization, VertexCompact* out);
+	VertexFull DecodeCompact(const VertexCompact& vertex, const VertexQuantization& quantization);
+
+	// Heights are mapped to unorm16 over [offset[1], offset[1] + scale[1]].
+	void EncodeHeights(const float* heights, size_t count, const VertexQuantization& quantization, uint16_t* out);
+	void DecodeHeights(const uint16_t* encoded, size_t count, const VertexQuantization& quantization, float* out);
+
+	void EncodeOctahedral(const float normal[3], float out[2]);
+	void DecodeOctahedral(const float encoded[2], float out[3]);
+
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t value);
+
+	VertexRoundTripError MeasureError(const VertexFull* vertices, size_t count,
+		const VertexQuantization& quantization, const VertexCompact* encoded);
+}
@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------------------
+// VertexDecode.hlsli
+//
+// Decode helpers for the compact vertex formats built by VertexCodec.
+//--------------------------------------------------------------------------------------
+cbuffer QuantBuffer : register(b2)
+{
+	float4 posScale;	// position = posOffset + unorm * posScale
+	float4 posOffset;
+	float4 grid;		// row length, cell size, 1 / heightmap dim, first grid coordinate
+};
+
+float3 DecodePosition(float4 q)
+{
+	return posOffset.xyz + q.xyz * posScale.xyz;
+}
+
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * (n.xy >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
+// Height streams store one unorm16 per grid vertex; x/z and UVs come from the vertex id.
+void DecodeHeightVertex(float h, uint id, out float3 position, out float2 tex)
+{
+	uint row = (uint)grid.x;
+	float2 cell = float2(id % row, id / row) + grid.w;
+	position = float3(cell.x * grid.y, posOffset.y + h * posScale.y, cell.y * grid.y);
+	tex = cell * grid.z;
+}
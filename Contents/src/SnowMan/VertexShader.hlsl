@@ -5,6 +5,8 @@
 // Advanced Technology Group (ATG)
 // Copyright (C) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
+#include "ClipPosition.hlsli"
+
 cbuffer MatrixBuffer
 {
 	matrix worldMatrix;
@@ -33,15 +35,13 @@ struct Interpolants
 	float3 normal       : fs_Nor;
 	float2 tex          : TEXCOORD0;
 	float4 lightPosition: TEXCOORD1;
+	float3 worldPosition: TEXCOORD2;
 };
 
 Interpolants main( Vertex In )
 {
 	Interpolants Out;
-	Out.position = float4(In.position, 1.0f);
-	Out.position = mul(Out.position, worldMatrix);
-	Out.position = mul(Out.position, viewMatrix);
-	Out.position = mul(Out.position, projectionMatrix);
+	Out.position = ClipPosition(In.position, worldMatrix, viewMatrix, projectionMatrix);
 	Out.normal = mul(In.normal.xyz, (float3x3)invTransWorldMatrix).xyz;
 	Out.normal = normalize(Out.normal);
 	Out.tex = In.tex;
@@ -49,6 +49,7 @@ Interpolants main( Vertex In )
 	Out.lightPosition = mul(Out.lightPosition, worldMatrix);
 	Out.lightPosition = mul(Out.lightPosition, lightViewMatrix);
 	Out.lightPosition = mul(Out.lightPosition, lightProjectionMatrix);
+	Out.worldPosition = mul(float4(In.position, 1.0f), worldMatrix).xyz;
 
 	return Out;
 }
\ No newline at end of file
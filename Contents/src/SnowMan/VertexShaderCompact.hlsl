@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------------------
+// VertexShaderCompact.hlsl
+//
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "VertexDecode.hlsli"
+#include "ClipPosition.hlsli"
+
+cbuffer MatrixBuffer
+{
+	matrix worldMatrix;
+	matrix viewMatrix;
+	matrix projectionMatrix;
+	matrix invTransWorldMatrix;
+	matrix lightViewMatrix;
+	matrix lightProjectionMatrix;
+};
+
+cbuffer CameraBuffer 
+{
+	float4 camPos;
+};
+
+struct Vertex
+{
+	float4 position      : vs_Pos;
+	float2 normal        : vs_Nor;
+	float2 tex           : vs_Tex;
+};
+
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float3 normal       : fs_Nor;
+	float2 tex          : TEXCOORD0;
+	float4 lightPosition: TEXCOORD1;
+	float3 worldPosition: TEXCOORD2;
+};
+
+Interpolants main( Vertex In )
+{
+	Interpolants Out;
+	precise float3 position = DecodePosition(In.position);
+	Out.position = ClipPosition(position, worldMatrix, viewMatrix, projectionMatrix);
+	Out.normal = mul(DecodeOctahedral(In.normal), (float3x3)invTransWorldMatrix).xyz;
+	Out.normal = normalize(Out.normal);
+	Out.tex = In.tex;
+	Out.lightPosition = float4(position, 1.0f);
+	Out.lightPosition = mul(Out.lightPosition, worldMatrix);
+	Out.lightPosition = mul(Out.lightPosition, lightViewMatrix);
+	Out.lightPosition = mul(Out.lightPosition, lightProjectionMatrix);
+	Out.worldPosition = mul(float4(position, 1.0f), worldMatrix).xyz;
+
+	return Out;
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "ViewFrustum.h"
+#include "JobSystem.h"
+#include <cmath>
+#include <emmintrin.h>
+
+namespace
+{
+	inline const float* Sphere(const float* spheres, size_t stride, size_t i)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(spheres) + i * stride);
+	}
+
+	inline bool Intersects(const FrustumPlanes& frustum, const float* s)
+	{
+		for (int p = 0; p < 6; p++) {
+			const float* plane = frustum.planes[p];
+			if (plane[0] * s[0] + plane[1] * s[1] + plane[2] * s[2] + plane[3] < -s[3])
+				return false;
+		}
+		return true;
+	}
+}
+
+void ViewFrustum::Extract(const float matrix[16], FrustumPlanes& frustum)
+{
+	// Clip space x, y, z and w are the matrix's columns; inside is -w <= x <= w,
+	// -w <= y <= w and 0 <= z <= w
+	const float* m = matrix;
+	for (int i = 0; i < 4; i++) {
+		frustum.planes[0][i] = m[i * 4 + 3] + m[i * 4 + 0];
+		frustum.planes[1][i] = m[i * 4 + 3] - m[i * 4 + 0];
+		frustum.planes[2][i] = m[i * 4 + 3] + m[i * 4 + 1];
+		frustum.planes[3][i] = m[i * 4 + 3] - m[i * 4 + 1];
+		frustum.planes[4][i] = m[i * 4 + 2];
+		frustum.planes[5][i] = m[i * 4 + 3] - m[i * 4 + 2];
+	}
+	for (auto& p : frustum.planes) {
+		const float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		for (float& v : p)
+			v /= length;
+	}
+}
+
+void ViewFrustum::ExtractSimd(const float matrix[16], FrustumPlanes& frustum)
+{
+	__m128 x = _mm_loadu_ps(matrix), y = _mm_loadu_ps(matrix + 4), z = _mm_loadu_ps(matrix + 8), w = _mm_loadu_ps(matrix + 12);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	// Now the columns; planes as rows, then transposed back so each lane is one plane
+	__m128 p0 = _mm_add_ps(w, x), p1 = _mm_sub_ps(w, x), p2 = _mm_add_ps(w, y), p3 = _mm_sub_ps(w, y);
+	__m128 p4 = z, p5 = _mm_sub_ps(w, z), p6 = p4, p7 = p5;
+	_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+	_MM_TRANSPOSE4_PS(p4, p5, p6, p7);
+	// Same operation order as Extract, so the planes are the same to the bit
+	__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, p0), _mm_mul_ps(p1, p1)), _mm_mul_ps(p2, p2)));
+	p0 = _mm_div_ps(p0, length);
+	p1 = _mm_div_ps(p1, length);
+	p2 = _mm_div_ps(p2, length);
+	p3 = _mm_div_ps(p3, length);
+	length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p4, p4), _mm_mul_ps(p5, p5)), _mm_mul_ps(p6, p6)));
+	p4 = _mm_div_ps(p4, length);
+	p5 = _mm_div_ps(p5, length);
+	p6 = _mm_div_ps(p6, length);
+	p7 = _mm_div_ps(p7, length);
+	_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+	_MM_TRANSPOSE4_PS(p4, p5, p6, p7);
+	_mm_storeu_ps(frustum.planes[0], p0);
+	_mm_storeu_ps(frustum.planes[1], p1);
+	_mm_storeu_ps(frustum.planes[2], p2);
+	_mm_storeu_ps(frustum.planes[3], p3);
+	_mm_storeu_ps(frustum.planes[4], p4);
+	_mm_storeu_ps(frustum.planes[5], p5);
+}
+
+bool ViewFrustum::IntersectsSphere(const FrustumPlanes& frustum, const float sphere[4])
+{
+	return Intersects(frustum, sphere);
+}
+
+void ViewFrustum::CullSpheres(const FrustumPlanes& frustum, const float* spheres, size_t sphereStride,
+	uint8_t* inside, size_t insideStride, size_t first, size_t last)
+{
+	for (size_t i = first; i < last; i++)
+		inside[i * insideStride] = Intersects(frustum, Sphere(spheres, sphereStride, i));
+}
+
+void ViewFrustum::CullSpheresSimd(const FrustumPlanes& frustum, const float* spheres, size_t sphereStride,
+	uint8_t* inside, size_t insideStride, size_t first, size_t last)
+{
+	__m128 a[6], b[6], c[6], d[6];
+	for (int p = 0; p < 6; p++) {
+		a[p] = _mm_set1_ps(frustum.planes[p][0]);
+		b[p] = _mm_set1_ps(frustum.planes[p][1]);
+		c[p] = _mm_set1_ps(frustum.planes[p][2]);
+		d[p] = _mm_set1_ps(frustum.planes[p][3]);
+	}
+	const __m128 sign = _mm_set1_ps(-0.0f);
+
+	size_t i = first;
+	for (; i + 4 <= last; i += 4) {
+		__m128 x = _mm_loadu_ps(Sphere(spheres, sphereStride, i));
+		__m128 y = _mm_loadu_ps(Sphere(spheres, sphereStride, i + 1));
+		__m128 z = _mm_loadu_ps(Sphere(spheres, sphereStride, i + 2));
+		__m128 r = _mm_loadu_ps(Sphere(spheres, sphereStride, i + 3));
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+		const __m128 negative = _mm_xor_ps(r, sign);
+		__m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], x), _mm_mul_ps(b[p], y)), _mm_mul_ps(c[p], z)), d[p]);
+			in = _mm_and_ps(in, _mm_cmpge_ps(distance, negative));
+		}
+		const int mask = _mm_movemask_ps(in);
+		for (int k = 0; k < 4; k++)
+			inside[(i + k) * insideStride] = uint8_t((mask >> k) & 1);
+	}
+	CullSpheres(frustum, spheres, sphereStride, inside, insideStride, i, last);
+}
+
+void ViewFrustum::CullAll(const FrustumPlanes& frustum, const float* spheres, size_t sphereStride,
+	uint8_t* inside, size_t insideStride, size_t count, JobSystem* jobs, bool simd)
+{
+	auto cull = [&](size_t first, size_t last) {
+		if (simd)
+			CullSpheresSimd(frustum, spheres, sphereStride, inside, insideStride, first, last);
+		else
+			CullSpheres(frustum, spheres, sphereStride, inside, insideStride, first, last);
+	};
+	if (jobs)
+		jobs->ParallelFor(0, count, 4096, cull);
+	else
+		cull(0, count);
+}
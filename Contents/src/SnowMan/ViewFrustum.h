@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class JobSystem;
+
+// The six planes of a view frustum: left, right, bottom, top, near, far. Each is
+// (a, b, c, d) with a unit normal pointing inwards, so a x + b y + c z + d is the signed
+// distance of a point from it, positive inside.
+struct FrustumPlanes
+{
+	float planes[6][4];
+};
+
+// Frustum planes from a view projection matrix, and sphere tests against them. Scalar
+// and 4-wide SSE2, with the same results. Matrices are row-major, row-vector
+// (DirectXMath), with D3D's 0 to 1 clip depth; planes come out in the space the matrix
+// transforms from, so world space for a view projection.
+// Plain C++ with no D3D dependency, so it can be exercised headlessly.
+namespace ViewFrustum
+{
+	void Extract(const float matrix[16], FrustumPlanes& frustum);
+	// Same results as Extract, the four columns at once.
+	void ExtractSimd(const float matrix[16], FrustumPlanes& frustum);
+
+	// Whether a sphere (center and radius) is at least partly inside.
+	bool IntersectsSphere(const FrustumPlanes& frustum, const float sphere[4]);
+
+	// Sets inside[i] to whether sphere i of [first, last) intersects the frustum. Spheres
+	// are four floats sphereStride bytes apart; inside is insideStride bytes apart.
+	void CullSpheres(const FrustumPlanes& frustum, const float* spheres, size_t sphereStride,
+		uint8_t* inside, size_t insideStride, size_t first, size_t last);
+	// Same results as CullSpheres, four spheres at a time.
+	void CullSpheresSimd(const FrustumPlanes& frustum, const float* spheres, size_t sphereStride,
+		uint8_t* inside, size_t insideStride, size_t first, size_t last);
+
+	// Culls every sphere, spread over jobs when given.
+	void CullAll(const FrustumPlanes& frustum, const float* spheres, size_t sphereStride,
+		uint8_t* inside, size_t insideStride, size_t count, JobSystem* jobs = nullptr, bool simd = true);
+}
@@ -5,6 +5,8 @@ class drawable
 {
 public:
 	std::vector<RModel*> components;
+	// Vertex layout used when create() builds GPU buffers.
+	VertexFormat vertexFormat = VertexFormat_Full;
 	virtual void create(ID3D11Device1* device) = 0;
 	drawable();
 	~drawable();
@@ -0,0 +1,18 @@
+//--------------------------------------------------------------------------------------
+// fullScreenVert.hlsl
+//
+// One triangle covering the viewport, with no vertex buffer: draw three vertices.
+//--------------------------------------------------------------------------------------
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float2 texCoord     : TEXCOORD0;
+};
+
+Interpolants main(uint vertex : SV_VertexID)
+{
+	Interpolants Out;
+	Out.texCoord = float2((vertex << 1) & 2, vertex & 2);
+	Out.position = float4(Out.texCoord * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+	return Out;
+}
@@ -0,0 +1,135 @@
+//--------------------------------------------------------------------------------------
+// fxaaPixel.hlsl
+//
+// Fast approximate anti-aliasing of the tone-mapped image, after Lottes' FXAA 3.11:
+// find the edge through the pixel from the luma of its neighbours, walk along it to
+// both ends, and blend towards the far side by how close the nearer end is.
+//--------------------------------------------------------------------------------------
+Texture2D<float4> source : register(t0);
+SamplerState linearClamp : register(s0);
+
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float2 texCoord     : TEXCOORD0;
+};
+
+struct Pixel
+{
+	float4 color    : SV_Target;
+};
+
+static const float EdgeThreshold = 0.125f;		// of the local luma maximum
+static const float EdgeThresholdMin = 0.0312f;	// dark pixels below this are left alone
+static const float SubpixelQuality = 0.75f;
+static const int SearchSteps = 10;
+static const float SearchStep[SearchSteps] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.5f, 2.0f, 2.0f, 2.0f, 4.0f, 8.0f };
+
+float Luma(float2 uv)
+{
+	return dot(source.SampleLevel(linearClamp, uv, 0).rgb, float3(0.299f, 0.587f, 0.114f));
+}
+
+float Luma(float2 uv, int2 offset)
+{
+	return dot(source.SampleLevel(linearClamp, uv, 0, offset).rgb, float3(0.299f, 0.587f, 0.114f));
+}
+
+Pixel main(Interpolants In)
+{
+	Pixel Out;
+	float2 uv = In.texCoord;
+	float2 texel;
+	source.GetDimensions(texel.x, texel.y);
+	texel = 1.0f / texel;
+
+	float3 center = source.SampleLevel(linearClamp, uv, 0).rgb;
+	float lumaM = dot(center, float3(0.299f, 0.587f, 0.114f));
+	float lumaN = Luma(uv, int2(0, -1));
+	float lumaS = Luma(uv, int2(0, 1));
+	float lumaW = Luma(uv, int2(-1, 0));
+	float lumaE = Luma(uv, int2(1, 0));
+	float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaW, lumaE)));
+	float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaW, lumaE)));
+	float range = lumaMax - lumaMin;
+	if (range < max(EdgeThresholdMin, lumaMax * EdgeThreshold)) {
+		Out.color = float4(center, 1.0f);
+		return Out;
+	}
+
+	float lumaNW = Luma(uv, int2(-1, -1));
+	float lumaNE = Luma(uv, int2(1, -1));
+	float lumaSW = Luma(uv, int2(-1, 1));
+	float lumaSE = Luma(uv, int2(1, 1));
+
+	// A horizontal edge changes most from north to south
+	float edgeHorizontal = abs(lumaNW + lumaSW - 2.0f * lumaW) + 2.0f * abs(lumaN + lumaS - 2.0f * lumaM) + abs(lumaNE + lumaSE - 2.0f * lumaE);
+	float edgeVertical = abs(lumaNW + lumaNE - 2.0f * lumaN) + 2.0f * abs(lumaW + lumaE - 2.0f * lumaM) + abs(lumaSW + lumaSE - 2.0f * lumaS);
+	bool horizontal = edgeHorizontal >= edgeVertical;
+
+	// Which side of the pixel the edge lies on
+	float luma1 = horizontal ? lumaN : lumaW;
+	float luma2 = horizontal ? lumaS : lumaE;
+	float gradient1 = luma1 - lumaM;
+	float gradient2 = luma2 - lumaM;
+	bool steeper1 = abs(gradient1) >= abs(gradient2);
+	float gradientScaled = 0.25f * max(abs(gradient1), abs(gradient2));
+	float stepLength = horizontal ? texel.y : texel.x;
+	float lumaLocal;
+	if (steeper1) {
+		stepLength = -stepLength;
+		lumaLocal = 0.5f * (luma1 + lumaM);
+	}
+	else
+		lumaLocal = 0.5f * (luma2 + lumaM);
+
+	// Walk both ways along the edge, half a pixel towards it, until the luma leaves it
+	float2 edgeUv = uv;
+	if (horizontal)
+		edgeUv.y += 0.5f * stepLength;
+	else
+		edgeUv.x += 0.5f * stepLength;
+	float2 along = horizontal ? float2(texel.x, 0.0f) : float2(0.0f, texel.y);
+	float2 uv1 = edgeUv - along;
+	float2 uv2 = edgeUv + along;
+	float lumaEnd1 = Luma(uv1) - lumaLocal;
+	float lumaEnd2 = Luma(uv2) - lumaLocal;
+	bool reached1 = abs(lumaEnd1) >= gradientScaled;
+	bool reached2 = abs(lumaEnd2) >= gradientScaled;
+	[loop]
+	for (int i = 0; i < SearchSteps && !(reached1 && reached2); i++) {
+		if (!reached1) {
+			uv1 -= along * SearchStep[i];
+			lumaEnd1 = Luma(uv1) - lumaLocal;
+			reached1 = abs(lumaEnd1) >= gradientScaled;
+		}
+		if (!reached2) {
+			uv2 += along * SearchStep[i];
+			lumaEnd2 = Luma(uv2) - lumaLocal;
+			reached2 = abs(lumaEnd2) >= gradientScaled;
+		}
+	}
+
+	// Blend across the edge by how far the pixel is from its nearer end, if that end
+	// turns the right way
+	float distance1 = horizontal ? uv.x - uv1.x : uv.y - uv1.y;
+	float distance2 = horizontal ? uv2.x - uv.x : uv2.y - uv.y;
+	bool nearer1 = distance1 < distance2;
+	float edgeOffset = 0.5f - min(distance1, distance2) / (distance1 + distance2);
+	bool centerDarker = lumaM < lumaLocal;
+	bool turnsRight = ((nearer1 ? lumaEnd1 : lumaEnd2) < 0.0f) != centerDarker;
+	float offset = turnsRight ? edgeOffset : 0.0f;
+
+	// Single pixel features get blended by their contrast with the neighbourhood
+	float lumaAverage = (2.0f * (lumaN + lumaS + lumaW + lumaE) + lumaNW + lumaNE + lumaSW + lumaSE) / 12.0f;
+	float subpixel = saturate(abs(lumaAverage - lumaM) / range);
+	subpixel = (3.0f - 2.0f * subpixel) * subpixel * subpixel;
+	offset = max(offset, subpixel * subpixel * SubpixelQuality);
+
+	if (horizontal)
+		uv.y += offset * stepLength;
+	else
+		uv.x += offset * stepLength;
+	Out.color = float4(source.SampleLevel(linearClamp, uv, 0).rgb, 1.0f);
+	return Out;
+}
@@ -0,0 +1,31 @@
+//--------------------------------------------------------------------------------------
+// impostorBakePixel.hlsl
+//
+// One frame of an impostor atlas: unlit albedo with coverage, and the object space
+// normal with the orthographic depth across the object's bounding sphere.
+//--------------------------------------------------------------------------------------
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float3 normal       : fs_Nor;
+	float2 tex          : TEXCOORD0;
+	float4 lightPosition: TEXCOORD1;
+	float3 worldPosition: TEXCOORD2;
+};
+
+struct Pixel
+{
+	float4 albedo       : SV_Target0;
+	float4 normalDepth  : SV_Target1;
+};
+
+Texture2D txDiffuse : register(t0);
+SamplerState samLinear : register(s0);
+
+Pixel main(Interpolants In)
+{
+	Pixel Out;
+	Out.albedo = float4(txDiffuse.Sample(samLinear, In.tex).rgb, 1.0f);
+	Out.normalDepth = float4(normalize(In.normal), In.position.z);
+	return Out;
+}
@@ -0,0 +1,38 @@
+//--------------------------------------------------------------------------------------
+// impostorPixel.hlsl
+//
+// Lights an impostor frame like PixelShader.hlsl lights the meshes, less the shadow
+// map, and puts the depth back where the baked surface was.
+//--------------------------------------------------------------------------------------
+#include "ClusteredLights.hlsli"
+#include "Impostor.hlsli"
+
+struct Pixel
+{
+	float4 color    : SV_Target;
+	float depth     : SV_Depth;
+};
+
+Texture2D txAlbedo : register(t0);
+Texture2D txNormalDepth : register(t1);
+SamplerState samClamp : register(s0);
+
+Pixel main(ImpostorInterpolants In)
+{
+	Pixel Out;
+	float4 albedo = txAlbedo.Sample(samClamp, In.tex);
+	clip(albedo.a - 0.5f);
+	float4 normalDepth = txNormalDepth.Sample(samClamp, In.tex);
+	float3 normal = normalize(ImpostorToWorld(In.axis, normalDepth.xyz));
+	// Baked depth runs from the front of the bounding sphere (0) to its back (1)
+	float3 worldPosition = In.worldPosition + In.forward * (normalDepth.w * 2.0f - 1.0f);
+	float4 clipPosition = mul(float4(worldPosition, 1.0f), viewProjection);
+	Out.depth = clipPosition.z / clipPosition.w;
+
+	float3 lightDir = float3(-1.0, 1.0, -1.0);
+	float diffuseTerm = saturate(dot(normal, normalize(lightDir)));
+	float ambientTerm = 0.05;
+	float3 lamps = ClusteredLighting(In.position.xy, worldPosition, normal);
+	Out.color = float4((ambientTerm + diffuseTerm + lamps) * albedo.rgb, 1.0);
+	return Out;
+}
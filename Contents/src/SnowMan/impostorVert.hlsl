@@ -0,0 +1,46 @@
+//--------------------------------------------------------------------------------------
+// impostorVert.hlsl
+//
+// One quad per impostor instance, with no vertex buffer: the instance picks the object,
+// the vertex the corner. The quad faces the atlas frame nearest the camera's direction,
+// as that frame was baked.
+//--------------------------------------------------------------------------------------
+#include "Impostor.hlsli"
+
+struct ImpostorInstance
+{
+	float3 center;
+	float radius;
+	float2 axis;
+	uint object;
+	uint pad;
+};
+
+StructuredBuffer<ImpostorInstance> instances : register(t0);
+
+ImpostorInterpolants main(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+	ImpostorInterpolants Out;
+	ImpostorInstance instance = instances[instanceId];
+
+	// ImpostorAtlas::SelectFrame
+	float3 dir = ImpostorToObject(instance.axis, camPos.xyz - instance.center);
+	uint2 cell = min((uint2)max(EncodeHemiOctahedral(dir) * framesPerSide, 0.0f), framesPerSide - 1);
+	float3 frameDir = DecodeHemiOctahedral((cell + 0.5f) / framesPerSide);
+	// ImpostorAtlas::FrameBasis
+	float3 forward = -frameDir;
+	float3 hint = abs(frameDir.y) > 0.999f ? float3(0.0f, 0.0f, 1.0f) : float3(0.0f, 1.0f, 0.0f);
+	float3 right = normalize(cross(hint, forward));
+	float3 up = cross(forward, right);
+
+	float2 corner = float2((vertexId & 1) ? 1.0f : -1.0f, (vertexId & 2) ? -1.0f : 1.0f);
+	float3 offset = (right * corner.x + up * corner.y) * instance.radius;
+	Out.worldPosition = instance.center + ImpostorToWorld(instance.axis, offset);
+	Out.position = mul(float4(Out.worldPosition, 1.0f), viewProjection);
+	// ImpostorAtlas::FrameRect
+	uint2 frame = uint2(instance.object % objectsPerRow, instance.object / objectsPerRow) * framesPerSide + cell;
+	Out.tex = (frame + float2(0.5f + 0.5f * corner.x, 0.5f - 0.5f * corner.y)) * frameSize;
+	Out.forward = ImpostorToWorld(instance.axis, forward) * instance.radius;
+	Out.axis = instance.axis;
+	return Out;
+}
@@ -0,0 +1,46 @@
+//--------------------------------------------------------------------------------------
+// luminanceHistogram.hlsl
+//
+// Adds every pixel of the HDR scene to a 64 bin histogram of log2 luminance, for
+// auto-exposure. AutoExposure::Bin is the CPU copy of the binning, so change both
+// together. The histogram is cleared before the dispatch.
+//--------------------------------------------------------------------------------------
+cbuffer HistogramBuffer : register(b0)
+{
+	float minLogLuminance;
+	float logLuminanceScale;	// bins per stop
+	uint width;
+	uint height;
+};
+
+Texture2D<float3> hdrScene : register(t0);
+RWByteAddressBuffer histogram : register(u0);
+
+static const uint HistogramBins = 64;
+groupshared uint bins[HistogramBins];
+
+uint LuminanceBin(float3 color)
+{
+	float luminance = color.r * 0.2126f + color.g * 0.7152f + color.b * 0.0722f;
+	float t = (log2(luminance) - minLogLuminance) * logLuminanceScale;
+	if (!(t > 0.0f))
+		return 0;
+	if (t >= float(HistogramBins - 1))
+		return HistogramBins - 1;
+	return uint(t);
+}
+
+[numthreads(16, 16, 1)]
+void main(uint3 id : SV_DispatchThreadID, uint index : SV_GroupIndex)
+{
+	if (index < HistogramBins)
+		bins[index] = 0;
+	GroupMemoryBarrierWithGroupSync();
+
+	if (id.x < width && id.y < height)
+		InterlockedAdd(bins[LuminanceBin(hdrScene.Load(int3(id.xy, 0)))], 1);
+	GroupMemoryBarrierWithGroupSync();
+
+	if (index < HistogramBins && bins[index] != 0)
+		histogram.InterlockedAdd(index * 4, bins[index]);
+}
@@ -39,7 +39,7 @@
 #include <wrl/client.h>
 
 #include <d3d11_1.h>
-#include <dxgi1_2.h>
+#include <dxgi1_6.h>
 #include <DirectXMath.h>
 #include <DirectXColors.h>
 #include <wincodec.h>
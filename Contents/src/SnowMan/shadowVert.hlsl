@@ -5,6 +5,8 @@
 // Advanced Technology Group (ATG)
 // Copyright (C) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
+#include "ClipPosition.hlsli"
+
 cbuffer MatrixBuffer
 {
 	matrix worldMatrix;
@@ -37,9 +39,6 @@ struct Interpolants
 Interpolants main(Vertex In)
 {
 	Interpolants Out;
-	Out.position = float4(In.position, 1.0f);
-	Out.position = mul(Out.position, worldMatrix);
-	Out.position = mul(Out.position, lightViewMatrix);
-	Out.position = mul(Out.position, lightProjectionMatrix);
+	Out.position = ClipPosition(In.position, worldMatrix, lightViewMatrix, lightProjectionMatrix);
 	return Out;
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+//--------------------------------------------------------------------------------------
+// shadowVertHeight.hlsl
+//
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "VertexDecode.hlsli"
+#include "ClipPosition.hlsli"
+
+cbuffer MatrixBuffer
+{
+	matrix worldMatrix;
+	matrix viewMatrix;
+	matrix projectionMatrix;
+	matrix invTransWorldMatrix;
+	matrix lightViewMatrix;
+	matrix lightProjectionMatrix;
+};
+
+cbuffer CameraBuffer
+{
+	float4 camPos;
+};
+
+struct Vertex
+{
+	float height         : vs_Height;
+	uint id              : SV_VertexID;
+};
+
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float3 normal       : fs_Nor;
+	float2 tex          : TEXCOORD0;
+};
+
+Interpolants main(Vertex In)
+{
+	Interpolants Out;
+	precise float3 position;
+	float2 tex;
+	DecodeHeightVertex(In.height, In.id, position, tex);
+	Out.position = ClipPosition(position, worldMatrix, lightViewMatrix, lightProjectionMatrix);
+	return Out;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// shadowVertPatch.hlsl
+//
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TerrainPatch.hlsli"
+#include "ClipPosition.hlsli"
+
+cbuffer MatrixBuffer
+{
+	matrix worldMatrix;
+	matrix viewMatrix;
+	matrix projectionMatrix;
+	matrix invTransWorldMatrix;
+	matrix lightViewMatrix;
+	matrix lightProjectionMatrix;
+};
+
+cbuffer CameraBuffer
+{
+	float4 camPos;
+};
+
+struct Vertex
+{
+	float3 position      : vs_Pos;
+	float3 normal        : vs_Nor;
+	float2 tex           : vs_Tex;
+	float2 chunk         : vs_Chunk;
+};
+
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float3 normal       : fs_Nor;
+	float2 tex          : TEXCOORD0;
+};
+
+Interpolants main(Vertex In)
+{
+	Interpolants Out;
+	precise float3 position;
+	float3 normal;
+	float2 tex;
+	DisplacePatchVertex(In.position.xz, In.chunk, position, normal, tex);
+	Out.position = ClipPosition(position, worldMatrix, lightViewMatrix, lightProjectionMatrix);
+	return Out;
+}
\ No newline at end of file
@@ -14,11 +14,10 @@ cbuffer CameraBuffer
 struct Interpolants
 {
 	float4 position     : SV_Position;
-	float3 normal       : fs_Nor;
-	float2 tex          : fs_Tex;
+	float3 direction    : fs_Dir;
 };
 
-Texture2D txDiffuse : register(t0);
+TextureCube txSky : register(t0);
 SamplerState samLinear : register(s0);
 
 struct Pixel
@@ -30,7 +29,7 @@ struct Pixel
 Pixel main(Interpolants In)
 {
 	Pixel Out;
-	float4 col = txDiffuse.Sample(samLinear, In.tex);
+	float4 col = txSky.Sample(samLinear, normalize(In.direction));
 	Out.color = float4(col.xyz, 1.0);
 	return Out;
 }
\ No newline at end of file
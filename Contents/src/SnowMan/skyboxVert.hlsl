@@ -30,8 +30,7 @@ struct Vertex
 struct Interpolants
 {
 	float4 position     : SV_Position;
-	float3 normal       : fs_Nor;
-	float2 tex          : fs_Tex;
+	float3 direction    : fs_Dir;
 };
 
 Interpolants main(Vertex In)
@@ -41,10 +40,10 @@ Interpolants main(Vertex In)
 	float4 position = float4(In.position + camPos.xyz, 1.0f);
 	position = mul(position, viewMatrix);
 	position = mul(position, projectionMatrix);
-	position.z = position.w*0.99999;
-	Out.position = position.xyzw;
-	Out.normal = In.normal;
-	Out.tex = In.tex;
+	// Depth exactly 1: the sky passes the LESS_EQUAL test only where nothing was drawn
+	Out.position = position.xyww;
+	// The cube is centered on the camera, so its positions are the view directions
+	Out.direction = In.position;
 
 	return Out;
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+//--------------------------------------------------------------------------------------
+// snowPixel.hlsl
+//
+// Round flakes out of the quads snowVert.hlsl draws.
+//--------------------------------------------------------------------------------------
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float2 corner       : TEXCOORD0;
+};
+
+struct Pixel
+{
+	float4 color    : SV_Target;
+};
+
+Pixel main(Interpolants In)
+{
+	Pixel Out;
+	clip(1.0f - dot(In.corner, In.corner));
+	Out.color = float4(0.95f, 0.97f, 1.0f, 1.0f);
+	return Out;
+}
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// snowVert.hlsl
+//
+// One camera facing quad per flake, with no vertex buffer: the instance picks the
+// flake, the vertex the corner.
+//--------------------------------------------------------------------------------------
+cbuffer MatrixBuffer
+{
+	matrix worldMatrix;
+	matrix viewMatrix;
+	matrix projectionMatrix;
+	matrix invTransWorldMatrix;
+	matrix lightViewMatrix;
+	matrix lightProjectionMatrix;
+};
+
+struct SnowParticle
+{
+	float3 position;
+	float size;
+	float3 velocity;
+	uint seed;
+};
+
+StructuredBuffer<SnowParticle> particles : register(t0);
+
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float2 corner       : TEXCOORD0;
+};
+
+Interpolants main(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+	Interpolants Out;
+	SnowParticle p = particles[instanceId];
+	float2 corner = float2((vertexId & 1) ? 1.0f : -1.0f, (vertexId & 2) ? -1.0f : 1.0f);
+	// Offset in view space, so the quad always faces the camera
+	float4 position = mul(float4(p.position, 1.0f), viewMatrix);
+	position.xy += corner * p.size;
+	Out.position = mul(position, projectionMatrix);
+	Out.corner = corner;
+	return Out;
+}
@@ -0,0 +1,92 @@
+//--------------------------------------------------------------------------------------
+// snowfallCompute.hlsl
+//
+// Advances every flake of one emitter by a step. Snowfall::Step is the CPU copy of
+// this shader: same operations, same order, so change both together.
+//--------------------------------------------------------------------------------------
+cbuffer SnowfallBuffer : register(b0)
+{
+	float3 boundsMin;
+	float deltaTime;
+	float3 boundsMax;
+	float gravityStep;
+	float3 wind;
+	float dragStep;
+	float3 boundsSize;
+	float turbulenceStep;
+	float2 groundOrigin;
+	float invCellSize;
+	float lastCell;
+	float minSize;
+	float sizeRange;
+	uint particleCount;
+	uint groundDim;
+};
+
+struct SnowParticle
+{
+	float3 position;
+	float size;
+	float3 velocity;
+	uint seed;
+};
+
+RWStructuredBuffer<SnowParticle> particles : register(u0);
+StructuredBuffer<float> heights : register(t0);
+
+uint XorShift(uint x)
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+float Unit(uint x)
+{
+	return float(x >> 8) * (1.0f / 16777216.0f);
+}
+
+[numthreads(256, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+	if (id.x >= particleCount)
+		return;
+	SnowParticle p = particles[id.x];
+
+	uint s = XorShift(p.seed);
+	precise float kickX = (Unit(s) - 0.5f) * turbulenceStep;
+	s = XorShift(s);
+	precise float kickZ = (Unit(s) - 0.5f) * turbulenceStep;
+
+	// No mad contraction: the CPU rounds after every multiply
+	precise float3 v;
+	v.x = p.velocity.x + (wind.x - p.velocity.x) * dragStep + kickX;
+	v.y = p.velocity.y + (wind.y - p.velocity.y) * dragStep - gravityStep;
+	v.z = p.velocity.z + (wind.z - p.velocity.z) * dragStep + kickZ;
+	precise float3 pos = p.position + v * deltaTime;
+
+	// Around the sides
+	pos.x = pos.x < boundsMin.x ? pos.x + boundsSize.x : (pos.x >= boundsMax.x ? pos.x - boundsSize.x : pos.x);
+	pos.z = pos.z < boundsMin.z ? pos.z + boundsSize.z : (pos.z >= boundsMax.z ? pos.z - boundsSize.z : pos.z);
+
+	bool landed = pos.y < boundsMin.y;
+	if (groundDim > 0) {
+		precise float fx = min(max((pos.x - groundOrigin.x) * invCellSize, 0.0f), lastCell);
+		precise float fz = min(max((pos.z - groundOrigin.y) * invCellSize, 0.0f), lastCell);
+		landed = landed || pos.y < heights[uint(fz) * groundDim + uint(fx)];
+	}
+	if (landed) {
+		s = XorShift(s);
+		pos.x = boundsMin.x + Unit(s) * boundsSize.x;
+		s = XorShift(s);
+		pos.z = boundsMin.z + Unit(s) * boundsSize.z;
+		pos.y = boundsMax.y;
+		v = wind;
+	}
+
+	p.position = pos;
+	p.velocity = v;
+	p.seed = s;
+	particles[id.x] = p;
+}
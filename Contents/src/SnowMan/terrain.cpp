@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "terrain.h"
+#include "MeshBuilder.h"
+#include "JobSystem.h"
 
 terrain::terrain()
 {
@@ -11,112 +13,201 @@ terrain::~terrain()
 }
 
 void terrain::create(ID3D11Device1* device) {
-	int size = 256 * 256;
-	float* mapHeights = new float[size];
 	wchar_t buff[MAX_PATH];
 	DX::FindMediaFile(buff, MAX_PATH, HP_filename);
 	_bstr_t b(buff);
 	char* c = b;
-	FILE *fp = fopen(c, "r");
+	FILE *fp = fopen(c, "rb");
+	if (!fp)
+		throw std::runtime_error(std::string("Terrain: cannot open heightmap ") + c);
+	// Square R16 heightmap, side length derived from the file size
+	fseek(fp, 0, SEEK_END);
+	long fileSize = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	int dim = int(sqrt(double(fileSize / sizeof(uint16_t))));
+	int size = dim * dim;
+	if (fileSize < 0 || size_t(size) * sizeof(uint16_t) != size_t(fileSize)) {
+		fclose(fp);
+		throw std::runtime_error(std::string("Terrain: heightmap ") + c + " is not a square of 16-bit heights");
+	}
+	float* mapHeights = new float[size];
 	uint16_t *heightsBuffer = new uint16_t[size];
-	fread(heightsBuffer, sizeof(uint16_t), size, fp);
-	for (int i = 0; i<size; i++) {
-		mapHeights[i] = heightsBuffer[i] / 65536.0f * 256.0f * 0.05f - 2.445f;
+	const size_t read = fread(heightsBuffer, sizeof(uint16_t), size, fp);
+	fclose(fp);
+	if (read != size_t(size)) {
+		delete[] mapHeights;
+		delete[] heightsBuffer;
+		throw std::runtime_error(std::string("Terrain: could not read heightmap ") + c);
 	}
-	delete heightsBuffer;
+	auto convert = [mapHeights, heightsBuffer](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) {
+			mapHeights[i] = heightsBuffer[i] / 65536.0f * 256.0f * 0.05f - 2.445f;
+		}
+	};
+	if (jobs)
+		jobs->ParallelFor(0, size, 16384, convert);
+	else
+		convert(0, size);
+	this->width = dim;
+	this->height = dim;
+	this->heights = mapHeights;
+	if (gpuDisplacement) {
+		createPatch(device, heightsBuffer, dim);
+		delete[] heightsBuffer;
+		return;
+	}
+	delete[] heightsBuffer;
 	printf("Building terrain...\n");
-	float half_width = 0.5f*256;
-	float half_height = 0.5f*256;
-
-	const float inv_height = 1.0f / 256;
-	const float inv_width = 1.0f / 256;
 
-	
+	const float inv_height = 1.0f / dim;
+	const float inv_width = 1.0f / dim;
+	const float cellSize = terrainDim / dim;
 
 	std::vector<DirectX::VertexPositionNormalTexture> vertices;
-	std::vector<uint16_t> indices;
-	int num_vertices = (256 - 2) * (256 - 2);
-	vertices.resize((256 - 2) * (256 - 2));
+	std::vector<uint32_t> indices;
+	const int row = dim - 2;
+	vertices.resize(row * row);
+	indices.reserve((row - 1) * (row - 1) * 6);
 
 	//vertices_data
-	for (int z = 1; z<256 - 1; z++)
-	{
-		for (int x = 1; x<256 - 1; x++)
+	auto buildRows = [&](size_t firstRow, size_t lastRow) {
+		for (int z = int(firstRow); z<int(lastRow); z++)
 		{
-			float fx = (float)x;
-			float fz = (float)z;
-			//Vertex 1
-			//Position
-			vertices[((x - 1) + (z - 1)*(256 - 2))].position.x = fx / (256 / terrainDim);
-			vertices[((x - 1) + (z - 1)*(256 - 2))].position.y = mapHeights[x + z * 256];
-			vertices[((x - 1) + (z - 1)*(256 - 2))].position.z = fz / (256 / terrainDim);
-			//TexCoords
-			vertices[((x - 1) + (z - 1)*(256 - 2))].textureCoordinate.x = fx * inv_width;
-			vertices[((x - 1) + (z - 1)*(256 - 2))].textureCoordinate.y = fz * inv_height;
-			//Normal
-			vertices[((x - 1) + (z - 1)*(256 - 2))].normal.x = 0;
-			vertices[((x - 1) + (z - 1)*(256 - 2))].normal.y = 1;
-			vertices[((x - 1) + (z - 1)*(256 - 2))].normal.z = 0;
+			for (int x = 1; x<dim - 1; x++)
+			{
+				float fx = (float)x;
+				float fz = (float)z;
+				auto& v = vertices[(x - 1) + (z - 1) * row];
+				//Position
+				v.position.x = fx / (dim / terrainDim);
+				v.position.y = mapHeights[x + z * dim];
+				v.position.z = fz / (dim / terrainDim);
+				//TexCoords
+				v.textureCoordinate.x = fx * inv_width;
+				v.textureCoordinate.y = fz * inv_height;
+				//Normal, as the patch path computes it in the vertex shader
+				TerrainNormal(mapHeights, dim, x, z, cellSize, &v.normal.x);
+			}
 		}
-	}
-	//indices data
-	for (int z = 1; z<256 - 2; z++)
-	{
-		for (int x = 1; x<256 - 2; x++)
+	};
+	if (jobs)
+		jobs->ParallelFor(1, dim - 1, 16, buildRows);
+	else
+		buildRows(1, dim - 1);
+	//indices data, from the compressed pack beside the heightmap when it matches this grid;
+	//otherwise built and written back for the next load
+	std::wstring packPath = std::wstring(buff) + L".idx";
+	bool packed = MeshBuilder::LoadIndices(packPath.c_str(), indices) && !indices.empty() && indices.size() == size_t(row - 1) * (row - 1) * 6 &&
+		*std::max_element(indices.begin(), indices.end()) < uint32_t(row * row);
+	if (!packed) {
+		indices.clear();
+		for (int z = 1; z<dim - 2; z++)
 		{
-			indices.push_back((x - 1) + (z - 1) * (256 - 2));
-			indices.push_back((x - 1) + z * (256 - 2));
-			indices.push_back(x + (z - 1) * (256 - 2));
+			for (int x = 1; x<dim - 2; x++)
+			{
+				indices.push_back((x - 1) + (z - 1) * row);
+				indices.push_back((x - 1) + z * row);
+				indices.push_back(x + (z - 1) * row);
 
-			indices.push_back((x - 1) + z * (256 - 2));
-			indices.push_back(x + z * (256 - 2));
-			indices.push_back(x + (z - 1) * (256 - 2));
+				indices.push_back((x - 1) + z * row);
+				indices.push_back(x + z * row);
+				indices.push_back(x + (z - 1) * row);
+			}
 		}
+		MeshBuilder::SaveIndices(packPath.c_str(), indices);
 	}
 
-	D3D11_BUFFER_DESC vertexBufferDesc = { 0 };
-	D3D11_SUBRESOURCE_DATA vertexData = { 0 };
-	D3D11_BUFFER_DESC indexBufferDesc = { 0 };
-	D3D11_SUBRESOURCE_DATA indexData = { 0 };
-	vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.StructureByteStride = 0;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-
-	//Head
-	RModel* rmodel = new RModel();
-	rmodel->vertices = vertices;
-	rmodel->indices = indices;
-	vertexBufferDesc.ByteWidth = sizeof(DirectX::VertexPositionNormalTexture) * rmodel->vertices.size();
-	vertexData.pSysMem = rmodel->vertices.data();
+	// Grids larger than 256x256 exceed 16-bit indices; split them into 16-bit sub-meshes.
+	// The height-only stream rebuilds x/z from the vertex id, so it keeps one mesh with 32-bit indices instead.
+	MeshBuilder::Mesh mesh;
+	if (vertexFormat == VertexFormat_Height)
+		mesh = MeshBuilder::CreateHeightField(device, vertices, indices, DirectX::XMFLOAT4(float(row), cellSize, inv_width, 1.0f));
+	else
+		mesh = MeshBuilder::Create(device, vertices, indices, true, vertexFormat);
+	for (auto& sub : mesh.subMeshes) {
+		RModel* rmodel = new RModel();
+		MeshBuilder::Assign(sub, rmodel);
+		rmodel->model = DirectX::XMMatrixScaling(10.0, 10.0, 10.0);
+		rmodel->color = DirectX::XMFLOAT4(0.9, 0.9, 0.9, 1.0);
+		if (this->components.empty()) {
+			rmodel->setTexture(device, L"Media/terrainTex.jpg");
+			rmodel->setNormalMap(device, L"Media/terrainNormalMap.jpg");
+		}
+		else {
+			rmodel->texture = this->components[0]->texture;
+			rmodel->normalMap = this->components[0]->normalMap;
+		}
+		this->components.push_back(rmodel);
+	}
+}
+
+void terrain::createPatch(ID3D11Device1* device, const uint16_t* rawHeights, int dim) {
+	printf("Building terrain patch...\n");
+	// The heightmap itself is the only per-terrain GPU data.
+	D3D11_TEXTURE2D_DESC txtDesc = {};
+	txtDesc.Width = txtDesc.Height = dim;
+	txtDesc.MipLevels = txtDesc.ArraySize = 1;
+	txtDesc.Format = DXGI_FORMAT_R16_UNORM;
+	txtDesc.SampleDesc.Count = 1;
+	txtDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	txtDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = rawHeights;
+	initialData.SysMemPitch = dim * sizeof(uint16_t);
+	ID3D11Texture2D* tex;
 	DX::ThrowIfFailed(
-		device->CreateBuffer(&vertexBufferDesc, &vertexData,
-			&rmodel->vertexBuffer));
-	// Create Index buffer.
-	indexBufferDesc.ByteWidth = sizeof(uint16_t) * rmodel->indices.size();
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = rmodel->indices.data();
+		device->CreateTexture2D(&txtDesc, &initialData, &tex));
 	DX::ThrowIfFailed(
-		device->CreateBuffer(&indexBufferDesc, &indexData,
-			&rmodel->indexBuffer));
+		device->CreateShaderResourceView(tex, nullptr, &this->heightMap));
+	tex->Release();
+
+	// Same grid extent as the baked mesh: coordinates 1 .. dim - 2
+	chunks.Build(heights, dim, PatchCells, 1, dim - 2, jobs);
+	float cellSize = terrainDim / dim;
+	// unorm16 -> the same heights as the baked path (raw / 65536 * 12.8 - 2.445)
+	patchParams.grid = DirectX::XMFLOAT4(cellSize, 65535.0f / 65536.0f * 256.0f * 0.05f, -2.445f, float(dim - 2));
+	patchParams.patch = DirectX::XMFLOAT4(1.0f / dim, float(PatchCells), 0.0f, 0.0f);
 
+	// One shared (PatchCells + 1)^2 patch, unit square in x/z, same winding as the baked grid
+	std::vector<DirectX::VertexPositionNormalTexture> vertices;
+	std::vector<uint32_t> indices;
+	const int row = PatchCells + 1;
+	for (int z = 0; z < row; z++) {
+		for (int x = 0; x < row; x++) {
+			float u = float(x) / PatchCells;
+			float v = float(z) / PatchCells;
+			vertices.push_back(DirectX::VertexPositionNormalTexture(DirectX::XMFLOAT3(u, 0.0f, v), DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f), DirectX::XMFLOAT2(u, v)));
+		}
+	}
+	for (int z = 1; z < row; z++) {
+		for (int x = 1; x < row; x++) {
+			indices.push_back((x - 1) + (z - 1) * row);
+			indices.push_back((x - 1) + z * row);
+			indices.push_back(x + (z - 1) * row);
+
+			indices.push_back((x - 1) + z * row);
+			indices.push_back(x + z * row);
+			indices.push_back(x + (z - 1) * row);
+		}
+	}
+	auto mesh = MeshBuilder::Create(device, vertices, indices);
+
+	// Visible chunk origins are streamed in every pass
+	D3D11_BUFFER_DESC instanceDesc = { 0 };
+	instanceDesc.ByteWidth = UINT(sizeof(TerrainChunkInstance) * chunks.ChunkCount());
+	instanceDesc.Usage = D3D11_USAGE_DYNAMIC;
+	instanceDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	instanceDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	DX::ThrowIfFailed(
+		device->CreateBuffer(&instanceDesc, nullptr, &this->instanceBuffer));
+
+	RModel* rmodel = new RModel();
+	MeshBuilder::Assign(mesh.subMeshes[0], rmodel);
 	rmodel->model = DirectX::XMMatrixScaling(10.0, 10.0, 10.0);
 	rmodel->color = DirectX::XMFLOAT4(0.9, 0.9, 0.9, 1.0);
 	rmodel->setTexture(device, L"Media/terrainTex.jpg");
 	rmodel->setNormalMap(device, L"Media/terrainNormalMap.jpg");
 	this->components.push_back(rmodel);
-	this->width = 256;
-	this->height = 256;
-	this->heights = mapHeights;
 }
 
 float terrain::GetHeight(float x, float z) const {
@@ -4,8 +4,15 @@
 #include <GeometricPrimitive.h>
 #include "Utilities.h"
 #include "FindMedia.h"
+#include "TerrainChunks.h"
 #include <comdef.h> 
 
+struct TerrainBufferType
+{
+	DirectX::XMFLOAT4 grid;		// cell size, height scale, height offset, last grid coordinate
+	DirectX::XMFLOAT4 patch;	// 1 / heightmap dim, cells per patch
+};
+
 class terrain : public drawable
 {
 public:
@@ -18,5 +25,19 @@ public:
 	float *heights;
 	float GetHeight(float x, float z) const;
 	int GetTerrainDim() const { return terrainDim; }
+	// Optional; spreads the height conversion and chunk/vertex build over worker threads.
+	JobSystem* jobs = nullptr;
+
+	// GPU displacement mode: components[0] is one shared patch drawn instanced per visible
+	// chunk, with heights read from heightMap in the vertex shader.
+	static const int PatchCells = 32;
+	bool gpuDisplacement = false;
+	TerrainChunkGrid chunks;
+	TerrainBufferType patchParams;
+	ID3D11ShaderResourceView* heightMap = nullptr;
+	ID3D11Buffer* instanceBuffer = nullptr;
+
+private:
+	void createPatch(ID3D11Device1* device, const uint16_t* rawHeights, int dim);
 };
 
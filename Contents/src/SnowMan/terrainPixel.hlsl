@@ -6,6 +6,8 @@
 // Advanced Technology Group (ATG)
 // Copyright (C) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
+#include "ClusteredLights.hlsli"
+
 cbuffer CameraBuffer
 {
 	float4 c_color;
@@ -17,6 +19,7 @@ struct Interpolants
 	float3 normal       : fs_Nor;
 	float2 tex          : TEXCOORD0;
 	float4 lightPosition: TEXCOORD1;
+	float3 worldPosition: TEXCOORD2;
 };
 
 
@@ -95,7 +98,8 @@ Pixel main(Interpolants In)
 	float3 lightDir = float3(-1.0, 1.0, -1.0);
 	float diffuseTerm = saturate(dot(TextureNormal_worldspace, normalize(lightDir.xyz)));
 	float ambientTerm = 0.1;
+	float3 lamps = ClusteredLighting(In.position.xy, In.worldPosition, TextureNormal_worldspace);
 	float4 col = txDiffuse.Sample(samLinear, In.tex);
-	Out.color = float4(sd*(ambientTerm + diffuseTerm)*col.xyz, 1.0);
+	Out.color = float4((sd*(ambientTerm + diffuseTerm) + lamps)*col.xyz, 1.0);
 	return Out;
 }
\ No newline at end of file
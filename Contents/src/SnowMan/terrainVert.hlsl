@@ -33,6 +33,7 @@ struct Interpolants
 	float3 normal       : fs_Nor;
 	float2 tex          : TEXCOORD0;
 	float4 lightPosition: TEXCOORD1;
+	float3 worldPosition: TEXCOORD2;
 };
 
 Interpolants main(Vertex In)
@@ -49,6 +50,7 @@ Interpolants main(Vertex In)
 	Out.lightPosition = mul(Out.lightPosition, worldMatrix);
 	Out.lightPosition = mul(Out.lightPosition, lightViewMatrix);
 	Out.lightPosition = mul(Out.lightPosition, lightProjectionMatrix);
+	Out.worldPosition = mul(float4(In.position, 1.0f), worldMatrix).xyz;
 
 	return Out;
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+//--------------------------------------------------------------------------------------
+// terrainVertPatch.hlsl
+//
+//
+// Advanced Technology Group (ATG)
+// Copyright (C) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+#include "TerrainPatch.hlsli"
+#include "ClipPosition.hlsli"
+
+cbuffer MatrixBuffer
+{
+	matrix worldMatrix;
+	matrix viewMatrix;
+	matrix projectionMatrix;
+	matrix invTransWorldMatrix;
+	matrix lightViewMatrix;
+	matrix lightProjectionMatrix;
+};
+
+cbuffer CameraBuffer
+{
+	float4 camPos;
+};
+
+struct Vertex
+{
+	float3 position      : vs_Pos;
+	float3 normal        : vs_Nor;
+	float2 tex           : vs_Tex;
+	float2 chunk         : vs_Chunk;
+};
+
+struct Interpolants
+{
+	float4 position     : SV_Position;
+	float3 normal       : fs_Nor;
+	float2 tex          : TEXCOORD0;
+	float4 lightPosition: TEXCOORD1;
+	float3 worldPosition: TEXCOORD2;
+};
+
+Interpolants main(Vertex In)
+{
+	Interpolants Out;
+	precise float3 position;
+	float3 normal;
+	float2 tex;
+	DisplacePatchVertex(In.position.xz, In.chunk, position, normal, tex);
+	Out.position = ClipPosition(position, worldMatrix, viewMatrix, projectionMatrix);
+	Out.normal = mul(normal, (float3x3)invTransWorldMatrix).xyz;
+	Out.normal = normalize(Out.normal);
+	Out.tex = tex;
+	Out.lightPosition = float4(position, 1.0f);
+	Out.lightPosition = mul(Out.lightPosition, worldMatrix);
+	Out.lightPosition = mul(Out.lightPosition, lightViewMatrix);
+	Out.lightPosition = mul(Out.lightPosition, lightProjectionMatrix);
+	Out.worldPosition = mul(float4(position, 1.0f), worldMatrix).xyz;
+
+	return Out;
+}
\ No newline at end of file